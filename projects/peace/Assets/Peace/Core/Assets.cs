@@ -74,8 +74,8 @@ namespace Peace
         public static Texture2D GetTexture(IntPtr handle)
         {
             IntPtr dataPtr = IntPtr.Zero;
-            int width = 0, height = 0, type = 0;
-            readTexture(handle, ref dataPtr, ref width, ref height, ref type);
+            int width = 0, height = 0, type = 0, size = 0;
+            readTexture(handle, ref dataPtr, ref width, ref height, ref type, ref size);
             
             TextureFormat format;
             switch (type)
@@ -89,14 +89,29 @@ namespace Peace
                 case IM_RGBA:
                     format = TextureFormat.RGBA32;
                     break;
+                case IM_BC1:
+                    format = TextureFormat.DXT1;
+                    break;
+                case IM_BC3:
+                    format = TextureFormat.DXT5;
+                    break;
                 default:
                     throw new DataException("Image type not supported: " + type);
             }
-            Texture2D texture = new Texture2D(width, height, format, false);
+            int mipCount = readTextureMipCount(handle);
+            Texture2D texture = new Texture2D(width, height, format, mipCount + 1, false);
             
-            int size = width * height * type;
+            // Mip levels are stored one after the other
             byte[] data = texture.GetRawTextureData();
             Marshal.Copy(dataPtr, data, 0, size);
+            int offset = size;
+
+            for (int level = 1; level <= mipCount; ++level)
+            {
+                readTextureMip(handle, level, ref dataPtr, ref size);
+                Marshal.Copy(dataPtr, data, offset, size);
+                offset += size;
+            }
             texture.LoadRawTextureData(data);
             texture.Apply();
 
@@ -107,6 +122,8 @@ namespace Peace
         private const int IM_GREY = 1;
         private const int IM_RGB = 3;
         private const int IM_RGBA = 4;
+        private const int IM_BC1 = 8;
+        private const int IM_BC3 = 16;
         
         [StructLayout(LayoutKind.Sequential)]
         struct MaterialDescription
@@ -114,7 +131,9 @@ namespace Peace
             public string MapKd;
             public double Kdr, Kdg, Kdb;
             public double Ksr, Ksg, Ksb;
-            public bool transparent;
+            // Native bools are one byte
+            [MarshalAs(UnmanagedType.I1)] public bool transparent;
+            [MarshalAs(UnmanagedType.I1)] public bool doubleSided;
         }
 
         [DllImport("peace")]
@@ -128,7 +147,14 @@ namespace Peace
 
         [DllImport("peace")]
         private static extern void readTexture(IntPtr texturePtr, ref IntPtr data,
-            ref int width, ref int height, ref int type);
+            ref int width, ref int height, ref int type, ref int size);
+
+        [DllImport("peace")]
+        private static extern int readTextureMipCount(IntPtr texturePtr);
+
+        [DllImport("peace")]
+        private static extern void readTextureMip(IntPtr texturePtr, int level,
+            ref IntPtr data, ref int size);
     }
 }
 
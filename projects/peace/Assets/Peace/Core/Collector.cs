@@ -21,6 +21,8 @@ namespace Peace
         private Dictionary<string, Mesh> _meshes;
         private Dictionary<string, Material> _materials;
         private Dictionary<string, Texture2D> _textures;
+        private Dictionary<string, InstanceGroup> _instances;
+        private bool _instancesEnabled;
         
         public CollectorStats LastStats = new CollectorStats();
 
@@ -34,6 +36,7 @@ namespace Peace
             _meshes = new Dictionary<string, Mesh>();
             _materials = new Dictionary<string, Material>();
             _textures = new Dictionary<string, Texture2D>();
+            _instances = new Dictionary<string, InstanceGroup>();
 
             SetPosition(Vector3.zero);
             _view.eyeResolution = 700;
@@ -52,6 +55,18 @@ namespace Peace
             _meshes.Clear();
             _materials.Clear();
             _textures.Clear();
+            _instances.Clear();
+        }
+
+        /// <summary>
+        /// Collect the objects placed many times, such as trees, as instance
+        /// groups instead of one node per copy. They are then read with
+        /// GetInstances().
+        /// </summary>
+        public void EnableInstances()
+        {
+            collectorAddInstanceChannel(_handle);
+            _instancesEnabled = true;
         }
 
         public void SetPosition(Vector3 position)
@@ -80,8 +95,8 @@ namespace Peace
             sw.Start();
 
             // Get from native code
-            IntPtr[] nodes = new IntPtr[0], meshes = new IntPtr[0], materials = new IntPtr[0], textures = new IntPtr[0];
-            string[] nodeNames = new string[0], meshNames = new string[0], materialNames = new string[0], textureNames = new string[0];
+            IntPtr[] nodes = new IntPtr[0], meshes = new IntPtr[0], materials = new IntPtr[0], textures = new IntPtr[0], instances = new IntPtr[0];
+            string[] nodeNames = new string[0], meshNames = new string[0], materialNames = new string[0], textureNames = new string[0], instanceNames = new string[0];
 
             await Task.Run(() =>
             {
@@ -89,6 +104,11 @@ namespace Peace
                 GetChannel(MESH_CHANNEL, out meshNames, out meshes);
                 GetChannel(MATERIAL_CHANNEL, out materialNames, out materials);
                 GetChannel(TEXTURE_CHANNEL, out textureNames, out textures);
+
+                if (_instancesEnabled)
+                {
+                    GetChannel(INSTANCE_CHANNEL, out instanceNames, out instances);
+                }
             });
 
             double l = LastStats.interopTime = sw.Elapsed.TotalMilliseconds;
@@ -115,6 +135,26 @@ namespace Peace
                 _nodes.Remove(key);
             }
 
+            // Update instances
+            toRemove = new HashSet<string>(_instances.Keys);
+
+            for (int i = 0; i < instances.Length; ++i)
+            {
+                if (!_instances.ContainsKey(instanceNames[i]))
+                {
+                    _instances.Add(instanceNames[i], ReadInstanceGroup(instances[i]));
+                }
+                else
+                {
+                    toRemove.Remove(instanceNames[i]);
+                }
+            }
+
+            foreach (var key in toRemove)
+            {
+                _instances.Remove(key);
+            }
+
             LastStats.nodesTime = sw.Elapsed.TotalMilliseconds - l;
             l = sw.Elapsed.TotalMilliseconds;
 
@@ -225,12 +265,53 @@ namespace Peace
             return _materials.TryGetValue(key, out material) ? material : null;
         }
 
+        public IEnumerable<InstanceGroup> GetInstances()
+        {
+            return _instances.Values;
+        }
+
+        private static InstanceGroup ReadInstanceGroup(IntPtr handle)
+        {
+            CollectorInstances native = readInstances(handle);
+            float[] data = new float[native.Count * 9];
+
+            if (data.Length != 0)
+            {
+                Marshal.Copy(native.Transforms, data, 0, data.Length);
+            }
+
+            InstanceGroup group = new InstanceGroup();
+            group.Mesh = native.Mesh;
+            group.Material = native.Material;
+            group.Transforms = new Matrix4x4[native.Count];
+
+            // Position, rotation and scale, with Y and Z swapped as for the nodes
+            for (int i = 0; i < native.Count; ++i)
+            {
+                int o = i * 9;
+                Vector3 position = new Vector3(data[o + 0], data[o + 2], data[o + 1]);
+                Quaternion rotation = Quaternion.Euler(data[o + 3], data[o + 5], data[o + 4]);
+                Vector3 scale = new Vector3(data[o + 6], data[o + 8], data[o + 7]);
+                group.Transforms[i] = Matrix4x4.TRS(position, rotation, scale);
+            }
+
+            return group;
+        }
+
 
         // Dll functions
         private const int NODE_CHANNEL = 0;
         private const int MESH_CHANNEL = 1;
         private const int MATERIAL_CHANNEL = 2;
         private const int TEXTURE_CHANNEL = 3;
+        private const int INSTANCE_CHANNEL = 4;
+
+        public class InstanceGroup
+        {
+            public string Mesh;
+            public string Material;
+            public Matrix4x4[] Transforms;
+        }
         
         [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
         public struct CollectorNode
@@ -242,6 +323,16 @@ namespace Peace
             public double rotX, rotY, rotZ;
         }
 
+        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+        struct CollectorInstances
+        {
+            public string Mesh;
+            public string Material;
+            public int Count;
+            // Count transforms of 9 floats each: position, rotation and scale
+            public IntPtr Transforms;
+        }
+
         [StructLayout(LayoutKind.Sequential)]
         struct CollectorView
         {
@@ -256,6 +347,9 @@ namespace Peace
         [DllImport("peace")]
         private static extern void freeCollector(IntPtr handle);
         
+        [DllImport("peace")]
+        private static extern void collectorAddInstanceChannel(IntPtr collectorPtr);
+        
         [DllImport("peace")]
         private static extern void collect(IntPtr collector, IntPtr world, CollectorView view);
 
@@ -269,5 +363,8 @@ namespace Peace
 
         [DllImport("peace")]
         private static extern CollectorNode readNode(IntPtr nodePtr);
+
+        [DllImport("peace")]
+        private static extern CollectorInstances readInstances(IntPtr bufferPtr);
     }
 }
\ No newline at end of file
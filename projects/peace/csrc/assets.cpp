@@ -11,6 +11,7 @@ struct MaterialDescription {
     double Kdr, Kdg, Kdb;
     double Ksr, Ksg, Ksb;
     bool transparent;
+    bool doubleSided;
 };
 
 #define DOUBLE_VERTEX_SIZE (sizeof(Vertex) / sizeof(double))
@@ -55,16 +56,44 @@ PEACE_EXPORT MaterialDescription readMaterial(MaterialPtr materialPtr) {
     result.Ksb = ks._b;
 
     result.transparent = material->isTransparent();
+    result.doubleSided = material->isDoubleSided();
 
     return result;
 }
 
+// Texture types are the size of a pixel for uncompressed textures, and the
+// size of a 4x4 block for block compressed textures.
+#define TEXTURE_TYPE_BC1 8
+#define TEXTURE_TYPE_BC3 16
+
 PEACE_EXPORT void readTexture(TexturePtr texturePtr, u8 **data, int *width,
-                              int *height, int *type) {
+                              int *height, int *type, int *size) {
     auto *image = static_cast<Image *>(texturePtr);
     *width = image->width();
     *height = image->height();
-    *type = image->elemSize();
-    *data = reinterpret_cast<u8 *>(&image->grey(0, 0));
+    *size = image->size();
+    *data = image->data();
+
+    switch (image->type()) {
+    case ImageType::BC1:
+        *type = TEXTURE_TYPE_BC1;
+        break;
+    case ImageType::BC3:
+        *type = TEXTURE_TYPE_BC3;
+        break;
+    default:
+        *type = image->elemSize();
+    }
+}
+
+PEACE_EXPORT int readTextureMipCount(TexturePtr texturePtr) {
+    return static_cast<Image *>(texturePtr)->mipCount();
+}
+
+PEACE_EXPORT void readTextureMip(TexturePtr texturePtr, int level, u8 **data,
+                                 int *size) {
+    auto &mip = static_cast<Image *>(texturePtr)->mip(level);
+    *size = mip.size();
+    *data = mip.data();
 }
 }
\ No newline at end of file
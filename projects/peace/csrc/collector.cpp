@@ -31,10 +31,20 @@ struct PEACE_EXPORT CollectorNode {
     double rotX, rotY, rotZ;
 };
 
+struct PEACE_EXPORT CollectorInstances {
+    char *mesh;
+    char *material;
+    int count;
+    /// Array of count transforms of 9 floats each: position, rotation and
+    /// scale
+    float *transforms;
+};
+
 const int NODE_CHANNEL = 0;
 const int MESH_CHANNEL = 1;
 const int MATERIAL_CHANNEL = 2;
 const int TEXTURE_CHANNEL = 3;
+const int INSTANCE_CHANNEL = 4;
 
 PEACE_EXPORT CollectorPtr createCollector() {
     return new Collector(CollectorPresets::SCENE);
@@ -44,6 +54,16 @@ PEACE_EXPORT void freeCollector(CollectorPtr collectorPtr) {
     delete static_cast<Collector *>(collectorPtr);
 }
 
+/** Collect the instanced objects in the instance channel, as InstanceBuffer,
+ * instead of the node channel. */
+PEACE_EXPORT void collectorAddInstanceChannel(CollectorPtr collectorPtr) {
+    auto *collector = static_cast<Collector *>(collectorPtr);
+
+    if (!collector->hasStorageChannel<InstanceBuffer>()) {
+        collector->addStorageChannel<InstanceBuffer>();
+    }
+}
+
 PEACE_EXPORT void collect(CollectorPtr collectorPtr, WorldPtr worldPtr,
                           CollectorView view) {
     auto *collector = static_cast<Collector *>(collectorPtr);
@@ -66,6 +86,10 @@ PEACE_EXPORT int collectorGetChannelSize(CollectorPtr collectorPtr, int type) {
         return collector->getStorageChannel<Material>().size();
     case TEXTURE_CHANNEL:
         return collector->getStorageChannel<Image>().size();
+    case INSTANCE_CHANNEL:
+        return collector->hasStorageChannel<InstanceBuffer>()
+                   ? collector->getStorageChannel<InstanceBuffer>().size()
+                   : 0;
     default:
         return -1;
     }
@@ -92,6 +116,12 @@ PEACE_EXPORT void collectorGetChannel(CollectorPtr collectorPtr, int type,
         getChannelContent(collector->getStorageChannel<Image>(), names,
                           objects);
         break;
+    case INSTANCE_CHANNEL:
+        if (collector->hasStorageChannel<InstanceBuffer>()) {
+            getChannelContent(collector->getStorageChannel<InstanceBuffer>(),
+                              names, objects);
+        }
+        break;
     default:
         // Return error
         break;
@@ -116,4 +146,15 @@ PEACE_EXPORT CollectorNode readNode(SceneNodePtr nodePtr) {
     result.rotZ = rot.z;
     return result;
 }
+
+PEACE_EXPORT CollectorInstances readInstances(InstanceBufferPtr bufferPtr) {
+    auto *buffer = static_cast<InstanceBuffer *>(bufferPtr);
+    CollectorInstances result{};
+    result.mesh = const_cast<char *>(buffer->getMeshID().c_str());
+    result.material = const_cast<char *>(buffer->getMaterialID().c_str());
+    result.count = static_cast<int>(buffer->size());
+    result.transforms = const_cast<float *>(
+        reinterpret_cast<const float *>(buffer->data()));
+    return result;
+}
 }
@@ -15,6 +15,7 @@
 typedef void *CollectorPtr;
 typedef void *WorldPtr;
 typedef void *SceneNodePtr;
+typedef void *InstanceBufferPtr;
 typedef void *MeshPtr;
 typedef void *MaterialPtr;
 typedef void *TexturePtr;
@@ -0,0 +1,382 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace world {
+
+/** Minimum count of block lines given to each thread, so that small images
+ * are not split into jobs too small to be worth a thread. */
+static const int MIN_LINES_PER_THREAD = 8;
+
+/** Load the 4x4 block at (bx, by) as 16 RGBA pixels. Border blocks are
+ * padded by repeating the last line and column of the image. */
+static void loadBlock(const Image &src, int bx, int by, u8 *block) {
+    const int elemSize = src.elemSize();
+    const int width = src.width();
+    const int height = src.height();
+
+    for (int j = 0; j < 4; ++j) {
+        const int y = std::min(by * 4 + j, height - 1);
+        const u8 *line = src.data() + y * width * elemSize;
+
+        for (int i = 0; i < 4; ++i) {
+            const int x = std::min(bx * 4 + i, width - 1);
+            const u8 *pixel = line + x * elemSize;
+            u8 *dst = block + (j * 4 + i) * 4;
+
+            if (elemSize == 1) {
+                dst[0] = dst[1] = dst[2] = pixel[0];
+                dst[3] = 255;
+            } else {
+                dst[0] = pixel[0];
+                dst[1] = pixel[1];
+                dst[2] = pixel[2];
+                dst[3] = elemSize == 4 ? pixel[3] : u8(255);
+            }
+        }
+    }
+}
+
+static u16 to565(const int *rgb) {
+    const int r = (rgb[0] * 31 + 127) / 255;
+    const int g = (rgb[1] * 63 + 127) / 255;
+    const int b = (rgb[2] * 31 + 127) / 255;
+    return static_cast<u16>((r << 11) | (g << 5) | b);
+}
+
+static void from565(u16 color, int *rgb) {
+    const int r = (color >> 11) & 31;
+    const int g = (color >> 5) & 63;
+    const int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+/** Encode the colors of the block in 8 bytes, in 4-color mode. */
+static void encodeColorBlock(const u8 *block, u8 *dst) {
+    int mins[3] = {255, 255, 255};
+    int maxs[3] = {0, 0, 0};
+    int sums[3] = {0, 0, 0};
+
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            const int v = block[i * 4 + c];
+            mins[c] = std::min(mins[c], v);
+            maxs[c] = std::max(maxs[c], v);
+            sums[c] += v;
+        }
+    }
+
+    // Take the diagonal of the bounding box that follows the colors: the
+    // channels varying against the main channel are flipped.
+    int main = 0;
+
+    for (int c = 1; c < 3; ++c) {
+        if (maxs[c] - mins[c] > maxs[main] - mins[main]) {
+            main = c;
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        if (c == main) {
+            continue;
+        }
+        int covariance = 0;
+
+        for (int i = 0; i < 16; ++i) {
+            covariance += (block[i * 4 + main] * 16 - sums[main]) *
+                          (block[i * 4 + c] * 16 - sums[c]) / 256;
+        }
+
+        if (covariance < 0) {
+            std::swap(mins[c], maxs[c]);
+        }
+    }
+
+    // Inset the endpoints to reduce the error on the intermediate colors
+    for (int c = 0; c < 3; ++c) {
+        const int inset = (maxs[c] - mins[c]) / 16;
+        maxs[c] -= inset;
+        mins[c] += inset;
+    }
+
+    u16 color0 = to565(maxs);
+    u16 color1 = to565(mins);
+
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    u32 indices = 0;
+
+    if (color0 != color1) {
+        int end0[3], end1[3], dir[3];
+        from565(color0, end0);
+        from565(color1, end1);
+
+        for (int c = 0; c < 3; ++c) {
+            dir[c] = end0[c] - end1[c];
+        }
+        const int length2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+        // Steps from color1 to color0, mapped to the BC1 indices
+        static const u32 stepIndex[4] = {1, 3, 2, 0};
+
+        for (int i = 0; i < 16; ++i) {
+            int t = 0;
+
+            for (int c = 0; c < 3; ++c) {
+                t += (block[i * 4 + c] - end1[c]) * dir[c];
+            }
+            int step = (t * 3 + length2 / 2) / length2;
+            step = std::max(0, std::min(step, 3));
+            indices |= stepIndex[step] << (2 * i);
+        }
+    }
+
+    dst[0] = static_cast<u8>(color0 & 0xFF);
+    dst[1] = static_cast<u8>(color0 >> 8);
+    dst[2] = static_cast<u8>(color1 & 0xFF);
+    dst[3] = static_cast<u8>(color1 >> 8);
+
+    for (int b = 0; b < 4; ++b) {
+        dst[4 + b] = static_cast<u8>(indices >> (8 * b));
+    }
+}
+
+/** Encode the alpha of the block in 8 bytes, in 8-alpha mode. */
+static void encodeAlphaBlock(const u8 *block, u8 *dst) {
+    int minAlpha = 255, maxAlpha = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        minAlpha = std::min(minAlpha, int(block[i * 4 + 3]));
+        maxAlpha = std::max(maxAlpha, int(block[i * 4 + 3]));
+    }
+
+    u64 indices = 0;
+
+    if (maxAlpha > minAlpha) {
+        const int range = maxAlpha - minAlpha;
+
+        for (int i = 0; i < 16; ++i) {
+            const int step =
+                ((block[i * 4 + 3] - minAlpha) * 7 + range / 2) / range;
+            // Steps from minAlpha to maxAlpha, mapped to the BC3 indices
+            const u64 index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+            indices |= index << (3 * i);
+        }
+    }
+
+    dst[0] = static_cast<u8>(maxAlpha);
+    dst[1] = static_cast<u8>(minAlpha);
+
+    for (int b = 0; b < 6; ++b) {
+        dst[2 + b] = static_cast<u8>(indices >> (8 * b));
+    }
+}
+
+/** Encode the block at (bx, by) of src to its place in dst, in the format of
+ * dst. */
+static void encodeBlock(const Image &src, int bx, int by, Image &dst) {
+    const bool bc3 = dst.type() == ImageType::BC3;
+    const int blocksX = (src.width() + 3) / 4;
+    u8 *out = dst.data() + (by * blocksX + bx) * (bc3 ? 16 : 8);
+    u8 block[64];
+    loadBlock(src, bx, by, block);
+
+    if (bc3) {
+        encodeAlphaBlock(block, out);
+        out += 8;
+    }
+    encodeColorBlock(block, out);
+}
+
+static void decodeColorBlock(const u8 *src, bool fourColors, u8 *block) {
+    const u16 color0 = static_cast<u16>(src[0] | (src[1] << 8));
+    const u16 color1 = static_cast<u16>(src[2] | (src[3] << 8));
+    int palette[4][4];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+
+    for (int c = 0; c < 3; ++c) {
+        const int c0 = palette[0][c], c1 = palette[1][c];
+
+        if (fourColors || color0 > color1) {
+            palette[2][c] = (2 * c0 + c1) / 3;
+            palette[3][c] = (c0 + 2 * c1) / 3;
+        } else {
+            palette[2][c] = (c0 + c1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = (fourColors || color0 > color1) ? 255 : 0;
+
+    const u32 indices = u32(src[4]) | (u32(src[5]) << 8) |
+                        (u32(src[6]) << 16) | (u32(src[7]) << 24);
+
+    for (int i = 0; i < 16; ++i) {
+        const int *color = palette[(indices >> (2 * i)) & 3];
+
+        for (int c = 0; c < 4; ++c) {
+            block[i * 4 + c] = static_cast<u8>(color[c]);
+        }
+    }
+}
+
+static void decodeAlphaBlock(const u8 *src, u8 *block) {
+    const int alpha0 = src[0], alpha1 = src[1];
+    int palette[8] = {alpha0, alpha1};
+
+    if (alpha0 > alpha1) {
+        for (int i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * alpha0 + (i - 1) * alpha1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 indices = 0;
+
+    for (int b = 0; b < 6; ++b) {
+        indices |= u64(src[2 + b]) << (8 * b);
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        block[i * 4 + 3] = static_cast<u8>(palette[(indices >> (3 * i)) & 7]);
+    }
+}
+
+Image BlockCompression::encode(const Image &src, ImageType format,
+                               int threadCount) {
+    if (src.isCompressed()) {
+        throw std::invalid_argument(
+            "BlockCompression::encode: image is already compressed");
+    }
+    if (format != ImageType::BC1 && format != ImageType::BC3) {
+        throw std::invalid_argument(
+            "BlockCompression::encode: format is not a compressed format");
+    }
+
+    Image dst(src.width(), src.height(), format);
+    const int blocksX = (src.width() + 3) / 4;
+    const int blocksY = (src.height() + 3) / 4;
+
+    auto encodeLines = [&](int begin, int end) {
+        for (int by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                encodeBlock(src, bx, by, dst);
+            }
+        }
+    };
+
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(
+        1, std::min(threadCount, blocksY / MIN_LINES_PER_THREAD));
+
+    // The first slice is encoded by the calling thread
+    std::vector<std::thread> threads;
+
+    for (int t = 1; t < threadCount; ++t) {
+        threads.emplace_back(encodeLines, blocksY * t / threadCount,
+                             blocksY * (t + 1) / threadCount);
+    }
+    encodeLines(0, blocksY / threadCount);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (int level = 1; level <= src.mipCount(); ++level) {
+        dst.addMip(encode(src.mip(level), format, threadCount));
+    }
+    return dst;
+}
+
+void BlockCompression::encodeRect(const Image &src, Image &dst,
+                                  const ImageRect &rect) {
+    if (src.isCompressed() || !dst.isCompressed() ||
+        src.width() != dst.width() || src.height() != dst.height()) {
+        throw std::invalid_argument(
+            "BlockCompression::encodeRect: images do not match");
+    }
+
+    const int bx0 = std::max(rect._x, 0) / 4;
+    const int by0 = std::max(rect._y, 0) / 4;
+    const int bx1 = (std::min(rect._x + rect._width, src.width()) + 3) / 4;
+    const int by1 = (std::min(rect._y + rect._height, src.height()) + 3) / 4;
+
+    for (int by = by0; by < by1; ++by) {
+        for (int bx = bx0; bx < bx1; ++bx) {
+            encodeBlock(src, bx, by, dst);
+        }
+    }
+}
+
+Image BlockCompression::encode(const Image &src, int threadCount) {
+    ImageType format =
+        src.type() == ImageType::RGBA ? ImageType::BC3 : ImageType::BC1;
+    return encode(src, format, threadCount);
+}
+
+Image BlockCompression::decode(const Image &src) {
+    if (!src.isCompressed()) {
+        throw std::invalid_argument(
+            "BlockCompression::decode: image is not compressed");
+    }
+
+    Image dst(src.width(), src.height(), ImageType::RGBA);
+    const int blocksX = (src.width() + 3) / 4;
+    const int blocksY = (src.height() + 3) / 4;
+    const bool bc3 = src.type() == ImageType::BC3;
+    const u8 *in = src.data();
+    u8 block[64];
+
+    for (int by = 0; by < blocksY; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            if (bc3) {
+                decodeColorBlock(in + 8, true, block);
+                decodeAlphaBlock(in, block);
+                in += 16;
+            } else {
+                decodeColorBlock(in, false, block);
+                in += 8;
+            }
+
+            const int width = std::min(4, src.width() - bx * 4);
+            const int height = std::min(4, src.height() - by * 4);
+
+            for (int j = 0; j < height; ++j) {
+                u8 *line = dst.data() +
+                           ((by * 4 + j) * src.width() + bx * 4) * 4;
+                std::copy(block + j * 16, block + j * 16 + width * 4, line);
+            }
+        }
+    }
+
+    for (int level = 1; level <= src.mipCount(); ++level) {
+        dst.addMip(decode(src.mip(level)));
+    }
+    return dst;
+}
+
+void BlockCompressedChannel::put(const ItemKey &key, const Image &item,
+                                 const ExplorationContext &ctx) {
+    if (item.isCompressed()) {
+        CollectorChannel<Image>::put(key, item, ctx);
+    } else {
+        CollectorChannel<Image>::put(key, BlockCompression::encode(item), ctx);
+    }
+}
+
+} // namespace world
@@ -0,0 +1,73 @@
+#ifndef WORLD_BLOCKCOMPRESSION_H
+#define WORLD_BLOCKCOMPRESSION_H
+
+#include "world/core/WorldConfig.h"
+
+#include "world/core/Collector.h"
+
+#include "Image.h"
+#include "ImageUtils.h"
+
+namespace world {
+
+/** CPU encoder and decoder for the block compressed image formats BC1 (also
+ * known as DXT1) and BC3 (DXT5). Those formats can be uploaded as is to the
+ * GPU, and take 6 times (BC1 from RGB) or 4 times (BC3 from RGBA) less
+ * memory than the uncompressed image.
+ *
+ * The encoder favors speed over quality: the endpoints of each block are
+ * taken on the diagonal of the bounding box of the block colors, and the
+ * pixels are projected on this diagonal. */
+class WORLDAPI_EXPORT BlockCompression {
+public:
+    BlockCompression() = delete;
+
+    /** Compress the image in the given format. The source image can be
+     * GREYSCALE, RGB or RGBA. Its size does not need to be a multiple of 4,
+     * border blocks are padded by repeating the last pixels. The mip levels
+     * of the source image are compressed as well.
+     * @param format ImageType::BC1 or ImageType::BC3. The alpha channel is
+     * dropped when compressing to BC1.
+     * @param threadCount number of threads used to encode the image. By
+     * default the image is encoded on the calling thread. If 0, the number
+     * of hardware threads is used.
+     * @throws std::invalid_argument if the source image is already
+     * compressed or if the format is not a compressed format. */
+    static Image encode(const Image &src, ImageType format,
+                        int threadCount = 1);
+
+    /** Compress the image, choosing BC3 if the image has an alpha channel
+     * and BC1 otherwise. */
+    static Image encode(const Image &src, int threadCount = 1);
+
+    /** Compress again the blocks of dst that overlap the rectangle, after
+     * the source image changed in this rectangle. dst keeps its format, and
+     * its mip levels are not updated: encodeRect() can be called on each of
+     * them.
+     * @throws std::invalid_argument if src is compressed, if dst is not, or
+     * if they have different sizes. */
+    static void encodeRect(const Image &src, Image &dst,
+                           const ImageRect &rect);
+
+    /** Decompress a BC1 or BC3 image and its mip levels to a RGBA image.
+     * @throws std::invalid_argument if the image is not compressed. */
+    static Image decode(const Image &src);
+};
+
+/** Image channel that compresses the images put in it with
+ * BlockCompression::encode(), so that a host can receive compressed textures
+ * from all the nodes. Images already compressed are stored as is. The
+ * ImageUpdate are not compressed: their producers have their own setting,
+ * like HeightmapGround::setTextureCompression().
+ *
+ * Usage: collector.addCustomChannel<Image, BlockCompressedChannel>() */
+class WORLDAPI_EXPORT BlockCompressedChannel : public CollectorChannel<Image> {
+public:
+    void put(const ItemKey &key, const Image &item,
+             const ExplorationContext &ctx =
+                 ExplorationContext::getDefault()) override;
+};
+
+} // namespace world
+
+#endif // WORLD_BLOCKCOMPRESSION_H
@@ -1,7 +1,11 @@
 #include "Image.h"
 
+#include <cassert>
 #include <stdexcept>
 #include <memory>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 #include "world/math/MathsHelper.h"
 
@@ -257,28 +261,59 @@ u32 typeElemSize(const ImageType &type) {
         return 3;
     case ImageType::RGBA:
         return 4;
+    default:
+        return 0;
+    }
+}
+
+u32 typeBlockSize(const ImageType &type) {
+    switch (type) {
+    case ImageType::BC1:
+        return 8;
+    case ImageType::BC3:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+u32 typeTotalSize(const ImageType &type, u32 sizeX, u32 sizeY) {
+    u32 blockSize = typeBlockSize(type);
+
+    if (blockSize != 0) {
+        return ((sizeX + 3) / 4) * ((sizeY + 3) / 4) * blockSize;
+    } else {
+        return sizeX * sizeY * typeElemSize(type);
     }
 }
 
 class PImage {
 public:
     PImage(u32 sizeX, u32 sizeY, u32 elemSize)
-            : _data(new u8[sizeX * sizeY * elemSize]), _sizeX(sizeX),
-              _sizeY(sizeY), _elemSize(elemSize) {}
+            : PImage(sizeX, sizeY, elemSize, sizeX * sizeY * elemSize) {}
+
+    PImage(u32 sizeX, u32 sizeY, u32 elemSize, u32 total)
+            : _data(new u8[total]), _sizeX(sizeX), _sizeY(sizeY),
+              _elemSize(elemSize), _total(total) {}
 
     PImage(u8 *data, u32 sizeX, u32 sizeY, u32 elemSize)
-            : _data(data), _sizeX(sizeX), _sizeY(sizeY), _elemSize(elemSize) {}
+            : _data(data), _sizeX(sizeX), _sizeY(sizeY), _elemSize(elemSize),
+              _total(sizeX * sizeY * elemSize) {}
 
     ~PImage() { delete[] _data; };
 
     u8 *at(u32 x, u32 y) { return _data + (y * _sizeX + x) * _elemSize; }
 
-    u32 total() { return _sizeX * _sizeY * _elemSize; }
+    u32 total() { return _total; }
 
     u8 *_data;
     u32 _sizeX;
     u32 _sizeY;
     u32 _elemSize;
+    u32 _total;
+
+    /// Mip levels, starting from level 1
+    std::vector<Image> _mips;
 };
 
 // ImageStream implementation
@@ -296,6 +331,14 @@ int ImageStream::read(char *buffer, int count) {
     int read = 0;
     const int s = static_cast<int>(mat._elemSize);
 
+    if (s == 0) {
+        // Compressed blocks are streamed as is
+        read = std::min(count, remaining());
+        memcpy(buffer, mat._data + _position, read);
+        _position += read;
+        return _position;
+    }
+
     while (count >= s) {
         u8 *data = mat._data + _position;
 
@@ -321,6 +364,11 @@ int ImageStream::read(char *buffer, int count) {
         case ImageType::GREYSCALE:
             buffer[read] = data[0];
             read++;
+            break;
+        case ImageType::BC1:
+        case ImageType::BC3:
+            // Compressed blocks are streamed above
+            break;
         }
 
         count -= s;
@@ -401,8 +449,11 @@ void RGBAPixel::setf(double r, double g, double b, double a) {
 // Implmentation de Image
 
 Image::Image(int width, int height, const ImageType &type)
-        : _internal(new PImage(static_cast<u32>(width),
-                               static_cast<u32>(height), typeElemSize(type))),
+        : _internal(new PImage(
+              static_cast<u32>(width), static_cast<u32>(height),
+              typeElemSize(type),
+              typeTotalSize(type, static_cast<u32>(width),
+                            static_cast<u32>(height)))),
           _type(type) {}
 
 Image::Image(const arma::Cube<double> &data) : _type(ImageType::RGB) {
@@ -444,8 +495,10 @@ Image::Image(Image &&image) : _internal(image._internal), _type(image._type) {
 
 Image::Image(const Image &image) {
     auto pother = image._internal;
-    _internal = new PImage(pother->_sizeX, pother->_sizeY, pother->_elemSize);
+    _internal = new PImage(pother->_sizeX, pother->_sizeY, pother->_elemSize,
+                           pother->total());
     memcpy(_internal->_data, pother->_data, pother->total());
+    _internal->_mips = pother->_mips;
     _type = image._type;
 }
 
@@ -460,9 +513,9 @@ Image &Image::operator=(const Image &img) {
 }
 
 Image &Image::operator=(Image &&img) {
-    _internal = img._internal;
+    // The previous data is released by img
+    std::swap(_internal, img._internal);
     _type = img._type;
-    img._internal = nullptr;
     return *this;
 }
 
@@ -476,31 +529,67 @@ int Image::height() const { return _internal->_sizeY; }
 
 int Image::size() const { return _internal->total(); }
 
+bool Image::isCompressed() const { return typeBlockSize(_type) != 0; }
+
+u8 *Image::data() { return _internal->_data; }
+
+const u8 *Image::data() const { return _internal->_data; }
+
+int Image::mipCount() const {
+    return static_cast<int>(_internal->_mips.size());
+}
+
+Image &Image::mip(int level) {
+    return level == 0 ? *this : _internal->_mips.at(level - 1);
+}
+
+const Image &Image::mip(int level) const {
+    return level == 0 ? *this : _internal->_mips.at(level - 1);
+}
+
+void Image::addMip(Image &&mip) { _internal->_mips.push_back(std::move(mip)); }
+
+void Image::clearMips(int keptLevel) {
+    if (keptLevel < mipCount()) {
+        _internal->_mips.erase(_internal->_mips.begin() + keptLevel,
+                               _internal->_mips.end());
+    }
+}
+
+// Compressed images store blocks, not pixels: they must be decoded with
+// BlockCompression::decode before their pixels can be accessed.
 RGBAPixel &Image::rgba(int x, int y) {
+    assert(!isCompressed());
     return *reinterpret_cast<RGBAPixel *>(_internal->at(x, y));
 }
 
 const RGBAPixel &Image::rgba(int x, int y) const {
+    assert(!isCompressed());
     return *reinterpret_cast<RGBAPixel *>(_internal->at(x, y));
 }
 
 RGBPixel &Image::rgb(int x, int y) {
+    assert(!isCompressed());
     return *reinterpret_cast<RGBPixel *>(_internal->at(x, y));
 }
 
 const RGBPixel &Image::rgb(int x, int y) const {
+    assert(!isCompressed());
     return *reinterpret_cast<RGBPixel *>(_internal->at(x, y));
 }
 
 GreyPixel &Image::grey(int x, int y) {
+    assert(!isCompressed());
     return *reinterpret_cast<GreyPixel *>(_internal->at(x, y));
 }
 
 const GreyPixel &Image::grey(int x, int y) const {
+    assert(!isCompressed());
     return *reinterpret_cast<GreyPixel *>(_internal->at(x, y));
 }
 
 void Image::setf(int x, int y, const float *values) {
+    assert(!isCompressed());
     u8 *target = _internal->at(x, y);
 
     for (u32 i = 0; i < _internal->_elemSize; ++i) {
@@ -509,6 +598,7 @@ void Image::setf(int x, int y, const float *values) {
 }
 
 void Image::getf(int x, int y, float *values) const {
+    assert(!isCompressed());
     const u8 *src = _internal->at(x, y);
 
     for (u32 i = 0; i < _internal->_elemSize; ++i) {
@@ -604,6 +694,9 @@ void Image::write(const std::string &path) const {
         throw std::runtime_error(std::string("Unsupported format for file ") +
                                  path + ". We only support png at the moment.");
     }
+    if (isCompressed()) {
+        throw std::runtime_error("Can't write compressed image to " + path);
+    }
 
     FILE *file = fopen(path.c_str(), "wb");
 
@@ -621,7 +714,7 @@ void Image::write(const std::string &path) const {
         // TODO error handling
     }
 
-    int colortype;
+    int colortype = PNG_COLOR_TYPE_RGB;
     switch (_type) {
     case ImageType::GREYSCALE:
         colortype = PNG_COLOR_TYPE_GRAY;
@@ -632,6 +725,10 @@ void Image::write(const std::string &path) const {
     case ImageType::RGBA:
         colortype = PNG_COLOR_TYPE_RGB_ALPHA;
         break;
+    case ImageType::BC1:
+    case ImageType::BC3:
+        // Compressed images are rejected above
+        break;
     }
 
     png_set_IHDR(png_ptr, info_ptr, _internal->_sizeX, _internal->_sizeY, 8,
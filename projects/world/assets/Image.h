@@ -9,7 +9,16 @@ namespace world {
 class PImage;
 class Image;
 
-enum class WORLDAPI_EXPORT ImageType { RGB = 0, RGBA = 1, GREYSCALE = 2 };
+/** Pixel format of an image. BC1 and BC3 are block compressed formats:
+ * pixels are stored as 4x4 blocks of 8 bytes (BC1, opaque) or 16 bytes
+ * (BC3, with alpha), and cannot be accessed individually. */
+enum class WORLDAPI_EXPORT ImageType {
+    RGB = 0,
+    RGBA = 1,
+    GREYSCALE = 2,
+    BC1 = 3,
+    BC3 = 4
+};
 
 class WORLDAPI_EXPORT ImageStream {
 public:
@@ -101,15 +110,46 @@ public:
 
     // infos
     ImageType type() const;
+    /// Get the size of one pixel in bytes, or 0 for compressed images
     int elemSize() const;
     int width() const;
     int height() const;
-    /// Get the total size of the image (width * height * elemSize)
+    /// Get the total size of the image data in bytes. For uncompressed
+    /// images it is width * height * elemSize.
     int size() const;
+    /// Returns true if the image is stored in a block compressed format.
+    bool isCompressed() const;
+
+    /** Gets a pointer on the raw image data, which is size() bytes long.
+     * Pixels are stored line by line, or block line by block line for
+     * compressed images. */
+    u8 *data();
+
+    const u8 *data() const;
+
+    // mip levels
+    /** Gets the count of mip levels stored with the image, not counting the
+     * image itself. Images have no mip level by default, see
+     * ImageUtils::generateMips(). */
+    int mipCount() const;
+
+    /** Gets the mip level at the given index. Level 0 is the image itself,
+     * and each level is half the size of the previous one.
+     * @throws std::out_of_range if level > mipCount() */
+    Image &mip(int level);
+
+    const Image &mip(int level) const;
+
+    /** Appends a mip level after the last one. */
+    void addMip(Image &&mip);
+
+    /** Removes the mip levels after the given level. */
+    void clearMips(int keptLevel = 0);
 
     // access
     /** Gets a rgba access on the pixel at (x, y). This
-     * method only works properly on RGBA image.
+     * method only works properly on RGBA image. It must not be called on a
+     * compressed image.
      * @param x column of the pixel.
      * @param y line of the pixel. */
     RGBAPixel &rgba(int x, int y);
@@ -122,7 +162,8 @@ public:
     const RGBAPixel &rgba(int x, int y) const;
 
     /** Gets a rgb access on the pixel at (x, y). This
-     * method works on both types RGBA and RGB.
+     * method works on both types RGBA and RGB. It must not be called on a
+     * compressed image.
      * @warning behaviour on RGBA type is not confirmed yet.
      * @param x column of the pixel.
      * @param y line of the pixel. */
@@ -137,7 +178,7 @@ public:
 
     /** Gets a greyscale access on the pixel at (x, y). The
      * behaviour on images other than greyscale type is
-     * undefined.
+     * undefined. It must not be called on a compressed image.
      * @param x column of the pixel.
      * @param y line of the pixel. */
     GreyPixel &grey(int x, int y);
@@ -150,12 +191,14 @@ public:
     const GreyPixel &grey(int x, int y) const;
 
     /** Set the value of the pixel at (x, y). The number of elements
-     * copied from the array depends on the type of the image.
+     * copied from the array depends on the type of the image. It must not
+     * be called on a compressed image.
      * @param values a float array holding the values to be set. */
     void setf(int x, int y, const float *values);
 
     /** Get the value of the pixel at (x, y). The number of elements
-     * copied to the array depends on the type of the image.
+     * copied to the array depends on the type of the image. It must not be
+     * called on a compressed image.
      * @param values pixel data are copied to this array. */
     void getf(int x, int y, float *values) const;
 
@@ -167,7 +210,7 @@ public:
 
     /** Writes the image at the specified location. The
      * extension of the file is used to determine the format
-     * of the written image.
+     * of the written image. Compressed images can not be written.
      * @param file a relative or absolute pathname to
      * the file.*/
     void write(const std::string &path) const;
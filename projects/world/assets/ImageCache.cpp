@@ -0,0 +1,205 @@
+#include "ImageCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace world {
+
+struct ImageCacheEntry {
+    std::shared_ptr<Image> _image;
+    bool _ready = false;
+    std::string _error;
+    size_t _byteSize = 0;
+    /** Position in the LRU list, only valid once the image is ready */
+    std::list<std::string>::iterator _lruIt;
+};
+
+class PImageCache {
+public:
+    std::mutex _mutex;
+    /// Notified when a path is pushed in the queue, or on exit
+    std::condition_variable _queueCond;
+    /// Notified each time an image is ready
+    std::condition_variable _readyCond;
+
+    std::unordered_map<std::string, ImageCacheEntry> _entries;
+    std::deque<std::string> _queue;
+    /// Ready images, most recently used first
+    std::list<std::string> _lru;
+
+    size_t _byteSize = 0;
+    size_t _byteBudget;
+    bool _stop = false;
+
+    std::vector<std::thread> _threads;
+
+
+    PImageCache(size_t byteBudget) : _byteBudget(byteBudget) {}
+
+    /** Schedule the image if it is not in the cache yet. Must be called
+     * with the mutex locked. */
+    ImageCacheEntry &schedule(const std::string &path) {
+        auto it = _entries.find(path);
+
+        if (it == _entries.end()) {
+            it = _entries.emplace(path, ImageCacheEntry()).first;
+            _queue.push_back(path);
+            _queueCond.notify_one();
+        } else if (it->second._ready) {
+            _lru.splice(_lru.begin(), _lru, it->second._lruIt);
+        }
+        return it->second;
+    }
+
+    /** Drop least recently used images until the cache fits in the byte
+     * budget. The most recent image is always kept. Must be called with the
+     * mutex locked. */
+    void evict() {
+        while (_byteSize > _byteBudget && _lru.size() > 1) {
+            auto it = _entries.find(_lru.back());
+            _byteSize -= it->second._byteSize;
+            _entries.erase(it);
+            _lru.pop_back();
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (true) {
+            _queueCond.wait(lock, [this] { return _stop || !_queue.empty(); });
+
+            if (_stop) {
+                return;
+            }
+
+            std::string path = std::move(_queue.front());
+            _queue.pop_front();
+
+            lock.unlock();
+            std::shared_ptr<Image> image;
+            std::string error;
+
+            try {
+                image = std::make_shared<Image>(Image::read(path));
+            } catch (std::exception &e) {
+                error = e.what();
+            }
+            lock.lock();
+
+            auto it = _entries.find(path);
+
+            // The cache may have been cleared in the meantime
+            if (it == _entries.end() || it->second._ready) {
+                continue;
+            }
+
+            ImageCacheEntry &entry = it->second;
+            entry._ready = true;
+
+            if (image) {
+                entry._image = std::move(image);
+                entry._byteSize = size_t(entry._image->size());
+                _byteSize += entry._byteSize;
+            } else {
+                entry._error = error.empty() ? "Unknown error" : error;
+            }
+
+            _lru.push_front(path);
+            entry._lruIt = _lru.begin();
+            evict();
+
+            _readyCond.notify_all();
+        }
+    }
+};
+
+ImageCache &ImageCache::global() {
+    static ImageCache cache(2);
+    return cache;
+}
+
+ImageCache::ImageCache(int threadCount, size_t byteBudget)
+        : _internal(new PImageCache(byteBudget)) {
+    for (int i = 0; i < std::max(threadCount, 1); ++i) {
+        _internal->_threads.emplace_back([this] { _internal->run(); });
+    }
+}
+
+ImageCache::~ImageCache() {
+    {
+        std::lock_guard<std::mutex> lock(_internal->_mutex);
+        _internal->_stop = true;
+    }
+    _internal->_queueCond.notify_all();
+
+    for (auto &thread : _internal->_threads) {
+        thread.join();
+    }
+
+    delete _internal;
+}
+
+void ImageCache::setByteBudget(size_t byteBudget) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    _internal->_byteBudget = byteBudget;
+    _internal->evict();
+}
+
+size_t ImageCache::getByteBudget() const {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    return _internal->_byteBudget;
+}
+
+size_t ImageCache::getByteSize() const {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    return _internal->_byteSize;
+}
+
+void ImageCache::prefetch(const std::string &path) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    _internal->schedule(path);
+}
+
+std::shared_ptr<Image> ImageCache::tryGet(const std::string &path) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    return _internal->schedule(path)._image;
+}
+
+std::shared_ptr<Image> ImageCache::get(const std::string &path) {
+    std::unique_lock<std::mutex> lock(_internal->_mutex);
+    _internal->schedule(path);
+
+    while (true) {
+        auto it = _internal->_entries.find(path);
+
+        // The entry may have been evicted or cleared while waiting
+        if (it == _internal->_entries.end()) {
+            _internal->schedule(path);
+        } else if (it->second._ready) {
+            if (!it->second._image) {
+                throw std::runtime_error(it->second._error);
+            }
+            return it->second._image;
+        }
+
+        _internal->_readyCond.wait(lock);
+    }
+}
+
+void ImageCache::clear() {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    _internal->_entries.clear();
+    _internal->_queue.clear();
+    _internal->_lru.clear();
+    _internal->_byteSize = 0;
+    _internal->_readyCond.notify_all();
+}
+
+} // namespace world
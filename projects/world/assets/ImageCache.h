@@ -0,0 +1,70 @@
+#ifndef WORLD_IMAGECACHE_H
+#define WORLD_IMAGECACHE_H
+
+#include "world/core/WorldConfig.h"
+
+#include <memory>
+#include <string>
+
+#include "Image.h"
+
+namespace world {
+
+class PImageCache;
+
+/** Cache of decoded images, keyed by file path. Images are read and decoded
+ * by background threads, so that an image can be polled with tryGet()
+ * without ever blocking on disk access or png decoding.
+ *
+ * Decoded images are kept until the total size of the cache exceeds the
+ * byte budget, then the least recently used images are dropped first.
+ * Dropped images stay valid as long as somebody holds a pointer on them.
+ *
+ * A global instance is shared by the whole process, so that all the grounds
+ * and worlds reading the same files decode them only once. */
+class WORLDAPI_EXPORT ImageCache {
+public:
+    /** Cache shared by the whole process. */
+    static ImageCache &global();
+
+    ImageCache(int threadCount = 1, size_t byteBudget = 256 * 1024 * 1024);
+
+    ~ImageCache();
+
+    ImageCache(const ImageCache &) = delete;
+
+    ImageCache &operator=(const ImageCache &) = delete;
+
+    void setByteBudget(size_t byteBudget);
+
+    size_t getByteBudget() const;
+
+    /** Get the total size of the decoded images held by the cache, in
+     * bytes. */
+    size_t getByteSize() const;
+
+    /** Schedule the decoding of the image at the given path, if it is not
+     * already decoded or scheduled. */
+    void prefetch(const std::string &path);
+
+    /** Get the image at the given path if it is already decoded. Otherwise
+     * the decoding is scheduled and nullptr is returned. nullptr is also
+     * returned if the image could not be read. */
+    std::shared_ptr<Image> tryGet(const std::string &path);
+
+    /** Get the image at the given path, waiting for it to be decoded if
+     * needed.
+     * @throws std::runtime_error if the image could not be read. */
+    std::shared_ptr<Image> get(const std::string &path);
+
+    /** Remove all the images from the cache. Images that are being decoded
+     * are dropped when they are ready. */
+    void clear();
+
+private:
+    PImageCache *_internal;
+};
+
+} // namespace world
+
+#endif // WORLD_IMAGECACHE_H
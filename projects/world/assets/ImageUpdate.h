@@ -0,0 +1,32 @@
+#ifndef WORLD_IMAGEUPDATE_H
+#define WORLD_IMAGEUPDATE_H
+
+#include "world/core/WorldConfig.h"
+
+#include <utility>
+
+#include "Image.h"
+
+namespace world {
+
+/** Partial update of an image that was already collected. An update is
+ * emitted with the key of the image it modifies, and only contains the
+ * modified pixels, so that hosts can upload them with a sub-image copy
+ * instead of uploading the whole image again. Hosts that want to receive
+ * updates must add a channel of this type to their collector. */
+struct WORLDAPI_EXPORT ImageUpdate {
+    /// Position of the top-left corner of the updated pixels in the image
+    int _x;
+    int _y;
+    /// Updated pixels, in the same type as the image. If the image is block
+    /// compressed, the position and size of the update are multiples of 4
+    /// (except on the image borders).
+    Image _pixels;
+
+    ImageUpdate(int x, int y, Image pixels)
+            : _x(x), _y(y), _pixels(std::move(pixels)) {}
+};
+
+} // namespace world
+
+#endif // WORLD_IMAGEUPDATE_H
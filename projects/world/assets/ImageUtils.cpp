@@ -1,23 +1,288 @@
 #include "ImageUtils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace world {
 
-Image ImageUtils::toType(const Image &src, ImageType type) {
-    Image dst(src.width(), src.height(), type);
-    float array[] = {0, 0, 0, 1};
+// Row kernels. The pixel sizes are template parameters, so that the loops on
+// channels are unrolled and each pixel format gets its own loop.
 
-    for (int y = 0; y < dst.height(); ++y) {
-        for (int x = 0; x < dst.width(); ++x) {
-            src.getf(x, y, array);
-            dst.setf(x, y, array);
+/** Byte value of a [0, 1] channel, truncated like in Image::setf(). */
+static inline u8 toByte(double value) {
+    return static_cast<u8>(clamp(value, 0., 1.) * 255);
+}
+
+static void checkUncompressed(const Image &img, const char *function) {
+    if (img.isCompressed()) {
+        throw std::invalid_argument(std::string("ImageUtils::") + function +
+                                    ": image is compressed");
+    }
+}
+
+using RowKernel = void (*)(u8 *dst, const u8 *src, int count);
+
+template <int dstElem, int srcElem>
+static void convertRow(u8 *dst, const u8 *src, int count) {
+    if (dstElem == srcElem) {
+        memcpy(dst, src, count * dstElem);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i, dst += dstElem, src += srcElem) {
+        dst[0] = src[0];
+
+        if (dstElem != 1) {
+            dst[1] = src[srcElem == 1 ? 0 : 1];
+            dst[2] = src[srcElem == 1 ? 0 : 2];
+        }
+        if (dstElem == 4) {
+            dst[3] = srcElem == 4 ? src[3] : u8(255);
+        }
+    }
+}
+
+// Vectorized parts of the row kernels. They compute exactly the same values
+// as the scalar loops, and return the number of pixels (or values) they
+// processed; the scalar loops process the remaining ones.
+
+#ifdef __SSE2__
+/** Blend two RGBA source pixels over two destination pixels, stored in u16
+ * lanes. The division by 255 is done with (x + 1 + (x >> 8)) >> 8, which is
+ * exact for x < 65535. */
+static inline __m128i blendPixelsSSE2(__m128i d, __m128i s) {
+    const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+    const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    const __m128i color = _mm_andnot_si128(alphaMask, s);
+    __m128i x =
+        _mm_add_epi16(_mm_mullo_epi16(color, a), _mm_mullo_epi16(d, inv));
+    x = _mm_add_epi16(x, _mm_set1_epi16(127));
+    x = _mm_add_epi16(x, _mm_add_epi16(_mm_srli_epi16(x, 8),
+                                       _mm_set1_epi16(1)));
+    return _mm_add_epi16(_mm_srli_epi16(x, 8), _mm_and_si128(alphaMask, s));
+}
+#endif
+
+#ifdef __AVX2__
+/** Same as blendPixelsSSE2(), on four pixels. */
+static inline __m256i blendPixelsAVX2(__m256i d, __m256i s) {
+    const __m256i alphaMask =
+        _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+    const __m256i a =
+        _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+    const __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+    const __m256i color = _mm256_andnot_si256(alphaMask, s);
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(color, a),
+                                 _mm256_mullo_epi16(d, inv));
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(127));
+    x = _mm256_add_epi16(x, _mm256_add_epi16(_mm256_srli_epi16(x, 8),
+                                             _mm256_set1_epi16(1)));
+    return _mm256_add_epi16(_mm256_srli_epi16(x, 8),
+                            _mm256_and_si256(alphaMask, s));
+}
+#endif
+
+/** Vectorized part of blendRow<4>(). */
+static int blendRowSIMD(u8 *dst, const u8 *src, int count) {
+    int i = 0;
+#ifdef __AVX2__
+    const __m256i zero256 = _mm256_setzero_si256();
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i *d = reinterpret_cast<__m256i *>(dst + i * 4);
+        __m256i dv = _mm256_loadu_si256(d);
+        __m256i sv =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+        // unpack and pack both work on 128 bits lanes, so the pixel order is
+        // kept
+        __m256i lo = blendPixelsAVX2(_mm256_unpacklo_epi8(dv, zero256),
+                                     _mm256_unpacklo_epi8(sv, zero256));
+        __m256i hi = blendPixelsAVX2(_mm256_unpackhi_epi8(dv, zero256),
+                                     _mm256_unpackhi_epi8(sv, zero256));
+        _mm256_storeu_si256(d, _mm256_packus_epi16(lo, hi));
+    }
+#endif
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i *d = reinterpret_cast<__m128i *>(dst + i * 4);
+        __m128i dv = _mm_loadu_si128(d);
+        __m128i sv =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        __m128i lo = blendPixelsSSE2(_mm_unpacklo_epi8(dv, zero),
+                                     _mm_unpacklo_epi8(sv, zero));
+        __m128i hi = blendPixelsSSE2(_mm_unpackhi_epi8(dv, zero),
+                                     _mm_unpackhi_epi8(sv, zero));
+        _mm_storeu_si128(d, _mm_packus_epi16(lo, hi));
+    }
+#endif
+    return i;
+}
+
+/** Vectorized part of getRowf(). The float division gives the same result
+ * as the double division rounded to float for all the 8 bits values. */
+static int getRowfSIMD(const u8 *row, float *values, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(255.f);
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i words[] = {_mm_unpacklo_epi8(bytes, zero),
+                           _mm_unpackhi_epi8(bytes, zero)};
+
+        for (int w = 0; w < 2; ++w) {
+            __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words[w], zero));
+            __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words[w], zero));
+            _mm_storeu_ps(values + i + w * 8, _mm_div_ps(lo, scale));
+            _mm_storeu_ps(values + i + w * 8 + 4, _mm_div_ps(hi, scale));
         }
     }
+#endif
+    return i;
+}
+
+#ifdef __SSE2__
+/** toByte() on two floats converted to doubles, as in the scalar code. */
+static inline __m128i toBytesSSE2(__m128 values, bool high) {
+    if (high) {
+        values = _mm_movehl_ps(values, values);
+    }
+    __m128d v = _mm_cvtps_pd(values);
+    v = _mm_max_pd(_mm_min_pd(v, _mm_set1_pd(1)), _mm_setzero_pd());
+    return _mm_cvttpd_epi32(_mm_mul_pd(v, _mm_set1_pd(255)));
+}
+#endif
+
+/** Vectorized part of setRowf(). */
+static int setRowfSIMD(u8 *row, const float *values, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps(values + i);
+        __m128 b = _mm_loadu_ps(values + i + 4);
+        // 32 bits integers, 2 in the low half of each register
+        __m128i lo = _mm_unpacklo_epi64(toBytesSSE2(a, false),
+                                        toBytesSSE2(a, true));
+        __m128i hi = _mm_unpacklo_epi64(toBytesSSE2(b, false),
+                                        toBytesSSE2(b, true));
+        __m128i words = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(row + i),
+                         _mm_packus_epi16(words, words));
+    }
+#endif
+    return i;
+}
+
+/** Blend RGBA source pixels over the destination pixels. */
+template <int dstElem>
+static void blendRow(u8 *dst, const u8 *src, int count) {
+    int i = 0;
+
+    if (dstElem == 4) {
+        i = blendRowSIMD(dst, src, count);
+        dst += i * 4;
+        src += i * 4;
+    }
+
+    for (; i < count; ++i, dst += dstElem, src += 4) {
+        const int alpha = src[3];
+        const int inv = 255 - alpha;
+
+        for (int c = 0; c < (dstElem == 1 ? 1 : 3); ++c) {
+            dst[c] =
+                static_cast<u8>((src[c] * alpha + dst[c] * inv + 127) / 255);
+        }
+        if (dstElem == 4) {
+            dst[3] = static_cast<u8>(alpha + (dst[3] * inv + 127) / 255);
+        }
+    }
+}
+
+template <int dstElem> static RowKernel getConvertKernel(int srcElem) {
+    switch (srcElem) {
+    case 1:
+        return convertRow<dstElem, 1>;
+    case 3:
+        return convertRow<dstElem, 3>;
+    default:
+        return convertRow<dstElem, 4>;
+    }
+}
+
+static RowKernel getConvertKernel(int dstElem, int srcElem) {
+    switch (dstElem) {
+    case 1:
+        return getConvertKernel<1>(srcElem);
+    case 3:
+        return getConvertKernel<3>(srcElem);
+    default:
+        return getConvertKernel<4>(srcElem);
+    }
+}
+
+static RowKernel getBlendKernel(int dstElem) {
+    switch (dstElem) {
+    case 1:
+        return blendRow<1>;
+    case 3:
+        return blendRow<3>;
+    default:
+        return blendRow<4>;
+    }
+}
+
+/** Apply the kernel on the rows of the source image drawn at (x, y) on the
+ * destination image, clipped to the destination bounds. */
+static void applyClipped(Image &dst, const Image &src, int x, int y,
+                         RowKernel kernel) {
+    const int x0 = std::max(x, 0), x1 = std::min(x + src.width(), dst.width());
+    const int y0 = std::max(y, 0);
+    const int y1 = std::min(y + src.height(), dst.height());
+
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const int dstElem = dst.elemSize(), srcElem = src.elemSize();
+
+    for (int row = y0; row < y1; ++row) {
+        kernel(dst.data() + (row * dst.width() + x0) * dstElem,
+               src.data() + ((row - y) * src.width() + x0 - x) * srcElem,
+               x1 - x0);
+    }
+}
 
+Image ImageUtils::toType(const Image &src, ImageType type) {
+    checkUncompressed(src, "toType");
+    Image dst(src.width(), src.height(), type);
+    checkUncompressed(dst, "toType");
+
+    getConvertKernel(dst.elemSize(), src.elemSize())(
+        dst.data(), src.data(), src.width() * src.height());
     return dst;
 }
 
-void ImageUtils::paintTexturef(Image &dst, const Image &src,
-                               const vec2d &dstPos, const vec2d &dstSize) {
+ImageRect ImageUtils::paintTexturef(Image &dst, const Image &src,
+                                    const vec2d &dstPos,
+                                    const vec2d &dstSize) {
+    checkUncompressed(dst, "paintTexturef");
+    checkUncompressed(src, "paintTexturef");
+
     vec2i dstDims{dst.width(), dst.height()};
     vec2i srcDims{src.width(), src.height()};
     vec2d startPoint = dstPos * dstDims;
@@ -29,24 +294,512 @@ void ImageUtils::paintTexturef(Image &dst, const Image &src,
     vec2i dstMax{static_cast<int>(floor(min(endPoint.x, dstDims.x))),
                  static_cast<int>(floor(min(endPoint.y, dstDims.y)))};
 
+    if (dstMin.x >= dstMax.x || dstMin.y >= dstMax.y) {
+        return {};
+    }
+
+    // Source column of each destination column
+    const int count = dstMax.x - dstMin.x;
+    std::vector<int> srcColumns(count);
+
     for (int x = dstMin.x; x < dstMax.x; ++x) {
-        for (int y = dstMin.y; y < dstMax.y; ++y) {
-            vec2d srcPos = (vec2d(x, y) - startPoint) / dims *
-                           (srcDims - vec2d(0.01, 0.01));
+        srcColumns[x - dstMin.x] = static_cast<int>(
+            floor((x - startPoint.x) / dims.x * (srcDims.x - 0.01)));
+    }
+
+    const int dstElem = dst.elemSize(), srcElem = src.elemSize();
+    // Only the colors are painted, the alpha of the destination is kept
+    const bool colorOnly = dstElem >= 3 && srcElem >= 3;
+    RowKernel convert = getConvertKernel(dstElem, srcElem);
+
+    for (int y = dstMin.y; y < dstMax.y; ++y) {
+        const int srcY = static_cast<int>(
+            floor((y - startPoint.y) / dims.y * (srcDims.y - 0.01)));
+        const u8 *srcLine = src.data() + srcY * src.width() * srcElem;
+        u8 *dstPixel = dst.data() + (y * dst.width() + dstMin.x) * dstElem;
+
+        for (int i = 0; i < count; ++i, dstPixel += dstElem) {
+            const u8 *srcPixel = srcLine + srcColumns[i] * srcElem;
 
-            // TODO handle other image types
-            // TODO test this function carefully
-            dst.rgb(x, y) = src.rgb(static_cast<int>(floor(srcPos.x)),
-                                    static_cast<int>(floor(srcPos.y)));
+            if (colorOnly) {
+                memcpy(dstPixel, srcPixel, 3);
+            } else {
+                convert(dstPixel, srcPixel, 1);
+            }
         }
     }
+
+    return {dstMin.x, dstMin.y, dstMax.x - dstMin.x, dstMax.y - dstMin.y};
 }
 
 void ImageUtils::fill(Image &img, const Color4d &color) {
-    for (u32 y = 0; y < img.height(); ++y) {
-        for (u32 x = 0; x < img.width(); ++x) {
-            img.rgb(x, y).setf(color._r, color._g, color._b);
+    fillRect(img, 0, 0, img.width(), img.height(), color);
+}
+
+void ImageUtils::fillRect(Image &img, int x, int y, int width, int height,
+                          const Color4d &color) {
+    checkUncompressed(img, "fillRect");
+
+    const int x0 = std::max(x, 0), x1 = std::min(x + width, img.width());
+    const int y0 = std::max(y, 0), y1 = std::min(y + height, img.height());
+
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    const int elemSize = img.elemSize();
+    const u8 pixel[] = {toByte(color._r), toByte(color._g), toByte(color._b),
+                        toByte(color._a)};
+    const int rowSize = (x1 - x0) * elemSize;
+
+    // Fill the first row, then copy it to the others
+    u8 *first = img.data() + (y0 * img.width() + x0) * elemSize;
+
+    for (int i = 0; i < rowSize; ++i) {
+        first[i] = pixel[i % elemSize];
+    }
+
+    for (int row = y0 + 1; row < y1; ++row) {
+        memcpy(img.data() + (row * img.width() + x0) * elemSize, first,
+               rowSize);
+    }
+}
+
+void ImageUtils::blit(Image &dst, const Image &src, int x, int y) {
+    checkUncompressed(dst, "blit");
+    checkUncompressed(src, "blit");
+    applyClipped(dst, src, x, y,
+                 getConvertKernel(dst.elemSize(), src.elemSize()));
+}
+
+void ImageUtils::blend(Image &dst, const Image &src, int x, int y) {
+    if (src.type() != ImageType::RGBA) {
+        blit(dst, src, x, y);
+        return;
+    }
+    checkUncompressed(dst, "blend");
+    applyClipped(dst, src, x, y, getBlendKernel(dst.elemSize()));
+}
+
+void ImageUtils::scaleBias(Image &img, const Color4d &scale,
+                           const Color4d &bias) {
+    checkUncompressed(img, "scaleBias");
+
+    const int elemSize = img.elemSize();
+    const double scales[] = {scale._r, scale._g, scale._b, scale._a};
+    const double biases[] = {bias._r, bias._g, bias._b, bias._a};
+    // One lookup table per channel
+    u8 table[4][256];
+
+    for (int c = 0; c < elemSize; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            const double result = v / 255. * scales[c] + biases[c];
+            table[c][v] = static_cast<u8>(clamp(result, 0., 1.) * 255 + 0.5);
+        }
+    }
+
+    u8 *data = img.data();
+    const int size = img.size();
+
+    for (int i = 0; i < size; i += elemSize) {
+        for (int c = 0; c < elemSize; ++c) {
+            data[i + c] = table[c][data[i + c]];
+        }
+    }
+}
+
+void ImageUtils::getRowf(const Image &img, int y, float *values) {
+    checkUncompressed(img, "getRowf");
+    const int count = img.width() * img.elemSize();
+    const u8 *row = img.data() + y * count;
+
+    for (int i = getRowfSIMD(row, values, count); i < count; ++i) {
+        values[i] = static_cast<float>(row[i] / 255.);
+    }
+}
+
+void ImageUtils::setRowf(Image &img, int y, const float *values) {
+    checkUncompressed(img, "setRowf");
+    const int count = img.width() * img.elemSize();
+    u8 *row = img.data() + y * count;
+
+    for (int i = setRowfSIMD(row, values, count); i < count; ++i) {
+        row[i] = toByte(values[i]);
+    }
+}
+
+Image ImageUtils::crop(const Image &src, int x, int y, int width,
+                        int height) {
+    if (src.isCompressed()) {
+        throw std::invalid_argument("ImageUtils::crop: image is compressed");
+    }
+    if (x < 0 || y < 0 || width < 0 || height < 0 ||
+        x + width > src.width() || y + height > src.height()) {
+        throw std::invalid_argument("ImageUtils::crop: out of bounds");
+    }
+
+    Image dst(width, height, src.type());
+    const int elemSize = src.elemSize();
+
+    for (int j = 0; j < height; ++j) {
+        memcpy(dst.data() + j * width * elemSize,
+               src.data() + ((y + j) * src.width() + x) * elemSize,
+               width * elemSize);
+    }
+    return dst;
+}
+
+/** Taps of a 2x downsampling filter: output pixel i is the weighted sum of
+ * the source pixels 2 * i + offset. */
+struct MipTaps {
+    int _offset;
+    std::vector<float> _weights;
+};
+
+static double besselI0(double x) {
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 20; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static const MipTaps &getMipTaps(MipFilter filter) {
+    static const MipTaps boxTaps{0, {0.5f, 0.5f}};
+    static const MipTaps kaiserTaps = []() {
+        const double width = 3, alpha = 4;
+        MipTaps taps{-2, {}};
+        double total = 0;
+
+        for (int i = 0; i < 6; ++i) {
+            // distance to the output pixel center, in output pixels
+            const double x = (i + taps._offset - 0.5) / 2;
+            const double sinc = sin(M_PI * x) / (M_PI * x);
+            const double r = x / width;
+            const double window =
+                besselI0(alpha * sqrt(1 - r * r)) / besselI0(alpha);
+            taps._weights.push_back(static_cast<float>(sinc * window));
+            total += sinc * window;
+        }
+        for (float &weight : taps._weights) {
+            weight /= static_cast<float>(total);
+        }
+        return taps;
+    }();
+
+    return filter == MipFilter::KAISER ? kaiserTaps : boxTaps;
+}
+
+static const float *getSrgbToLinear() {
+    static const std::vector<float> table = []() {
+        std::vector<float> t(256);
+
+        for (int i = 0; i < 256; ++i) {
+            const double c = i / 255.0;
+            t[i] = static_cast<float>(
+                c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+/** Table from linear values quantized on 4096 steps to sRGB values. */
+static const u8 *getLinearToSrgb() {
+    static const std::vector<u8> table = []() {
+        std::vector<u8> t(4096);
+
+        for (int i = 0; i < 4096; ++i) {
+            const double c = i / 4095.0;
+            const double s =
+                c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1 / 2.4) - 0.055;
+            t[i] = static_cast<u8>(s * 255 + 0.5);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+/** SSE2 part of the 2x2 box filter of a line. Returns the number of output
+ * pixels computed, the remaining ones are computed by the scalar loop. Only
+ * greyscale and RGBA lines are vectorized. */
+template <int elemSize>
+static int downsampleBoxSSE2(const u8 *, const u8 *, u8 *, int) {
+    return 0;
+}
+
+#ifdef __SSE2__
+template <>
+int downsampleBoxSSE2<1>(const u8 *row0, const u8 *row1, u8 *out,
+                         int count) {
+    const __m128i lowBytes = _mm_set1_epi16(0xFF);
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+
+    // 16 source pixels of each row give 8 output pixels
+    for (; x + 8 <= count; x += 8) {
+        __m128i a =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * x));
+        __m128i b =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * x));
+        __m128i sum =
+            _mm_add_epi16(_mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8));
+        sum = _mm_add_epi16(sum, _mm_and_si128(b, lowBytes));
+        sum = _mm_add_epi16(sum, _mm_srli_epi16(b, 8));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x),
+                         _mm_packus_epi16(sum, sum));
+    }
+    return x;
+}
+
+template <>
+int downsampleBoxSSE2<4>(const u8 *row0, const u8 *row1, u8 *out,
+                         int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    int x = 0;
+
+    // 4 source pixels of each row give 2 output pixels
+    for (; x + 2 <= count; x += 2) {
+        __m128i a =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 8 * x));
+        __m128i b =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 8 * x));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                   _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                   _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 4 * x),
+                         _mm_packus_epi16(sum, sum));
+    }
+    return x;
+}
+#endif
+
+/** out[i] += weight * in[i] for the count values of a line. */
+static void accumulateRow(float *out, const float *in, float weight,
+                          int count) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 w = _mm_set1_ps(weight);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(out + i),
+                                _mm_mul_ps(w, _mm_loadu_ps(in + i)));
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] += weight * in[i];
+    }
+}
+
+/** 2x2 box filter on 8 bits values, without any conversion. */
+template <int elemSize>
+static void downsampleBox(const Image &src, Image &dst) {
+    const int srcLine = src.width() * elemSize;
+    // If the source is 1 pixel wide, the pixel is averaged with itself
+    const int next = src.width() > 1 ? elemSize : 0;
+
+    for (int y = 0; y < dst.height(); ++y) {
+        const u8 *row0 =
+            src.data() + std::min(2 * y, src.height() - 1) * srcLine;
+        const u8 *row1 =
+            src.data() + std::min(2 * y + 1, src.height() - 1) * srcLine;
+        u8 *out = dst.data() + y * dst.width() * elemSize;
+        int x = 0;
+
+        if (next != 0) {
+            x = downsampleBoxSSE2<elemSize>(row0, row1, out, dst.width());
+        }
+
+        for (; x < dst.width(); ++x) {
+            const u8 *p0 = row0 + 2 * x * elemSize;
+            const u8 *p1 = row1 + 2 * x * elemSize;
+
+            for (int c = 0; c < elemSize; ++c) {
+                out[x * elemSize + c] = static_cast<u8>(
+                    (p0[c] + p0[c + next] + p1[c] + p1[c + next] + 2) >> 2);
+            }
+        }
+    }
+}
+
+/** Separable filter on float values, with sRGB decoding and alpha
+ * weighting. The horizontal pass is done line by line while decoding, and
+ * the vertical pass line by line while encoding, so that the only
+ * intermediate buffer is the horizontally filtered image. The pixel size is
+ * a template parameter so that the loops on channels are unrolled. */
+template <int elemSize>
+static void downsampleFiltered(const Image &src, Image &dst,
+                               const MipChainParams &params) {
+    const bool hasAlpha = elemSize == 4;
+    const bool alphaWeighted = params._alphaWeighted && hasAlpha;
+    const int colorCount = hasAlpha ? 3 : elemSize;
+    const int srcW = src.width(), srcH = src.height();
+    const int dstW = dst.width(), dstH = dst.height();
+    const MipTaps &taps = getMipTaps(params._filter);
+    const int tapCount = static_cast<int>(taps._weights.size());
+    const float *weights = taps._weights.data();
+    const int lineSize = dstW * elemSize;
+
+    // Decoding and horizontal pass
+    const float *srgbToLinear = getSrgbToLinear();
+    std::vector<float> input(srcW * elemSize);
+    std::vector<float> horizontal(lineSize * srcH, 0.f);
+
+    for (int y = 0; y < srcH; ++y) {
+        const u8 *inLine = src.data() + y * srcW * elemSize;
+
+        for (int x = 0; x < srcW; ++x) {
+            const u8 *pixel = inLine + x * elemSize;
+            float *value = input.data() + x * elemSize;
+            const float alpha = hasAlpha ? pixel[3] / 255.f : 1.f;
+
+            for (int c = 0; c < colorCount; ++c) {
+                value[c] =
+                    params._srgb ? srgbToLinear[pixel[c]] : pixel[c] / 255.f;
+            }
+            if (alphaWeighted) {
+                for (int c = 0; c < colorCount; ++c) {
+                    value[c] *= alpha;
+                }
+            }
+            if (hasAlpha) {
+                value[3] = alpha;
+            }
+        }
+
+        float *outLine = horizontal.data() + y * lineSize;
+
+        for (int x = 0; x < dstW; ++x) {
+            const int first = 2 * x + taps._offset;
+            float *out = outLine + x * elemSize;
+
+            if (first >= 0 && first + tapCount <= srcW) {
+                const float *in = input.data() + first * elemSize;
+#ifdef __SSE2__
+                // One RGBA pixel per register
+                if (elemSize == 4) {
+                    __m128 sum = _mm_setzero_ps();
+
+                    for (int t = 0; t < tapCount; ++t) {
+                        sum = _mm_add_ps(sum,
+                                         _mm_mul_ps(_mm_set1_ps(weights[t]),
+                                                    _mm_loadu_ps(in + t * 4)));
+                    }
+                    _mm_storeu_ps(out, sum);
+                    continue;
+                }
+#endif
+                for (int t = 0; t < tapCount; ++t) {
+                    for (int c = 0; c < elemSize; ++c) {
+                        out[c] += weights[t] * in[t * elemSize + c];
+                    }
+                }
+            } else {
+                for (int t = 0; t < tapCount; ++t) {
+                    const int sx = clamp(first + t, 0, srcW - 1);
+
+                    for (int c = 0; c < elemSize; ++c) {
+                        out[c] += weights[t] * input[sx * elemSize + c];
+                    }
+                }
+            }
+        }
+    }
+
+    // Vertical pass and encoding
+    const u8 *linearToSrgb = getLinearToSrgb();
+    std::vector<float> output(lineSize);
+
+    for (int y = 0; y < dstH; ++y) {
+        std::fill(output.begin(), output.end(), 0.f);
+
+        for (int t = 0; t < tapCount; ++t) {
+            const int sy = clamp(2 * y + taps._offset + t, 0, srcH - 1);
+            accumulateRow(output.data(), horizontal.data() + sy * lineSize,
+                          weights[t], lineSize);
+        }
+
+        u8 *outLine = dst.data() + y * lineSize;
+
+        for (int x = 0; x < dstW; ++x) {
+            const float *value = output.data() + x * elemSize;
+            u8 *pixel = outLine + x * elemSize;
+            const float alpha = hasAlpha ? clamp(value[3], 0.f, 1.f) : 1.f;
+
+            for (int c = 0; c < colorCount; ++c) {
+                float v = value[c];
+
+                if (alphaWeighted) {
+                    v = alpha > 0 ? v / alpha : 0;
+                }
+                v = clamp(v, 0.f, 1.f);
+                pixel[c] = params._srgb
+                               ? linearToSrgb[static_cast<int>(v * 4095 + 0.5f)]
+                               : static_cast<u8>(v * 255 + 0.5f);
+            }
+            if (hasAlpha) {
+                pixel[3] = static_cast<u8>(alpha * 255 + 0.5f);
+            }
+        }
+    }
+}
+
+Image ImageUtils::downsample(const Image &src, const MipChainParams &params) {
+    if (src.isCompressed()) {
+        throw std::invalid_argument(
+            "ImageUtils::downsample: image is compressed");
+    }
+
+    Image dst(std::max(src.width() / 2, 1), std::max(src.height() / 2, 1),
+              src.type());
+
+    if (params._filter == MipFilter::BOX && !params._srgb &&
+        !(params._alphaWeighted && src.type() == ImageType::RGBA)) {
+        switch (src.type()) {
+        case ImageType::GREYSCALE:
+            downsampleBox<1>(src, dst);
+            break;
+        case ImageType::RGB:
+            downsampleBox<3>(src, dst);
+            break;
+        default:
+            downsampleBox<4>(src, dst);
+        }
+    } else if (src.type() == ImageType::GREYSCALE) {
+        downsampleFiltered<1>(src, dst, params);
+    } else if (src.type() == ImageType::RGB) {
+        downsampleFiltered<3>(src, dst, params);
+    } else {
+        downsampleFiltered<4>(src, dst, params);
+    }
+    return dst;
+}
+
+void ImageUtils::generateMips(Image &img, const MipChainParams &params,
+                              int firstLevel) {
+    if (img.isCompressed()) {
+        throw std::invalid_argument(
+            "ImageUtils::generateMips: image is compressed");
+    }
+    img.clearMips(std::max(firstLevel - 1, 0));
+
+    while (true) {
+        const Image &last = img.mip(img.mipCount());
+
+        if (last.width() <= 1 && last.height() <= 1) {
+            break;
         }
+        img.addMip(downsample(last, params));
     }
 }
 
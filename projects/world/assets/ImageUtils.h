@@ -3,28 +3,127 @@
 
 #include "world/core/WorldConfig.h"
 
+#include <algorithm>
+
 #include "Image.h"
 #include "Color.h"
 #include "world/math/Vector.h"
 
 namespace world {
 
+enum class WORLDAPI_EXPORT MipFilter {
+    /// Average of 2x2 pixels. The fastest filter.
+    BOX = 0,
+    /// Kaiser windowed sinc filter with 6x6 taps, which keeps the mips
+    /// sharper than the box filter.
+    KAISER = 1
+};
+
+/** Rectangle of pixels in an image. */
+struct WORLDAPI_EXPORT ImageRect {
+    int _x = 0;
+    int _y = 0;
+    int _width = 0;
+    int _height = 0;
+
+    bool isEmpty() const { return _width <= 0 || _height <= 0; }
+
+    /** Extend this rectangle so that it also contains the other one. */
+    void merge(const ImageRect &other) {
+        if (other.isEmpty()) {
+            return;
+        }
+        if (isEmpty()) {
+            *this = other;
+            return;
+        }
+        const int right = std::max(_x + _width, other._x + other._width);
+        const int bottom = std::max(_y + _height, other._y + other._height);
+        _x = std::min(_x, other._x);
+        _y = std::min(_y, other._y);
+        _width = right - _x;
+        _height = bottom - _y;
+    }
+};
+
+struct WORLDAPI_EXPORT MipChainParams {
+    MipFilter _filter = MipFilter::BOX;
+    /// Color channels are sRGB encoded, so they are filtered in linear space.
+    bool _srgb = false;
+    /// Colors are weighted by alpha, so that transparent pixels do not bleed
+    /// their color on the visible ones.
+    bool _alphaWeighted = false;
+};
+
 class WORLDAPI_EXPORT ImageUtils {
 public:
     ImageUtils() = delete;
 
+    /** Convert the image to another uncompressed type. Greyscale levels are
+     * copied to the red, green and blue channels, the red channel is used
+     * as the greyscale level, and missing alpha is set to opaque. */
     static Image toType(const Image &src, ImageType type);
 
     /**
      * \param dstPos position of the top-left corner of the source image on
      * the destination image. {0., 0.} is top left and {1., 1.} is bottom right.
      * dstPos can be outside of destination image bounds.
-     * \param size of the source image relatively to the destination image. */
-    static void paintTexturef(Image &dst, const Image &src, const vec2d &dstPos,
-                              const vec2d &dstSize);
+     * \param size of the source image relatively to the destination image.
+     * \returns the rectangle of the destination image that was painted. */
+    static ImageRect paintTexturef(Image &dst, const Image &src,
+                                   const vec2d &dstPos, const vec2d &dstSize);
 
+    /** Fill the whole image with the given color. Greyscale images are
+     * filled with the red component. */
     static void fill(Image &img, const Color4d &color);
 
+    /** Fill a rectangle of the image with the given color. The rectangle is
+     * clipped to the image bounds. */
+    static void fillRect(Image &img, int x, int y, int width, int height,
+                         const Color4d &color);
+
+    /** Copy the source image on the destination image, with its top-left
+     * corner at (x, y). The source is clipped to the destination bounds and
+     * converted to the destination type like in toType(). */
+    static void blit(Image &dst, const Image &src, int x, int y);
+
+    /** Blend the source image over the destination image using the source
+     * alpha, with its top-left corner at (x, y). The alpha of a RGBA
+     * destination is blended too. Sources without alpha are copied like in
+     * blit(). */
+    static void blend(Image &dst, const Image &src, int x, int y);
+
+    /** Replace each channel value v of the image by v * scale + bias,
+     * clamped to [0, 1]. Greyscale images use the red components. */
+    static void scaleBias(Image &img, const Color4d &scale,
+                          const Color4d &bias);
+
+    /** Read the line y of the image as floats in [0, 1]. values must hold
+     * width * elemSize floats. Same conversion as Image::getf(). */
+    static void getRowf(const Image &img, int y, float *values);
+
+    /** Write the line y of the image from floats in [0, 1]. Same conversion
+     * as Image::setf(). */
+    static void setRowf(Image &img, int y, const float *values);
+
+    /** Copy a rectangle of the source image to a new image.
+     * @throws std::invalid_argument if the rectangle is not inside the image,
+     * or if the image is compressed. */
+    static Image crop(const Image &src, int x, int y, int width, int height);
+
+    /** Create an image of half the size of src, rounded down and at least
+     * 1 pixel.
+     * @throws std::invalid_argument if the image is compressed. */
+    static Image downsample(const Image &src,
+                            const MipChainParams &params = {});
+
+    /** Compute the mip levels of the image, down to the 1x1 level. Levels
+     * below firstLevel are kept as is, so they can be filled beforehand, and
+     * the following levels are computed from them.
+     * @throws std::invalid_argument if the image is compressed. */
+    static void generateMips(Image &img, const MipChainParams &params = {},
+                             int firstLevel = 1);
+
     /** Draw a line at the given coordinates (in pixels) */
     static void drawLine(Image &img, const vec2d &from, const vec2d &to,
                          double width, const Color4d &color,
@@ -0,0 +1,234 @@
+#include "Impostor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "world/math/BoundingBox.h"
+
+namespace world {
+
+static u8 toByte(double value) {
+    return static_cast<u8>(std::max(0., std::min(value, 1.)) * 255 + 0.5);
+}
+
+Impostor::Impostor(int gridSize, int cellRes)
+        : _gridSize(gridSize), _cellRes(cellRes),
+          _colorAtlas(gridSize * cellRes, gridSize * cellRes, ImageType::RGBA),
+          _normalAtlas(gridSize * cellRes, gridSize * cellRes,
+                       ImageType::RGB) {}
+
+void Impostor::addMesh(const Mesh &mesh, const Color4d &color) {
+    for (u32 f = 0; f < mesh.getFaceCount(); ++f) {
+        const Face &face = mesh.getFace(f);
+
+        for (int v = 0; v < 3; ++v) {
+            const Vertex &vertex = mesh.getVertex(face.getID(v));
+            _positions.push_back(vertex.getPosition());
+            _normals.push_back(vertex.getNormal());
+        }
+        _colors.push_back(color);
+    }
+}
+
+void Impostor::bake() {
+    u8 *colors = _colorAtlas.data();
+    u8 *normals = _normalAtlas.data();
+    std::fill(colors, colors + _colorAtlas.size(), u8(0));
+    std::fill(normals, normals + _normalAtlas.size(), u8(0));
+
+    if (_positions.empty()) {
+        return;
+    }
+
+    BoundingBox bbox(_positions[0], _positions[0]);
+
+    for (const vec3d &position : _positions) {
+        bbox.addPoint(position);
+    }
+    _center = (bbox.getLowerBound() + bbox.getUpperBound()) / 2;
+    _radius = 0;
+
+    for (const vec3d &position : _positions) {
+        _radius = std::max(_radius, (position - _center).norm());
+    }
+
+    std::vector<double> depth(_cellRes * _cellRes);
+
+    for (int j = 0; j < _gridSize; ++j) {
+        for (int i = 0; i < _gridSize; ++i) {
+            renderCell(i, j, depth);
+        }
+    }
+}
+
+vec3d Impostor::getViewDirection(int i, int j) const {
+    // Center of the cell in [-1, 1]^2, then unfold the square into the
+    // upper half of the octahedron |x| + |y| + z = 1
+    const double px = (i + 0.5) / _gridSize * 2 - 1;
+    const double py = (j + 0.5) / _gridSize * 2 - 1;
+    const double x = (px + py) / 2;
+    const double y = (px - py) / 2;
+    return vec3d{x, y, 1 - std::abs(x) - std::abs(y)}.normalize();
+}
+
+vec2i Impostor::getCell(const vec3d &direction) const {
+    const double sum = std::abs(direction.x) + std::abs(direction.y) +
+                       std::abs(direction.z);
+    const double x = direction.x / sum;
+    const double y = direction.y / sum;
+    const double px = x + y, py = x - y;
+
+    auto toCell = [this](double p) {
+        const int cell = static_cast<int>(std::floor((p + 1) / 2 * _gridSize));
+        return std::max(0, std::min(cell, _gridSize - 1));
+    };
+    return {toCell(px), toCell(py)};
+}
+
+Mesh Impostor::createCrossedQuads(int quadCount) const {
+    Mesh mesh;
+    const double cellSize = 1. / _gridSize;
+
+    for (int q = 0; q < quadCount; ++q) {
+        const double angle = M_PI * q / quadCount;
+        const vec2i cell = getCell({cos(angle), sin(angle), 0});
+        vec3d right, up;
+        viewBasis(getViewDirection(cell.x, cell.y), right, up);
+        right *= _radius;
+        up *= _radius;
+
+        const vec3d normal = right.crossProduct(up).normalize();
+        const double u = cell.x * cellSize, v = cell.y * cellSize;
+        const int first = static_cast<int>(mesh.getVerticesCount());
+
+        mesh.newVertex(_center - right - up, normal, {u, v});
+        mesh.newVertex(_center + right - up, normal, {u + cellSize, v});
+        mesh.newVertex(_center + right + up, normal,
+                       {u + cellSize, v + cellSize});
+        mesh.newVertex(_center - right + up, normal, {u, v + cellSize});
+        mesh.newFace(first, first + 1, first + 2);
+        mesh.newFace(first, first + 2, first + 3);
+    }
+    return mesh;
+}
+
+void Impostor::viewBasis(const vec3d &direction, vec3d &right,
+                         vec3d &up) const {
+    right = vec3d{0, 0, 1}.crossProduct(direction);
+
+    if (right.norm() < 1e-9) {
+        right = {1, 0, 0};
+    } else {
+        right = right.normalize();
+    }
+    up = direction.crossProduct(right);
+}
+
+void Impostor::renderCell(int i, int j, std::vector<double> &depth) {
+    const vec3d direction = getViewDirection(i, j);
+    vec3d right, up;
+    viewBasis(direction, right, up);
+
+    std::fill(depth.begin(), depth.end(),
+              -std::numeric_limits<double>::infinity());
+
+    // Pixels of the cell cover [-radius, radius]^2 in the view plane
+    const double scale = _cellRes / (2 * _radius);
+    const int atlasWidth = _gridSize * _cellRes;
+    const int firstRow = (_gridSize - 1 - j) * _cellRes;
+    const int firstColumn = i * _cellRes;
+    u8 *colors = _colorAtlas.data();
+    u8 *normals = _normalAtlas.data();
+
+    for (size_t t = 0; t < _colors.size(); ++t) {
+        // Triangle in pixel coordinates, y going up
+        double px[3], py[3], pz[3];
+
+        for (int v = 0; v < 3; ++v) {
+            const vec3d p = _positions[t * 3 + v] - _center;
+            px[v] = (p.dotProduct(right) + _radius) * scale;
+            py[v] = (p.dotProduct(up) + _radius) * scale;
+            pz[v] = p.dotProduct(direction);
+        }
+
+        const double area = (px[1] - px[0]) * (py[2] - py[0]) -
+                            (px[2] - px[0]) * (py[1] - py[0]);
+
+        if (std::abs(area) < 1e-12) {
+            continue;
+        }
+
+        // Pixels whose center is in the bounding box of the triangle
+        auto first = [](double a, double b, double c) {
+            return int(std::ceil(std::min({a, b, c}) - 0.5));
+        };
+        auto last = [](double a, double b, double c) {
+            return int(std::floor(std::max({a, b, c}) - 0.5));
+        };
+        const int minX = std::max(0, first(px[0], px[1], px[2]));
+        const int maxX = std::min(_cellRes - 1, last(px[0], px[1], px[2]));
+        const int minY = std::max(0, first(py[0], py[1], py[2]));
+        const int maxY = std::min(_cellRes - 1, last(py[0], py[1], py[2]));
+
+        for (int y = minY; y <= maxY; ++y) {
+            const double cy = y + 0.5;
+
+            for (int x = minX; x <= maxX; ++x) {
+                const double cx = x + 0.5;
+
+                // Barycentric coordinates of the pixel center
+                double w[3];
+
+                for (int v = 0; v < 3; ++v) {
+                    const int a = (v + 1) % 3, b = (v + 2) % 3;
+                    w[v] = ((px[b] - px[a]) * (cy - py[a]) -
+                            (cx - px[a]) * (py[b] - py[a])) /
+                           area;
+                }
+
+                if (w[0] < 0 || w[1] < 0 || w[2] < 0) {
+                    continue;
+                }
+
+                const double z = w[0] * pz[0] + w[1] * pz[1] + w[2] * pz[2];
+                double &pixelDepth = depth[y * _cellRes + x];
+
+                if (z <= pixelDepth) {
+                    continue;
+                }
+                pixelDepth = z;
+
+                vec3d normal = _normals[t * 3] * w[0] +
+                               _normals[t * 3 + 1] * w[1] +
+                               _normals[t * 3 + 2] * w[2];
+
+                if (normal.norm() < 1e-9) {
+                    normal = direction;
+                }
+                normal = normal.normalize();
+
+                // Normals of double sided geometry face the viewer
+                if (normal.dotProduct(direction) < 0) {
+                    normal = -normal;
+                }
+
+                const int row = firstRow + _cellRes - 1 - y;
+                const int pixel = row * atlasWidth + firstColumn + x;
+                const Color4d &color = _colors[t];
+                u8 *c = colors + pixel * 4;
+                c[0] = toByte(color._r);
+                c[1] = toByte(color._g);
+                c[2] = toByte(color._b);
+                c[3] = 255;
+
+                u8 *n = normals + pixel * 3;
+                n[0] = toByte(normal.x * 0.5 + 0.5);
+                n[1] = toByte(normal.y * 0.5 + 0.5);
+                n[2] = toByte(normal.z * 0.5 + 0.5);
+            }
+        }
+    }
+}
+
+} // namespace world
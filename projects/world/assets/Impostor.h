@@ -0,0 +1,92 @@
+#ifndef WORLD_IMPOSTOR_H
+#define WORLD_IMPOSTOR_H
+
+#include "world/core/WorldConfig.h"
+
+#include <vector>
+
+#include "world/math/Vector.h"
+#include "Color.h"
+#include "Image.h"
+#include "Mesh.h"
+
+namespace world {
+
+/** Octahedral impostor of an object: views of the object from the
+ * directions of the upper hemisphere, rendered on the CPU in a color atlas
+ * and a normal atlas.
+ *
+ * The atlases are split in gridSize x gridSize cells. Cell (i, j) holds the
+ * orthographic view of the object along the direction of its center in the
+ * hemi-octahedral mapping (see getViewDirection()). In each view, the right
+ * axis is normalize(z x direction), or x when looking straight down, and the
+ * up axis is direction x right. The view covers a square of side 2 *
+ * getRadius() centered on getCenter().
+ *
+ * Cells are indexed with the texture convention of the meshes: i goes along
+ * u, j goes along v, and v = 1 is the first row of the images. The color
+ * atlas holds the colors of the meshes and an alpha of 0 where the object
+ * is not visible. The normal atlas holds the normals of the object in the
+ * object space, encoded as n * 0.5 + 0.5. */
+class WORLDAPI_EXPORT Impostor {
+public:
+    Impostor(int gridSize = 8, int cellRes = 64);
+
+    /** Add a mesh to the object, drawn with a flat color. */
+    void addMesh(const Mesh &mesh, const Color4d &color);
+
+    /** Render all the views of the object in the atlases. */
+    void bake();
+
+    int getGridSize() const { return _gridSize; }
+
+    int getCellRes() const { return _cellRes; }
+
+    const Image &getColorAtlas() const { return _colorAtlas; }
+
+    const Image &getNormalAtlas() const { return _normalAtlas; }
+
+    /** Center of the bounding sphere of the object. */
+    vec3d getCenter() const { return _center; }
+
+    /** Radius of the bounding sphere of the object. */
+    double getRadius() const { return _radius; }
+
+    /** Direction from the object toward the viewer of the cell (i, j). */
+    vec3d getViewDirection(int i, int j) const;
+
+    /** Cell whose view direction is the closest to the given direction. The
+     * direction is mirrored on the upper hemisphere if it points down. */
+    vec2i getCell(const vec3d &direction) const;
+
+    /** Create a mesh of quadCount quads crossing at the center of the
+     * object. Each quad shows the horizontal view of the object that faces
+     * it, and can be drawn with the color atlas as texture. This mesh does
+     * not need a dedicated shader to be rendered. */
+    Mesh createCrossedQuads(int quadCount = 3) const;
+
+private:
+    int _gridSize;
+    int _cellRes;
+
+    /// Vertices of the triangles of all the meshes, 3 per triangle
+    std::vector<vec3d> _positions;
+    std::vector<vec3d> _normals;
+    /// Color of each triangle
+    std::vector<Color4d> _colors;
+
+    vec3d _center;
+    double _radius = 0;
+
+    Image _colorAtlas;
+    Image _normalAtlas;
+
+
+    void viewBasis(const vec3d &direction, vec3d &right, vec3d &up) const;
+
+    void renderCell(int i, int j, std::vector<double> &depth);
+};
+
+} // namespace world
+
+#endif // WORLD_IMPOSTOR_H
@@ -0,0 +1,27 @@
+#include "InstanceBuffer.h"
+
+#include <utility>
+
+namespace world {
+
+static_assert(sizeof(InstanceTransform) == 9 * sizeof(float),
+              "InstanceTransform must be tightly packed");
+
+InstanceBuffer::InstanceBuffer(std::string meshID, std::string materialID)
+        : _meshID(std::move(meshID)), _materialID(std::move(materialID)) {}
+
+void InstanceBuffer::add(const vec3d &position, const vec3d &rotation,
+                         const vec3d &scale) {
+    _transforms.push_back({position, rotation, scale});
+}
+
+SceneNode InstanceBuffer::getNode(size_t i) const {
+    const InstanceTransform &transform = _transforms[i];
+    SceneNode node(_meshID, _materialID);
+    node.setPosition(transform._position);
+    node.setRotation(transform._rotation);
+    node.setScale(transform._scale);
+    return node;
+}
+
+} // namespace world
@@ -0,0 +1,67 @@
+#ifndef WORLD_INSTANCEBUFFER_H
+#define WORLD_INSTANCEBUFFER_H
+
+#include "world/core/WorldConfig.h"
+
+#include <string>
+#include <vector>
+
+#include "world/math/Vector.h"
+#include "SceneNode.h"
+
+namespace world {
+
+/** Transform of one instance, in single precision so that it can be uploaded
+ * as is to the GPU. */
+struct InstanceTransform {
+    vec3f _position;
+    vec3f _rotation;
+    vec3f _scale;
+};
+
+/** Many instances of the same mesh with the same material. The transforms
+ * of the instances are stored in a contiguous array, so that a host can read
+ * them as a single block, for example to fill an instancing buffer.
+ *
+ * Generators that place many copies of the same object (InstancePool)
+ * emit one buffer per object instead of one SceneNode per copy, provided
+ * that the collector has a channel for this type. */
+class WORLDAPI_EXPORT InstanceBuffer {
+public:
+    InstanceBuffer() = default;
+
+    explicit InstanceBuffer(std::string meshID, std::string materialID = "");
+
+    const std::string &getMeshID() const { return _meshID; }
+
+    const std::string &getMaterialID() const { return _materialID; }
+
+    void add(const vec3d &position, const vec3d &rotation,
+             const vec3d &scale);
+
+    void reserve(size_t count) { _transforms.reserve(count); }
+
+    size_t size() const { return _transforms.size(); }
+
+    bool empty() const { return _transforms.empty(); }
+
+    const InstanceTransform &operator[](size_t i) const {
+        return _transforms[i];
+    }
+
+    /** Get the transforms of all the instances, as a contiguous array of
+     * size() elements. */
+    const InstanceTransform *data() const { return _transforms.data(); }
+
+    /** Create a scene node for the i-th instance. */
+    SceneNode getNode(size_t i) const;
+
+private:
+    std::string _meshID;
+    std::string _materialID;
+    std::vector<InstanceTransform> _transforms;
+};
+
+} // namespace world
+
+#endif // WORLD_INSTANCEBUFFER_H
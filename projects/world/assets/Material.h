@@ -52,6 +52,12 @@ public:
 
     bool isTransparent() const { return _transparent; }
 
+    /** Tells the renderer to draw both sides of the faces, so that thin
+     * objects like leaves do not need their faces to be duplicated. */
+    void setDoubleSided(bool doubleSided) { _doubleSided = doubleSided; }
+
+    bool isDoubleSided() const { return _doubleSided; }
+
 private:
     std::string _name;
     std::string _shader;
@@ -70,5 +76,6 @@ private:
     std::string _mapBump;
 
     bool _transparent = false;
+    bool _doubleSided = false;
 };
 } // namespace world
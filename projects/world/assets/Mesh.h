@@ -70,8 +70,16 @@ class WORLDAPI_EXPORT Mesh {
 public:
     Mesh(std::string name = "");
 
+    Mesh(const Mesh &other) = default;
+
+    Mesh(Mesh &&other) = default;
+
     virtual ~Mesh();
 
+    Mesh &operator=(const Mesh &other) = default;
+
+    Mesh &operator=(Mesh &&other) = default;
+
     std::string getName() const { return _name; }
 
     /** Tells the mesh that we are going to add a certain amount
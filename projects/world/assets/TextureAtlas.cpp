@@ -0,0 +1,189 @@
+#include "TextureAtlas.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "world/math/MathsHelper.h"
+#include "ImageUtils.h"
+
+namespace world {
+
+TextureAtlas::TextureAtlas(int pageRes, int textureRes, int maxPages,
+                           int padding, ImageType type)
+        : _pageRes(pageRes), _textureRes(textureRes), _maxPages(maxPages),
+          _padding(padding), _type(type),
+          _slotsPerRow(pageRes / (textureRes + 2 * padding)) {
+
+    if (_slotsPerRow <= 0) {
+        throw std::invalid_argument("Atlas pages are too small to hold one "
+                                    "texture");
+    }
+    if (_maxPages <= 0) {
+        throw std::invalid_argument("Atlas must have at least one page");
+    }
+}
+
+bool TextureAtlas::has(const std::string &key) const {
+    return _entries.find(key) != _entries.end();
+}
+
+AtlasSlot TextureAtlas::find(const std::string &key) const {
+    auto it = _entries.find(key);
+    return it == _entries.end() ? AtlasSlot() : it->second._slot;
+}
+
+AtlasSlot TextureAtlas::get(const std::string &key) {
+    auto it = _entries.find(key);
+
+    if (it == _entries.end()) {
+        return AtlasSlot();
+    }
+
+    _lru.splice(_lru.begin(), _lru, it->second._lruIt);
+    it->second._frame = _frame;
+    return it->second._slot;
+}
+
+AtlasSlot TextureAtlas::put(const std::string &key, const Image &texture,
+                            std::string *evicted) {
+    if (texture.width() != _textureRes || texture.height() != _textureRes) {
+        throw std::invalid_argument("Texture size does not match atlas "
+                                    "texture resolution");
+    }
+
+    if (evicted != nullptr) {
+        evicted->clear();
+    }
+
+    AtlasSlot slot = get(key);
+
+    if (!slot.isValid()) {
+        slot = allocate(evicted);
+
+        if (!slot.isValid()) {
+            return slot;
+        }
+        _lru.push_front(key);
+        _entries[key] = Entry{slot, _lru.begin(), _frame};
+    }
+
+    copyTexture(slot, texture, {0, 0, _textureRes, _textureRes});
+    return slot;
+}
+
+AtlasSlot TextureAtlas::update(const std::string &key, const Image &texture,
+                               const ImageRect &rect) {
+    if (texture.width() != _textureRes || texture.height() != _textureRes) {
+        throw std::invalid_argument("Texture size does not match atlas "
+                                    "texture resolution");
+    }
+
+    AtlasSlot slot = find(key);
+
+    if (slot.isValid()) {
+        copyTexture(slot, texture, rect);
+    }
+    return slot;
+}
+
+void TextureAtlas::remove(const std::string &key) {
+    auto it = _entries.find(key);
+
+    if (it != _entries.end()) {
+        _freeSlots.push_back(it->second._slot);
+        _lru.erase(it->second._lruIt);
+        _entries.erase(it);
+    }
+}
+
+vec2d TextureAtlas::transformUV(const AtlasSlot &slot, const vec2d &uv) const {
+    const double res = _pageRes;
+    return {(slot._x + uv.x * _textureRes) / res,
+            1 - (slot._y + (1 - uv.y) * _textureRes) / res};
+}
+
+ImageRect TextureAtlas::takeChangedRect(int page) {
+    ImageRect changed = _pages.at(page)._changed;
+    _pages.at(page)._changed = ImageRect();
+    return changed;
+}
+
+AtlasSlot TextureAtlas::allocate(std::string *evicted) {
+    if (_freeSlots.empty() && int(_pages.size()) < _maxPages) {
+        const int page = int(_pages.size());
+        const int slotSize = _textureRes + 2 * _padding;
+        _pages.emplace_back(_pageRes, _type);
+        ImageUtils::fill(_pages.back()._image, Color4d(0, 0, 0, 0));
+
+        // Pushed in reverse order so that slots are used from the top left
+        for (int y = _slotsPerRow - 1; y >= 0; --y) {
+            for (int x = _slotsPerRow - 1; x >= 0; --x) {
+                AtlasSlot slot;
+                slot._page = page;
+                slot._x = x * slotSize + _padding;
+                slot._y = y * slotSize + _padding;
+                _freeSlots.push_back(slot);
+            }
+        }
+    }
+
+    if (_freeSlots.empty()) {
+        // Evict least recently used texture, unless it is used in the
+        // current frame
+        const std::string &key = _lru.back();
+
+        if (_frame != 0 && _entries.at(key)._frame == _frame) {
+            return AtlasSlot();
+        }
+
+        if (evicted != nullptr) {
+            *evicted = key;
+        }
+        remove(key);
+    }
+
+    AtlasSlot slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    return slot;
+}
+
+void TextureAtlas::copyTexture(const AtlasSlot &slot, const Image &texture,
+                               const ImageRect &changed) {
+    Page &page = _pages.at(slot._page);
+    Image &image = page._image;
+    ImageUtils::blit(image, texture, slot._x, slot._y);
+
+    // Fill the padding by repeating the borders of the texture, first on
+    // the sides, then above and below
+    const int elemSize = image.elemSize();
+    const int lineSize = image.width() * elemSize;
+    u8 *origin = image.data() + slot._y * lineSize + slot._x * elemSize;
+
+    for (int y = 0; y < _textureRes; ++y) {
+        u8 *first = origin + y * lineSize;
+        u8 *last = first + (_textureRes - 1) * elemSize;
+
+        for (int p = 1; p <= _padding; ++p) {
+            memcpy(first - p * elemSize, first, elemSize);
+            memcpy(last + p * elemSize, last, elemSize);
+        }
+    }
+
+    u8 *firstLine = origin - _padding * elemSize;
+    u8 *lastLine = firstLine + (_textureRes - 1) * lineSize;
+    const int paddedSize = (_textureRes + 2 * _padding) * elemSize;
+
+    for (int p = 1; p <= _padding; ++p) {
+        memcpy(firstLine - p * lineSize, firstLine, paddedSize);
+        memcpy(lastLine + p * lineSize, lastLine, paddedSize);
+    }
+
+    // The padding repeats the borders of the texture
+    page._changed.merge({slot._x + changed._x - _padding,
+                         slot._y + changed._y - _padding,
+                         changed._width + 2 * _padding,
+                         changed._height + 2 * _padding});
+    ++page._version;
+}
+
+} // namespace world
@@ -0,0 +1,154 @@
+#ifndef WORLD_TEXTUREATLAS_H
+#define WORLD_TEXTUREATLAS_H
+
+#include "world/core/WorldConfig.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "world/math/Vector.h"
+#include "Image.h"
+#include "ImageUtils.h"
+
+namespace world {
+
+/** Location of a texture in a TextureAtlas. */
+struct WORLDAPI_EXPORT AtlasSlot {
+    int _page = -1;
+    /** Position of the texture in the page, in pixels. This position does
+     * not include the padding. */
+    int _x = 0;
+    int _y = 0;
+
+    bool isValid() const { return _page >= 0; }
+};
+
+/** A TextureAtlas packs square textures of the same size into bigger
+ * fixed-size images called pages. Each texture is identified by a string key
+ * and stored in a slot of a page. Pages are allocated on demand up to a
+ * maximum count. When all the slots are used, the least recently used
+ * texture is evicted to make room for the new one.
+ *
+ * Each slot has a padding of a few pixels, filled by repeating the borders of
+ * the texture, to avoid bleeding between neighbour textures when the pages
+ * are sampled with filtering.
+ *
+ * Once startFrame() has been called, the textures used in the current frame
+ * are not evicted: a texture that is still displayed keeps its slot until
+ * the frame ends. */
+class WORLDAPI_EXPORT TextureAtlas {
+public:
+    TextureAtlas(int pageRes, int textureRes, int maxPages, int padding = 2,
+                 ImageType type = ImageType::RGB);
+
+    int getPageRes() const { return _pageRes; }
+
+    int getTextureRes() const { return _textureRes; }
+
+    int getMaxPages() const { return _maxPages; }
+
+    int getPageCount() const { return int(_pages.size()); }
+
+    /** Number of slots on a row or a column of a page. */
+    int getSlotsPerRow() const { return _slotsPerRow; }
+
+    /** Size of a slot in pixels, including the padding. */
+    int getSlotSize() const { return _textureRes + 2 * _padding; }
+
+    const Image &getPage(int page) const { return _pages.at(page)._image; }
+
+    /** Get the version of the page. The version is incremented each time the
+     * content of the page changes. */
+    u32 getPageVersion(int page) const { return _pages.at(page)._version; }
+
+    /** Get the rectangle of the page changed since the last call, and reset
+     * it. A new page is changed as a whole. */
+    ImageRect takeChangedRect(int page);
+
+    bool has(const std::string &key) const;
+
+    /** Get the slot of the given texture without marking it as used.
+     * Returns an invalid slot if the texture is not in the atlas. */
+    AtlasSlot find(const std::string &key) const;
+
+    /** Get the slot of the given texture, and mark it as recently used.
+     * Returns an invalid slot if the texture is not in the atlas. */
+    AtlasSlot get(const std::string &key);
+
+    /** Store the texture in the atlas and mark it as recently used. If the
+     * texture is already in the atlas, its content is updated. If there is
+     * no room left in the atlas, the least recently used texture is evicted.
+     * @param evicted if not null, receives the key of the evicted texture,
+     * or an empty string if no texture was evicted.
+     * @returns the slot where the texture is stored, or an invalid slot if
+     * all the slots are used in the current frame. */
+    AtlasSlot put(const std::string &key, const Image &texture,
+                  std::string *evicted = nullptr);
+
+    /** Update the content of a texture already in the atlas, of which only
+     * the given rectangle changed. Only this rectangle and the padding
+     * around it are counted in the changed rectangle of the page.
+     * @returns the slot of the texture, or an invalid slot if the texture is
+     * not in the atlas. */
+    AtlasSlot update(const std::string &key, const Image &texture,
+                     const ImageRect &rect);
+
+    /** Start a new frame. The textures used in the previous frames can be
+     * evicted again. */
+    void startFrame() { ++_frame; }
+
+    void remove(const std::string &key);
+
+    /** Transform texture coordinates relative to a texture into texture
+     * coordinates relative to the page in which the texture is stored. Uses
+     * the same convention as terrain meshes: u goes along the image columns
+     * and v = 1 is the first row of the image. */
+    vec2d transformUV(const AtlasSlot &slot, const vec2d &uv) const;
+
+private:
+    struct Page {
+        Image _image;
+        u32 _version = 0;
+        /// Rectangle changed since the last call to takeChangedRect()
+        ImageRect _changed;
+
+        Page(int res, ImageType type)
+                : _image(res, res, type), _changed{0, 0, res, res} {}
+    };
+
+    struct Entry {
+        AtlasSlot _slot;
+        std::list<std::string>::iterator _lruIt;
+        /// Last frame in which the texture was used
+        u64 _frame;
+    };
+
+    int _pageRes;
+    int _textureRes;
+    int _maxPages;
+    int _padding;
+    ImageType _type;
+    int _slotsPerRow;
+
+    std::vector<Page> _pages;
+    std::vector<AtlasSlot> _freeSlots;
+    std::unordered_map<std::string, Entry> _entries;
+    /// Keys of the textures, most recently used first
+    std::list<std::string> _lru;
+    /// Current frame, 0 if startFrame() was never called
+    u64 _frame = 0;
+
+
+    AtlasSlot allocate(std::string *evicted);
+
+    /** Copy the texture to the slot, and add the given rectangle of the
+     * texture to the changed rectangle of the page. */
+    void copyTexture(const AtlasSlot &slot, const Image &texture,
+                     const ImageRect &changed);
+};
+
+} // namespace world
+
+#endif // WORLD_TEXTUREATLAS_H
@@ -5,21 +5,29 @@
 #include "core/WorldTypes.h"
 
 #include "math/Bezier.h"
+#include "math/BlueNoise.h"
 #include "math/BoundingBox.h"
+#include "math/BoundingVolumeHierarchy.h"
 #include "math/Interpolation.h"
 #include "math/MathsHelper.h"
 #include "math/Perlin.h"
 #include "math/Vector.h"
 
+#include "assets/BlockCompression.h"
 #include "assets/Color.h"
 #include "assets/Image.h"
+#include "assets/ImageCache.h"
+#include "assets/ImageUpdate.h"
+#include "assets/InstanceBuffer.h"
 #include "assets/ImageUtils.h"
+#include "assets/Impostor.h"
 #include "assets/Material.h"
 #include "assets/Mesh.h"
 #include "assets/MeshOps.h"
 #include "assets/SceneNode.h"
 #include "assets/ObjLoader.h"
 #include "assets/Scene.h"
+#include "assets/TextureAtlas.h"
 #include "assets/VoxelGrid.h"
 #include "assets/VoxelOps.h"
 
@@ -34,6 +42,7 @@
 #include "core/GridChunkSystem.h"
 #include "core/GridStorage.h"
 #include "core/GridStorageReducer.h"
+#include "core/EpochManager.h"
 #include "core/InstancePool.h"
 #include "core/SeedDistribution.h"
 
@@ -1,8 +1,15 @@
 #include "Collector.h"
 
+#include <atomic>
+
 namespace world {
 
-Collector::Collector(CollectorPresets preset) {
+static u64 newEpoch() {
+    static std::atomic<u64> lastEpoch{0};
+    return ++lastEpoch;
+}
+
+Collector::Collector(CollectorPresets preset) : _epoch(newEpoch()) {
     switch (preset) {
     case CollectorPresets::SCENE:
         addStorageChannel<SceneNode>();
@@ -19,6 +26,7 @@ void Collector::reset() {
     for (auto &entry : _channels) {
         entry.second->reset();
     }
+    _epoch = newEpoch();
 }
 
 Scene Collector::toScene() {
@@ -59,6 +67,14 @@ void Collector::fillScene(Scene &scene) {
             scene.addNode(object._value);
         }
 
+        if (hasStorageChannel<InstanceBuffer>()) {
+            for (auto buffer : getStorageChannel<InstanceBuffer>()) {
+                for (size_t i = 0; i < buffer._value.size(); ++i) {
+                    scene.addNode(buffer._value.getNode(i));
+                }
+            }
+        }
+
         for (auto mesh : meshChannel) {
             scene.addMesh(mesh._key.str(), mesh._value);
         }
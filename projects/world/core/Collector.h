@@ -8,6 +8,7 @@
 
 #include "WorldTypes.h"
 #include "world/assets/SceneNode.h"
+#include "world/assets/InstanceBuffer.h"
 #include "world/assets/Material.h"
 #include "world/assets/Scene.h"
 
@@ -34,9 +35,13 @@ public:
     Collector(CollectorPresets preset = CollectorPresets::NONE);
 
     /** Delete all the resources harvested from the previous
-     * "collect" calls */
+     * "collect" calls. The collector enters a new epoch. */
     virtual void reset();
 
+    /** Epochs are unique among all the collectors, so two collectors never
+     * share an epoch. */
+    u64 getEpoch() const override { return _epoch; }
+
     template <typename T> CollectorChannel<T> &addStorageChannel();
 
     // TODO simplify method call (only one required template argument instead of
@@ -61,6 +66,7 @@ protected:
 #else
     std::map<size_t, std::unique_ptr<ICollectorChannelBase>> _channels;
 #endif
+    u64 _epoch;
 
 
     ICollectorChannelBase &getChannelByType(size_t type) override;
@@ -5,7 +5,17 @@ namespace world {
 ColorMap::ColorMap(const vec2i &res)
         : _cache(res.x, res.y, 3), _shouldRebuild(true) {}
 
-void ColorMap::setOrder(int order) { _order = order; }
+void ColorMap::setOrder(int order) {
+    _order = order;
+    _shouldRebuild = true;
+}
+
+void ColorMap::setNeighbourCount(int count) {
+    _neighbourCount = count;
+    _shouldRebuild = true;
+}
+
+void ColorMap::setBilinearSampling(bool bilinear) { _bilinear = bilinear; }
 
 void ColorMap::addPoint(const vec2d &pos, const Color4d &color) {
     _points.emplace_back(pos, toInternalColor(color));
@@ -20,6 +30,7 @@ void ColorMap::rebuild() {
     double scale = (double)h / w;
 
     IDWInterpolator<position, color> interp(_order);
+    interp.setNeighbourCount(_neighbourCount);
 
     for (auto &point : _points) {
         position scaled{point.first.x, point.first.y * scale};
@@ -45,10 +56,29 @@ Color4d ColorMap::getColorAt(const vec2d &pos) {
         rebuild();
     }
 
-    auto ix = static_cast<arma::uword>(pos.x * (_cache.n_rows - 1));
-    auto iy = static_cast<arma::uword>(pos.y * (_cache.n_cols - 1));
+    if (!_bilinear || _cache.n_rows < 2 || _cache.n_cols < 2) {
+        auto ix = static_cast<arma::uword>(pos.x * (_cache.n_rows - 1));
+        auto iy = static_cast<arma::uword>(pos.y * (_cache.n_cols - 1));
 
-    return Color4d(_cache(ix, iy, 0), _cache(ix, iy, 1), _cache(ix, iy, 2));
+        return Color4d(_cache(ix, iy, 0), _cache(ix, iy, 1),
+                       _cache(ix, iy, 2));
+    }
+
+    const double x = clamp(pos.x, 0, 1) * (_cache.n_rows - 1);
+    const double y = clamp(pos.y, 0, 1) * (_cache.n_cols - 1);
+    const auto x0 = std::min(static_cast<arma::uword>(x), _cache.n_rows - 2);
+    const auto y0 = std::min(static_cast<arma::uword>(y), _cache.n_cols - 2);
+    const double tx = x - x0, ty = y - y0;
+
+    double c[3];
+
+    for (arma::uword i = 0; i < 3; ++i) {
+        const arma::mat &slice = _cache.slice(i);
+        c[i] = (slice(x0, y0) * (1 - tx) + slice(x0 + 1, y0) * tx) * (1 - ty) +
+               (slice(x0, y0 + 1) * (1 - tx) + slice(x0 + 1, y0 + 1) * tx) * ty;
+    }
+
+    return Color4d(c[0], c[1], c[2]);
 }
 
 Image *ColorMap::createImage() {
@@ -61,6 +91,8 @@ Image *ColorMap::createImage() {
 
 void ColorMap::write(WorldFile &wf) const {
     wf.addInt("order", _order);
+    wf.addInt("neighbourCount", _neighbourCount);
+    wf.addBool("bilinear", _bilinear);
     wf.addArray("points");
 
     for (auto &pt : _points) {
@@ -73,6 +105,9 @@ void ColorMap::write(WorldFile &wf) const {
 
 void ColorMap::read(const WorldFile &wf) {
     wf.readIntOpt("order", _order);
+    wf.readIntOpt("neighbourCount", _neighbourCount);
+    wf.readBoolOpt("bilinear", _bilinear);
+    _shouldRebuild = true;
 
     _points.clear();
 
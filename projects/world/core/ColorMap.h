@@ -22,7 +22,10 @@ namespace world {
  * spatial position and color. Then a spatial interpolation is used to fill all
  * the colormap. Then it's possible to retrieve the value at a special point
  * calling the method getColorAt(). All the coordinates are bounded to [0, 1].
- * At the moment this colormap only supports 2 dimensions. */
+ * At the moment this colormap only supports 2 dimensions.
+ *
+ * The interpolated colors are stored in a dense lookup table of the given
+ * resolution, which is sampled either with the nearest cell or bilinearly. */
 class WORLDAPI_EXPORT ColorMap : public ISerializable {
 public:
     typedef vec2d position;
@@ -32,6 +35,14 @@ public:
 
     void setOrder(int order);
 
+    /** Set the number of nearest points used to interpolate each cell of the
+     * lookup table. 0 means all the points are used. */
+    void setNeighbourCount(int count);
+
+    /** If true, getColorAt() interpolates bilinearly between the four
+     * nearest cells of the lookup table. */
+    void setBilinearSampling(bool bilinear);
+
     void addPoint(const vec2d &pos, const Color4d &color);
 
     void rebuild();
@@ -49,6 +60,8 @@ public:
 
 private:
     int _order = 3;
+    int _neighbourCount = 0;
+    bool _bilinear = false;
     std::vector<std::pair<position, color>> _points;
 
     arma::cube _cache;
@@ -26,6 +26,13 @@ public:
         return _resolution;
     }
 
+    double getMinResolutionIn(const BoundingBox &bbox) const override {
+        return _bbox.contains(bbox.getLowerBound()) &&
+                       _bbox.contains(bbox.getUpperBound())
+                   ? _resolution
+                   : 0;
+    }
+
     BoundingBox getBounds() const override { return _bbox; }
 
 private:
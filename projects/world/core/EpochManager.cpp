@@ -0,0 +1,96 @@
+#include "EpochManager.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace world {
+
+EpochManager::ReadGuard::~ReadGuard() {
+    if (_manager != nullptr) {
+        _manager->_readers[_epoch & 1].fetch_sub(1);
+    }
+}
+
+EpochManager::~EpochManager() {
+    for (auto &retired : _retired) {
+        retired.second();
+    }
+}
+
+EpochManager::ReadGuard EpochManager::read() {
+    while (true) {
+        const u64 epoch = _epoch.load();
+        _readers[epoch & 1].fetch_add(1);
+
+        // If the epoch changed in between, the writer may have missed this
+        // reader when it checked the reader count
+        if (_epoch.load() == epoch) {
+            return ReadGuard(this, epoch);
+        }
+        _readers[epoch & 1].fetch_sub(1);
+    }
+}
+
+void EpochManager::retire(std::function<void()> deleter) {
+    std::lock_guard<std::mutex> lock(_retiredMutex);
+    _retired.emplace_back(_epoch.load(), std::move(deleter));
+}
+
+void EpochManager::reclaim() {
+    std::vector<std::function<void()>> deleters;
+    {
+        std::lock_guard<std::mutex> lock(_retiredMutex);
+
+        if (_retired.empty()) {
+            return;
+        }
+        tryAdvance();
+        const u64 epoch = tryAdvance();
+
+        // An object retired at epoch e is not reachable anymore by the
+        // readers of epoch e + 1. Once the epoch is e + 2, the readers of
+        // epoch e are all gone.
+        auto ready = std::stable_partition(
+            _retired.begin(), _retired.end(),
+            [epoch](const std::pair<u64, std::function<void()>> &retired) {
+                return retired.first + 2 > epoch;
+            });
+
+        for (auto it = ready; it != _retired.end(); ++it) {
+            deleters.push_back(std::move(it->second));
+        }
+        _retired.erase(ready, _retired.end());
+    }
+
+    for (auto &deleter : deleters) {
+        deleter();
+    }
+}
+
+void EpochManager::synchronize() {
+    reclaim();
+
+    while (retiredCount() != 0) {
+        std::this_thread::yield();
+        reclaim();
+    }
+}
+
+size_t EpochManager::retiredCount() const {
+    std::lock_guard<std::mutex> lock(_retiredMutex);
+    return _retired.size();
+}
+
+u64 EpochManager::tryAdvance() {
+    const u64 epoch = _epoch.load();
+
+    // The readers of the next epoch share their count with the readers of
+    // the previous epoch, which must all be gone
+    if (_readers[(epoch + 1) & 1].load() == 0) {
+        _epoch.store(epoch + 1);
+        return epoch + 1;
+    }
+    return epoch;
+}
+
+} // namespace world
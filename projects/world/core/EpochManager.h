@@ -0,0 +1,96 @@
+#ifndef WORLD_EPOCH_MANAGER_H
+#define WORLD_EPOCH_MANAGER_H
+
+#include "world/core/WorldConfig.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "WorldTypes.h"
+
+namespace world {
+
+/** Epoch based reclamation of objects shared with lock-free readers.
+ *
+ * Readers access the shared objects inside a read section, which begins
+ * with read() and ends when the returned guard is destroyed. Entering and
+ * leaving a read section never blocks. When a writer replaces a shared
+ * object, it retires the old one instead of deleting it. Retired objects
+ * are deleted by reclaim() once all the read sections that may have seen
+ * them are over (the grace period).
+ *
+ * Writers must not be inside a read section when they call reclaim() or
+ * synchronize(). */
+class WORLDAPI_EXPORT EpochManager {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard(ReadGuard &&other) noexcept
+                : _manager(other._manager), _epoch(other._epoch) {
+            other._manager = nullptr;
+        }
+
+        ReadGuard(const ReadGuard &other) = delete;
+
+        ~ReadGuard();
+
+        ReadGuard &operator=(const ReadGuard &other) = delete;
+
+    private:
+        EpochManager *_manager;
+        u64 _epoch;
+
+        ReadGuard(EpochManager *manager, u64 epoch)
+                : _manager(manager), _epoch(epoch) {}
+
+        friend class EpochManager;
+    };
+
+    EpochManager() = default;
+
+    /** Delete all the retired objects. There must be no reader left. */
+    ~EpochManager();
+
+    EpochManager(const EpochManager &other) = delete;
+
+    EpochManager &operator=(const EpochManager &other) = delete;
+
+    /** Enter a read section. */
+    ReadGuard read();
+
+    /** Schedule the deletion of an object that readers cannot reach
+     * anymore. The deleter is called by reclaim() after the grace period. */
+    void retire(std::function<void()> deleter);
+
+    /** Delete the retired objects whose grace period is over. This method
+     * does not wait for the readers. */
+    void reclaim();
+
+    /** Wait for the end of the grace period of all the retired objects and
+     * delete them. */
+    void synchronize();
+
+    /** Count of retired objects that are not deleted yet. */
+    size_t retiredCount() const;
+
+private:
+    /// Current epoch. Readers entering a read section are counted in the
+    /// reader count of the parity of the epoch.
+    std::atomic<u64> _epoch{0};
+    std::atomic<u32> _readers[2] = {{0}, {0}};
+
+    mutable std::mutex _retiredMutex;
+    /// Retired objects and the epoch at which they were retired
+    std::vector<std::pair<u64, std::function<void()>>> _retired;
+
+    /** Advance the epoch if no reader is left in the previous epoch of the
+     * same parity. Returns the current epoch. */
+    u64 tryAdvance();
+};
+
+} // namespace world
+
+#endif // WORLD_EPOCH_MANAGER_H
@@ -49,6 +49,19 @@ double FirstPersonView::getMaxResolutionIn(const BoundingBox &bbox) const {
     return getResolutionAt(getNearestPointIn(bbox));
 }
 
+double FirstPersonView::getMinResolutionIn(const BoundingBox &bbox) const {
+    vec3d lower = bbox.getLowerBound();
+    vec3d upper = bbox.getUpperBound();
+
+    // The resolution decreases with the distance, so the minimum is at the
+    // farthest corner
+    vec3d farthest{
+        _position.x - lower.x > upper.x - _position.x ? lower.x : upper.x,
+        _position.y - lower.y > upper.y - _position.y ? lower.y : upper.y,
+        _position.z - lower.z > upper.z - _position.z ? lower.z : upper.z};
+    return getResolutionAt(farthest);
+}
+
 BoundingBox FirstPersonView::getBounds() const {
     vec3d far{_farDistance, _farDistance, _farDistance};
     return {_position - far, _position + far};
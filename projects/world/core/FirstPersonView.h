@@ -35,6 +35,8 @@ public:
 
     double getMaxResolutionIn(const BoundingBox &bbox) const override;
 
+    double getMinResolutionIn(const BoundingBox &bbox) const override;
+
     BoundingBox getBounds() const override;
 
 private:
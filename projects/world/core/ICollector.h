@@ -31,6 +31,13 @@ public:
     template <typename T, typename T2, typename... Args>
     bool hasChannel() const;
 
+    /** Get the epoch of the collector. The epoch changes each time the
+     * collector forgets the items that were put in it, so a node can skip
+     * putting again the items it put during the same epoch. The default
+     * implementation returns 0, which means that the collector can not tell,
+     * and that the items must be put again at each collect. */
+    virtual u64 getEpoch() const { return 0; }
+
 protected:
     virtual ICollectorChannelBase &getChannelByType(size_t type) = 0;
 
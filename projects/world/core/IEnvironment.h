@@ -3,7 +3,10 @@
 
 #include "world/core/WorldConfig.h"
 
+#include <vector>
+
 #include "world/math/Vector.h"
+#include "world/math/BoundingBox.h"
 
 namespace world {
 
@@ -17,6 +20,39 @@ public:
                                        const vec3d &direction,
                                        double resolution,
                                        const ExplorationContext &ctx) const = 0;
+
+    /** Find the nearest free point of each origin in an array, in the same
+     * direction and at the same resolution. Implementations can override
+     * this method to process all the points at once, which is much faster
+     * than calling findNearestFreePoint() for each point.
+     * @param origins array of count points
+     * @param results array receiving the count free points. It can be the
+     * same array as origins. */
+    virtual void findNearestFreePoints(const vec3d *origins, vec3d *results,
+                                       size_t count, const vec3d &direction,
+                                       double resolution,
+                                       const ExplorationContext &ctx) const {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] =
+                findNearestFreePoint(origins[i], direction, resolution, ctx);
+        }
+    }
+
+    /** Get a counter that changes each time the environment is modified, so
+     * that the users caching the points found by findNearestFreePoint() know
+     * when to find them again. The default implementation returns 0, for
+     * the environments that never change. */
+    virtual u64 getEditEpoch() const { return 0; }
+
+    /** Get the bounds of the modifications made after the given edit epoch,
+     * relatively to the offset of the context. Returns false if those
+     * modifications are not known, in which case the whole environment
+     * must be considered as modified. The default implementation only
+     * knows that nothing was modified if the epoch did not change. */
+    virtual bool getEditsSince(u64 epoch, std::vector<BoundingBox> &,
+                               const ExplorationContext &) const {
+        return epoch == getEditEpoch();
+    }
 };
 
 class WORLDAPI_EXPORT DefaultEnvironment : public IEnvironment {
@@ -1,9 +1,16 @@
 #include "IInstanceGenerator.h"
 
+#include <atomic>
+
 namespace world {
 
 WORLD_REGISTER_BASE_CLASS(IInstanceGenerator)
 
+static u64 newGeneration() {
+    static std::atomic<u64> lastGeneration{0};
+    return ++lastGeneration;
+}
+
 // TODO
 // - Add and delete methods to Template to have a coherent and handy API
 // - Add a method to automatically collect a template at a specific resolution
@@ -67,4 +74,11 @@ SceneNode Template::getDefaultNode() {
         return SceneNode();
     }
 }
+
+
+// #### IInstanceGenerator
+
+IInstanceGenerator::IInstanceGenerator() : _generation(newGeneration()) {}
+
+void IInstanceGenerator::updateGeneration() { _generation = newGeneration(); }
 } // namespace world
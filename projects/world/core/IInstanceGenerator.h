@@ -26,6 +26,9 @@ public:
     vec3d _position;
     vec3d _rotation;
     vec3d _scale = {1};
+    /** Identifier of the template. Instances of templates with the same id
+     * are assumed to have the same items, and may be collected together in
+     * the same InstanceBuffer. */
     int _id = 0;
 
 
@@ -58,8 +61,16 @@ private:
 
 class WORLDAPI_EXPORT IInstanceGenerator : public ISerializable {
 public:
+    IInstanceGenerator();
+
     virtual ~IInstanceGenerator() = default;
 
+    /** Get the generation stamp of the templates. The stamp is unique among
+     * all the generators, and changes each time the templates of this
+     * generator change. Templates collected with the same stamp can be
+     * reused. */
+    u64 getGeneration() const { return _generation; }
+
     virtual std::vector<Template> collectTemplates(
         ICollector &collector, const ExplorationContext &ctx,
         double maxRes) = 0;
@@ -69,7 +80,13 @@ public:
     /** Create a new fresh instance of this generator. */
     virtual IInstanceGenerator *newInstance() = 0;
 
+protected:
+    /** Give a new generation stamp to this generator. Subclasses call this
+     * method each time their templates change. */
+    void updateGeneration();
+
 private:
+    u64 _generation;
 };
 
 } // namespace world
@@ -32,6 +32,20 @@ public:
         return getMaxResolutionIn(bbox2);
     }
 
+    /** Lower bound of the resolution in the bounding box. The default
+     * implementation returns 0, which is always correct but prevents the
+     * callers from resolving whole boxes at once. */
+    virtual double getMinResolutionIn(const BoundingBox &bbox) const {
+        return 0;
+    }
+
+    double getMinResolutionIn(const BoundingBox &bbox,
+                              const ExplorationContext &ctx) const {
+        BoundingBox bbox2 = bbox;
+        bbox2.translate(ctx.getOffset());
+        return getMinResolutionIn(bbox2);
+    }
+
     /** Bounds of the non-zero resolution zone. Everything outside of
      * this box has a resolution of 0. */
     virtual BoundingBox getBounds() const = 0;
@@ -6,6 +6,7 @@
 #include <random>
 
 #include "world/core/Chunk.h"
+#include "world/math/BlueNoise.h"
 
 namespace world {
 
@@ -93,9 +94,15 @@ protected:
 };
 
 
+/** Distribution of evenly spaced instances, following a blue noise pattern.
+ * The positions only depend on the chunk and on the pattern offset, which
+ * is chosen randomly at construction. */
 class WORLDAPI_EXPORT RandomDistribution : public DistributionBase {
 public:
-    RandomDistribution() {}
+    RandomDistribution() {
+        std::uniform_real_distribution<double> offsetDistrib(0, 1000);
+        _offset = {offsetDistrib(_rng), offsetDistrib(_rng)};
+    }
 
     void setDensity(double density) { _density = density; }
 
@@ -106,26 +113,44 @@ public:
         const vec3d chunkPos = chunk.getPosition3D();
         const vec3d chunkDims = chunk.getSize();
 
-        double chunkArea = chunkDims.x * chunkDims.y;
-        int instanceCount = static_cast<int>(floor(chunkArea * _density));
-        std::uniform_real_distribution<double> posDistrib(0, 1);
-        std::uniform_int_distribution<int> genIDDistrib(0,
-                                                        _habitats.size() - 1);
-
-        for (int i = 0; i < instanceCount; ++i) {
-            double x = posDistrib(_rng) * chunkDims.x;
-            double y = posDistrib(_rng) * chunkDims.y;
-            vec3d position =
-                ctx.getEnvironment().findNearestFreePoint(
-                    chunkPos + vec3d{x, y, -3000}, vec3d{0, 0, 1}, _resolution,
-                    ExplorationContext::getDefault()) -
-                chunkPos;
+        auto samples = BlueNoiseTile::getDefault().getSamples(
+            {chunkPos.x, chunkPos.y},
+            {chunkPos.x + chunkDims.x, chunkPos.y + chunkDims.y}, _density,
+            _offset);
+
+        std::vector<vec3d> absPositions(samples.size());
+
+        for (size_t i = 0; i < samples.size(); ++i) {
+            const vec2d &pos = samples[i]._position;
+            absPositions[i] = {pos.x, pos.y, chunkPos.z - 3000};
+        }
+
+        ctx.getEnvironment().findNearestFreePoints(
+            absPositions.data(), absPositions.data(), absPositions.size(),
+            vec3d{0, 0, 1}, _resolution, ExplorationContext::getDefault());
+
+        const int genCount = static_cast<int>(_habitats.size());
+
+        for (size_t i = 0; i < absPositions.size(); ++i) {
+            vec3d position = absPositions[i] - chunkPos;
 
             if (position.z < 0 || position.z >= chunkDims.z) {
                 continue;
             }
 
-            positions.push_back({position, genIDDistrib(_rng)});
+            // The rank of the sample is uniformly distributed, so it can
+            // pick the generator without breaking determinism. The
+            // generators are rotated between the repetitions of the tile,
+            // whose variants share the points of their borders.
+            int genID = 0;
+
+            if (genCount != 0) {
+                const u32 count = static_cast<u32>(genCount);
+                const u32 rankID = static_cast<u32>(samples[i]._rank * count);
+                genID = static_cast<int>((rankID + samples[i]._tileHash) %
+                                         count);
+            }
+            positions.push_back({position, genID});
         }
 
         return positions;
@@ -134,16 +159,23 @@ public:
     void write(WorldFile &wf) const override {
         DistributionBase::write(wf);
         wf.addDouble("density", _density);
+        wf.addStruct("offset", _offset);
     }
 
     void read(const WorldFile &wf) override {
         DistributionBase::read(wf);
         wf.readDoubleOpt("density", _density);
+
+        if (wf.hasChild("offset")) {
+            wf.readStruct("offset", _offset);
+        }
     }
 
 private:
     // instance count per m^2
     double _density = 0.2;
+    /// Offset of the blue noise pattern, in m
+    vec2d _offset;
 };
 
 } // namespace world
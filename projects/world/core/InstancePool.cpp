@@ -1,5 +1,6 @@
 #include "InstancePool.h"
 #include "SeedDistribution.h"
+#include "world/core/StringOps.h"
 
 namespace world {
 template class WORLDAPI_EXPORT InstancePool<RandomDistribution>;
@@ -11,4 +12,189 @@ WORLD_REGISTER_TEMPLATE_CHILD_CLASS(IChunkDecorator, InstancePool,
 WORLD_REGISTER_TEMPLATE_CHILD_CLASS(IChunkDecorator, InstancePool,
                                     SeedDistribution,
                                     "InstancePool_SeedDistribution")
-} // namespace world
\ No newline at end of file
+
+
+// #### TemplateCache
+
+/** Channel that drops all the items put in it. */
+template <typename T> class NullChannel : public ICollectorChannel<T> {
+public:
+    void put(const ItemKey &, const T &,
+             const ExplorationContext &) override {}
+
+    bool has(const ItemKey &, const ExplorationContext &) const override {
+        return false;
+    }
+
+    void remove(const ItemKey &, const ExplorationContext &) override {}
+};
+
+/** Channel that keeps the items put in it in a TemplateCache entry. */
+template <typename T> class RecordingChannel : public ICollectorChannel<T> {
+public:
+    using Items = std::map<std::string, std::pair<ItemKey, T>>;
+
+    Items &_items;
+
+    explicit RecordingChannel(Items &items) : _items(items) {}
+
+    void put(const ItemKey &key, const T &item,
+             const ExplorationContext &ctx) override {
+        const std::string id = ctx.mutateKey(key).str();
+        _items.erase(id);
+        _items.emplace(id, std::make_pair(key, item));
+    }
+
+    bool has(const ItemKey &key,
+             const ExplorationContext &ctx) const override {
+        return _items.find(ctx.mutateKey(key).str()) != _items.end();
+    }
+
+    void remove(const ItemKey &key, const ExplorationContext &ctx) override {
+        _items.erase(ctx.mutateKey(key).str());
+    }
+};
+
+template <typename T>
+static void addNullChannel(Collector &collector, const ICollector &model) {
+    if (model.hasChannel<T>()) {
+        collector.addCustomChannel<T, NullChannel<T>>();
+    }
+}
+
+template <typename T>
+static void addRecordingChannel(
+    Collector &collector, const ICollector &model,
+    std::map<std::string, std::pair<ItemKey, T>> &items) {
+    if (model.hasChannel<T>()) {
+        collector.addCustomChannel<T, RecordingChannel<T>>(items);
+    }
+}
+
+template <typename T>
+const T *TemplateCache::Assets<T>::require(ICollector &collector,
+                                           const std::string &id,
+                                           const ExplorationContext &ctx) {
+    auto it = _items.find(id);
+
+    if (it == _items.end()) {
+        return nullptr;
+    }
+    if (_put.insert(id).second && collector.hasChannel<T>()) {
+        collector.getChannel<T>().put(it->second.first, it->second.second,
+                                      ctx);
+    }
+    return &it->second.second;
+}
+
+void TemplateCache::startCollect() { ++_frame; }
+
+void TemplateCache::update(size_t index, IInstanceGenerator &generator,
+                           const ICollector &collector,
+                           const ExplorationContext &ctx) {
+    if (index >= _entries.size()) {
+        _entries.resize(index + 1);
+    }
+    Entry &entry = _entries[index];
+
+    if (entry._generator == &generator &&
+        entry._generation == generator.getGeneration()) {
+        return;
+    }
+
+    // The templates depend on the channels of the collector, but their assets
+    // are only put when an instance requires them.
+    entry._meshes = {};
+    entry._materials = {};
+    entry._images = {};
+    Collector templateCollector;
+    addNullChannel<SceneNode>(templateCollector, collector);
+    addRecordingChannel(templateCollector, collector, entry._meshes._items);
+    addRecordingChannel(templateCollector, collector,
+                        entry._materials._items);
+    addRecordingChannel(templateCollector, collector, entry._images._items);
+
+    // Templates keep their ids, so that the instances created with the
+    // previous templates can still require the assets
+    std::vector<int> ids;
+
+    for (auto &tp : entry._templates) {
+        ids.push_back(tp._id);
+        _entryIds.erase(tp._id);
+    }
+
+    // TODO collect at the correct resolution. At the moment the max res is
+    // set to 10000, so we get (hopefully) all the LODs.
+    entry._generator = &generator;
+    entry._ctx = ctx;
+    entry._generation = generator.getGeneration();
+    entry._templates =
+        generator.collectTemplates(templateCollector, ctx, 10000);
+    entry._epoch = 0;
+    entry._frame = 0;
+
+    for (size_t i = 0; i < entry._templates.size(); ++i) {
+        auto &tp = entry._templates[i];
+        tp._id = i < ids.size() ? ids[i] : _nextId++;
+        _entryIds[tp._id] = {index, i};
+    }
+}
+
+std::vector<Template> &TemplateCache::getTemplates(size_t index) {
+    return _entries.at(index)._templates;
+}
+
+void TemplateCache::require(ICollector &collector, int templateId,
+                            double resolution) {
+    auto it = _entryIds.find(templateId);
+
+    if (it == _entryIds.end()) {
+        return;
+    }
+    Entry &entry = _entries[it->second.first];
+    const u64 epoch = collector.getEpoch();
+
+    if (entry._epoch != epoch || (epoch == 0 && entry._frame != _frame)) {
+        entry._epoch = epoch;
+        entry._frame = _frame;
+        entry._meshes._put.clear();
+        entry._materials._put.clear();
+        entry._images._put.clear();
+    }
+
+    auto *item = entry._templates[it->second.second].getAt(resolution);
+
+    if (item == nullptr) {
+        return;
+    }
+    const ExplorationContext &ctx = entry._ctx;
+
+    for (const SceneNode &node : item->_nodes) {
+        entry._meshes.require(collector, node.getMeshID(), ctx);
+        const Material *material =
+            entry._materials.require(collector, node.getMaterialID(), ctx);
+
+        if (material == nullptr) {
+            continue;
+        }
+        entry._images.require(collector, material->getMapKd(), ctx);
+
+        for (const auto &param : material->getShaderParams()) {
+            using Type = ShaderParam::Type;
+
+            if (param.second._type == Type::TEXTURE) {
+                entry._images.require(collector, param.second._value, ctx);
+            } else if (param.second._type == Type::TEXTURE_ARRAY) {
+                for (auto &id : split(param.second._value, ',')) {
+                    entry._images.require(collector, id, ctx);
+                }
+            }
+        }
+    }
+}
+
+void TemplateCache::clear() {
+    _entries.clear();
+    _entryIds.clear();
+}
+} // namespace world
@@ -3,11 +3,16 @@
 
 #include "world/core/WorldConfig.h"
 
+#include <cmath>
 #include <random>
 #include <vector>
 #include <map>
+#include <set>
+#include <memory>
 
 #include "WorldKeys.h"
+#include "world/math/BoundingVolumeHierarchy.h"
+#include "world/assets/InstanceBuffer.h"
 #include "WorldNode.h"
 #include "IChunkDecorator.h"
 #include "Chunk.h"
@@ -16,12 +21,92 @@
 
 namespace world {
 
+/** Templates of the generators of an InstancePool, shared by the pool with
+ * the Instance nodes it creates.
+ *
+ * The templates of a generator are built once per generation stamp of the
+ * generator, and the assets they use are kept with them. Those assets are
+ * not put in the collector when the templates are built, but when a visible
+ * instance needs them (see require()): each asset is put once per collector
+ * epoch.
+ *
+ * Collector::reset() empties the channels and starts a new epoch, so hosts
+ * that reset their collector at each frame, like Peace, get the assets of the
+ * visible templates at each frame. Hosts that keep their collector between
+ * frames only get the assets that were not required yet. */
+class WORLDAPI_EXPORT TemplateCache {
+public:
+    /** Start a new collect. The assets are put again in collectors without
+     * epoch at each collect. */
+    void startCollect();
+
+    /** Update the templates of the generator at the given index. The
+     * templates are built again only if the generation of the generator
+     * changed since the last update. The context is the one used to put the
+     * assets of this generator in the collector. */
+    void update(size_t index, IInstanceGenerator &generator,
+                const ICollector &collector, const ExplorationContext &ctx);
+
+    std::vector<Template> &getTemplates(size_t index);
+
+    /** Put in the collector the meshes, materials and textures used by the
+     * item of the template with the given id at the given resolution, unless
+     * they were already put in the current epoch of the collector. */
+    void require(ICollector &collector, int templateId, double resolution);
+
+    /** Remove all the templates. */
+    void clear();
+
+private:
+    /** Assets of one type put by a generator when its templates were built,
+     * by the id the scene nodes and the materials use to refer to them. */
+    template <typename T> struct Assets {
+        std::map<std::string, std::pair<ItemKey, T>> _items;
+        /// Ids of the assets put in the current epoch of the collector
+        std::set<std::string> _put;
+
+        /** Put the asset with the given id, if it was not put yet. Returns
+         * the asset, or nullptr if the generator did not put this id. */
+        const T *require(ICollector &collector, const std::string &id,
+                         const ExplorationContext &ctx);
+    };
+
+    struct Entry {
+        IInstanceGenerator *_generator = nullptr;
+        /// Context in which the templates were built
+        ExplorationContext _ctx;
+        std::vector<Template> _templates;
+        u64 _generation = 0;
+
+        Assets<Mesh> _meshes;
+        Assets<Material> _materials;
+        Assets<Image> _images;
+
+        /// Epoch of the collector in which the assets were put
+        u64 _epoch = 0;
+        /// Count of InstancePool::collectSelf calls when the assets were put.
+        /// Used with collectors that have no epoch.
+        u64 _frame = 0;
+    };
+
+    std::vector<Entry> _entries;
+    /// Index of the entry and of the template in the entry for each
+    /// template id
+    std::map<int, std::pair<size_t, size_t>> _entryIds;
+    int _nextId = 0;
+    u64 _frame = 0;
+};
+
 
 template <typename TDistribution = RandomDistribution>
 class InstancePool : public IChunkDecorator, public WorldNode {
     WORLD_WRITE_SUBCLASS_METHOD
 public:
-    InstancePool() : _distribution(), _rng(static_cast<u64>(time(NULL))) {}
+    InstancePool()
+            : _distribution(), _rng(static_cast<u64>(time(NULL))),
+              _templates(std::make_shared<TemplateCache>()) {}
+
+    ~InstancePool() override;
 
     void setResolution(double resolution);
 
@@ -53,7 +138,9 @@ private:
     std::mt19937 _rng;
     std::unique_ptr<IInstanceGenerator> _templateGenerator;
     std::vector<std::unique_ptr<IInstanceGenerator>> _generators;
-    std::vector<std::vector<Template>> _objects;
+    /// Templates of the generators, also used by the instances to put the
+    /// assets they display in the collector
+    std::shared_ptr<TemplateCache> _templates;
     u64 _chunksDecorated = 0;
     /// Internal field to remember the typical chunk area at the resolution of
     /// the pool
@@ -76,16 +163,47 @@ public:
 
     explicit Instance(Template tp) : _templates{std::move(tp)} {}
 
+    /** Create an instance node whose templates come from the given cache.
+     * The instance puts the assets of its templates in the collector through
+     * the cache before collecting them. */
+    explicit Instance(std::shared_ptr<TemplateCache> cache)
+            : _cache(std::move(cache)) {}
+
     void addNode(Template tp);
 
     size_t getNodeCount() const;
 
+    /** Collect the instances. If the collector has an InstanceBuffer
+     * channel, the instances of each node of each template are collected
+     * together in a single InstanceBuffer. Otherwise each instance is
+     * collected as a separate SceneNode. */
     void collectSelf(ICollector &collector,
                      const IResolutionModel &resolutionModel,
                      const ExplorationContext &ctx) override;
 
 private:
     std::vector<Template> _templates;
+    std::shared_ptr<TemplateCache> _cache;
+    /// Hierarchy of the template positions, built at the first collect
+    BoundingVolumeHierarchy _bvh;
+
+
+    /** Call the callback with the index, the resolution and the item of
+     * each template that is visible. Whole nodes of the hierarchy are
+     * resolved at once when the resolution model allows it. */
+    template <typename TCallback>
+    void forEachVisible(const IResolutionModel &resolutionModel,
+                        const ExplorationContext &ctx, TCallback callback);
+
+    void collectBuffers(ICollector &collector,
+                        ICollectorChannel<InstanceBuffer> &bufferChan,
+                        const IResolutionModel &resolutionModel,
+                        const ExplorationContext &ctx);
+
+    /** Transform the position of a node of the template: the position is
+     * scaled, rotated by the Euler angles of the template (around x, then y,
+     * then z) and moved to the position of the template. */
+    static vec3d transformPosition(const Template &tp, const vec3d &position);
 };
 
 } // namespace world
@@ -11,6 +11,12 @@
 
 namespace world {
 
+template <typename TDistribution>
+InstancePool<TDistribution>::~InstancePool() {
+    // Instances may outlive the pool
+    _templates->clear();
+}
+
 template <typename TDistribution>
 void InstancePool<TDistribution>::setResolution(double resolution) {
     _resolution = resolution;
@@ -39,20 +45,14 @@ inline void InstancePool<TDistribution>::collectSelf(
         _generators.push_back(std::move(newSpecies));
     }
 
-    // Collect generators objects
-    _objects.clear();
+    // Update generators templates. Their assets are put in the collector
+    // by the instances that display them.
+    _templates->startCollect();
 
     for (int id = 0; id < _generators.size(); ++id) {
-        auto &generator = _generators.at(id);
         auto childCtx = ctx;
         childCtx.appendPrefix({NodeKeys::fromInt(id)});
-
-        // TODO collect at the correct resolution, then update all templates of
-        // the instance. At the moment the max res is set to 10000, so we
-        // collect (hopefully) all the LODs.
-        auto templates =
-            generator->collectTemplates(collector, childCtx, 10000);
-        _objects.emplace_back(templates);
+        _templates->update(id, *_generators[id], collector, childCtx);
     }
 }
 
@@ -76,11 +76,11 @@ inline void InstancePool<TDistribution>::decorate(
 
     // Distribution
     std::uniform_real_distribution<double> rotDistrib(0, M_PI * 2);
-    auto &instance = chunk.addChild<Instance>();
+    auto &instance = chunk.addChild<Instance>(_templates);
     auto positions = _distribution.getPositions(chunk, ctx);
 
     for (auto &position : positions) {
-        auto &templates = _objects.at(position._genID);
+        auto &templates = _templates->getTemplates(position._genID);
 
         if (templates.empty()) {
             continue;
@@ -170,10 +170,11 @@ void InstancePool<TDistribution>::exportSpecies(const std::string &outputDir,
                 ExplorationContext::getDefault());
     double sep = avgSize;
 
-    for (size_t x = 0; x < _objects.size(); ++x) {
-        auto &templates = _objects[x];
+    for (size_t x = 0; x < _generators.size(); ++x) {
+        auto &templates = _templates->getTemplates(x);
 
         for (size_t y = 0; y < templates.size(); ++y) {
+            _templates->require(collector, templates[y]._id, 10000);
             vec3d c{x * sep, y * sep, 0};
             SceneNode node = templates[y].getDefaultNode();
             node.setPosition(c);
@@ -217,6 +218,7 @@ void InstancePool<TDistribution>::exportSpecies(const std::string &outputDir,
 
 inline void Instance::addNode(Template tp) {
     _templates.push_back(std::move(tp));
+    _bvh.clear();
 }
 
 inline size_t Instance::getNodeCount() const { return _templates.size(); }
@@ -224,37 +226,147 @@ inline size_t Instance::getNodeCount() const { return _templates.size(); }
 inline void Instance::collectSelf(ICollector &collector,
                                   const IResolutionModel &resolutionModel,
                                   const ExplorationContext &ctx) {
-    if (collector.hasChannel<SceneNode>()) {
+    if (collector.hasChannel<InstanceBuffer>()) {
+        collectBuffers(collector, collector.getChannel<InstanceBuffer>(),
+                       resolutionModel, ctx);
+    } else if (collector.hasChannel<SceneNode>()) {
         auto &objChan = collector.getChannel<SceneNode>();
 
-        for (size_t i = 0; i < _templates.size(); ++i) {
+        forEachVisible(resolutionModel, ctx, [&](size_t i, double resolution,
+                                                 const Template::Item &nodes) {
             ItemKey key{std::to_string(i)};
             auto &tp = _templates[i];
 
-            // Get the nodes corresponding to the right resolution
-            double resolution =
-                resolutionModel.getResolutionAt(tp._position, ctx);
-            auto *nodes = tp.getAt(resolution);
+            if (_cache) {
+                _cache->require(collector, tp._id, resolution);
+            }
 
-            if (nodes != nullptr) {
-                // Add every node of the resolution level to the collector
-                int j = 0;
-
-                for (SceneNode node : nodes->_nodes) {
-                    // Update each object's transform based on the global one
-                    node.setPosition(node.getPosition() * tp._scale +
-                                     tp._position);
-                    // TODO update position based on rotation
-                    node.setRotation(tp._rotation);
-                    node.setScale(node.getScale() * tp._scale);
-                    objChan.put({key, std::to_string(j) + "." +
-                                          std::to_string(nodes->_minRes)},
-                                node, ctx);
-                    ++j;
-                }
+            // Add every node of the resolution level to the collector
+            int j = 0;
+
+            for (SceneNode node : nodes._nodes) {
+                // Update each object's transform based on the global one
+                node.setPosition(transformPosition(tp, node.getPosition()));
+                node.setRotation(tp._rotation);
+                node.setScale(node.getScale() * tp._scale);
+                objChan.put({key, std::to_string(j) + "." +
+                                      std::to_string(nodes._minRes)},
+                            node, ctx);
+                ++j;
             }
+        });
+    }
+}
+
+inline void Instance::collectBuffers(
+    ICollector &collector, ICollectorChannel<InstanceBuffer> &bufferChan,
+    const IResolutionModel &resolutionModel, const ExplorationContext &ctx) {
+    // One buffer for each node of each item, by template id and resolution
+    std::map<std::pair<int, double>, std::vector<InstanceBuffer>> buffers;
+
+    forEachVisible(resolutionModel, ctx, [&](size_t i, double resolution,
+                                             const Template::Item &nodes) {
+        auto &tp = _templates[i];
+
+        if (_cache) {
+            _cache->require(collector, tp._id, resolution);
+        }
+        auto &itemBuffers = buffers[{tp._id, nodes._minRes}];
+
+        if (itemBuffers.empty()) {
+            for (const SceneNode &node : nodes._nodes) {
+                itemBuffers.emplace_back(node.getMeshID(),
+                                         node.getMaterialID());
+            }
+        }
+
+        for (size_t j = 0; j < nodes._nodes.size(); ++j) {
+            const SceneNode &node = nodes._nodes[j];
+            itemBuffers[j].add(transformPosition(tp, node.getPosition()),
+                               tp._rotation, node.getScale() * tp._scale);
+        }
+    });
+
+    for (auto &entry : buffers) {
+        for (size_t j = 0; j < entry.second.size(); ++j) {
+            ItemKey key{std::to_string(entry.first.first) + "." +
+                        std::to_string(j) + "." +
+                        std::to_string(entry.first.second)};
+            bufferChan.put(key, entry.second[j], ctx);
         }
     }
 }
 
+inline vec3d Instance::transformPosition(const Template &tp,
+                                        const vec3d &position) {
+    const vec3d p = position * tp._scale;
+    const double ca = std::cos(tp._rotation.x), sa = std::sin(tp._rotation.x);
+    const double cb = std::cos(tp._rotation.y), sb = std::sin(tp._rotation.y);
+    const double cg = std::cos(tp._rotation.z), sg = std::sin(tp._rotation.z);
+
+    // Rotated axes
+    const vec3d ax{cg * cb, sg * cb, -sb};
+    const vec3d ay{cg * sb * sa - sg * ca, sg * sb * sa + cg * ca, cb * sa};
+    const vec3d az{cg * sb * ca + sg * sa, sg * sb * ca - cg * sa, cb * ca};
+    return tp._position + ax * p.x + ay * p.y + az * p.z;
+}
+
+template <typename TCallback>
+inline void Instance::forEachVisible(const IResolutionModel &resolutionModel,
+                                     const ExplorationContext &ctx,
+                                     TCallback callback) {
+    if (_bvh.empty() && !_templates.empty()) {
+        std::vector<vec3d> positions;
+        positions.reserve(_templates.size());
+
+        for (auto &tp : _templates) {
+            positions.push_back(tp._position);
+        }
+        _bvh.build(positions);
+    }
+    const auto &indices = _bvh.getIndices();
+
+    _bvh.visit([&](const BoundingVolumeHierarchy::Node &node) {
+        const double maxRes =
+            resolutionModel.getMaxResolutionIn(node._bbox, ctx);
+        const double minRes =
+            resolutionModel.getMinResolutionIn(node._bbox, ctx);
+
+        // Templates whose item is the same at both bounds are resolved
+        // without querying the resolution at their position
+        bool resolved = true;
+
+        if (!node.isLeaf()) {
+            for (u32 i = node._first; i < node._first + node._count; ++i) {
+                auto &tp = _templates[indices[i]];
+
+                if (tp.getAt(minRes) != tp.getAt(maxRes)) {
+                    resolved = false;
+                    break;
+                }
+            }
+
+            if (!resolved) {
+                return true;
+            }
+        }
+
+        for (u32 i = node._first; i < node._first + node._count; ++i) {
+            auto &tp = _templates[indices[i]];
+            double resolution = maxRes;
+            auto *nodes = tp.getAt(maxRes);
+
+            if (nodes != tp.getAt(minRes)) {
+                resolution = resolutionModel.getResolutionAt(tp._position, ctx);
+                nodes = tp.getAt(resolution);
+            }
+
+            if (nodes != nullptr) {
+                callback(indices[i], resolution, *nodes);
+            }
+        }
+        return false;
+    });
+}
+
 } // namespace world
@@ -20,11 +20,40 @@ private:
     std::function<Out(In...)> _function;
 };
 
+/** Engine returned by paramsRng() on the current thread. */
+inline std::mt19937 *&currentParamsRng() {
+    thread_local std::mt19937 defaultRng(static_cast<u32>(time(NULL)));
+    thread_local std::mt19937 *rng = &defaultRng;
+    return rng;
+}
+
+/** Random engine of the random parameters. Each thread has its own engine,
+ * which can be replaced during a generation with ParamsRngScope. */
+inline std::mt19937 &paramsRng() { return *currentParamsRng(); }
+
+/** Make paramsRng() return the given engine on the current thread, until
+ * this object is destroyed. A generation can be made reproducible by
+ * running it with its own seeded engine, without changing the draws of the
+ * rest of the thread. */
+class ParamsRngScope {
+public:
+    explicit ParamsRngScope(std::mt19937 &rng)
+            : _previous(currentParamsRng()) {
+        currentParamsRng() = &rng;
+    }
+
+    ~ParamsRngScope() { currentParamsRng() = _previous; }
+
+    ParamsRngScope(const ParamsRngScope &other) = delete;
+
+    ParamsRngScope &operator=(const ParamsRngScope &other) = delete;
+
+private:
+    std::mt19937 *_previous;
+};
+
 template <typename Out, typename... In> struct Params {
-    static std::mt19937 &rng() {
-        static std::mt19937 _rng(static_cast<u32>(time(NULL)));
-        return _rng;
-    };
+    static std::mt19937 &rng() { return paramsRng(); };
 
     static Parameter<Out, In...> constant(Out value) {
         Parameter<Out, In...> ret;
@@ -5,41 +5,33 @@
 
 namespace world {
 
+SeedDistribution::SeedDistribution()
+        : DistributionBase(), _seed(_rng()), _cellSystem(0, {1}, {1}),
+          _reducer(_cellSystem, 1024) {
+    _tileSize = _maxDist;
+    // 0.75 = Expected value of law 1 - X^2 with X in [0, 1]
+    double invMeanRadius = 1 / (0.75 / 1000 * _maxDist);
+    _seedDensity = 1 / M_PI * invMeanRadius * invMeanRadius * _seedAmount;
+    _seeds.setReducer(&_reducer);
+}
+
 void SeedDistribution::addSeeds(Chunk &chunk) {
     if (_habitats.empty())
         throw std::runtime_error(
             "[SeedDistribution] No generator available for new seeds!");
 
+    // Forget the oldest cells before adding the cells of this chunk, so that
+    // they are all available until the next call
+    _reducer.reduceStorage();
     auto bounds = getBounds(chunk);
-    double area = _tileSize * _tileSize / 1e6;
-    std::uniform_real_distribution<double> distrib(0, 1);
-    std::uniform_int_distribution<int> genDistrib(0, _habitats.size() - 1);
 
     for (int y = bounds.first.y; y <= bounds.second.y; ++y) {
         for (int x = bounds.first.x; x <= bounds.second.x; ++x) {
             vec2i tileCoords{x, y};
-            auto ret = _seeds.insert({tileCoords, std::vector<Seed>()});
-
-            if (ret.second) {
-                auto &seeds = ret.first->second;
-                double count = randRound(_rng, area * _seedDensity);
-
-                for (int i = 0; i < count; ++i) {
-                    vec2d seedPos =
-                        (vec2d{distrib(_rng), distrib(_rng)} + tileCoords) *
-                        _tileSize;
-                    double distRatio = distrib(_rng);
-                    double distance = _maxDist * (1 - distRatio * distRatio);
-
-                    // Choose the generator
-                    // TODO choose the generator according to local conditions
-                    u32 generatorId = genDistrib(_rng);
-                    seeds.push_back({seedPos, generatorId, distance});
-
-                    // std::cout << seedPos.x << " " << seedPos.y << " " <<
-                    // distance << " " << generatorId << std::endl;
-                }
-            }
+            _seeds.getOrCreateCallback(
+                {x, y, 0, 0}, [this, &tileCoords](SeedCell &cell) {
+                    generateCell(tileCoords, cell);
+                });
         }
     }
 }
@@ -50,9 +42,11 @@ std::vector<Seed> SeedDistribution::getSeedsAround(Chunk &chunk) {
 
     for (int y = bounds.first.y; y <= bounds.second.y; ++y) {
         for (int x = bounds.first.x; x <= bounds.second.x; ++x) {
-            auto it = _seeds.find({x, y});
-            if (it != _seeds.end()) {
-                seeds.insert(seeds.end(), it->second.begin(), it->second.end());
+            SeedCell *cell;
+
+            if (_seeds.tryGet({x, y, 0, 0}, &cell)) {
+                seeds.insert(seeds.end(), cell->_seeds.begin(),
+                             cell->_seeds.end());
             }
         }
     }
@@ -95,41 +89,56 @@ std::vector<SeedDistribution::Position> SeedDistribution::getPositions(
     std::uniform_real_distribution<double> posDistrib(0, 1);
     std::uniform_real_distribution<double> keepDistrib(0, 1);
 
+    // Get 3D positions (with altitude), all at once
+    std::vector<vec3d> absPositions(count);
+
+    for (vec3d &absPos : absPositions) {
+        absPos = chunkPos + vec3d{posDistrib(_rng) * chunkDims.x,
+                                  posDistrib(_rng) * chunkDims.y, -10000};
+    }
+
+    ctx.getEnvironment().findNearestFreePoints(
+        absPositions.data(), absPositions.data(), absPositions.size(),
+        vec3d{0, 0, 1}, _resolution, ExplorationContext::getDefault());
+
+    // Positions of the seeds in flat arrays, so that the distances to all the
+    // seeds are computed in one pass. There are only about 20 seeds around a
+    // chunk, and their falloff has no cut-off, so they are all visited.
+    const size_t seedCount = seedsAround.size();
+    std::vector<double> seedX(seedCount), seedY(seedCount);
+
+    for (size_t s = 0; s < seedCount; ++s) {
+        seedX[s] = seedsAround[s]._position.x;
+        seedY[s] = seedsAround[s]._position.y;
+    }
+
+    std::vector<double> speciesCoefs(_habitats.size());
+    std::vector<double> habitatCoefs(seedCount);
+    std::vector<double> squaredDistances(seedCount);
+
+    // This lambda compute the chance of surviving at x if species life zone
+    // is range
+    const auto getProb = [](vec2d range, double x) {
+        double l = (range.y - range.x) * 0.1;
+        return min(smoothstep(range.x - l, range.x + l, x),
+                   smoothstep(range.y + l, range.y - l, x));
+    };
+
     // For each position, species will compete with each others
     // <!> This algorithm considers that a species competes for the habitat
     // even if it is not adapted to it.
     for (int i = 0; i < count; ++i) {
-        // Get 3D position (with altitude)
-        vec3d position{posDistrib(_rng) * chunkDims.x,
-                       posDistrib(_rng) * chunkDims.y, -10000};
-        vec3d absPos = ctx.getEnvironment().findNearestFreePoint(
-            chunkPos + position, vec3d{0, 0, 1}, _resolution,
-            ExplorationContext::getDefault());
-        position = absPos - chunkPos;
+        const vec3d &absPos = absPositions[i];
+        vec3d position = absPos - chunkPos;
 
         if (position.z < 0 || position.z >= chunkDims.z) {
             continue;
         }
 
-        // Compute chance for each species to win the place
-        std::vector<double> habitatCoefs;
-        habitatCoefs.reserve(seedsAround.size());
-
-        std::vector<double> distanceCoefs;
-        distanceCoefs.reserve(seedsAround.size());
-
-        double total = 0;
-
-        // This lambda compute the chance of surviving at x if species life zone
-        // is range
-        const auto getProb = [](vec2d range, double x) {
-            double l = (range.y - range.x) * 0.1;
-            return min(smoothstep(range.x - l, range.x + l, x),
-                       smoothstep(range.y + l, range.y - l, x));
-        };
-
-        for (auto &seed : seedsAround) {
-            HabitatFeatures &habitat = _habitats.at(seed._generatorId);
+        // The habitat coefficient only depends on the species, so it is
+        // computed once per species instead of once per seed
+        for (size_t s = 0; s < _habitats.size(); ++s) {
+            HabitatFeatures &habitat = _habitats[s];
             double habitatCoef = 1;
 
             if (absPos.z < 0 && !habitat._sea) {
@@ -140,15 +149,36 @@ std::vector<SeedDistribution::Position> SeedDistribution::getPositions(
             // TODO add humidity and temperature
             // double humidity = _env->getHumidity(position);
             // double temperature = _env->getTemperature(position);
+            speciesCoefs[s] = habitatCoef;
+        }
+
+        const double *xs = seedX.data();
+        const double *ys = seedY.data();
+        double *distances = squaredDistances.data();
+
+        for (size_t s = 0; s < seedCount; ++s) {
+            const double dx = xs[s] - absPos.x;
+            const double dy = ys[s] - absPos.y;
+            distances[s] = dx * dx + dy * dy;
+        }
+
+        // Compute chance for each species to win the place. The seeds of the
+        // species that can not live here add nothing to the total, so their
+        // distance coefficient is skipped.
+        double total = 0;
 
-            habitatCoefs.push_back(habitatCoef);
+        for (size_t s = 0; s < seedCount; ++s) {
+            const Seed &seed = seedsAround[s];
+            const double habitatCoef = speciesCoefs[seed._generatorId];
+            habitatCoefs[s] = habitatCoef;
 
-            double distance = seed._position.length(vec2d(absPos));
-            double distanceCoef = pow(2, -distance / seed._distance) / 2;
-            distanceCoefs.push_back(distanceCoef);
-            // TODO (advanced) introduce environmental obstacles
+            if (habitatCoef != 0) {
+                double distance = sqrt(distances[s]);
+                double distanceCoef = pow(2, -distance / seed._distance) / 2;
+                // TODO (advanced) introduce environmental obstacles
 
-            total += habitatCoef * distanceCoef;
+                total += habitatCoef * distanceCoef;
+            }
         }
 
         // Select seed according to previously computed probabilities
@@ -180,6 +210,7 @@ std::vector<SeedDistribution::Position> SeedDistribution::getPositions(
 
 void SeedDistribution::write(WorldFile &wf) const {
     DistributionBase::write(wf);
+    wf.addUint("seed", _seed);
     wf.addDouble("tileSize", _tileSize);
     wf.addDouble("seedDensity", _seedDensity);
     wf.addDouble("seedAmount", _seedAmount);
@@ -188,6 +219,7 @@ void SeedDistribution::write(WorldFile &wf) const {
 
 void SeedDistribution::read(const WorldFile &wf) {
     DistributionBase::read(wf);
+    wf.readUintOpt("seed", _seed);
     wf.readDoubleOpt("tileSize", _tileSize);
     wf.readDoubleOpt("seedDensity", _seedDensity);
     wf.readDoubleOpt("seedAmount", _seedAmount);
@@ -201,4 +233,27 @@ std::pair<vec2i, vec2i> SeedDistribution::getBounds(const Chunk &chunk) const {
     return {(lower / _tileSize).floor(), (upper / _tileSize).ceil()};
 }
 
+void SeedDistribution::generateCell(const vec2i &tileCoords,
+                                    SeedCell &cell) const {
+    // The seeds only depend on the cell, not on the order of the visits.
+    // minstd_rand is much cheaper to seed than mt19937.
+    std::minstd_rand rng(hashCell(tileCoords.x, tileCoords.y, _seed));
+    double area = _tileSize * _tileSize / 1e6;
+    std::uniform_real_distribution<double> distrib(0, 1);
+    std::uniform_int_distribution<int> genDistrib(0, _habitats.size() - 1);
+    double count = randRound(rng, area * _seedDensity);
+
+    for (int i = 0; i < count; ++i) {
+        vec2d seedPos =
+            (vec2d{distrib(rng), distrib(rng)} + tileCoords) * _tileSize;
+        double distRatio = distrib(rng);
+        double distance = _maxDist * (1 - distRatio * distRatio);
+
+        // Choose the generator
+        // TODO choose the generator according to local conditions
+        u32 generatorId = genDistrib(rng);
+        cell._seeds.push_back({seedPos, generatorId, distance});
+    }
+}
+
 } // namespace world
@@ -3,12 +3,13 @@
 
 #include "world/core/WorldConfig.h"
 
-#include <map>
-
 #include "world/core/WorldTypes.h"
 #include "world/core/IEnvironment.h"
 #include "world/math/Vector.h"
 #include "world/core/Chunk.h"
+#include "GridStorage.h"
+#include "GridStorageReducer.h"
+#include "TileSystem.h"
 #include "InstanceDistribution.h"
 
 namespace world {
@@ -19,15 +20,37 @@ struct WORLDAPI_EXPORT Seed {
     double _distance = 1000;
 };
 
+/** Seeds of one cell of a SeedDistribution. */
+class WORLDAPI_EXPORT SeedCell : public IGridElement {
+public:
+    std::vector<Seed> _seeds;
+};
+
+/** Distribution where species spread from seeds. The seeds of each cell of
+ * the ground are derived from the coordinates of the cell and the seed of
+ * the distribution. Only the recently used cells are kept in memory, the
+ * other cells are generated again when they are needed, with the same
+ * seeds as long as the habitats do not change. */
 class WORLDAPI_EXPORT SeedDistribution : public DistributionBase {
 public:
-    SeedDistribution() : DistributionBase() {
-        _tileSize = _maxDist;
-        // 0.75 = Expected value of law 1 - X^2 with X in [0, 1]
-        double invMeanRadius = 1 / (0.75 / 1000 * _maxDist);
-        _seedDensity = 1 / M_PI * invMeanRadius * invMeanRadius * _seedAmount;
-    }
+    SeedDistribution();
+
+    SeedDistribution(const SeedDistribution &other) = delete;
+
+    SeedDistribution &operator=(const SeedDistribution &other) = delete;
 
+    /** Set the seed from which the seeds of all the cells are derived. */
+    void setSeed(u32 seed) { _seed = seed; }
+
+    /** Set the maximum count of cells kept in memory. */
+    void setMaxCells(u32 maxCells) { _reducer.setMaxInstances(maxCells); }
+
+    /** Count of cells currently kept in memory. */
+    size_t getCellCount() const { return _seeds.size(); }
+
+    /** Make sure the seeds of the cells around the chunk are in memory. The
+     * cells that have not been used for the longest time may be removed
+     * from memory. */
     void addSeeds(Chunk &chunk);
 
     std::vector<Seed> getSeedsAround(Chunk &chunk);
@@ -43,7 +66,13 @@ private:
     double _tileSize;
     /// Number of seeds per km^2. Computed from seedAmount and maxDist.
     double _seedDensity;
-    std::map<vec2i, std::vector<Seed>> _seeds;
+    /// Seed of the random generators of the cells
+    u32 _seed;
+
+    /// Tile system of the cells, they all have lod 0
+    TileSystem _cellSystem;
+    GridStorageReducer _reducer;
+    GridStorage<SeedCell> _seeds;
 
     /// Mean amount of seeds occupying the same territory.
     double _seedAmount = 2;
@@ -53,6 +82,8 @@ private:
 
     /** Returns id bounds of the zone around the given chunk */
     std::pair<vec2i, vec2i> getBounds(const Chunk &chunk) const;
+
+    void generateCell(const vec2i &tileCoords, SeedCell &cell) const;
 };
 
 } // namespace world
@@ -110,6 +110,45 @@ vec3d FlatWorld::findNearestFreePoint(const vec3d &origin,
     return {origin.x, origin.y, z - ctx.getOffset().z};
 }
 
+void FlatWorld::findNearestFreePoints(const vec3d *origins, vec3d *results,
+                                      size_t count, const vec3d &,
+                                      double resolution,
+                                      const ExplorationContext &ctx) const {
+    const vec3d offset = ctx.getOffset();
+    std::vector<vec2d> points(count);
+    std::vector<double> altitudes(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        points[i] = {origins[i].x + offset.x, origins[i].y + offset.y};
+    }
+
+    _internal->_ground->observeAltitudesAt(points.data(), altitudes.data(),
+                                           count, resolution);
+
+    for (size_t i = 0; i < count; ++i) {
+        results[i] = {origins[i].x, origins[i].y, altitudes[i] - offset.z};
+    }
+}
+
+u64 FlatWorld::getEditEpoch() const {
+    return _internal->_ground->getEditEpoch();
+}
+
+bool FlatWorld::getEditsSince(u64 epoch, std::vector<BoundingBox> &bounds,
+                              const ExplorationContext &ctx) const {
+    const size_t first = bounds.size();
+
+    if (!_internal->_ground->getEditsSince(epoch, bounds)) {
+        return false;
+    }
+    const vec3d offset = ctx.getOffset();
+
+    for (size_t i = first; i < bounds.size(); ++i) {
+        bounds[i].translate(-offset);
+    }
+    return true;
+}
+
 void FlatWorld::write(WorldFile &wf) const {
     wf.addChild("ground", _internal->_ground->serializeSubclass());
     World::write(wf);
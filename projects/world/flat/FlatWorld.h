@@ -31,6 +31,16 @@ public:
                                double resolution,
                                const ExplorationContext &ctx) const override;
 
+    void findNearestFreePoints(const vec3d *origins, vec3d *results,
+                               size_t count, const vec3d &direction,
+                               double resolution,
+                               const ExplorationContext &ctx) const override;
+
+    u64 getEditEpoch() const override;
+
+    bool getEditsSince(u64 epoch, std::vector<BoundingBox> &bounds,
+                       const ExplorationContext &ctx) const override;
+
     void write(WorldFile &wf) const override;
 
     void read(const WorldFile &wf) override;
@@ -1,5 +1,13 @@
 #include "IGround.h"
 
 namespace world {
+
+void IGround::observeAltitudesAt(const vec2d *points, double *altitudes,
+                                 size_t count, double resolution) {
+    for (size_t i = 0; i < count; ++i) {
+        altitudes[i] = observeAltitudeAt(points[i].x, points[i].y, resolution);
+    }
+}
+
 WORLD_REGISTER_BASE_CLASS(GroundNode);
 }
\ No newline at end of file
@@ -3,7 +3,10 @@
 
 #include "world/core/WorldConfig.h"
 
+#include <vector>
+
 #include "world/core/WorldNode.h"
+#include "world/math/BoundingBox.h"
 #include "world/assets/Image.h"
 
 namespace world {
@@ -16,6 +19,27 @@ public:
 
     virtual double observeAltitudeAt(double x, double y, double resolution) = 0;
 
+    /** Get the altitude of each point of an array. The default
+     * implementation calls observeAltitudeAt() for each point.
+     * @param points array of count (x, y) coordinates
+     * @param altitudes array receiving the count altitudes */
+    virtual void observeAltitudesAt(const vec2d *points, double *altitudes,
+                                    size_t count, double resolution);
+
+    /** Get a counter that changes each time the heights of the ground are
+     * edited, so that the users caching altitudes know when to query them
+     * again. The default implementation returns 0, for the grounds that
+     * can not be edited. */
+    virtual u64 getEditEpoch() const { return 0; }
+
+    /** Get the bounds of the height edits made after the given edit epoch.
+     * Returns false if those edits are not known, in which case the whole
+     * ground must be considered as edited. The default implementation only
+     * knows that nothing was edited if the epoch did not change. */
+    virtual bool getEditsSince(u64 epoch, std::vector<BoundingBox> &) const {
+        return epoch == getEditEpoch();
+    }
+
     /** Paint the given image on the terrain texture.
      * \param origin the (x, y) coordinates of the top left corner of
      * the image on the terrain, in meters.
@@ -0,0 +1,189 @@
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <random>
+
+#include "RandomHelper.h"
+
+namespace world {
+
+/** Count of random candidates tried for each new point. More candidates
+ * give a more regular spacing. */
+static const int CANDIDATE_COUNT = 16;
+
+/** Squared distance between two points of the unit square, which wraps
+ * around on both axes. */
+static double toroidalDistance2(const vec2d &a, const vec2d &b) {
+    double dx = std::abs(a.x - b.x);
+    double dy = std::abs(a.y - b.y);
+    dx = std::min(dx, 1 - dx);
+    dy = std::min(dy, 1 - dy);
+    return dx * dx + dy * dy;
+}
+
+/** Place pointCount points with the best candidate algorithm: each new
+ * point is the candidate farthest from all the points already placed. If
+ * border is given, its points closer than margin to the borders of the
+ * square are kept at the same rank, and the other points are placed farther
+ * than margin from the borders, and away from all the kept points. */
+static std::vector<vec2d> bestCandidates(std::mt19937 &rng, u32 pointCount,
+                                         const std::vector<vec2d> *border,
+                                         double margin) {
+    const double lower = border != nullptr ? margin : 0;
+    std::uniform_real_distribution<double> distrib(lower, 1 - lower);
+    auto isKept = [&](const vec2d &p) {
+        return p.x < margin || p.x >= 1 - margin || p.y < margin ||
+               p.y >= 1 - margin;
+    };
+
+    std::vector<vec2d> points;
+    points.reserve(pointCount);
+    // Points the candidates must avoid
+    std::vector<vec2d> placed;
+    placed.reserve(pointCount);
+
+    if (border != nullptr) {
+        std::copy_if(border->begin(), border->end(),
+                     std::back_inserter(placed), isKept);
+    }
+
+    // Squared distance to the nearest placed point of each candidate
+    std::vector<vec2d> candidates(CANDIDATE_COUNT);
+    std::vector<double> nearest(CANDIDATE_COUNT);
+
+    for (u32 i = 0; i < pointCount; ++i) {
+        if (border != nullptr && isKept((*border)[i])) {
+            points.push_back((*border)[i]);
+            continue;
+        }
+
+        for (int c = 0; c < CANDIDATE_COUNT; ++c) {
+            candidates[c] = {distrib(rng), distrib(rng)};
+            nearest[c] = 2;
+        }
+
+        for (const vec2d &point : placed) {
+            for (int c = 0; c < CANDIDATE_COUNT; ++c) {
+                nearest[c] = std::min(
+                    nearest[c], toroidalDistance2(candidates[c], point));
+            }
+        }
+
+        auto best = std::max_element(nearest.begin(), nearest.end());
+        points.push_back(candidates[best - nearest.begin()]);
+        placed.push_back(points.back());
+    }
+    return points;
+}
+
+BlueNoiseTile::BlueNoiseTile(u32 pointCount, u32 seed, u32 variantCount)
+        : _pointCount(pointCount), _seed(seed),
+          _gridSize(std::max(1, static_cast<int>(std::sqrt(pointCount / 4.)))) {
+    std::mt19937 rng(seed);
+    const std::vector<vec2d> base =
+        bestCandidates(rng, pointCount, nullptr, 0);
+    _variants.push_back(makeVariant(base));
+
+    // The other variants keep the points of the base tile within about one
+    // spacing of the borders. The base tile repeats without seams, so the
+    // variants match each other across the borders.
+    const double margin = 1 / std::sqrt(std::max(pointCount, 1u));
+
+    for (u32 v = 1; v < variantCount; ++v) {
+        _variants.push_back(
+            makeVariant(bestCandidates(rng, pointCount, &base, margin)));
+    }
+}
+
+BlueNoiseTile::Variant BlueNoiseTile::makeVariant(
+    const std::vector<vec2d> &points) const {
+    // Sort the points by cell, so that getSamples only visits the cells
+    // that overlap the requested rectangle
+    const int cellCount = _gridSize * _gridSize;
+    std::vector<int> cells(_pointCount);
+    Variant variant;
+    variant._cellStarts.assign(cellCount + 1, 0);
+
+    for (u32 i = 0; i < _pointCount; ++i) {
+        const int cx = std::min(int(points[i].x * _gridSize), _gridSize - 1);
+        const int cy = std::min(int(points[i].y * _gridSize), _gridSize - 1);
+        cells[i] = cy * _gridSize + cx;
+        ++variant._cellStarts[cells[i] + 1];
+    }
+
+    for (int c = 0; c < cellCount; ++c) {
+        variant._cellStarts[c + 1] += variant._cellStarts[c];
+    }
+
+    variant._points.resize(_pointCount);
+    variant._ranks.resize(_pointCount);
+    std::vector<u32> next(variant._cellStarts.begin(),
+                          variant._cellStarts.end() - 1);
+
+    for (u32 i = 0; i < _pointCount; ++i) {
+        const u32 index = next[cells[i]]++;
+        variant._points[index] = points[i];
+        variant._ranks[index] = static_cast<double>(i) / _pointCount;
+    }
+    return variant;
+}
+
+const BlueNoiseTile &BlueNoiseTile::getDefault() {
+    static const BlueNoiseTile tile;
+    return tile;
+}
+
+std::vector<BlueNoiseTile::Sample> BlueNoiseTile::getSamples(
+    const vec2d &lower, const vec2d &upper, double density,
+    const vec2d &offset) const {
+    std::vector<Sample> samples;
+
+    if (density <= 0 || _pointCount == 0 || _variants.empty()) {
+        return samples;
+    }
+
+    const double tileSize = std::sqrt(_pointCount / density);
+    const double cellSize = tileSize / _gridSize;
+
+    // Cells of the repeated grid overlapping the rectangle
+    const vec2d start = (lower - offset) / cellSize;
+    const vec2d end = (upper - offset) / cellSize;
+    const s64 minX = static_cast<s64>(std::floor(start.x));
+    const s64 minY = static_cast<s64>(std::floor(start.y));
+    const s64 maxX = static_cast<s64>(std::ceil(end.x));
+    const s64 maxY = static_cast<s64>(std::ceil(end.y));
+    samples.reserve(static_cast<size_t>(
+        std::max(0., (upper.x - lower.x) * (upper.y - lower.y) * density)));
+
+    for (s64 y = minY; y < maxY; ++y) {
+        const s64 tileY = y >= 0 ? y / _gridSize : (y + 1) / _gridSize - 1;
+        const int cellY = static_cast<int>(y - tileY * _gridSize);
+
+        for (s64 x = minX; x < maxX; ++x) {
+            const s64 tileX = x >= 0 ? x / _gridSize : (x + 1) / _gridSize - 1;
+            const int cellX = static_cast<int>(x - tileX * _gridSize);
+            const vec2d tileOrigin =
+                offset + vec2d{double(tileX), double(tileY)} * tileSize;
+            const u32 tileHash = hashCell(tileX, tileY, _seed);
+            const Variant &variant = _variants[tileHash % _variants.size()];
+
+            const int cell = cellY * _gridSize + cellX;
+            const u32 cellEnd = variant._cellStarts[cell + 1];
+
+            for (u32 i = variant._cellStarts[cell]; i < cellEnd; ++i) {
+                const vec2d position =
+                    tileOrigin + variant._points[i] * tileSize;
+
+                if (position.x >= lower.x && position.x < upper.x &&
+                    position.y >= lower.y && position.y < upper.y) {
+                    samples.push_back({position, variant._ranks[i], tileHash});
+                }
+            }
+        }
+    }
+    return samples;
+}
+
+} // namespace world
@@ -0,0 +1,85 @@
+#ifndef WORLD_BLUENOISE_H
+#define WORLD_BLUENOISE_H
+
+#include "world/core/WorldConfig.h"
+
+#include <vector>
+
+#include "world/core/WorldTypes.h"
+#include "Vector.h"
+
+namespace world {
+
+/** Square tile of blue noise points, that can be repeated over the plane
+ * without seams: the spacing between points is the same across the borders
+ * of the tile as inside the tile.
+ *
+ * The points are generated with Mitchell's best candidate algorithm, which
+ * makes them progressive: the first n points of the tile are themselves
+ * evenly spaced. The rank of each point in this order can be used to thin
+ * the pattern according to a density field, by keeping the points whose
+ * rank is lower than the local density, without losing the spacing.
+ *
+ * To avoid a visible repetition, the plane is covered with several variants
+ * of the tile, like Wang tiles with a single edge color: the variants share
+ * the points near the borders of the tile, so any variant can be placed
+ * next to any other, and they differ inside. The variant of each repetition
+ * of the tile is picked by hashing its position. */
+class WORLDAPI_EXPORT BlueNoiseTile {
+public:
+    struct Sample {
+        vec2d _position;
+        /// Rank of the point in the progressive order, in [0, 1)
+        double _rank;
+        /// Hash of the repetition of the tile that contains the point. It
+        /// can be used to vary what the points stand for between the
+        /// repetitions, as the variants share the points of their borders.
+        u32 _tileHash;
+    };
+
+    /** Generate a tile with the given count of points and variants. The
+     * same seed always gives the same tile. */
+    BlueNoiseTile(u32 pointCount = 1024, u32 seed = 0, u32 variantCount = 8);
+
+    /** Tile with the default parameters, shared by all the users. It is
+     * generated at the first call. */
+    static const BlueNoiseTile &getDefault();
+
+    u32 getPointCount() const { return _pointCount; }
+
+    u32 getVariantCount() const { return static_cast<u32>(_variants.size()); }
+
+    /** Get the points of the pattern in the rectangle [lower, upper). The
+     * pattern is scaled so that it contains on average density points per
+     * unit of area, and shifted by offset. The result only depends on the
+     * arguments, and the cost is proportional to the count of points
+     * returned. */
+    std::vector<Sample> getSamples(const vec2d &lower, const vec2d &upper,
+                                   double density,
+                                   const vec2d &offset = {}) const;
+
+private:
+    struct Variant {
+        /// Points in [0, 1)^2, sorted by cell of the grid
+        std::vector<vec2d> _points;
+        /// Rank of each point
+        std::vector<double> _ranks;
+        /// Index of the first point of each cell, plus the end of the last
+        /// cell
+        std::vector<u32> _cellStarts;
+    };
+
+    std::vector<Variant> _variants;
+    u32 _pointCount;
+    u32 _seed;
+    /// Number of cells of the grid along each axis
+    int _gridSize;
+
+
+    /** Sort the points, given in progressive order, by cell of the grid. */
+    Variant makeVariant(const std::vector<vec2d> &points) const;
+};
+
+} // namespace world
+
+#endif // WORLD_BLUENOISE_H
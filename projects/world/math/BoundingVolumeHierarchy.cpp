@@ -0,0 +1,66 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+namespace world {
+
+void BoundingVolumeHierarchy::build(const std::vector<vec3d> &points,
+                                    u32 leafSize) {
+    clear();
+
+    if (points.empty()) {
+        return;
+    }
+    leafSize = std::max(leafSize, 1u);
+    _indices.resize(points.size());
+
+    for (u32 i = 0; i < _indices.size(); ++i) {
+        _indices[i] = i;
+    }
+
+    _nodes.push_back({{}, 0, static_cast<u32>(points.size()), 0});
+
+    // Nodes are created in breadth first order, so the children of a node
+    // are always after it
+    for (size_t n = 0; n < _nodes.size(); ++n) {
+        const u32 first = _nodes[n]._first;
+        const u32 count = _nodes[n]._count;
+        auto begin = _indices.begin() + first;
+        auto end = begin + count;
+
+        BoundingBox bbox(points[*begin]);
+
+        for (auto it = begin; it != end; ++it) {
+            bbox.addPoint(points[*it]);
+        }
+        _nodes[n]._bbox = bbox;
+
+        if (count <= leafSize) {
+            continue;
+        }
+
+        const vec3d dims = bbox.getDimensions();
+        const int axis = dims.x >= dims.y && dims.x >= dims.z
+                             ? 0
+                             : (dims.y >= dims.z ? 1 : 2);
+        auto coord = [&](u32 i) {
+            const vec3d &p = points[i];
+            return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+        };
+        const u32 half = count / 2;
+        std::nth_element(begin, begin + half, end, [&](u32 a, u32 b) {
+            return coord(a) < coord(b);
+        });
+
+        _nodes[n]._children = static_cast<u32>(_nodes.size());
+        _nodes.push_back({{}, first, half, 0});
+        _nodes.push_back({{}, first + half, count - half, 0});
+    }
+}
+
+void BoundingVolumeHierarchy::clear() {
+    _nodes.clear();
+    _indices.clear();
+}
+
+} // namespace world
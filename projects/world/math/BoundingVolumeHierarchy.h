@@ -0,0 +1,60 @@
+#ifndef WORLD_BOUNDINGVOLUMEHIERARCHY_H
+#define WORLD_BOUNDINGVOLUMEHIERARCHY_H
+
+#include "world/core/WorldConfig.h"
+
+#include <vector>
+
+#include "world/core/WorldTypes.h"
+#include "BoundingBox.h"
+
+namespace world {
+
+/** Bounding volume hierarchy over a set of points. Each node holds the
+ * bounding box of a contiguous range of the point indices, and the leaves
+ * hold at most leafSize points. Nodes are split at the median of the
+ * longest axis of their box. */
+class WORLDAPI_EXPORT BoundingVolumeHierarchy {
+public:
+    struct Node {
+        BoundingBox _bbox;
+        /// Range of the node in getIndices()
+        u32 _first;
+        u32 _count;
+        /// Index of the first child, the second child is next to it. 0 for
+        /// the leaves.
+        u32 _children;
+
+        bool isLeaf() const { return _children == 0; }
+    };
+
+    /** Build the hierarchy of the points, replacing the previous one. */
+    void build(const std::vector<vec3d> &points, u32 leafSize = 16);
+
+    void clear();
+
+    bool empty() const { return _nodes.empty(); }
+
+    /** Bounding box of all the points. The hierarchy must not be empty. */
+    const BoundingBox &getBounds() const { return _nodes.at(0)._bbox; }
+
+    size_t getNodeCount() const { return _nodes.size(); }
+
+    /** Indices of the points, in the order of the nodes. */
+    const std::vector<u32> &getIndices() const { return _indices; }
+
+    /** Visit the nodes depth first from the root. The visitor is called
+     * with each node and returns true to visit the children of the node.
+     * The return value is ignored for the leaves. */
+    template <typename TVisitor> void visit(TVisitor visitor) const;
+
+private:
+    std::vector<Node> _nodes;
+    std::vector<u32> _indices;
+};
+
+} // namespace world
+
+#include "BoundingVolumeHierarchy.inl"
+
+#endif // WORLD_BOUNDINGVOLUMEHIERARCHY_H
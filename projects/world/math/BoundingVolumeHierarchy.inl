@@ -0,0 +1,24 @@
+#include "BoundingVolumeHierarchy.h"
+
+namespace world {
+
+template <typename TVisitor>
+void BoundingVolumeHierarchy::visit(TVisitor visitor) const {
+    if (_nodes.empty()) {
+        return;
+    }
+    // The depth is logarithmic, so the stack stays small
+    std::vector<u32> stack{0};
+
+    while (!stack.empty()) {
+        const Node &node = _nodes[stack.back()];
+        stack.pop_back();
+
+        if (visitor(node) && !node.isLeaf()) {
+            stack.push_back(node._children + 1);
+            stack.push_back(node._children);
+        }
+    }
+}
+
+} // namespace world
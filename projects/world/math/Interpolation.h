@@ -3,8 +3,10 @@
 #define WORLD_INTERPOLATION_H
 
 #include "world/core/WorldConfig.h"
+#include "world/core/WorldTypes.h"
 
 #include <utility>
+#include <vector>
 #include <functional>
 
 #include "MathsHelper.h"
@@ -14,8 +16,25 @@ namespace world {
 struct Interpolation {
     typedef std::function<double(double)> interpFunc;
 
+    // Interpolation functions that can be inlined by the compiler. They can
+    // be used anywhere an interpFunc is expected, but are much faster when
+    // given to the template overloads.
+
+    struct Linear {
+        double operator()(double x) const { return x; }
+    };
+
+    struct Cosine {
+        double operator()(double x) const { return (1 - cos(x * M_PI)) * 0.5; }
+    };
+
+    struct Smoothstep {
+        double operator()(double x) const { return x * x * (3 - 2 * x); }
+    };
+
+    template <typename Interp>
     static inline double interpolate(double x1, double y1, double x2, double y2,
-                                     double x, const interpFunc &f) {
+                                     double x, const Interp &f) {
         double d = x2 - x1;
 
         if (d < std::numeric_limits<double>::epsilon()) {
@@ -28,6 +47,11 @@ struct Interpolation {
         return y2 * xFunc + y1 * (1 - xFunc);
     }
 
+    static inline double interpolate(double x1, double y1, double x2, double y2,
+                                     double x, const interpFunc &f) {
+        return interpolate<interpFunc>(x1, y1, x2, y2, x, f);
+    }
+
     static const interpFunc LINEAR;
     static const interpFunc COSINE;
 
@@ -47,7 +71,12 @@ double cuberp(double values[4], double x);
 
 // https://en.wikipedia.org/wiki/Inverse_distance_weighting
 /** Spatial interpolation based on several known values at arbitrary locations.
- */
+ *
+ * By default every known value contributes to every query. When a neighbour
+ * count or a cutoff radius is set, the known values are bucketed in a uniform
+ * grid over their x and y coordinates, and only the nearest ones are visited,
+ * so that the cost of a query does not depend on the total number of known
+ * values anymore. */
 template <typename T_Pts, typename T_Data> class IDWInterpolator {
 public:
     typedef std::pair<T_Pts, T_Data> DataPoint;
@@ -57,43 +86,50 @@ public:
 
     void setP(int p) { _p = p; }
 
+    /** Only the given number of nearest known values are used to
+     * compute each query. 0 means all of them. */
+    void setNeighbourCount(int k) { _k = k; }
+
+    void setRadius(double radius) { _radius = radius; }
+
     void setData(const std::vector<DataPoint> data) {
         _data = std::vector<DataPoint>(data);
+        _gridDirty = true;
     }
 
-    void addData(T_Pts pt, T_Data data) { _data.emplace_back(pt, data); }
+    void addData(T_Pts pt, T_Data data) {
+        _data.emplace_back(pt, data);
+        _gridDirty = true;
+    }
 
-    T_Data getData(const T_Pts pt) const {
-        T_Data sum; // TODO = T_Data::zero();
-        double wSum = 0;
+    T_Data getData(const T_Pts pt) const;
 
-        for (const DataPoint &dp : _data) {
-            auto length = T_Pts::length(pt, dp.first);
+private:
+    int _p;
+    double _radius;
+    int _k = 0;
+    std::vector<DataPoint> _data;
 
-            if (length < std::numeric_limits<decltype(length)>::epsilon()) {
-                return dp.second;
-            } else {
-                double weight = length < _radius ? powi(length, -_p) : 0;
+    // Spatial index
+    mutable bool _gridDirty = true;
+    mutable double _cellSize;
+    mutable double _gridMinX, _gridMinY;
+    mutable int _gridWidth, _gridHeight;
+    /** Start of each cell in _cellPoints, with a last element equal to
+     * _data.size() */
+    mutable std::vector<u32> _cellStarts;
+    mutable std::vector<u32> _cellPoints;
 
-                wSum = wSum + weight;
-                sum = sum + dp.second * weight;
-            }
-        }
+    bool useGrid() const;
 
-        if (wSum < std::numeric_limits<double>::epsilon()) {
-            // Soit il n'y a pas de points, soit on en est trop loin. Dans les
-            // deux cas, on retourne 0.
-            return sum;
-        }
+    void buildGrid() const;
 
-        return sum * (1 / wSum);
-    }
+    T_Data getDataBruteForce(const T_Pts &pt) const;
 
-private:
-    int _p;
-    double _radius;
-    std::vector<DataPoint> _data;
+    T_Data getDataGrid(const T_Pts &pt) const;
 };
 } // namespace world
 
+#include "Interpolation.inl"
+
 #endif // WORLD_INTERPOLATION_H
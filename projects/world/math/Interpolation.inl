@@ -0,0 +1,220 @@
+#include "Interpolation.h"
+
+namespace world {
+
+template <typename T_Pts, typename T_Data>
+T_Data IDWInterpolator<T_Pts, T_Data>::getData(const T_Pts pt) const {
+    if (useGrid()) {
+        return getDataGrid(pt);
+    } else {
+        return getDataBruteForce(pt);
+    }
+}
+
+template <typename T_Pts, typename T_Data>
+bool IDWInterpolator<T_Pts, T_Data>::useGrid() const {
+    if (_data.empty()) {
+        return false;
+    }
+
+    if (_gridDirty) {
+        buildGrid();
+    }
+
+    if (_k > 0) {
+        return true;
+    }
+
+    // The radius only culls known values if it is smaller than the span of
+    // the grid
+    const double span =
+        std::max(_gridWidth, _gridHeight) * _cellSize + _cellSize;
+    return _radius < span;
+}
+
+template <typename T_Pts, typename T_Data>
+void IDWInterpolator<T_Pts, T_Data>::buildGrid() const {
+    double minX = std::numeric_limits<double>::max(), maxX = -minX;
+    double minY = minX, maxY = maxX;
+
+    for (const DataPoint &dp : _data) {
+        minX = std::min(minX, (double)dp.first.x);
+        maxX = std::max(maxX, (double)dp.first.x);
+        minY = std::min(minY, (double)dp.first.y);
+        maxY = std::max(maxY, (double)dp.first.y);
+    }
+
+    // Around 2 points per cell if the points are evenly distributed
+    const double n = static_cast<double>(_data.size());
+    const double extX = maxX - minX, extY = maxY - minY;
+    const double area = extX * extY;
+    double cellSize = area > 0 ? sqrt(area * 2 / n) : std::max(extX, extY) / n;
+
+    if (!(cellSize > 0)) {
+        cellSize = 1;
+    }
+
+    // Nearly colinear points have almost no area, which would give tiny cells
+    // along the longest side. The grid is limited to a few times sqrt(n)
+    // cells on each axis.
+    const double maxCells = std::max(1.0, ceil(sqrt(n) * 4));
+    cellSize = std::max(cellSize, std::max(extX, extY) / maxCells);
+
+    _cellSize = cellSize;
+    _gridMinX = minX;
+    _gridMinY = minY;
+    _gridWidth = static_cast<int>(extX / cellSize) + 1;
+    _gridHeight = static_cast<int>(extY / cellSize) + 1;
+
+    // Counting sort of the points in their cells
+    const size_t cellCount = size_t(_gridWidth) * _gridHeight;
+    std::vector<u32> cellIds(_data.size());
+    _cellStarts.assign(cellCount + 1, 0);
+
+    for (size_t i = 0; i < _data.size(); ++i) {
+        const T_Pts &p = _data[i].first;
+        int cx = clamp(int((p.x - minX) / cellSize), 0, _gridWidth - 1);
+        int cy = clamp(int((p.y - minY) / cellSize), 0, _gridHeight - 1);
+        cellIds[i] = u32(cy * _gridWidth + cx);
+        ++_cellStarts[cellIds[i] + 1];
+    }
+
+    for (size_t c = 0; c < cellCount; ++c) {
+        _cellStarts[c + 1] += _cellStarts[c];
+    }
+
+    std::vector<u32> fill(_cellStarts.begin(), _cellStarts.end() - 1);
+    _cellPoints.resize(_data.size());
+
+    for (size_t i = 0; i < _data.size(); ++i) {
+        _cellPoints[fill[cellIds[i]]++] = u32(i);
+    }
+
+    _gridDirty = false;
+}
+
+template <typename T_Pts, typename T_Data>
+T_Data IDWInterpolator<T_Pts, T_Data>::getDataBruteForce(
+    const T_Pts &pt) const {
+    T_Data sum; // TODO = T_Data::zero();
+    double wSum = 0;
+
+    for (const DataPoint &dp : _data) {
+        auto length = T_Pts::length(pt, dp.first);
+
+        if (length < std::numeric_limits<decltype(length)>::epsilon()) {
+            return dp.second;
+        } else {
+            double weight = length < _radius ? powi(length, -_p) : 0;
+
+            wSum = wSum + weight;
+            sum = sum + dp.second * weight;
+        }
+    }
+
+    if (wSum < std::numeric_limits<double>::epsilon()) {
+        // Soit il n'y a pas de points, soit on en est trop loin. Dans les
+        // deux cas, on retourne 0.
+        return sum;
+    }
+
+    return sum * (1 / wSum);
+}
+
+template <typename T_Pts, typename T_Data>
+T_Data IDWInterpolator<T_Pts, T_Data>::getDataGrid(const T_Pts &pt) const {
+    // The query is clamped to the grid. A known value in a cell at ring r
+    // around the query cell is then at least (r - 1) * cellSize away.
+    const int qx = clamp(int(floor((pt.x - _gridMinX) / _cellSize)), 0,
+                         _gridWidth - 1);
+    const int qy = clamp(int(floor((pt.y - _gridMinY) / _cellSize)), 0,
+                         _gridHeight - 1);
+    const int maxRing = std::max(_gridWidth, _gridHeight);
+
+    // Max-heap on distance of the k nearest known values. Without k, all the
+    // values in the radius are kept.
+    typedef std::pair<double, u32> Neighbour;
+    std::vector<Neighbour> neighbours;
+    const size_t k = _k > 0 ? size_t(_k) : _data.size();
+
+    auto visitCell = [&](int cx, int cy) -> bool {
+        const size_t cell = size_t(cy) * _gridWidth + cx;
+
+        for (u32 i = _cellStarts[cell]; i < _cellStarts[cell + 1]; ++i) {
+            const u32 id = _cellPoints[i];
+            const double length = T_Pts::length(pt, _data[id].first);
+
+            if (length < std::numeric_limits<double>::epsilon()) {
+                neighbours.assign(1, {length, id});
+                return true;
+            }
+
+            if (length >= _radius) {
+                continue;
+            } else if (neighbours.size() < k) {
+                neighbours.emplace_back(length, id);
+                std::push_heap(neighbours.begin(), neighbours.end());
+            } else if (length < neighbours.front().first) {
+                std::pop_heap(neighbours.begin(), neighbours.end());
+                neighbours.back() = {length, id};
+                std::push_heap(neighbours.begin(), neighbours.end());
+            }
+        }
+        return false;
+    };
+
+    for (int r = 0; r <= maxRing; ++r) {
+        const int xmin = std::max(qx - r, 0);
+        const int xmax = std::min(qx + r, _gridWidth - 1);
+        bool exact = false;
+
+        for (int cx = xmin; cx <= xmax && !exact; ++cx) {
+            if (cx == qx - r || cx == qx + r) {
+                const int ymin = std::max(qy - r, 0);
+                const int ymax = std::min(qy + r, _gridHeight - 1);
+
+                for (int cy = ymin; cy <= ymax && !exact; ++cy) {
+                    exact = visitCell(cx, cy);
+                }
+            } else {
+                if (qy - r >= 0) {
+                    exact = visitCell(cx, qy - r);
+                }
+                if (!exact && qy + r < _gridHeight) {
+                    exact = visitCell(cx, qy + r);
+                }
+            }
+        }
+
+        if (exact) {
+            return _data[neighbours.front().second].second;
+        }
+
+        // Next ring is at least r * cellSize away
+        double cutoff = _radius;
+
+        if (neighbours.size() == k) {
+            cutoff = std::min(cutoff, neighbours.front().first);
+        }
+
+        if (r * _cellSize >= cutoff) {
+            break;
+        }
+    }
+
+    T_Data sum;
+    double wSum = 0;
+
+    for (const Neighbour &n : neighbours) {
+        double weight = powi(n.first, -_p);
+        wSum = wSum + weight;
+        sum = sum + _data[n.second].second * weight;
+    }
+
+    if (wSum < std::numeric_limits<double>::epsilon()) {
+        return sum;
+    }
+
+    return sum * (1 / wSum);
+}
+} // namespace world
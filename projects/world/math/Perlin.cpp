@@ -10,6 +10,7 @@
 
 #include "MathsHelper.h"
 #include "Interpolation.h"
+#include "RandomHelper.h"
 
 using namespace arma;
 
@@ -21,7 +22,8 @@ Perlin::modifier Perlin::DEFAULT_MODIFIER = [](double, double, double val) {
     return val;
 };
 
-std::vector<double> getCoefs(int octaves, double persistence, bool normalize) {
+std::vector<double> Perlin::getCoefs(int octaves, double persistence,
+                                     bool normalize) {
     std::vector<double> coefs;
 
     double persistenceSum = 0;
@@ -40,7 +42,7 @@ std::vector<double> getCoefs(int octaves, double persistence, bool normalize) {
     return coefs;
 }
 
-int getOffset(int offset, int octave, const PerlinInfo &info) {
+int Perlin::getOffset(int offset, int octave, const PerlinInfo &info) {
     if (octave >= info.reference) {
         return offset * powi(2, octave - info.reference);
     } else {
@@ -49,14 +51,39 @@ int getOffset(int offset, int octave, const PerlinInfo &info) {
     }
 }
 
-double getOffsetf(int offset, int octave, const PerlinInfo &info) {
+double Perlin::getOffsetf(int offset, int octave, const PerlinInfo &info) {
     double rawOffset = offset * powi(2., octave - info.reference);
     return rawOffset - floor(rawOffset);
 }
 
+inline double gradientDot(u32 hash, double x, double y) {
+    const double d = M_SQRT1_2;
+
+    switch (hash & 7u) {
+    case 0:
+        return x;
+    case 1:
+        return -x;
+    case 2:
+        return y;
+    case 3:
+        return -y;
+    case 4:
+        return (x + y) * d;
+    case 5:
+        return (-x + y) * d;
+    case 6:
+        return (x - y) * d;
+    default:
+        return (-x - y) * d;
+    }
+}
+
+inline double fade(double t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+
 Perlin::Perlin() : Perlin::Perlin(static_cast<long>(time(NULL))) {}
 
-Perlin::Perlin(long seed) : _rng(seed) {
+Perlin::Perlin(long seed) : _seed(static_cast<u32>(seed)), _rng(seed) {
     for (u32 i = 0; i < 256; ++i) {
         _hash[i] = static_cast<u8>(i);
     }
@@ -94,82 +121,78 @@ void Perlin::growBuffer(arma::uword size) {
     }
 }
 
-void Perlin::fillBuffer(int octave, const PerlinInfo &info,
-                        const modifier &sourceModifier) {
-
-    double localFreq = info.frequency * powi(2., octave - info.reference);
-    u32 fi = static_cast<u32>(ceil(localFreq));
-    growBuffer(fi + 1);
-
-    int offX = getOffset(info.offsetX, octave, info);
-    int offY = getOffset(info.offsetY, octave, info);
+void Perlin::generatePerlinNoise2D(arma::Mat<double> &output,
+                                   const PerlinInfo &info) {
+    generatePerlinNoise2D(output, info, Identity());
+}
 
-    // Fill buffer
-    for (u32 y = 0; y <= fi; y++) {
-        for (u32 x = 0; x <= fi; x++) {
-            u32 px = static_cast<u32>(x + offX) & 0xFFu;
-            u32 py = static_cast<u32>(y + offY) & 0xFFu;
-            double val = _hash[px + _hash[py + _hash[octave]]] / 255.;
+void Perlin::generatePerlinNoise2D(Mat<double> &output, const PerlinInfo &info,
+                                   const modifier &sourceModifier) {
+    generatePerlinNoise2D<modifier>(output, info, sourceModifier);
+}
 
-            if (info.repeatable) {
-                if (x == fi) {
-                    val = _buffer(0, y);
-                } else if (y == fi) {
-                    val = _buffer(x, 0);
-                }
-            }
+Mat<double> Perlin::generatePerlinNoise2D(int size, const PerlinInfo &info) {
 
-            _buffer(x, y) = sourceModifier((double)x / fi, (double)y / fi, val);
-        }
-    }
+    Mat<double> result((uword)size, (uword)size);
+    generatePerlinNoise2D(result, info);
+    return result;
 }
 
-void Perlin::generatePerlinOctave(arma::Mat<double> &output, int octave,
-                                  const PerlinInfo &info,
-                                  const modifier &sourceModifier) {
+double Perlin::gradientNoise(double x, double y, int octave) const {
+    const u32 seed = _seed + static_cast<u32>(octave) * 0x9E3779B9u;
+
+    // Gradient noise is 0.5 on its lattice points. The lattice of each octave
+    // is shifted by a fraction of a cell, so that the lattices of the octaves
+    // do not line up on a regular grid of identical values.
+    const u32 shift = hashCell(octave, -1, seed);
+    x += 0.25 + 0.5 * (shift & 0xFFFFu) / 65536.;
+    y += 0.25 + 0.5 * (shift >> 16) / 65536.;
+
+    const double fx = floor(x);
+    const double fy = floor(y);
+    const s64 ix = static_cast<s64>(fx);
+    const s64 iy = static_cast<s64>(fy);
+    const double dx = x - fx;
+    const double dy = y - fy;
+
+    const double n00 = gradientDot(hashCell(ix, iy, seed), dx, dy);
+    const double n10 = gradientDot(hashCell(ix + 1, iy, seed), dx - 1, dy);
+    const double n01 = gradientDot(hashCell(ix, iy + 1, seed), dx, dy - 1);
+    const double n11 =
+        gradientDot(hashCell(ix + 1, iy + 1, seed), dx - 1, dy - 1);
+
+    const double u = fade(dx);
+    const double v = fade(dy);
+    const double nx0 = n00 + u * (n10 - n00);
+    const double nx1 = n01 + u * (n11 - n01);
+
+    // Gradient noise with unit gradients is in [-sqrt(2)/2, sqrt(2)/2], but
+    // it rarely goes beyond [-0.5, 0.5]. Values are not rescaled so that the
+    // variance stays close to the variance of the value noise.
+    return 0.5 + (nx0 + v * (nx1 - nx0));
+}
 
-    fillBuffer(octave, info, sourceModifier);
+void Perlin::generateGradientOctave(arma::Mat<double> &output, int octave,
+                                    const PerlinInfo &info) {
+    const double scale = powi(2., octave - info.reference);
+    const double f = info.frequency * scale;
+    const double offX = info.offsetX * scale;
+    const double offY = info.offsetY * scale;
 
-    const double f = info.frequency * powi(2., octave - info.reference);
-    const double offXf = getOffsetf(info.offsetX, octave, info);
-    const double offYf = getOffsetf(info.offsetY, octave, info);
+    const double stepX = f / (output.n_rows - 1);
+    const double stepY = f / (output.n_cols - 1);
 
-    // Build octave
     for (u32 y = 0; y < output.n_cols; y++) {
+        const double yd = offY + y * stepY;
+
         for (u32 x = 0; x < output.n_rows; x++) {
-            double xd = f * x / (output.n_rows - 1) + offXf;
-            double yd = f * y / (output.n_cols - 1) + offYf;
-
-            // Bounds
-            int borneX1 = static_cast<int>(floor(xd));
-            int borneY1 = static_cast<int>(floor(yd));
-            int borneX2 = static_cast<int>(ceil(xd));
-            int borneY2 = static_cast<int>(ceil(yd));
-
-            // Interpolation
-            double v1 = Interpolation::interpolateCosine(
-                borneX1, _buffer(borneX1, borneY1), borneX2,
-                _buffer(borneX2, borneY1), xd);
-
-            double v2 = Interpolation::interpolateCosine(
-                borneX1, _buffer(borneX1, borneY2), borneX2,
-                _buffer(borneX2, borneY2), xd);
-
-            output(x, y) =
-                Interpolation::interpolateCosine(borneY1, v1, borneY2, v2, yd);
+            output(x, y) = gradientNoise(offX + x * stepX, yd, octave);
         }
     }
 }
 
-void Perlin::generatePerlinNoise2D(arma::Mat<double> &output,
-                                   const PerlinInfo &info) {
-    generatePerlinNoise2D(output, info, DEFAULT_MODIFIER);
-}
-
-void Perlin::generatePerlinNoise2D(Mat<double> &output, const PerlinInfo &info,
-                                   const modifier &sourceModifier) {
-
-    // Dtermination de la taille de la matrice
+void Perlin::generateGradientNoise2D(arma::Mat<double> &output,
+                                     const PerlinInfo &info) {
     const uword size = std::min(output.n_rows, output.n_cols);
 
     output.fill(0);
@@ -179,16 +202,9 @@ void Perlin::generatePerlinNoise2D(Mat<double> &output, const PerlinInfo &info,
 
     Mat<double> octave(size, size);
     for (int i = 0; i < info.octaves; i++) {
-        generatePerlinOctave(octave, i, info, sourceModifier);
+        generateGradientOctave(octave, i, info);
         output += octave * coefs[i];
     }
 }
 
-Mat<double> Perlin::generatePerlinNoise2D(int size, const PerlinInfo &info) {
-
-    Mat<double> result((uword)size, (uword)size);
-    generatePerlinNoise2D(result, info);
-    return result;
-}
-
 } // namespace world
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <armadillo/armadillo>
 
 #include "world/core/WorldTypes.h"
+#include "Interpolation.h"
 
 namespace perlin {
 enum class WORLDAPI_EXPORT Direction {
@@ -47,6 +48,28 @@ public:
 
     static modifier DEFAULT_MODIFIER;
 
+    // Modifiers that can be given as template parameter to
+    // generatePerlinNoise2D. They are applied on the random values of the
+    // lattice, which are between 0 and 1.
+
+    struct Identity {
+        double operator()(double, double, double val) const { return val; }
+    };
+
+    /** Distance to the middle value, scaled to [0, 1]. */
+    struct Abs {
+        double operator()(double, double, double val) const {
+            return std::abs(2 * val - 1);
+        }
+    };
+
+    /** Inverse of Abs, gives sharp crests at middle values. */
+    struct Ridged {
+        double operator()(double, double, double val) const {
+            return 1 - std::abs(2 * val - 1);
+        }
+    };
+
     Perlin();
 
     Perlin(long seed);
@@ -66,12 +89,47 @@ public:
     void generatePerlinNoise2D(arma::Mat<double> &output,
                                const PerlinInfo &info);
 
+    /** Generate perlin noise using a std::function modifier. This is slower
+     * than the template version, prefer the latter when the modifier type is
+     * known at compile time. */
     void generatePerlinNoise2D(arma::Mat<double> &output,
                                const PerlinInfo &info,
                                const modifier &sourceModifier);
 
+    /** Generate perlin noise with the modifier and the interpolation
+     * function given as functors, so that they can be inlined in the
+     * generation loops.
+     * @param sourceModifier functor with signature
+     * double(double x, double y, double value)
+     * @param interp functor with signature double(double t), see for
+     * example Interpolation::Cosine */
+    template <typename Modifier, typename Interp = Interpolation::Cosine>
+    void generatePerlinNoise2D(arma::Mat<double> &output,
+                               const PerlinInfo &info,
+                               const Modifier &sourceModifier,
+                               const Interp &interp = Interp());
+
     arma::Mat<double> generatePerlinNoise2D(int size, const PerlinInfo &info);
 
+    /** Generate gradient noise on a globally continuous lattice. Each
+     * octave has its own lattice covering the whole plane, and lattice
+     * gradients are obtained by hashing absolute lattice coordinates.
+     * Thus two matrices generated with different offsets or references
+     * always match where they overlap, and any tile can be generated
+     * independently of its neighbours. `repeatable` is ignored.
+     *
+     * Each octave is centered on 0.5 and has about the same variance as
+     * the octaves of generatePerlinNoise2D, so this method can replace it
+     * without changing the parameters. */
+    void generateGradientNoise2D(arma::Mat<double> &output,
+                                 const PerlinInfo &info);
+
+    /** Evaluate one octave of the gradient noise at the given lattice
+     * coordinates. The lattice of each octave is shifted by a fraction of a
+     * cell, which depends on the seed and on the octave. Result is almost
+     * always in [0, 1]. */
+    double gradientNoise(double x, double y, int octave) const;
+
     std::vector<u8> getHash() const;
 
 private:
@@ -79,6 +137,7 @@ private:
     bool _normalize = true;
 
     // Internal fields
+    u32 _seed;
     std::mt19937 _rng;
     u8 _hash[512];
 
@@ -87,11 +146,26 @@ private:
 
     void growBuffer(arma::uword size);
 
+    template <typename Modifier>
     void fillBuffer(int octave, const PerlinInfo &info,
-                    const modifier &sourceModifier);
+                    const Modifier &sourceModifier);
 
+    template <typename Modifier, typename Interp>
     void generatePerlinOctave(arma::Mat<double> &output, int octave,
                               const PerlinInfo &info,
-                              const modifier &sourceModifier);
+                              const Modifier &sourceModifier,
+                              const Interp &interp);
+
+    void generateGradientOctave(arma::Mat<double> &output, int octave,
+                                const PerlinInfo &info);
+
+    static std::vector<double> getCoefs(int octaves, double persistence,
+                                        bool normalize);
+
+    static int getOffset(int offset, int octave, const PerlinInfo &info);
+
+    static double getOffsetf(int offset, int octave, const PerlinInfo &info);
 };
 } // namespace world
+
+#include "Perlin.inl"
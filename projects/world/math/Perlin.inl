@@ -0,0 +1,118 @@
+#include "Perlin.h"
+
+namespace world {
+
+template <typename Modifier, typename Interp>
+void Perlin::generatePerlinNoise2D(arma::Mat<double> &output,
+                                   const PerlinInfo &info,
+                                   const Modifier &sourceModifier,
+                                   const Interp &interp) {
+
+    const arma::uword size = std::min(output.n_rows, output.n_cols);
+
+    output.fill(0);
+
+    std::vector<double> coefs =
+        getCoefs(info.octaves, info.persistence, _normalize);
+
+    arma::Mat<double> octave(size, size);
+    for (int i = 0; i < info.octaves; i++) {
+        generatePerlinOctave(octave, i, info, sourceModifier, interp);
+        output += octave * coefs[i];
+    }
+}
+
+template <typename Modifier>
+void Perlin::fillBuffer(int octave, const PerlinInfo &info,
+                        const Modifier &sourceModifier) {
+
+    double localFreq = info.frequency * powi(2., octave - info.reference);
+    u32 fi = static_cast<u32>(ceil(localFreq));
+    growBuffer(fi + 1);
+
+    int offX = getOffset(info.offsetX, octave, info);
+    int offY = getOffset(info.offsetY, octave, info);
+
+    // Fill buffer
+    for (u32 y = 0; y <= fi; y++) {
+        for (u32 x = 0; x <= fi; x++) {
+            u32 px = static_cast<u32>(x + offX) & 0xFFu;
+            u32 py = static_cast<u32>(y + offY) & 0xFFu;
+            double val = _hash[px + _hash[py + _hash[octave]]] / 255.;
+
+            if (info.repeatable) {
+                if (x == fi) {
+                    val = _buffer(0, y);
+                } else if (y == fi) {
+                    val = _buffer(x, 0);
+                }
+            }
+
+            _buffer.at(x, y) =
+                sourceModifier((double)x / fi, (double)y / fi, val);
+        }
+    }
+}
+
+template <typename Modifier, typename Interp>
+void Perlin::generatePerlinOctave(arma::Mat<double> &output, int octave,
+                                  const PerlinInfo &info,
+                                  const Modifier &sourceModifier,
+                                  const Interp &interp) {
+
+    fillBuffer(octave, info, sourceModifier);
+
+    const double f = info.frequency * powi(2., octave - info.reference);
+    const double offXf = getOffsetf(info.offsetX, octave, info);
+    const double offYf = getOffsetf(info.offsetY, octave, info);
+
+    // Bounds and interpolation weights only depend on one coordinate, so they
+    // are computed once per line and once per column.
+    struct Bounds {
+        arma::uword _b1;
+        arma::uword _b2;
+        double _w;
+    };
+
+    auto getBounds = [&](u32 i, arma::uword count, double offset) {
+        double d = f * i / (count - 1) + offset;
+        double b1 = floor(d);
+        double b2 = ceil(d);
+        double w = b2 - b1 < std::numeric_limits<double>::epsilon()
+                       ? 0
+                       : interp(clamp(d - b1, 0, 1));
+        return Bounds{static_cast<arma::uword>(b1),
+                      static_cast<arma::uword>(b2), w};
+    };
+
+    std::vector<Bounds> xBounds(output.n_rows);
+
+    for (u32 x = 0; x < output.n_rows; x++) {
+        xBounds[x] = getBounds(x, output.n_rows, offXf);
+    }
+
+    // Bounds are increasing, so checking the last ones is enough
+    if (xBounds.back()._b2 >= _buffer.n_rows ||
+        getBounds(output.n_cols - 1, output.n_cols, offYf)._b2 >=
+            _buffer.n_cols) {
+        throw std::out_of_range("Perlin: lattice index out of bounds");
+    }
+
+    // Build octave
+    for (u32 y = 0; y < output.n_cols; y++) {
+        const Bounds yb = getBounds(y, output.n_cols, offYf);
+        const double *col1 = _buffer.colptr(yb._b1);
+        const double *col2 = _buffer.colptr(yb._b2);
+        double *out = output.colptr(y);
+
+        for (u32 x = 0; x < output.n_rows; x++) {
+            const Bounds &xb = xBounds[x];
+
+            double v1 = col1[xb._b2] * xb._w + col1[xb._b1] * (1 - xb._w);
+            double v2 = col2[xb._b2] * xb._w + col2[xb._b1] * (1 - xb._w);
+            out[x] = v2 * yb._w + v1 * (1 - yb._w);
+        }
+    }
+}
+
+} // namespace world
@@ -5,10 +5,24 @@
 
 #include <random>
 
+#include "world/core/WorldTypes.h"
 #include "MathsHelper.h"
 
 namespace world {
 
+/** Hash the integer coordinates of a cell, for example a cell of a grid or
+ * of a lattice (finalizer from MurmurHash3). */
+inline u32 hashCell(s64 x, s64 y, u32 seed) {
+    u64 h = static_cast<u64>(x) * 0x9E3779B97F4A7C15ull ^
+            static_cast<u64>(y) * 0xC2B2AE3D27D4EB4Full ^ seed;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return static_cast<u32>(h);
+}
+
 /** Scale input value to a random factor. Scale factors near 1 are chosen
  * more often. */
 template <class RNG>
@@ -16,6 +16,7 @@ void Rocks::addRock(const vec3d &position) {
     _rocks.emplace_back();
     generateMesh(_rocks.back().mesh);
     _rocks.back().position = position;
+    updateGeneration();
 }
 
 std::vector<Template> Rocks::collectTemplates(ICollector &collector,
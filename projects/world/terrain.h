@@ -13,6 +13,8 @@
 #include "terrain/AltitudeTexturer.h"
 #include "terrain/SimpleTexturer.h"
 #include "terrain/MapFilteredDistribution.h"
+#include "terrain/MultilayerGroundTexture.h"
+#include "terrain/DefaultTextureProvider.h"
 
 // deprecated
 #include "terrain/TerrainSubdivisionGenerator.h"
@@ -45,19 +45,11 @@ void ApplyParentTerrain::processTile(ITileContext &context) {
     const double parentProp = 1 + _parentOverflow - childProp;
 
     arma::mat bufferParent(res, res);
+    TerrainOps::resampleLinear(parent, {oX, oY}, {ratio, ratio}, bufferParent);
+    bufferParent *= parentProp;
 
-    for (int x = 0; x < res; x++) {
-        for (int y = 0; y < res; y++) {
-            bufferParent(x, y) = parent.getInterpolatedHeight(
-                                     oX + ((double)x / (res - 1)) * ratio,
-                                     oY + ((double)y / (res - 1)) * ratio,
-                                     Interpolation::LINEAR) *
-                                 parentProp;
-
-            // to unapply :
-            // * (unapply ? -1. : 1.)
-        }
-    }
+    // to unapply :
+    // * (unapply ? -1. : 1.)
 
     TerrainOps::multiply(child, childProp);
     TerrainOps::applyOffset(child, bufferParent);
@@ -1,14 +1,28 @@
 #include "DefaultTextureProvider.h"
 
+#include "world/assets/ImageCache.h"
+
 namespace world {
 
 WORLD_REGISTER_CHILD_CLASS(ITextureProvider, DefaultTextureProvider,
                            "DefaultTextureProvider")
 
-DefaultTextureProvider::DefaultTextureProvider(std::string path) {
+DefaultTextureProvider::DefaultTextureProvider(std::string path)
+        : _placeholderColor(0.5, 0.5, 0.5),
+          _placeholder(1, 1, ImageType::RGBA) {
     if (!path.empty()) {
         _cache.setRoot(path);
     }
+    setPlaceholderColor(_placeholderColor);
+}
+
+void DefaultTextureProvider::setBlocking(bool blocking) {
+    _blocking = blocking;
+}
+
+void DefaultTextureProvider::setPlaceholderColor(const Color4d &color) {
+    _placeholderColor = color;
+    _placeholder.rgba(0, 0).setf(color._r, color._g, color._b, color._a);
 }
 
 Image &DefaultTextureProvider::getTexture(int layer, int lod) {
@@ -16,12 +30,68 @@ Image &DefaultTextureProvider::getTexture(int layer, int lod) {
     auto it = _images.find(key);
 
     if (it == _images.end()) {
-        // Lookup cache (crash if image does not exists)
-        std::string imgId = getImageId(layer, lod);
-        it = _images.insert({key, _cache.readImage(imgId)}).first;
+        ImageCache &cache = ImageCache::global();
+        std::shared_ptr<Image> image;
+
+        if (_blocking) {
+            // Throws if image does not exist
+            image = cache.get(getImagePath(layer, lod));
+        } else {
+            image = cache.tryGet(getImagePath(layer, lod));
+        }
+
+        if (!image) {
+            return _placeholder;
+        }
+        it = _images.emplace(key, std::move(image)).first;
+    }
+
+    return *it->second;
+}
+
+bool DefaultTextureProvider::hasTexture(int layer, int lod) {
+    std::pair<int, int> key(layer, lod);
+
+    if (_images.find(key) != _images.end()) {
+        return true;
     }
 
-    return it->second;
+    auto image = ImageCache::global().tryGet(getImagePath(layer, lod));
+
+    if (!image) {
+        return false;
+    }
+    _images.emplace(key, std::move(image));
+    return true;
+}
+
+void DefaultTextureProvider::prefetch(int layer, int lod) {
+    if (_images.find({layer, lod}) == _images.end()) {
+        ImageCache::global().prefetch(getImagePath(layer, lod));
+    }
+}
+
+void DefaultTextureProvider::write(WorldFile &wf) const {
+    ITextureProvider::write(wf);
+    wf.addBool("blocking", _blocking);
+    wf.addStruct("placeholderColor",
+                 vec3d{_placeholderColor._r, _placeholderColor._g,
+                       _placeholderColor._b});
+}
+
+void DefaultTextureProvider::read(const WorldFile &wf) {
+    ITextureProvider::read(wf);
+    wf.readBoolOpt("blocking", _blocking);
+
+    if (wf.hasChild("placeholderColor")) {
+        vec3d color;
+        wf.readStruct("placeholderColor", color);
+        setPlaceholderColor(Color4d(color.x, color.y, color.z));
+    }
+}
+
+std::string DefaultTextureProvider::getImagePath(int layer, int lod) const {
+    return _cache.getPath(getImageId(layer, lod)) + ".png";
 }
 
 } // namespace world
@@ -4,21 +4,49 @@
 #include "world/core/WorldConfig.h"
 
 #include <map>
+#include <memory>
 #include <utility>
 
+#include "world/assets/Color.h"
 #include "MultilayerGroundTexture.h"
 
 namespace world {
 
+/** Reads the textures from png files in the cache directory. The images are
+ * decoded by the global ImageCache, which can start decoding them in the
+ * background when they are prefetched. */
 class WORLDAPI_EXPORT DefaultTextureProvider : public ITextureProvider {
     WORLD_WRITE_SUBCLASS_METHOD
 public:
     DefaultTextureProvider(std::string path = "");
 
+    /** If true, getTexture() waits for the texture to be decoded. Otherwise
+     * (the default) a one pixel placeholder texture is returned until the
+     * texture is decoded, and the tiles textured with the placeholder are
+     * generated again afterwards. */
+    void setBlocking(bool blocking);
+
+    void setPlaceholderColor(const Color4d &color);
+
     Image &getTexture(int layer, int lod) override;
 
+    bool hasTexture(int layer, int lod) override;
+
+    void prefetch(int layer, int lod) override;
+
+    void write(WorldFile &wf) const override;
+
+    void read(const WorldFile &wf) override;
+
 private:
-    std::map<std::pair<int, int>, Image> _images;
+    std::map<std::pair<int, int>, std::shared_ptr<Image>> _images;
+
+    bool _blocking = false;
+    Color4d _placeholderColor;
+    Image _placeholder;
+
+
+    std::string getImagePath(int layer, int lod) const;
 };
 
 } // namespace world
@@ -1,6 +1,15 @@
 #include "HeightmapGround.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
 #include <unordered_map>
 #include <memory>
 #include <list>
@@ -9,6 +18,9 @@
 #include "world/assets/SceneNode.h"
 #include "world/assets/Material.h"
 #include "world/assets/ImageUtils.h"
+#include "world/assets/ImageUpdate.h"
+#include "world/assets/BlockCompression.h"
+#include "world/assets/TextureAtlas.h"
 #include "world/math/MathsHelper.h"
 #include "ApplyParentTerrain.h"
 #include "PerlinTerrainGenerator.h"
@@ -20,6 +32,7 @@
 #include "DiamondSquareTerrain.h"
 #include "world/core/GridStorage.h"
 #include "world/core/GridStorageReducer.h"
+#include "world/core/EpochManager.h"
 #include "MultilayerGroundTexture.h"
 #include "DefaultTextureProvider.h"
 
@@ -42,6 +55,84 @@ struct WorkerEntry {
 using Tile = HeightmapGround::Tile;
 
 
+/** Painting queued by HeightmapGround::paintTexture(). */
+struct PendingPaint {
+    vec2d _origin;
+    vec2d _size;
+    int _minLod;
+    int _maxLod;
+    Image _image;
+
+    PendingPaint(const vec2d &origin, const vec2d &size, int minLod,
+                 int maxLod, const Image &image)
+            : _origin(origin), _size(size), _minLod(minLod), _maxLod(maxLod),
+              _image(image) {}
+};
+
+
+/** Copy of the heights of a generated tile, read by the altitude queries
+ * without locking. It is created once when the tile is generated or edited,
+ * and is never modified once published: edits publish a new copy. */
+struct TerrainSnapshot {
+    Terrain _terrain;
+    /// Set by the readers, so that the tile is not evicted while they use it
+    mutable std::atomic_bool _accessed{false};
+
+    explicit TerrainSnapshot(const Terrain &terrain)
+            : _terrain(terrain.getResolution()) {
+        const int res = terrain.getResolution();
+
+        for (int y = 0; y < res; ++y) {
+            for (int x = 0; x < res; ++x) {
+                _terrain(x, y) = terrain(x, y);
+            }
+        }
+    }
+};
+
+
+/** Index of the terrain snapshots read by the altitude queries. The tiles
+ * are spread in buckets, and each bucket is immutable once published: when
+ * tiles are generated, edited or evicted, only their buckets are copied and
+ * replaced. The snapshots of the other tiles are shared by the copies. */
+struct GroundIndex {
+    using Bucket =
+        std::map<TileCoordinates, std::shared_ptr<const TerrainSnapshot>>;
+
+    static const int BUCKET_COUNT = 64;
+
+    std::atomic<const Bucket *> _buckets[BUCKET_COUNT];
+
+    GroundIndex() {
+        for (auto &bucket : _buckets) {
+            bucket.store(new Bucket());
+        }
+    }
+
+    ~GroundIndex() {
+        for (auto &bucket : _buckets) {
+            delete bucket.load();
+        }
+    }
+
+    static int getBucket(const TileCoordinates &key) {
+        // The low bits of the hash of TileCoordinates are constant, so they
+        // are mixed with the high bits
+        u64 h = std::hash<TileCoordinates>()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return static_cast<int>(h % BUCKET_COUNT);
+    }
+
+    const TerrainSnapshot *find(const TileCoordinates &key) const {
+        const Bucket &bucket = *_buckets[getBucket(key)].load();
+        auto it = bucket.find(key);
+        return it == bucket.end() ? nullptr : it->second.get();
+    }
+};
+
+
 // Utility class
 class GroundContext : public ITileContext {
 public:
@@ -68,12 +159,105 @@ public:
         _terrains.setReducer(&_reducer);
     }
 
+    /// Lock of the writers: collect, edits, paintings, and the queries that
+    /// generate tiles other than the altitude queries.
+    std::mutex _mutex;
+    /// Lock of the tiles, the workers and the reducer. The writers take it
+    /// to access the tiles, and the altitude queries to generate a missing
+    /// tile. collect() takes it lod after lod and tile after tile, so that
+    /// the altitude queries do not wait for the whole collect.
+    std::mutex _tilesMutex;
+    /// Tiles being generated for the altitude queries. The queries missing
+    /// the same tile wait for the same generation.
+    std::mutex _pendingMutex;
+    std::map<TileCoordinates, std::shared_future<void>> _pendingTiles;
+
     GridStorageReducer _reducer;
     GridStorage<HeightmapGroundTile> _terrains;
     std::list<WorkerEntry> _generators;
+
+    std::unique_ptr<TextureAtlas> _atlas;
+
+    std::vector<PendingPaint> _pendingPaints;
+    /// Rectangle of each tile texture modified since it was last emitted
+    std::map<TileCoordinates, ImageRect> _dirtyTextures;
+    /// Compressed atlas pages, with their mip levels. Only the blocks in the
+    /// rectangle changed since a page was compressed are compressed again.
+    std::map<int, Image> _compressedPages;
+    /// Rectangle of each compressed page changed since it was compressed
+    std::map<int, ImageRect> _uncompressedRects;
+
+    /// Height delta of the edited tiles, added to the generated terrains
+    std::map<TileCoordinates, arma::mat> _heightDeltas;
+    /// Tiles whose mesh changed since it was last emitted
+    std::set<TileCoordinates> _dirtyMeshes;
+    /// Rectangle of the last update put for each texture. If the update
+    /// channel still holds this update when the texture is updated again,
+    /// both rectangles are merged in the new update, which replaces it.
+    std::map<ItemKey, ImageRect> _pendingUpdates;
+
+    EpochManager _epochs;
+    /// Index read by the altitude queries. The replaced buckets are deleted
+    /// by _epochs after a grace period.
+    GroundIndex _index;
+    /// Tiles generated or edited since the index was last published
+    std::set<TileCoordinates> _unpublished;
+    /// Count of height edits, read without locking
+    std::atomic<u64> _editEpoch{0};
+    /// Lock of the edit history, which is read without the other locks
+    mutable std::mutex _editsMutex;
+    /// Bounds of the last height edits, with the edit epoch they lead to
+    std::deque<std::pair<u64, BoundingBox>> _edits;
 };
 
 
+/** Call f(key, x, y, position) for each point between min and max of the
+ * terrains at the given lod. Points on the border of a tile are also the
+ * points of the neighbour tile, and are visited once for each tile. */
+template <typename F>
+static void forEachTerrainPoint(const TileSystem &tileSystem, int terrainRes,
+                                int lod, const vec2d &min, const vec2d &max,
+                                F f) {
+    const TileCoordinates tileMin =
+        tileSystem.getTileCoordinates({min.x, min.y, 0}, lod);
+    const TileCoordinates tileMax =
+        tileSystem.getTileCoordinates({max.x, max.y, 0}, lod);
+    const vec3d tileSize = tileSystem.getTileSize(lod);
+    const double spacing = tileSize.x / (terrainRes - 1);
+
+    auto firstPoint = [&](double v) {
+        return clamp(int(ceil(v / spacing)), 0, terrainRes - 1);
+    };
+    auto lastPoint = [&](double v) {
+        return clamp(int(floor(v / spacing)), 0, terrainRes - 1);
+    };
+
+    // Points on the left and bottom borders belong to the previous tiles
+    for (int tx = tileMin._pos.x - 1; tx <= tileMax._pos.x; ++tx) {
+        for (int ty = tileMin._pos.y - 1; ty <= tileMax._pos.y; ++ty) {
+            TileCoordinates key{tx, ty, 0, lod};
+            const vec3d offset = tileSystem.getTileOffset(key);
+
+            if (min.x > offset.x + tileSize.x ||
+                min.y > offset.y + tileSize.y) {
+                continue;
+            }
+            const int x0 = firstPoint(min.x - offset.x);
+            const int x1 = lastPoint(max.x - offset.x);
+            const int y0 = firstPoint(min.y - offset.y);
+            const int y1 = lastPoint(max.y - offset.y);
+
+            for (int x = x0; x <= x1; ++x) {
+                for (int y = y0; y <= y1; ++y) {
+                    f(key, x, y,
+                      vec2d{offset.x + x * spacing, offset.y + y * spacing});
+                }
+            }
+        }
+    }
+}
+
+
 WORLD_REGISTER_CHILD_CLASS(GroundNode, HeightmapGround, "HeightmapGround")
 
 // Idees d'ameliorations :
@@ -134,12 +318,75 @@ void HeightmapGround::setLodRange(const ITerrainWorker &worker, int minLod,
 double HeightmapGround::observeAltitudeAt(double x, double y,
                                           double resolution) {
     int lvl = _tileSystem.getLod(resolution);
-    return observeAltitudeAt(x, y, lvl);
+    TileCoordinates key = _tileSystem.getTileCoordinates({x, y, 0}, lvl);
+    vec3d inTile = _tileSystem.getLocalCoordinates({x, y, 0}, lvl);
+
+    while (true) {
+        {
+            auto guard = _internal->_epochs.read();
+            const TerrainSnapshot *snapshot = _internal->_index.find(key);
+
+            if (snapshot != nullptr) {
+                snapshot->_accessed.store(true, std::memory_order_relaxed);
+                return _minAltitude + getAltitudeRange() *
+                                          snapshot->_terrain.getExactHeightAt(
+                                              inTile.x, inTile.y);
+            }
+        }
+
+        // The tile is missing, generate it. It is looked up again because
+        // collect() may evict it before this thread reads it.
+        generateMissingTile(key);
+    }
+}
+
+void HeightmapGround::generateMissingTile(const TileCoordinates &key) {
+    std::promise<void> promise;
+    std::shared_future<void> pending;
+    bool generating = false;
+    {
+        std::lock_guard<std::mutex> lock(_internal->_pendingMutex);
+        auto it = _internal->_pendingTiles.find(key);
+
+        if (it == _internal->_pendingTiles.end()) {
+            pending = promise.get_future().share();
+            _internal->_pendingTiles.emplace(key, pending);
+            generating = true;
+        } else {
+            pending = it->second;
+        }
+    }
+
+    if (!generating) {
+        // Rethrows the exception of the generation, if any
+        pending.get();
+        return;
+    }
+
+    try {
+        std::lock_guard<std::mutex> lock(_internal->_tilesMutex);
+        provide(key);
+        publishTerrains();
+        promise.set_value();
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_internal->_pendingMutex);
+        _internal->_pendingTiles.erase(key);
+    }
+    pending.get();
 }
 
 void HeightmapGround::collect(ICollector &collector,
                               const IResolutionModel &resolutionModel,
                               const ExplorationContext &ctx) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    std::unique_lock<std::mutex> tilesLock(_internal->_tilesMutex);
+
+    applyPendingPaints();
+    processOutdatedTiles();
 
     BoundingBox bbox = resolutionModel.getBounds();
 
@@ -158,16 +405,153 @@ void HeightmapGround::collect(ICollector &collector,
     }
 
     addNotGeneratedParents(toGenerate);
-    generateTerrains(toGenerate);
+    tilesLock.unlock();
+
+    // The tiles lock is released between the lods and between the tiles, so
+    // that the altitude queries can generate the tiles they miss meanwhile.
+    std::vector<std::set<TileCoordinates>> lods(_tileSystem._maxLod + 1);
+
+    for (const TileCoordinates &key : toGenerate) {
+        lods[key._lod].insert(key);
+    }
+
+    for (auto &keys : lods) {
+        tilesLock.lock();
+
+        for (auto it = keys.begin(); it != keys.end();) {
+            it = isGenerated(*it) ? keys.erase(it) : std::next(it);
+        }
+        generateTerrains(keys);
+        tilesLock.unlock();
+    }
+
+    if (_internal->_atlas) {
+        // The tiles of the previous frames can leave the atlas again
+        _internal->_atlas->startFrame();
+    }
 
     for (auto &coord : toCollect) {
+        tilesLock.lock();
         addTerrain(coord, collector);
+        tilesLock.unlock();
+    }
+
+    tilesLock.lock();
+
+    if (_internal->_atlas) {
+        addAtlasPages(collector);
+    }
+
+    // Tiles used by the altitude queries are kept as well
+    for (auto &bucket : _internal->_index._buckets) {
+        for (const auto &entry : *bucket.load()) {
+            if (entry.second->_accessed.exchange(false)) {
+                _internal->_reducer.registerAccess(entry.first);
+            }
+        }
     }
 
     // std::cout << "Ground before reducing: " << _internal->_terrains.size();
     _internal->_reducer.reduceStorage();
     // std::cout << ", Ground after reducing: " << _internal->_terrains.size()
     //          << std::endl;
+
+    // Forget the modifications of the evicted tiles
+    auto &dirtyTextures = _internal->_dirtyTextures;
+
+    for (auto it = dirtyTextures.begin(); it != dirtyTextures.end();) {
+        if (_internal->_terrains.has(it->first)) {
+            ++it;
+        } else {
+            it = dirtyTextures.erase(it);
+        }
+    }
+    for (auto it = _internal->_dirtyMeshes.begin();
+         it != _internal->_dirtyMeshes.end();) {
+        if (_internal->_terrains.has(*it)) {
+            ++it;
+        } else {
+            it = _internal->_dirtyMeshes.erase(it);
+        }
+    }
+    // The height deltas of the coarser lods are computed again from the
+    // edits when their tile is generated again, see restoreHeightDelta()
+    auto &heightDeltas = _internal->_heightDeltas;
+
+    for (auto it = heightDeltas.begin(); it != heightDeltas.end();) {
+        if (it->first._lod == _tileSystem._maxLod ||
+            _internal->_terrains.has(it->first)) {
+            ++it;
+        } else {
+            it = heightDeltas.erase(it);
+        }
+    }
+
+    // Forget the updates that the host has consumed
+    auto &pendingUpdates = _internal->_pendingUpdates;
+
+    for (auto it = pendingUpdates.begin(); it != pendingUpdates.end();) {
+        if (collector.hasChannel<ImageUpdate>() &&
+            collector.getChannel<ImageUpdate>().has(it->first)) {
+            ++it;
+        } else {
+            it = pendingUpdates.erase(it);
+        }
+    }
+    publishTerrains();
+}
+
+void HeightmapGround::enableTextureAtlas(int pageRes, int maxPages) {
+    auto atlas =
+        std::make_unique<TextureAtlas>(pageRes, _textureRes, maxPages);
+
+    // The page table stores the page and the slot on 8 bits
+    if (maxPages > 256 || atlas->getSlotsPerRow() > 256) {
+        throw std::invalid_argument(
+            "Atlas has too many pages or slots for the page table");
+    }
+    _atlasPageRes = pageRes;
+    _atlasMaxPages = maxPages;
+    _internal->_atlas = std::move(atlas);
+    _internal->_compressedPages.clear();
+    _internal->_uncompressedRects.clear();
+}
+
+void HeightmapGround::disableTextureAtlas() {
+    _atlasMaxPages = 0;
+    _internal->_atlas.reset();
+    _internal->_compressedPages.clear();
+    _internal->_uncompressedRects.clear();
+}
+
+Image HeightmapGround::createAtlasPageTable(int lod, const vec2i &origin,
+                                            const vec2i &size) const {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    Image pageTable(size.x, size.y, ImageType::RGBA);
+    TextureAtlas *atlas = _internal->_atlas.get();
+
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            TileCoordinates key{origin.x + x, origin.y + y, 0, lod};
+            AtlasSlot slot;
+            auto &pixel = pageTable.rgba(x, y);
+
+            if (atlas != nullptr) {
+                slot = atlas->find(getTerrainDataId(key));
+            }
+
+            if (!slot.isValid()) {
+                pixel.set(0, 0, 0, 0);
+                continue;
+            }
+
+            const int slotSize = atlas->getSlotSize();
+            pixel.set(u8(slot._x / slotSize), u8(slot._y / slotSize),
+                      u8(slot._page), 255);
+        }
+    }
+
+    return pageTable;
 }
 
 void HeightmapGround::paintTexture(const vec2d &origin, const vec2d &size,
@@ -175,31 +559,47 @@ void HeightmapGround::paintTexture(const vec2d &origin, const vec2d &size,
                                    const Image &img) {
     const int minLod = _tileSystem.getLod(resolutionRange.x);
     const int maxLod = _tileSystem.getLod(resolutionRange.y);
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    _internal->_pendingPaints.emplace_back(origin, size, minLod, maxLod, img);
+}
 
-    const vec3d min{origin.x, origin.y, 0};
-    const vec3d max{origin.x + size.x, origin.y + size.y, 0};
-
-    for (int lod = minLod; lod <= maxLod; ++lod) {
-        TileCoordinates tileMin = _tileSystem.getTileCoordinates(min, lod);
-        TileCoordinates tileMax = _tileSystem.getTileCoordinates(max, lod);
-        vec3d localMin = _tileSystem.getLocalCoordinates(min, lod);
-        vec3d localMax = _tileSystem.getLocalCoordinates(max, lod);
-        vec3d tileSize = _tileSystem.getTileSize(lod);
-        vec3i tileDist = tileMax._pos - tileMin._pos;
-
-        vec3d imgSize = tileSize * tileDist + localMax - localMin;
-
-        for (int x = tileMin._pos.x; x <= tileMax._pos.x; ++x) {
-            for (int y = tileMin._pos.y; y <= tileMax._pos.y; ++y) {
-                TileCoordinates current{x, y, 0, lod};
-                vec3d imgCoords =
-                    (tileMin._pos - current._pos) * tileSize + localMin;
-                ImageUtils::paintTexturef(provideTerrain(current).getTexture(),
-                                          img, {imgCoords.x, imgCoords.y},
-                                          {imgSize.x, imgSize.y});
+void HeightmapGround::applyPendingPaints() {
+    for (const PendingPaint &paint : _internal->_pendingPaints) {
+        const vec2d &origin = paint._origin;
+        const vec2d &size = paint._size;
+        const vec3d min{origin.x, origin.y, 0};
+        const vec3d max{origin.x + size.x, origin.y + size.y, 0};
+
+        for (int lod = paint._minLod; lod <= paint._maxLod; ++lod) {
+            TileCoordinates tileMin = _tileSystem.getTileCoordinates(min, lod);
+            TileCoordinates tileMax = _tileSystem.getTileCoordinates(max, lod);
+            vec3d localMin = _tileSystem.getLocalCoordinates(min, lod);
+            vec3d localMax = _tileSystem.getLocalCoordinates(max, lod);
+            vec3d tileSize = _tileSystem.getTileSize(lod);
+            vec3i tileDist = tileMax._pos - tileMin._pos;
+
+            vec3d imgSize = tileSize * tileDist + localMax - localMin;
+
+            for (int x = tileMin._pos.x; x <= tileMax._pos.x; ++x) {
+                for (int y = tileMin._pos.y; y <= tileMax._pos.y; ++y) {
+                    TileCoordinates current{x, y, 0, lod};
+                    vec3d imgCoords =
+                        (tileMin._pos - current._pos) * tileSize + localMin;
+                    Image &texture = provideTerrain(current).getTexture();
+                    ImageRect painted = ImageUtils::paintTexturef(
+                        texture, paint._image, {imgCoords.x, imgCoords.y},
+                        {imgSize.x, imgSize.y});
+
+                    if (!painted.isEmpty()) {
+                        _internal->_dirtyTextures[current].merge(painted);
+                        invalidateTextureMips(current);
+                    }
+                }
             }
         }
     }
+
+    _internal->_pendingPaints.clear();
 }
 
 void HeightmapGround::write(WorldFile &wf) const {
@@ -208,6 +608,11 @@ void HeightmapGround::write(WorldFile &wf) const {
     wf.addInt("terrainRes", _terrainRes);
     wf.addInt("textureRes", _textureRes);
     wf.addInt("texPixSize", _texPixSize);
+    wf.addInt("atlasPageRes", _atlasPageRes);
+    wf.addInt("atlasMaxPages", _atlasMaxPages);
+    wf.addBool("textureCompression", _textureCompression);
+    wf.addBool("textureMips", _textureMips);
+    wf.addInt("mipSeedLevel", _mipSeedLevel);
 
     wf.addStruct("tileSystem", _tileSystem);
 
@@ -216,6 +621,36 @@ void HeightmapGround::write(WorldFile &wf) const {
     for (auto &generator : _internal->_generators) {
         wf.addToArray("workers", generator._worker->serializeSubclass());
     }
+
+    // Only the edits are saved, the deltas of the coarser lods are computed
+    // again from them when the tiles are generated
+    WorldFile editsWf;
+    editsWf.addArray("tiles");
+
+    for (auto &entry : _internal->_heightDeltas) {
+        if (entry.first._lod != _tileSystem._maxLod) {
+            continue;
+        }
+        WorldFile tileWf;
+        tileWf.addInt("x", entry.first._pos.x);
+        tileWf.addInt("y", entry.first._pos.y);
+        tileWf.addArray("points");
+        const arma::mat &delta = entry.second;
+
+        for (u32 y = 0; y < delta.n_cols; ++y) {
+            for (u32 x = 0; x < delta.n_rows; ++x) {
+                if (delta(x, y) != 0) {
+                    WorldFile pointWf;
+                    pointWf.addInt("x", int(x));
+                    pointWf.addInt("y", int(y));
+                    pointWf.addDouble("delta", delta(x, y));
+                    tileWf.addToArray("points", std::move(pointWf));
+                }
+            }
+        }
+        editsWf.addToArray("tiles", std::move(tileWf));
+    }
+    wf.addChild("heightEdits", std::move(editsWf));
 }
 
 void HeightmapGround::read(const WorldFile &wf) {
@@ -225,6 +660,19 @@ void HeightmapGround::read(const WorldFile &wf) {
     wf.readIntOpt("textureRes", _textureRes);
     wf.readIntOpt("texPixSize", _texPixSize);
 
+    int atlasMaxPages = 0;
+    wf.readIntOpt("atlasPageRes", _atlasPageRes);
+    wf.readIntOpt("atlasMaxPages", atlasMaxPages);
+    wf.readBoolOpt("textureCompression", _textureCompression);
+    wf.readBoolOpt("textureMips", _textureMips);
+    wf.readIntOpt("mipSeedLevel", _mipSeedLevel);
+
+    if (atlasMaxPages > 0) {
+        enableTextureAtlas(_atlasPageRes, atlasMaxPages);
+    } else {
+        disableTextureAtlas();
+    }
+
     wf.readStruct("tileSystem", _tileSystem);
     _tileSystem._bufferRes.x = _tileSystem._bufferRes.y =
         _textureRes * _texPixSize;
@@ -235,6 +683,24 @@ void HeightmapGround::read(const WorldFile &wf) {
     for (auto it = wf.readArray("workers"); !it.end(); ++it) {
         addWorkerInternal(readSubclass<ITerrainWorker>(*it));
     }
+
+    _internal->_heightDeltas.clear();
+
+    if (wf.hasChild("heightEdits")) {
+        const WorldFile &editsWf = wf.readChild("heightEdits");
+
+        for (auto it = editsWf.readArray("tiles"); !it.end(); ++it) {
+            TileCoordinates key{it->readInt("x"), it->readInt("y"), 0,
+                                _tileSystem._maxLod};
+            arma::mat delta(_terrainRes, _terrainRes, arma::fill::zeros);
+
+            for (auto pt = (*it).readArray("points"); !pt.end(); ++pt) {
+                delta(pt->readInt("x"), pt->readInt("y")) =
+                    pt->readDouble("delta");
+            }
+            _internal->_heightDeltas.emplace(key, std::move(delta));
+        }
+    }
 }
 
 void HeightmapGround::addWorkerInternal(ITerrainWorker *worker) {
@@ -253,6 +719,118 @@ void HeightmapGround::addWorkerInternal(ITerrainWorker *worker) {
     }
 }
 
+void HeightmapGround::processOutdatedTiles() {
+    for (auto &entry : _internal->_generators) {
+        std::set<TileCoordinates> keys;
+        entry._worker->popOutdatedTiles(keys);
+
+        if (keys.empty()) {
+            continue;
+        }
+        GroundContext context(this, &entry, nullptr);
+
+        for (const TileCoordinates &key : keys) {
+            // The tile may have been evicted since it was processed
+            if (!isGenerated(key)) {
+                continue;
+            }
+            context._tile = &provide(key);
+            entry._worker->processTile(context);
+        }
+        entry._worker->flush();
+
+        for (const TileCoordinates &key : keys) {
+            if (isGenerated(key)) {
+                Image &texture = provideTerrain(key).getTexture();
+                invalidateTextureMips(key);
+                _internal->_dirtyTextures[key].merge(
+                    {0, 0, texture.width(), texture.height()});
+            }
+        }
+    }
+}
+
+void HeightmapGround::observeAltitudesAt(const vec2d *points,
+                                         double *altitudes, size_t count,
+                                         double resolution) {
+    const int lvl = _tileSystem.getLod(resolution);
+
+    // Sort the points by tile
+    std::vector<std::pair<TileCoordinates, size_t>> order;
+    order.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        order.emplace_back(
+            _tileSystem.getTileCoordinates({points[i].x, points[i].y, 0}, lvl),
+            i);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<size_t> misses;
+    {
+        auto guard = _internal->_epochs.read();
+        const GroundIndex &index = _internal->_index;
+
+        for (size_t begin = 0; begin < count;) {
+            const TileCoordinates &key = order[begin].first;
+            const TerrainSnapshot *snapshot = index.find(key);
+            size_t end = begin;
+
+            if (snapshot != nullptr) {
+                snapshot->_accessed.store(true, std::memory_order_relaxed);
+            }
+
+            for (; end < count && order[end].first == key; ++end) {
+                const size_t i = order[end].second;
+
+                if (snapshot == nullptr) {
+                    misses.push_back(i);
+                    continue;
+                }
+                vec3d inTile = _tileSystem.getLocalCoordinates(
+                    {points[i].x, points[i].y, 0}, lvl);
+                altitudes[i] = _minAltitude +
+                               getAltitudeRange() *
+                                   snapshot->_terrain.getExactHeightAt(
+                                       inTile.x, inTile.y);
+            }
+            begin = end;
+        }
+    }
+
+    if (misses.empty()) {
+        return;
+    }
+
+    // Generate the missing tiles
+    for (size_t i : misses) {
+        altitudes[i] = observeAltitudeAt(points[i].x, points[i].y, resolution);
+    }
+}
+
+u64 HeightmapGround::getEditEpoch() const { return _internal->_editEpoch; }
+
+bool HeightmapGround::getEditsSince(u64 epoch,
+                                    std::vector<BoundingBox> &bounds) const {
+    std::lock_guard<std::mutex> lock(_internal->_editsMutex);
+    const auto &edits = _internal->_edits;
+
+    if (epoch == _internal->_editEpoch) {
+        return true;
+    }
+    // The edits following epoch were forgotten
+    if (epoch > _internal->_editEpoch || edits.empty() ||
+        edits.front().first > epoch + 1) {
+        return false;
+    }
+
+    for (const auto &edit : edits) {
+        if (edit.first > epoch) {
+            bounds.push_back(edit.second);
+        }
+    }
+    return true;
+}
+
 double HeightmapGround::observeAltitudeAt(double x, double y, int lvl) {
     TileCoordinates key = _tileSystem.getTileCoordinates({x, y, 0}, lvl);
     vec3d inTile = _tileSystem.getLocalCoordinates({x, y, 0}, lvl);
@@ -264,27 +842,79 @@ double HeightmapGround::observeAltitudeAt(double x, double y, int lvl) {
 
 inline ItemKey terrainToItem(const std::string &key) { return {"_" + key}; }
 
+inline ItemKey atlasPageToItem(int page) {
+    return {"_atlas" + std::to_string(page)};
+}
+
 void HeightmapGround::addTerrain(const TileCoordinates &key,
                                  ICollector &collector) {
-    ItemKey itemKey = terrainToItem(getTerrainDataId(key));
+    const std::string terrainId = getTerrainDataId(key);
+    ItemKey itemKey = terrainToItem(terrainId);
     Terrain &terrain = this->provideTerrain(key);
 
     if (collector.hasChannel<SceneNode>() && collector.hasChannel<Mesh>()) {
 
         auto &objChannel = collector.getChannel<SceneNode>();
-        auto &meshChannel = collector.getChannel<Mesh>();
 
-        if (!objChannel.has(itemKey)) {
+        const bool meshChanged = _internal->_dirtyMeshes.erase(key) != 0;
+        // Painted rectangle of the texture since it was last emitted
+        ImageRect dirty;
+        auto dirtyIt = _internal->_dirtyTextures.find(key);
+
+        if (dirtyIt != _internal->_dirtyTextures.end()) {
+            dirty = dirtyIt->second;
+            _internal->_dirtyTextures.erase(dirtyIt);
+        }
+
+        // In atlas mode, the tile may have to be (re)loaded in the atlas, in
+        // which case its slot changes and the mesh must be emitted again.
+        TextureAtlas *atlas = _internal->_atlas.get();
+        AtlasSlot slot;
+        bool relocated = false;
+
+        if (atlas != nullptr) {
+            slot = atlas->get(terrainId);
+
+            if (!slot.isValid()) {
+                std::string evicted;
+                slot = atlas->put(terrainId, terrain.getTexture(), &evicted);
+                relocated = true;
+
+                if (!evicted.empty()) {
+                    removeTerrain(terrainToItem(evicted), collector);
+                }
+                if (!slot.isValid()) {
+                    // All the slots are used by the tiles of this frame. The
+                    // tile is collected in a later frame.
+                    return;
+                }
+            } else if (!dirty.isEmpty()) {
+                // Only the painted rectangle of the page is emitted again,
+                // see addAtlasPages()
+                atlas->update(terrainId, terrain.getTexture(), dirty);
+            }
+        }
+
+        if (!objChannel.has(itemKey) || relocated) {
             // Relocate the terrain
             auto &bbox = terrain.getBoundingBox();
             vec3d offset = bbox.getLowerBound();
 
-            // Create the mesh
-            meshChannel.put(itemKey, provideMesh(key));
+            putMesh(key, itemKey, slot, collector);
 
             SceneNode object(itemKey.str());
             object.setPosition(offset);
 
+            if (atlas != nullptr) {
+                // Material and texture are shared by all the tiles of the
+                // page, see addAtlasPages()
+                if (collector.hasChannel<Material>()) {
+                    object.setMaterialID(atlasPageToItem(slot._page).str());
+                }
+                objChannel.put(itemKey, object);
+                return;
+            }
+
             // Create the material
             Material material("terrain");
             material.setKd(1, 1, 1);
@@ -299,106 +929,1226 @@ void HeightmapGround::addTerrain(const TileCoordinates &key,
             // Retrieve the texture
             auto &texture = terrain.getTexture();
 
+            if (_textureMips) {
+                provideTextureMips(key);
+            }
+
             if (collector.hasChannel<Material>()) {
                 auto &matChan = collector.getChannel<Material>();
                 object.setMaterialID(itemKey.str());
 
                 if (collector.hasChannel<Image>()) {
-                    auto &imageChan = collector.getChannel<Image>();
                     material.setMapKd(itemKey.str());
-                    imageChan.put(itemKey, texture);
+                    putTexture(itemKey, texture, collector);
                 }
 
                 matChan.put(itemKey, material);
             }
 
             objChannel.put(itemKey, object);
+            return;
         }
-    }
-}
 
-// ==== ACCESS
+        // The height was edited since the tile was collected
+        if (meshChanged) {
+            putMesh(key, itemKey, slot, collector);
+        }
 
-Tile &HeightmapGround::provide(const TileCoordinates &key) {
-    return _internal->_terrains.getOrCreateCallback(
-        key,
-        [this, &key](HeightmapGroundTile &tile) {
-            std::set<TileCoordinates> coords{key};
-            addNotGeneratedParents(coords);
-            generateTerrains(coords);
-        },
-        key, _terrainRes);
-}
+        // The texture was painted since it was collected
+        if (!dirty.isEmpty() && atlas == nullptr &&
+            collector.hasChannel<Material>() && collector.hasChannel<Image>()) {
+            auto &texture = terrain.getTexture();
 
-Terrain &HeightmapGround::provideTerrain(const TileCoordinates &key) {
-    return provide(key)._terrain;
+            if (!putTextureUpdate(itemKey, texture, dirty, collector)) {
+                if (_textureMips) {
+                    provideTextureMips(key);
+                }
+                putTexture(itemKey, texture, collector);
+            }
+        }
+    }
 }
 
-Mesh &HeightmapGround::provideMesh(const TileCoordinates &key) {
-    auto &mesh = provide(key)._mesh;
+void HeightmapGround::putMesh(const TileCoordinates &key,
+                              const ItemKey &itemKey, const AtlasSlot &slot,
+                              ICollector &collector) {
+    auto &meshChannel = collector.getChannel<Mesh>();
 
-    if (mesh.empty()) {
-        generateMesh(key);
-    }
+    if (slot.isValid()) {
+        Mesh mesh = provideMesh(key);
+        TextureAtlas &atlas = *_internal->_atlas;
 
-    return mesh;
+        for (u32 i = 0; i < mesh.getVerticesCount(); ++i) {
+            Vertex &vert = mesh.getVertex(i);
+            vert.setTexture(atlas.transformUV(slot, vert.getTexture()));
+        }
+        meshChannel.put(itemKey, mesh);
+    } else {
+        meshChannel.put(itemKey, provideMesh(key));
+    }
 }
 
-bool HeightmapGround::isGenerated(const TileCoordinates &key) {
-    return _internal->_terrains.has(key);
+void HeightmapGround::removeTerrain(const ItemKey &itemKey,
+                                    ICollector &collector) {
+    if (collector.hasChannel<SceneNode>()) {
+        collector.getChannel<SceneNode>().remove(itemKey);
+    }
+    if (collector.hasChannel<Mesh>()) {
+        collector.getChannel<Mesh>().remove(itemKey);
+    }
 }
 
+void HeightmapGround::addAtlasPages(ICollector &collector) {
+    if (!collector.hasChannel<Material>()) {
+        return;
+    }
 
-std::string HeightmapGround::getTerrainDataId(
-    const TileCoordinates &key) const {
-    u64 id = static_cast<u64>(key._pos.x & 0x0FFFFFFFu) +
-             (static_cast<u64>(key._pos.y & 0x0FFFFFFFu) << 24u) +
-             (static_cast<u64>(key._lod & 0xFFu) << 48u);
-    return std::to_string(id);
-}
+    TextureAtlas &atlas = *_internal->_atlas;
+    auto &matChan = collector.getChannel<Material>();
 
+    for (int page = 0; page < atlas.getPageCount(); ++page) {
+        ItemKey pageKey = atlasPageToItem(page);
+        // Tiles loaded or painted since the page was emitted
+        const ImageRect changed = atlas.takeChangedRect(page);
+        _internal->_uncompressedRects[page].merge(changed);
 
-// ==== GENERATION
-void HeightmapGround::addNotGeneratedParents(std::set<TileCoordinates> &keys) {
-    std::set<TileCoordinates> temp;
+        if (matChan.has(pageKey)) {
+            if (changed.isEmpty() || !collector.hasChannel<Image>() ||
+                putTextureUpdate(pageKey, atlas.getPage(page), changed,
+                                 collector)) {
+                continue;
+            }
+        }
 
-    do {
-        temp.clear();
+        Material material("terrain");
+        material.setKd(1, 1, 1);
+        material.setMapKd("texture01");
 
-        for (const TileCoordinates &key : keys) {
-            if (key._lod != 0) {
-                auto pkey = _tileSystem.getParentTileCoordinates(key);
+        if (collector.hasChannel<Image>()) {
+            material.setMapKd(pageKey.str());
+            Image pageImage = atlas.getPage(page);
 
-                if (keys.find(pkey) == keys.end() && !isGenerated(pkey)) {
-                    temp.insert(pkey);
-                }
+            if (_textureMips) {
+                MipChainParams params;
+                params._srgb = true;
+                ImageUtils::generateMips(pageImage, params);
+            }
+
+            if (_textureCompression) {
+                putCompressedPage(page, pageImage, collector);
+            } else {
+                putTexture(pageKey, pageImage, collector);
             }
         }
 
-        keys.insert(temp.begin(), temp.end());
-    } while (!temp.empty());
+        matChan.put(pageKey, material);
+    }
 }
 
-void HeightmapGround::generateTerrains(const std::set<TileCoordinates> &keys) {
-    typedef std::vector<Tile *> generateTiles_t;
-    std::vector<generateTiles_t> lods(_tileSystem._maxLod + 1);
+void HeightmapGround::putTexture(const ItemKey &itemKey, const Image &texture,
+                                 ICollector &collector) {
+    auto &imageChan = collector.getChannel<Image>();
 
-    for (const TileCoordinates &key : keys) {
-        Tile *tile = &_internal->_terrains.getOrCreate(key, key, _terrainRes);
-        lods[key._lod].push_back(tile);
+    if (_textureCompression) {
+        imageChan.put(itemKey, BlockCompression::encode(texture));
+    } else {
+        imageChan.put(itemKey, texture);
     }
+}
 
-    // Each lod is generated separately to ensure parents are
-    // created before generating children
-    int lod = 0;
-
-    for (auto &generatedTiles : lods) {
+void HeightmapGround::putCompressedPage(int page, const Image &pageImage,
+                                        ICollector &collector) {
+    auto &compressed = _internal->_compressedPages;
+    auto it = compressed.find(page);
+    const ImageRect changed = _internal->_uncompressedRects[page];
+    _internal->_uncompressedRects.erase(page);
+
+    if (it == compressed.end() ||
+        it->second.mipCount() != pageImage.mipCount()) {
+        compressed.erase(page);
+        it = compressed.emplace(page, BlockCompression::encode(pageImage))
+                 .first;
+    } else if (!changed.isEmpty()) {
+        // The mips are box filtered, so a change of the page only changes
+        // the same rectangle halved at each level
+        for (int level = 0; level <= pageImage.mipCount(); ++level) {
+            const int scale = 1 << level;
+            const int x0 = changed._x / scale, y0 = changed._y / scale;
+            const int x1 = (changed._x + changed._width + scale - 1) / scale;
+            const int y1 = (changed._y + changed._height + scale - 1) / scale;
+            BlockCompression::encodeRect(pageImage.mip(level),
+                                         it->second.mip(level),
+                                         {x0, y0, x1 - x0, y1 - y0});
+        }
+    }
+    collector.getChannel<Image>().put(atlasPageToItem(page), it->second);
+}
+
+bool HeightmapGround::putTextureUpdate(const ItemKey &itemKey,
+                                       const Image &texture,
+                                       const ImageRect &rect,
+                                       ICollector &collector) {
+    // The mip levels would have to be updated as well
+    if (_textureMips || !collector.hasChannel<ImageUpdate>()) {
+        return false;
+    }
+
+    auto &channel = collector.getChannel<ImageUpdate>();
+    // The previous update is replaced if the host has not consumed it yet,
+    // so the new update must contain its rectangle as well
+    ImageRect merged = rect;
+    auto pendingIt = _internal->_pendingUpdates.find(itemKey);
+
+    if (pendingIt != _internal->_pendingUpdates.end() &&
+        channel.has(itemKey)) {
+        merged.merge(pendingIt->second);
+    }
+
+    // Clip the rectangle, and align it on the blocks if the texture is
+    // compressed
+    const int align = _textureCompression ? 4 : 1;
+    const int x0 = std::max(merged._x, 0) / align * align;
+    const int y0 = std::max(merged._y, 0) / align * align;
+    const int x1 =
+        std::min((merged._x + merged._width + align - 1) / align * align,
+                 texture.width());
+    const int y1 =
+        std::min((merged._y + merged._height + align - 1) / align * align,
+                 texture.height());
+
+    if (x0 >= x1 || y0 >= y1) {
+        return true;
+    }
+    _internal->_pendingUpdates[itemKey] = {x0, y0, x1 - x0, y1 - y0};
+
+    Image pixels = ImageUtils::crop(texture, x0, y0, x1 - x0, y1 - y0);
+
+    if (_textureCompression) {
+        // Compressed blocks do not depend on their neighbours, so the update
+        // matches the same rectangle of the compressed texture
+        pixels = BlockCompression::encode(pixels);
+    }
+
+    channel.put(itemKey, ImageUpdate(x0, y0, std::move(pixels)));
+    return true;
+}
+
+// ==== QUERIES
+
+/** Tolerance on the distances along the rays, in meters. */
+static const double RAY_EPSILON = 1e-6;
+
+/** Count of height edits whose bounds are kept, see getEditsSince(). */
+static const size_t EDIT_HISTORY_SIZE = 256;
+
+/** Number of squares on a side of the given level of a height pyramid. */
+static int pyramidLevelSize(int terrainRes, int level) {
+    int size = terrainRes - 1;
+
+    for (int i = 0; i < level; ++i) {
+        size = (size + 1) / 2;
+    }
+    return size;
+}
+
+/** Clip the range [tmin, tmax] of the ray to the part of the ray above the
+ * rectangle (x0, y0, x1, y1). Returns false if the ray does not pass above
+ * the rectangle. */
+static bool clipRay(const vec3d &origin, const vec3d &direction, double x0,
+                    double y0, double x1, double y1, double &tmin,
+                    double &tmax) {
+    const double o[2] = {origin.x, origin.y};
+    const double d[2] = {direction.x, direction.y};
+    const double lo[2] = {x0, y0};
+    const double hi[2] = {x1, y1};
+
+    for (int a = 0; a < 2; ++a) {
+        if (std::abs(d[a]) < std::numeric_limits<double>::epsilon()) {
+            if (o[a] < lo[a] || o[a] > hi[a]) {
+                return false;
+            }
+            continue;
+        }
+        double t0 = (lo[a] - o[a]) / d[a];
+        double t1 = (hi[a] - o[a]) / d[a];
+
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+    }
+    return tmin <= tmax;
+}
+
+/** Check if the altitude of the ray between tmin and tmax overlaps the
+ * range [low, high]. */
+static bool rayOverlaps(const vec3d &origin, const vec3d &direction,
+                        double tmin, double tmax, double low, double high) {
+    const double z0 = origin.z + direction.z * tmin;
+    const double z1 = origin.z + direction.z * tmax;
+    return std::max(z0, z1) >= low && std::min(z0, z1) <= high;
+}
+
+/** Moller-Trumbore ray-triangle intersection. */
+static bool intersectTriangle(const vec3d &origin, const vec3d &direction,
+                              const vec3d &a, const vec3d &b, const vec3d &c,
+                              double &t) {
+    const double eps = 1e-9;
+    const vec3d e1 = b - a;
+    const vec3d e2 = c - a;
+    const vec3d p = direction.crossProduct(e2);
+    const double det = e1.dotProduct(p);
+
+    if (std::abs(det) < eps) {
+        return false;
+    }
+    const double invDet = 1 / det;
+    const vec3d s = origin - a;
+    const double u = s.dotProduct(p) * invDet;
+
+    if (u < -eps || u > 1 + eps) {
+        return false;
+    }
+    const vec3d q = s.crossProduct(e1);
+    const double v = direction.dotProduct(q) * invDet;
+
+    if (v < -eps || u + v > 1 + eps) {
+        return false;
+    }
+    t = e2.dotProduct(q) * invDet;
+    return true;
+}
+
+optional<vec3d> HeightmapGround::raycast(const vec3d &origin,
+                                         const vec3d &direction,
+                                         double maxDistance,
+                                         double resolution) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    std::lock_guard<std::mutex> tilesLock(_internal->_tilesMutex);
+    const int targetLod = _tileSystem.getLod(resolution);
+    const vec3d dir = direction.normalize();
+    const vec3d tileSize = _tileSystem.getTileSize(0);
+    // Small step to find the next tile when the ray leaves a tile
+    const double step = tileSize.x * 1e-9;
+    double t = 0;
+
+    // Walk through the tiles of lod 0 along the ray
+    while (t < maxDistance) {
+        TileCoordinates key =
+            _tileSystem.getTileCoordinates(origin + dir * (t + step), 0);
+        key._pos.z = 0;
+        const vec3d offset = _tileSystem.getTileOffset(key);
+
+        double tEnter = t, tExit = maxDistance;
+        clipRay(origin, dir, offset.x, offset.y, offset.x + tileSize.x,
+                offset.y + tileSize.y, tEnter, tExit);
+        double hit;
+
+        if (raycastTile(key, origin, dir, t, tExit, targetLod, hit)) {
+            return origin + dir * hit;
+        }
+        t = std::max(tExit, t + step);
+    }
+
+    return {};
+}
+
+double HeightmapGround::observeMaxAltitude(const vec2d &min, const vec2d &max,
+                                           double resolution) {
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    std::lock_guard<std::mutex> tilesLock(_internal->_tilesMutex);
+    const int targetLod = _tileSystem.getLod(resolution);
+
+    // Branch and bound: the tiles with the highest upper bound are explored
+    // first, until the best height found is above all the bounds.
+    struct Candidate {
+        double _bound;
+        TileCoordinates _key;
+        /// The bound comes from the terrain of the tile, not from its parent
+        bool _exact;
+
+        bool operator<(const Candidate &other) const {
+            return _bound < other._bound;
+        }
+    };
+
+    std::priority_queue<Candidate> candidates;
+    const double infinity = std::numeric_limits<double>::infinity();
+    double best = -infinity;
+
+    auto overlaps = [&](const TileCoordinates &key) {
+        const vec3d offset = _tileSystem.getTileOffset(key);
+        const vec3d size = _tileSystem.getTileSize(key._lod);
+        return offset.x <= max.x && offset.x + size.x >= min.x &&
+               offset.y <= max.y && offset.y + size.y >= min.y;
+    };
+
+    TileCoordinates tileMin =
+        _tileSystem.getTileCoordinates({min.x, min.y, 0}, 0);
+    TileCoordinates tileMax =
+        _tileSystem.getTileCoordinates({max.x, max.y, 0}, 0);
+
+    for (int x = tileMin._pos.x; x <= tileMax._pos.x; ++x) {
+        for (int y = tileMin._pos.y; y <= tileMax._pos.y; ++y) {
+            candidates.push({infinity, {x, y, 0, 0}, false});
+        }
+    }
+
+    while (!candidates.empty()) {
+        Candidate candidate = candidates.top();
+        candidates.pop();
+
+        if (candidate._bound <= best) {
+            break;
+        }
+
+        const TileCoordinates &key = candidate._key;
+        Tile &tile = provide(key);
+
+        if (!candidate._exact) {
+            candidates.push(
+                {getSubtreeBounds(tile, targetLod).y, key, true});
+        } else if (key._lod == targetLod) {
+            updateHeightPyramid(tile);
+            const int top = int(tile._heightPyramid.size()) - 1;
+            findMaxHeight(tile, top, 0, 0, min, max, best);
+        } else {
+            const int factor = _tileSystem._factor;
+
+            for (int i = 0; i < factor; ++i) {
+                for (int j = 0; j < factor; ++j) {
+                    TileCoordinates child{key._pos.x * factor + i,
+                                          key._pos.y * factor + j, 0,
+                                          key._lod + 1};
+
+                    if (overlaps(child)) {
+                        candidates.push({candidate._bound, child, false});
+                    }
+                }
+            }
+        }
+    }
+
+    return _minAltitude + getAltitudeRange() * best;
+}
+
+void HeightmapGround::updateHeightBounds(Tile &tile) {
+    const Terrain &terrain = tile._terrain;
+    const int res = terrain.getResolution();
+    vec2d bounds{terrain(0, 0), terrain(0, 0)};
+
+    for (int y = 0; y < res; ++y) {
+        for (int x = 0; x < res; ++x) {
+            bounds.x = std::min(bounds.x, terrain(x, y));
+            bounds.y = std::max(bounds.y, terrain(x, y));
+        }
+    }
+    tile._zBounds = bounds;
+}
+
+void HeightmapGround::updateHeightPyramid(Tile &tile) {
+    auto &pyramid = tile._heightPyramid;
+
+    if (!pyramid.empty()) {
+        return;
+    }
+
+    const Terrain &terrain = tile._terrain;
+    const int res = terrain.getResolution();
+    int size = res - 1;
+    std::vector<vec2d> level(size * size);
+
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const double h[4] = {terrain(x, y), terrain(x + 1, y),
+                                 terrain(x, y + 1), terrain(x + 1, y + 1)};
+            level[y * size + x] = {*std::min_element(h, h + 4),
+                                   *std::max_element(h, h + 4)};
+        }
+    }
+    pyramid.push_back(std::move(level));
+
+    while (size > 1) {
+        const std::vector<vec2d> &last = pyramid.back();
+        const int nextSize = (size + 1) / 2;
+        std::vector<vec2d> next(nextSize * nextSize);
+
+        for (int y = 0; y < nextSize; ++y) {
+            for (int x = 0; x < nextSize; ++x) {
+                vec2d bounds = last[(y * 2) * size + x * 2];
+
+                for (int j = y * 2; j < std::min(y * 2 + 2, size); ++j) {
+                    for (int i = x * 2; i < std::min(x * 2 + 2, size); ++i) {
+                        bounds.x = std::min(bounds.x, last[j * size + i].x);
+                        bounds.y = std::max(bounds.y, last[j * size + i].y);
+                    }
+                }
+                next[y * nextSize + x] = bounds;
+            }
+        }
+        pyramid.push_back(std::move(next));
+        size = nextSize;
+    }
+
+    tile._zBounds = pyramid.back()[0];
+}
+
+vec2d HeightmapGround::getSubtreeBounds(const Tile &tile,
+                                        int targetLod) const {
+    if (tile._boundedLod >= targetLod) {
+        return tile._subtreeBounds;
+    }
+    // The tiles not generated yet stay in the altitude range of the ground
+    return {std::min(tile._subtreeBounds.x, 0.),
+            std::max(tile._subtreeBounds.y, 1.)};
+}
+
+void HeightmapGround::updateSubtreeBounds(const TileCoordinates &key) {
+    const int factor = _tileSystem._factor;
+    TileCoordinates current = key;
+
+    while (true) {
+        Tile *tile;
+
+        // A missing ancestor is skipped: the next one misses a child, so its
+        // bounds do not hold below its own lod anymore
+        if (_internal->_terrains.tryGet(current, &tile)) {
+            vec2d bounds = tile->_zBounds;
+            int boundedLod = std::numeric_limits<int>::max();
+
+            for (int i = 0; i < factor; ++i) {
+                for (int j = 0; j < factor; ++j) {
+                    TileCoordinates childKey{current._pos.x * factor + i,
+                                             current._pos.y * factor + j, 0,
+                                             current._lod + 1};
+                    Tile *child;
+
+                    if (_internal->_terrains.tryGet(childKey, &child) &&
+                        child->_boundedLod >= 0) {
+                        bounds.x = std::min(bounds.x, child->_subtreeBounds.x);
+                        bounds.y = std::max(bounds.y, child->_subtreeBounds.y);
+                        boundedLod = std::min(boundedLod, child->_boundedLod);
+                    } else {
+                        boundedLod = current._lod;
+                    }
+                }
+            }
+
+            if (!(current == key) && tile->_boundedLod == boundedLod &&
+                tile->_subtreeBounds.x == bounds.x &&
+                tile->_subtreeBounds.y == bounds.y) {
+                break;
+            }
+            tile->_subtreeBounds = bounds;
+            tile->_boundedLod = boundedLod;
+        }
+
+        if (current._lod == 0) {
+            break;
+        }
+        current = _tileSystem.getParentTileCoordinates(current);
+    }
+}
+
+bool HeightmapGround::raycastTile(const TileCoordinates &key,
+                                  const vec3d &origin, const vec3d &direction,
+                                  double tmin, double tmax, int targetLod,
+                                  double &hit) {
+    const vec3d offset = _tileSystem.getTileOffset(key);
+    const vec3d size = _tileSystem.getTileSize(key._lod);
+
+    if (!clipRay(origin, direction, offset.x, offset.y, offset.x + size.x,
+                 offset.y + size.y, tmin, tmax)) {
+        return false;
+    }
+
+    Tile &tile = provide(key);
+
+    const vec2d bounds = getSubtreeBounds(tile, targetLod);
+
+    if (!rayOverlaps(origin, direction, tmin, tmax,
+                     _minAltitude + getAltitudeRange() * bounds.x,
+                     _minAltitude + getAltitudeRange() * bounds.y)) {
+        return false;
+    }
+
+    if (key._lod == targetLod) {
+        updateHeightPyramid(tile);
+        const int top = int(tile._heightPyramid.size()) - 1;
+        return raycastPyramid(tile, top, 0, 0, origin, direction, tmin, tmax,
+                              hit);
+    }
+
+    // Children are traversed in the order the ray passes through them
+    std::vector<std::pair<double, TileCoordinates>> children;
+    const int factor = _tileSystem._factor;
+
+    for (int i = 0; i < factor; ++i) {
+        for (int j = 0; j < factor; ++j) {
+            TileCoordinates child{key._pos.x * factor + i,
+                                  key._pos.y * factor + j, 0, key._lod + 1};
+            const vec3d childOffset = _tileSystem.getTileOffset(child);
+            const vec3d childSize = _tileSystem.getTileSize(child._lod);
+            double t0 = tmin, t1 = tmax;
+
+            if (clipRay(origin, direction, childOffset.x, childOffset.y,
+                        childOffset.x + childSize.x,
+                        childOffset.y + childSize.y, t0, t1)) {
+                children.emplace_back(t0, child);
+            }
+        }
+    }
+
+    std::sort(children.begin(), children.end(),
+              [](const std::pair<double, TileCoordinates> &lhs,
+                 const std::pair<double, TileCoordinates> &rhs) {
+                  return lhs.first < rhs.first;
+              });
+
+    for (auto &child : children) {
+        if (raycastTile(child.second, origin, direction, tmin, tmax,
+                        targetLod, hit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HeightmapGround::raycastPyramid(Tile &tile, int level, int x, int y,
+                                     const vec3d &origin,
+                                     const vec3d &direction, double tmin,
+                                     double tmax, double &hit) {
+    const Terrain &terrain = tile._terrain;
+    const int res = terrain.getResolution();
+    const vec3d offset = _tileSystem.getTileOffset(tile._key);
+    const double spacing =
+        _tileSystem.getTileSize(tile._key._lod).x / (res - 1);
+
+    // Quads covered by the square
+    const int span = 1 << level;
+    const int x0 = x * span, x1 = std::min((x + 1) * span, res - 1);
+    const int y0 = y * span, y1 = std::min((y + 1) * span, res - 1);
+
+    if (!clipRay(origin, direction, offset.x + x0 * spacing,
+                 offset.y + y0 * spacing, offset.x + x1 * spacing,
+                 offset.y + y1 * spacing, tmin, tmax)) {
+        return false;
+    }
+
+    const int size = pyramidLevelSize(res, level);
+    const vec2d &bounds = tile._heightPyramid[level][y * size + x];
+
+    if (!rayOverlaps(origin, direction, tmin, tmax,
+                     _minAltitude + getAltitudeRange() * bounds.x,
+                     _minAltitude + getAltitudeRange() * bounds.y)) {
+        return false;
+    }
+
+    if (level == 0) {
+        auto vertex = [&](int i, int j) {
+            return vec3d{offset.x + i * spacing, offset.y + j * spacing,
+                         _minAltitude + getAltitudeRange() * terrain(i, j)};
+        };
+        // Same triangles as Terrain::getExactHeightAt
+        const vec3d a = vertex(x, y), b = vertex(x + 1, y);
+        const vec3d c = vertex(x, y + 1), d = vertex(x + 1, y + 1);
+        double best = std::numeric_limits<double>::infinity(), t;
+
+        if (intersectTriangle(origin, direction, a, b, c, t) &&
+            t >= tmin - RAY_EPSILON && t <= tmax + RAY_EPSILON) {
+            best = t;
+        }
+        if (intersectTriangle(origin, direction, d, c, b, t) &&
+            t >= tmin - RAY_EPSILON && t <= tmax + RAY_EPSILON) {
+            best = std::min(best, t);
+        }
+
+        if (best == std::numeric_limits<double>::infinity()) {
+            return false;
+        }
+        hit = best;
+        return true;
+    }
+
+    // Sub-squares are traversed in the order the ray passes through them
+    std::vector<std::pair<double, vec2i>> children;
+    const int childSize = pyramidLevelSize(res, level - 1);
+    const int childSpan = span / 2;
+
+    for (int i = x * 2; i < std::min(x * 2 + 2, childSize); ++i) {
+        for (int j = y * 2; j < std::min(y * 2 + 2, childSize); ++j) {
+            double t0 = tmin, t1 = tmax;
+            const int cx1 = std::min((i + 1) * childSpan, res - 1);
+            const int cy1 = std::min((j + 1) * childSpan, res - 1);
+
+            if (clipRay(origin, direction, offset.x + i * childSpan * spacing,
+                        offset.y + j * childSpan * spacing,
+                        offset.x + cx1 * spacing, offset.y + cy1 * spacing, t0,
+                        t1)) {
+                children.emplace_back(t0, vec2i{i, j});
+            }
+        }
+    }
+
+    std::sort(children.begin(), children.end(),
+              [](const std::pair<double, vec2i> &lhs,
+                 const std::pair<double, vec2i> &rhs) {
+                  return lhs.first < rhs.first;
+              });
+
+    for (auto &child : children) {
+        if (raycastPyramid(tile, level - 1, child.second.x, child.second.y,
+                           origin, direction, tmin, tmax, hit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HeightmapGround::findMaxHeight(Tile &tile, int level, int x, int y,
+                                    const vec2d &min, const vec2d &max,
+                                    double &best) {
+    const Terrain &terrain = tile._terrain;
+    const int res = terrain.getResolution();
+    const vec3d offset = _tileSystem.getTileOffset(tile._key);
+    const vec3d tileSize = _tileSystem.getTileSize(tile._key._lod);
+    const double spacing = tileSize.x / (res - 1);
+
+    // Square, and its intersection with the rectangle
+    const int span = 1 << level;
+    const double sx0 = offset.x + x * span * spacing;
+    const double sy0 = offset.y + y * span * spacing;
+    const double sx1 = offset.x + std::min((x + 1) * span, res - 1) * spacing;
+    const double sy1 = offset.y + std::min((y + 1) * span, res - 1) * spacing;
+    const double rx0 = std::max(sx0, min.x), rx1 = std::min(sx1, max.x);
+    const double ry0 = std::max(sy0, min.y), ry1 = std::min(sy1, max.y);
+
+    if (rx0 > rx1 || ry0 > ry1) {
+        return;
+    }
+
+    const int size = pyramidLevelSize(res, level);
+    const vec2d &bounds = tile._heightPyramid[level][y * size + x];
+
+    if (bounds.y <= best) {
+        return;
+    }
+
+    // The highest point of a square is one of its points
+    if (rx0 == sx0 && rx1 == sx1 && ry0 == sy0 && ry1 == sy1) {
+        best = bounds.y;
+        return;
+    }
+
+    if (level == 0) {
+        // The quad is made of two planar triangles, split by the diagonal
+        // u + v = spacing. The highest point is one of the corners of the
+        // rectangle, or one of the crossings of the diagonal with the sides
+        // of the rectangle.
+        auto updateBest = [&](double px, double py) {
+            if (px >= rx0 && px <= rx1 && py >= ry0 && py <= ry1) {
+                best = std::max(best, terrain.getExactHeightAt(
+                                          (px - offset.x) / tileSize.x,
+                                          (py - offset.y) / tileSize.y));
+            }
+        };
+
+        updateBest(rx0, ry0);
+        updateBest(rx1, ry0);
+        updateBest(rx0, ry1);
+        updateBest(rx1, ry1);
+        updateBest(sx0 + spacing - (ry0 - sy0), ry0);
+        updateBest(sx0 + spacing - (ry1 - sy0), ry1);
+        updateBest(rx0, sy0 + spacing - (rx0 - sx0));
+        updateBest(rx1, sy0 + spacing - (rx1 - sx0));
+        return;
+    }
+
+    const int childSize = pyramidLevelSize(res, level - 1);
+
+    for (int i = x * 2; i < std::min(x * 2 + 2, childSize); ++i) {
+        for (int j = y * 2; j < std::min(y * 2 + 2, childSize); ++j) {
+            findMaxHeight(tile, level - 1, i, j, min, max, best);
+        }
+    }
+}
+
+// ==== EDITION
+
+void HeightmapGround::addHeight(const vec2d &center, double radius,
+                                double height) {
+    editHeight(center, radius, HeightEdit::ADD, height, 1);
+}
+
+void HeightmapGround::setHeight(const vec2d &center, double radius,
+                                double altitude, double strength) {
+    editHeight(center, radius, HeightEdit::SET, altitude, strength);
+}
+
+void HeightmapGround::smoothHeight(const vec2d &center, double radius,
+                                   double strength) {
+    editHeight(center, radius, HeightEdit::SMOOTH, 0, strength);
+}
+
+void HeightmapGround::editHeight(const vec2d &center, double radius,
+                                 HeightEdit edit, double value,
+                                 double strength) {
+    struct Change {
+        TileCoordinates _key;
+        int _x, _y;
+        double _delta;
+    };
+
+    std::lock_guard<std::mutex> lock(_internal->_mutex);
+    std::lock_guard<std::mutex> tilesLock(_internal->_tilesMutex);
+    const int lod = _tileSystem._maxLod;
+    const double spacing = _tileSystem.getTileSize(lod).x / (_terrainRes - 1);
+    const vec2d min{center.x - radius, center.y - radius};
+    const vec2d max{center.x + radius, center.y + radius};
+
+    // All the changes are computed before being applied, so that smoothing
+    // does not depend on the order of the points.
+    std::vector<Change> changes;
+
+    forEachTerrainPoint(
+        _tileSystem, _terrainRes, lod, min, max,
+        [&](const TileCoordinates &key, int x, int y, const vec2d &pos) {
+            const double distance = (pos - center).norm();
+
+            if (distance >= radius) {
+                return;
+            }
+            const double weight =
+                strength * 0.5 * (1 + cos(M_PI * distance / radius));
+            double delta = 0;
+
+            switch (edit) {
+            case HeightEdit::ADD:
+                delta = value * weight;
+                break;
+            case HeightEdit::SET:
+                delta = (value - observeAltitudeAt(pos.x, pos.y, lod)) *
+                        weight;
+                break;
+            case HeightEdit::SMOOTH: {
+                double mean = 0;
+
+                for (int i = -1; i <= 1; ++i) {
+                    for (int j = -1; j <= 1; ++j) {
+                        mean += observeAltitudeAt(pos.x + i * spacing,
+                                                  pos.y + j * spacing, lod);
+                    }
+                }
+                mean /= 9;
+                delta =
+                    (mean - observeAltitudeAt(pos.x, pos.y, lod)) * weight;
+                break;
+            }
+            }
+
+            if (delta != 0) {
+                changes.push_back({key, x, y, delta / getAltitudeRange()});
+            }
+        });
+
+    std::set<TileCoordinates> edited;
+
+    for (const Change &change : changes) {
+        addHeightDelta(change._key, change._x, change._y, change._delta);
+        edited.insert(change._key);
+    }
+
+    invalidateMeshes(edited);
+    updateEditedBounds(edited);
+
+    // Each point of the coarser lods depends on the points of the finer lod
+    // around it, so the updated area grows with each lod
+    double margin = 0;
+
+    for (int parentLod = lod - 1; parentLod >= 0; --parentLod) {
+        margin += _tileSystem.getTileSize(parentLod + 1).x / (_terrainRes - 1);
+        propagateHeightDelta(parentLod, {min.x - margin, min.y - margin},
+                             {max.x + margin, max.y + margin});
+    }
+
+    publishTerrains();
+
+    std::lock_guard<std::mutex> editsLock(_internal->_editsMutex);
+    auto &edits = _internal->_edits;
+    edits.emplace_back(
+        _internal->_editEpoch + 1,
+        BoundingBox({min.x - margin, min.y - margin, _minAltitude},
+                    {max.x + margin, max.y + margin, _maxAltitude}));
+
+    if (edits.size() > EDIT_HISTORY_SIZE) {
+        edits.pop_front();
+    }
+    ++_internal->_editEpoch;
+}
+
+void HeightmapGround::addHeightDelta(const TileCoordinates &key, int x, int y,
+                                     double delta) {
+    auto &heightDeltas = _internal->_heightDeltas;
+    auto it = heightDeltas.find(key);
+
+    if (it == heightDeltas.end()) {
+        it = heightDeltas
+                 .emplace(key, arma::mat(_terrainRes, _terrainRes,
+                                         arma::fill::zeros))
+                 .first;
+    }
+    it->second(x, y) += delta;
+
+    Tile *tile;
+
+    if (_internal->_terrains.tryGet(key, &tile)) {
+        tile->_terrain(x, y) += delta;
+        tile->_heightPyramid.clear();
+        _internal->_unpublished.insert(key);
+    }
+}
+
+double HeightmapGround::sampleHeightDelta(int lod, double x, double y) const {
+    const TileCoordinates key = _tileSystem.getTileCoordinates({x, y, 0}, lod);
+    auto it = _internal->_heightDeltas.find(key);
+
+    if (it == _internal->_heightDeltas.end()) {
+        return 0;
+    }
+
+    const arma::mat &delta = it->second;
+    const vec3d local = _tileSystem.getLocalCoordinates({x, y, 0}, lod);
+    const double fx = local.x * (_terrainRes - 1);
+    const double fy = local.y * (_terrainRes - 1);
+    const int x0 = clamp(int(floor(fx)), 0, _terrainRes - 2);
+    const int y0 = clamp(int(floor(fy)), 0, _terrainRes - 2);
+    const double dx = fx - x0, dy = fy - y0;
+
+    return (delta(x0, y0) * (1 - dx) + delta(x0 + 1, y0) * dx) * (1 - dy) +
+           (delta(x0, y0 + 1) * (1 - dx) + delta(x0 + 1, y0 + 1) * dx) * dy;
+}
+
+double HeightmapGround::filterHeightDelta(int lod, const vec2d &pos) const {
+    const double childSpacing =
+        _tileSystem.getTileSize(lod + 1).x / (_terrainRes - 1);
+    // Tent filter over the 3x3 points of the finer lod around each point
+    const double weights[3] = {0.25, 0.5, 0.25};
+    double value = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            value += weights[i] * weights[j] *
+                     sampleHeightDelta(lod + 1, pos.x + (i - 1) * childSpacing,
+                                       pos.y + (j - 1) * childSpacing);
+        }
+    }
+    return value;
+}
+
+void HeightmapGround::propagateHeightDelta(int lod, const vec2d &min,
+                                           const vec2d &max) {
+    std::set<TileCoordinates> edited;
+
+    forEachTerrainPoint(
+        _tileSystem, _terrainRes, lod, min, max,
+        [&](const TileCoordinates &key, int x, int y, const vec2d &pos) {
+            const double value = filterHeightDelta(lod, pos);
+            auto it = _internal->_heightDeltas.find(key);
+            const double old =
+                it == _internal->_heightDeltas.end() ? 0 : it->second(x, y);
+
+            if (value != old) {
+                addHeightDelta(key, x, y, value - old);
+                edited.insert(key);
+            }
+        });
+
+    invalidateMeshes(edited);
+    updateEditedBounds(edited);
+}
+
+void HeightmapGround::restoreHeightDelta(const TileCoordinates &key) {
+    auto &heightDeltas = _internal->_heightDeltas;
+    const int maxLod = _tileSystem._maxLod;
+
+    if (key._lod >= maxLod || heightDeltas.find(key) != heightDeltas.end()) {
+        return;
+    }
+
+    // Each lod depends on the next lod around it, so the points of the tile
+    // depend on a larger area at each finer lod
+    std::vector<double> margins(maxLod + 1, 0);
+
+    for (int lod = key._lod + 1; lod <= maxLod; ++lod) {
+        const double spacing =
+            _tileSystem.getTileSize(lod).x / (_terrainRes - 1);
+        margins[lod] = margins[lod - 1] + spacing;
+    }
+
+    const vec3d tileMin = _tileSystem.getTileOffset(key);
+    const vec3d tileMax = tileMin + _tileSystem.getTileSize(key._lod);
+    const double inf = std::numeric_limits<double>::max();
+    vec2d editMin{inf, inf}, editMax{-inf, -inf};
+
+    for (const auto &entry : heightDeltas) {
+        if (entry.first._lod != maxLod) {
+            continue;
+        }
+        const vec3d min = _tileSystem.getTileOffset(entry.first);
+        const vec3d max = min + _tileSystem.getTileSize(maxLod);
+
+        if (max.x >= tileMin.x - margins[maxLod] &&
+            min.x <= tileMax.x + margins[maxLod] &&
+            max.y >= tileMin.y - margins[maxLod] &&
+            min.y <= tileMax.y + margins[maxLod]) {
+            editMin = {std::min(editMin.x, min.x), std::min(editMin.y, min.y)};
+            editMax = {std::max(editMax.x, max.x), std::max(editMax.y, max.y)};
+        }
+    }
+
+    // The deltas that were not dropped are up to date
+    std::set<TileCoordinates> restored;
+
+    for (int lod = maxLod - 1; lod >= key._lod; --lod) {
+        // Area needed by the tile, where the edits have an effect
+        const double spread = margins[maxLod] - margins[lod];
+        const vec2d min{std::max(tileMin.x - margins[lod], editMin.x - spread),
+                        std::max(tileMin.y - margins[lod], editMin.y - spread)};
+        const vec2d max{std::min(tileMax.x + margins[lod], editMax.x + spread),
+                        std::min(tileMax.y + margins[lod], editMax.y + spread)};
+
+        if (min.x > max.x || min.y > max.y) {
+            return;
+        }
+
+        forEachTerrainPoint(
+            _tileSystem, _terrainRes, lod, min, max,
+            [&](const TileCoordinates &current, int x, int y,
+                const vec2d &pos) {
+                auto it = heightDeltas.find(current);
+
+                if (it != heightDeltas.end() && restored.count(current) == 0) {
+                    return;
+                }
+                const double value = filterHeightDelta(lod, pos);
+
+                if (value == 0) {
+                    return;
+                }
+                if (it == heightDeltas.end()) {
+                    it = heightDeltas
+                             .emplace(current,
+                                      arma::mat(_terrainRes, _terrainRes,
+                                                arma::fill::zeros))
+                             .first;
+                    restored.insert(current);
+                }
+                it->second(x, y) = value;
+            });
+    }
+}
+
+void HeightmapGround::invalidateMeshes(const std::set<TileCoordinates> &keys) {
+    for (const TileCoordinates &key : keys) {
+        for (int i = -1; i <= 1; ++i) {
+            for (int j = -1; j <= 1; ++j) {
+                TileCoordinates neighbour{key._pos.x + i, key._pos.y + j, 0,
+                                          key._lod};
+                Tile *tile;
+
+                if (_internal->_terrains.tryGet(neighbour, &tile)) {
+                    tile->_mesh = Mesh();
+                    _internal->_dirtyMeshes.insert(neighbour);
+                }
+            }
+        }
+    }
+}
+
+void HeightmapGround::updateEditedBounds(
+    const std::set<TileCoordinates> &keys) {
+    for (const TileCoordinates &key : keys) {
+        Tile *tile;
+
+        if (!_internal->_terrains.tryGet(key, &tile)) {
+            continue;
+        }
+        updateHeightBounds(*tile);
+        updateSubtreeBounds(key);
+    }
+}
+
+// ==== ACCESS
+
+Tile &HeightmapGround::provide(const TileCoordinates &key) {
+    return _internal->_terrains.getOrCreateCallback(
+        key,
+        [this, &key](HeightmapGroundTile &tile) {
+            std::set<TileCoordinates> coords{key};
+            addNotGeneratedParents(coords);
+            generateTerrains(coords);
+        },
+        key, _terrainRes);
+}
+
+Terrain &HeightmapGround::provideTerrain(const TileCoordinates &key) {
+    return provide(key)._terrain;
+}
+
+Mesh &HeightmapGround::provideMesh(const TileCoordinates &key) {
+    auto &mesh = provide(key)._mesh;
+
+    if (mesh.empty()) {
+        generateMesh(key);
+    }
+
+    return mesh;
+}
+
+void HeightmapGround::provideTextureMips(const TileCoordinates &key) {
+    Image &texture = provideTerrain(key).getTexture();
+
+    if (texture.mipCount() != 0) {
+        return;
+    }
+
+    MipChainParams params;
+    params._srgb = true;
+
+    if (key._lod == 0 || _mipSeedLevel <= 0) {
+        ImageUtils::generateMips(texture, params);
+        return;
+    }
+
+    // Fine levels are computed from the tile texture
+    for (int level = 1; level < _mipSeedLevel; ++level) {
+        const Image &last = texture.mip(level - 1);
+
+        if (last.width() <= 1 && last.height() <= 1) {
+            return;
+        }
+        texture.addMip(ImageUtils::downsample(last, params));
+    }
+
+    // Coarse levels are cropped from the parent texture
+    TileCoordinates parentKey = _tileSystem.getParentTileCoordinates(key);
+    provideTextureMips(parentKey);
+    const Image &parentTexture = provideTerrain(parentKey).getTexture();
+    const vec3i quadrant = key._pos - parentKey._pos * _tileSystem._factor;
+
+    while (true) {
+        const int level = texture.mipCount() + 1;
+        const Image &last = texture.mip(level - 1);
+
+        if (last.width() <= 1 && last.height() <= 1) {
+            return;
+        }
+        const int width = std::max(last.width() / 2, 1);
+        const int height = std::max(last.height() / 2, 1);
+
+        if (level - 1 > parentTexture.mipCount()) {
+            break;
+        }
+        const Image &parentLevel = parentTexture.mip(level - 1);
+
+        if (parentLevel.width() != width * _tileSystem._factor ||
+            parentLevel.height() != height * _tileSystem._factor) {
+            break;
+        }
+        texture.addMip(ImageUtils::crop(parentLevel, quadrant.x * width,
+                                        quadrant.y * height, width, height));
+    }
+
+    // The parent texture does not match, compute the remaining levels
+    ImageUtils::generateMips(texture, params, texture.mipCount() + 1);
+}
+
+void HeightmapGround::invalidateTextureMips(const TileCoordinates &key) {
+    provideTerrain(key).getTexture().clearMips();
+
+    if (_mipSeedLevel <= 0) {
+        return;
+    }
+    const int factor = _tileSystem._factor;
+
+    for (int i = 0; i < factor; ++i) {
+        for (int j = 0; j < factor; ++j) {
+            TileCoordinates child{key._pos.x * factor + i,
+                                  key._pos.y * factor + j, 0, key._lod + 1};
+
+            if (!isGenerated(child)) {
+                continue;
+            }
+            Image &texture = provideTerrain(child).getTexture();
+
+            // Only the levels from the seed level on come from the parent
+            if (texture.mipCount() >= _mipSeedLevel) {
+                invalidateTextureMips(child);
+                _internal->_dirtyTextures[child].merge(
+                    {0, 0, texture.width(), texture.height()});
+            }
+        }
+    }
+}
+
+bool HeightmapGround::isGenerated(const TileCoordinates &key) {
+    return _internal->_terrains.has(key);
+}
+
+
+std::string HeightmapGround::getTerrainDataId(
+    const TileCoordinates &key) const {
+    u64 id = static_cast<u64>(key._pos.x & 0x0FFFFFFFu) +
+             (static_cast<u64>(key._pos.y & 0x0FFFFFFFu) << 24u) +
+             (static_cast<u64>(key._lod & 0xFFu) << 48u);
+    return std::to_string(id);
+}
+
+
+// ==== GENERATION
+void HeightmapGround::addNotGeneratedParents(std::set<TileCoordinates> &keys) {
+    std::set<TileCoordinates> temp;
+
+    do {
+        temp.clear();
+
+        for (const TileCoordinates &key : keys) {
+            if (key._lod != 0) {
+                auto pkey = _tileSystem.getParentTileCoordinates(key);
+
+                if (keys.find(pkey) == keys.end() && !isGenerated(pkey)) {
+                    temp.insert(pkey);
+                }
+            }
+        }
+
+        keys.insert(temp.begin(), temp.end());
+    } while (!temp.empty());
+}
+
+void HeightmapGround::generateTerrains(const std::set<TileCoordinates> &keys) {
+    typedef std::vector<Tile *> generateTiles_t;
+    std::vector<generateTiles_t> lods(_tileSystem._maxLod + 1);
+
+    for (const TileCoordinates &key : keys) {
+        Tile *tile = &_internal->_terrains.getOrCreate(key, key, _terrainRes);
+        lods[key._lod].push_back(tile);
+    }
+
+    // Each lod is generated separately to ensure parents are
+    // created before generating children
+    int lod = 0;
+
+    for (auto &generatedTiles : lods) {
 
         // Allocation of terrain and textures
         for (auto &tile : generatedTiles) {
             const auto &key = tile->_key;
             Terrain &terrain = tile->_terrain;
             terrain.setTexture(Image(_textureRes, _textureRes, ImageType::RGB));
+            // The painted rectangles of a previous texture are obsolete
+            _internal->_dirtyTextures.erase(key);
 
             double terrainSize = _tileSystem.getTileSize(key._lod).x;
             terrain.setBounds(terrainSize * key._pos.x,
@@ -430,8 +2180,68 @@ void HeightmapGround::generateTerrains(const std::set<TileCoordinates> &keys) {
             }
         }
 
+        // Height edits
+        for (auto &tile : generatedTiles) {
+            restoreHeightDelta(tile->_key);
+            auto it = _internal->_heightDeltas.find(tile->_key);
+
+            if (it != _internal->_heightDeltas.end()) {
+                TerrainOps::applyOffset(tile->_terrain, it->second);
+            }
+            updateHeightBounds(*tile);
+            updateSubtreeBounds(tile->_key);
+            _internal->_unpublished.insert(tile->_key);
+        }
+
         ++lod;
     }
+
+    publishTerrains();
+}
+
+void HeightmapGround::publishTerrains() {
+    using Bucket = GroundIndex::Bucket;
+    GroundIndex &index = _internal->_index;
+    // New version of the modified buckets
+    std::map<int, std::unique_ptr<Bucket>> modified;
+
+    auto getModified = [&](int b) -> Bucket & {
+        auto &bucket = modified[b];
+
+        if (!bucket) {
+            bucket = std::make_unique<Bucket>(*index._buckets[b].load());
+        }
+        return *bucket;
+    };
+
+    for (const TileCoordinates &key : _internal->_unpublished) {
+        Tile *tile;
+
+        if (_internal->_terrains.tryGet(key, &tile)) {
+            getModified(GroundIndex::getBucket(key))[key] =
+                std::make_shared<const TerrainSnapshot>(tile->_terrain);
+        }
+    }
+    _internal->_unpublished.clear();
+
+    for (int b = 0; b < GroundIndex::BUCKET_COUNT; ++b) {
+        const Bucket &bucket = *index._buckets[b].load();
+
+        for (const auto &entry : bucket) {
+            if (!_internal->_terrains.has(entry.first)) {
+                getModified(b).erase(entry.first);
+            }
+        }
+    }
+
+    // Readers may still use the current buckets: they are deleted after the
+    // grace period
+    for (auto &entry : modified) {
+        const Bucket *current =
+            index._buckets[entry.first].exchange(entry.second.release());
+        _internal->_epochs.retire([current]() { delete current; });
+    }
+    _internal->_epochs.reclaim();
 }
 
 void HeightmapGround::generateMesh(const TileCoordinates &key) {
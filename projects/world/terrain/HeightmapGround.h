@@ -6,9 +6,12 @@
 #include <utility>
 #include <functional>
 #include <set>
+#include <vector>
 
 #include "world/core/TileSystem.h"
 #include "world/flat/IGround.h"
+#include "world/assets/ImageUtils.h"
+#include "world/assets/TextureAtlas.h"
 #include "Terrain.h"
 #include "ITerrainWorker.h"
 
@@ -22,13 +25,32 @@ public:
             : TerrainTile(coords, terrainRes) {}
 
 private:
+    /// Lowest and highest heights of the terrain
     vec2d _zBounds;
+    /** Lowest and highest heights of the terrain on squares of 2^level x
+     * 2^level quads, for each level. The last level has a single square,
+     * whose bounds are _zBounds. It is built by the queries that need it,
+     * and is empty if the terrain changed since it was built. */
+    std::vector<std::vector<vec2d>> _heightPyramid;
+    /** Lowest and highest heights of the terrain of the tile and of all its
+     * descendants down to _boundedLod, which are all generated. */
+    vec2d _subtreeBounds;
+    int _boundedLod = -1;
 
     friend class HeightmapGround;
 };
 
 /** This class manages an infinite ground with as much details
- * as we want. */
+ * as we want.
+ *
+ * observeAltitudeAt() and observeAltitudesAt() can be called from any
+ * thread, even while another thread collects the ground: they read an
+ * immutable copy of the heights of the generated tiles, without locking. Only
+ * the queries falling on a tile that is not generated yet wait, for the
+ * generation of this tile: the queries missing the same tile share a single
+ * generation, and collect() lets them run between the generation and the
+ * collection of its tiles. The other methods are serialized with each
+ * other. */
 class WORLDAPI_EXPORT HeightmapGround : public GroundNode {
     WORLD_WRITE_SUBCLASS_METHOD
 public:
@@ -57,10 +79,70 @@ public:
         _textureRes = textureRes;
         _tileSystem._bufferRes.x = _tileSystem._bufferRes.y =
             _textureRes * _texPixSize;
+
+        if (isTextureAtlasEnabled()) {
+            enableTextureAtlas(_atlasPageRes, _atlasMaxPages);
+        }
     }
 
     void setMaxLOD(int lod) { _tileSystem._maxLod = lod; }
 
+    /** Enable the texture atlas output mode. In this mode, tile textures are
+     * not emitted as separate images anymore. They are packed into the pages
+     * of a TextureAtlas, which are emitted instead, with one material per
+     * page. The texture coordinates of the emitted tile meshes are
+     * transformed to point to the tile texture in its page.
+     * @param pageRes resolution of the pages, in pixels
+     * @param maxPages maximum number of pages. When all pages are full, the
+     * least recently collected tiles are removed from the atlas, and from the
+     * collector. The tiles collected in the current frame are never removed:
+     * if all the slots are used by them, the next tiles are collected in a
+     * later frame.
+     * @throws std::invalid_argument if there are more than 256 pages, or
+     * more than 256 slots on a row of a page, which the page table cannot
+     * address (see createAtlasPageTable()). */
+    void enableTextureAtlas(int pageRes = 2048, int maxPages = 4);
+
+    void disableTextureAtlas();
+
+    bool isTextureAtlasEnabled() const { return _atlasMaxPages > 0; }
+
+    /** Enable block compression of the emitted textures. Tile textures, or
+     * atlas pages in atlas mode, are emitted as BC1 images (BC3 if they have
+     * an alpha channel), which take 6 times less memory than uncompressed RGB
+     * images. See BlockCompression. */
+    void setTextureCompression(bool compression) {
+        _textureCompression = compression;
+    }
+
+    bool isTextureCompressionEnabled() const { return _textureCompression; }
+
+    /** Generate the mip levels of the emitted textures. The coarse levels of
+     * a tile texture are copied from the texture of its parent tile, which
+     * covers the tile and its siblings at half the resolution: level n of
+     * the tile is a quarter of level n - 1 of the parent. This saves most of
+     * the mip computation, and keeps the coarse levels consistent between
+     * neighbour tiles.
+     * @param parentSeedLevel first mip level copied from the parent tile, 0
+     * to compute all the levels from the tile texture. */
+    void enableTextureMips(int parentSeedLevel = 2) {
+        _textureMips = true;
+        _mipSeedLevel = parentSeedLevel;
+    }
+
+    void disableTextureMips() { _textureMips = false; }
+
+    bool isTextureMipsEnabled() const { return _textureMips; }
+
+    /** Create the page table of the texture atlas for a rectangle of tiles
+     * at the given lod. Each pixel of the page table corresponds to one
+     * tile: red and green are the column and row of the tile slot in its
+     * page, blue is the page index, and alpha is 255 if the tile is in the
+     * atlas, 0 otherwise.
+     * @param origin coordinates of the first tile of the rectangle */
+    Image createAtlasPageTable(int lod, const vec2i &origin,
+                               const vec2i &size) const;
+
     // TERRAIN WORKERS
     /** Adds a default worker set to generate heightmaps in the
      * ground. This method is for quick-setup purpose. */
@@ -76,15 +158,84 @@ public:
     void setLodRange(const ITerrainWorker &worker, int minLod, int maxLod);
 
     // EXPLORATION
+    /** Get the altitude at (x, y). This method does not block if the tile
+     * containing the point is already generated, see the class
+     * documentation. */
     double observeAltitudeAt(double x, double y, double resolution) override;
 
+    /** Get the altitude of each point of an array. The points are grouped
+     * by tile, so that each tile is looked up only once. Like
+     * observeAltitudeAt(), it only blocks to generate the missing tiles. */
+    void observeAltitudesAt(const vec2d *points, double *altitudes,
+                            size_t count, double resolution) override;
+
+    /** Get the count of height edits applied so far. */
+    u64 getEditEpoch() const override;
+
+    /** Get the bounds of the height edits made after the given epoch, if
+     * they are among the last edits, which are remembered. The coarse
+     * levels of detail are modified around the edited area, and the bounds
+     * include them. */
+    bool getEditsSince(u64 epoch,
+                       std::vector<BoundingBox> &bounds) const override;
+
+    /** Find the first intersection of a ray with the ground, at the lod
+     * matching the given resolution. The tiles are traversed from the
+     * coarsest lod, and the finer tiles are only generated where the ray
+     * passes close to the ground. As the coarse tiles do not bound exactly
+     * the finer tiles, the traversal assumes that the finer tiles do not
+     * deviate from their parent much more than the tiles already generated.
+     * @param direction direction of the ray, does not need to be normalized
+     * @param maxDistance maximum distance of the intersection to the origin
+     * @returns the intersection point, if any. */
+    optional<vec3d> raycast(const vec3d &origin, const vec3d &direction,
+                            double maxDistance, double resolution);
+
+    /** Get the highest altitude of the ground in the rectangle between min
+     * and max, at the lod matching the given resolution. Like raycast(), it
+     * only generates the finer tiles that may contain the highest point. */
+    double observeMaxAltitude(const vec2d &min, const vec2d &max,
+                              double resolution);
+
     void collect(ICollector &collector, const IResolutionModel &resolutionModel,
                  const ExplorationContext &ctx =
                      ExplorationContext::getDefault()) override;
 
+    /** Paint the image on the tile textures. The painting is deferred to
+     * the next call to collect(), so that many small paintings (footprints,
+     * tyre tracks...) between two frames cost a single update. The modified
+     * rectangles of each texture are merged, and if the texture was already
+     * collected, only the modified rectangle is sent to the collector as an
+     * ImageUpdate, provided that the collector has a channel for this type
+     * and that texture mips are disabled. Otherwise the whole texture is
+     * collected again. */
     void paintTexture(const vec2d &origin, const vec2d &size,
                       const vec2d &resolutionRange, const Image &img) override;
 
+    // EDITION
+    /** Raise the terrain by the given height in meters (negative to dig) in
+     * a disc. The edit falls off smoothly from the center to the border of
+     * the disc.
+     *
+     * Height edits are stored in a delta layer on top of the generated
+     * terrain, at the finest lod, and downsampled to the coarser lods. They
+     * are kept when the tiles are generated again. Only the tiles under the
+     * edit are modified, and their meshes are collected again at the next
+     * call to collect(). The texture of the tiles is not regenerated. */
+    void addHeight(const vec2d &center, double radius, double height);
+
+    /** Move the terrain toward the given altitude in a disc.
+     * @param strength 1 to reach the altitude at the center of the disc, less
+     * to move only partially toward it. */
+    void setHeight(const vec2d &center, double radius, double altitude,
+                   double strength = 1);
+
+    /** Smooth the terrain in a disc, by moving each point toward the mean of
+     * its neighbours.
+     * @param strength between 0 (no effect) and 1. */
+    void smoothHeight(const vec2d &center, double radius,
+                      double strength = 0.5);
+
     // IO
     void write(WorldFile &wf) const override;
 
@@ -105,15 +256,132 @@ private:
      * set it to more if you need performances. */
     int _texPixSize = 4;
 
+    int _atlasPageRes = 2048;
+    /** Maximum page count of the texture atlas, 0 if the texture atlas is
+     * disabled. */
+    int _atlasMaxPages = 0;
+
+    bool _textureCompression = false;
+
+    bool _textureMips = false;
+    int _mipSeedLevel = 2;
+
     TileSystem _tileSystem;
 
     // WORKER
     void addWorkerInternal(ITerrainWorker *worker);
 
+    /** Process again the generated tiles whose result is outdated according
+     * to their worker, and mark their texture as modified. */
+    void processOutdatedTiles();
+
     double observeAltitudeAt(double x, double y, int lvl);
 
+    /** Generate a tile missed by an altitude query, and publish it. If the
+     * tile is already being generated for another query, wait for this
+     * generation instead. */
+    void generateMissingTile(const TileCoordinates &key);
+
     void addTerrain(const TileCoordinates &key, ICollector &collector);
 
+    void removeTerrain(const ItemKey &itemKey, ICollector &collector);
+
+    void addAtlasPages(ICollector &collector);
+
+    /** Put the texture in the image channel of the collector, compressed if
+     * texture compression is enabled. */
+    void putTexture(const ItemKey &itemKey, const Image &texture,
+                    ICollector &collector);
+
+    /** Put the compressed atlas page in the image channel of the collector,
+     * with the mip levels of the given page image. */
+    void putCompressedPage(int page, const Image &pageImage,
+                           ICollector &collector);
+
+    /** Put the given rectangle of the texture in the image update channel of
+     * the collector. Returns false if the update cannot be sent, in which
+     * case the whole texture must be collected again. */
+    bool putTextureUpdate(const ItemKey &itemKey, const Image &texture,
+                          const ImageRect &rect, ICollector &collector);
+
+    /** Apply the paintings queued by paintTexture() to the tile textures,
+     * and record the modified rectangle of each texture. */
+    void applyPendingPaints();
+
+    /** Put the mesh of the tile in the collector. If the tile is stored in
+     * the texture atlas, its texture coordinates are transformed to the
+     * slot. */
+    void putMesh(const TileCoordinates &key, const ItemKey &itemKey,
+                 const AtlasSlot &slot, ICollector &collector);
+
+
+    // EDITION
+    enum class HeightEdit { ADD, SET, SMOOTH };
+
+    void editHeight(const vec2d &center, double radius, HeightEdit edit,
+                    double value, double strength);
+
+    /** Add the given value to the height delta and to the terrain, if it is
+     * generated, at the point (x, y) of the tile. */
+    void addHeightDelta(const TileCoordinates &key, int x, int y,
+                        double delta);
+
+    /** Get the height delta at the given lod, interpolated at (x, y). */
+    double sampleHeightDelta(int lod, double x, double y) const;
+
+    /** Get the height delta of the given lod at the given point, by
+     * downsampling the height delta of the next lod. */
+    double filterHeightDelta(int lod, const vec2d &pos) const;
+
+    /** Recompute the height delta of the given lod, between min and max, by
+     * downsampling the height delta of the next lod. */
+    void propagateHeightDelta(int lod, const vec2d &min, const vec2d &max);
+
+    /** Compute again the height delta of the tile from the edits, if it was
+     * dropped when the tile was evicted. Only the edits, which are the
+     * height deltas of the finest lod, are kept for evicted tiles. */
+    void restoreHeightDelta(const TileCoordinates &key);
+
+    /** Clear the meshes of the tiles and their neighbours, which depend on
+     * their border for normals, so that they are generated and collected
+     * again. */
+    void invalidateMeshes(const std::set<TileCoordinates> &keys);
+
+    /** Update the height bounds of the edited tiles, and the subtree
+     * bounds of their ancestors. */
+    void updateEditedBounds(const std::set<TileCoordinates> &keys);
+
+
+    // QUERIES
+    /** Compute the lowest and highest heights of the tile. */
+    void updateHeightBounds(Tile &tile);
+
+    /** Build the height pyramid of the tile, if it is not already built. */
+    void updateHeightPyramid(Tile &tile);
+
+    /** Get the lowest and highest heights of the tile and of the tiles it
+     * contains down to the target lod. Where those tiles are not all
+     * generated yet, the bounds are widened to the altitude range. */
+    vec2d getSubtreeBounds(const Tile &tile, int targetLod) const;
+
+    /** Update the subtree bounds of the tile from its height bounds and
+     * from its children, then the bounds of its ancestors. The height
+     * bounds of the tile must be up to date. */
+    void updateSubtreeBounds(const TileCoordinates &key);
+
+    bool raycastTile(const TileCoordinates &key, const vec3d &origin,
+                     const vec3d &direction, double tmin, double tmax,
+                     int targetLod, double &hit);
+
+    bool raycastPyramid(Tile &tile, int level, int x, int y,
+                        const vec3d &origin, const vec3d &direction,
+                        double tmin, double tmax, double &hit);
+
+    /** Update best with the highest height of the terrain of the tile in
+     * the rectangle between min and max, if it is higher. */
+    void findMaxHeight(Tile &tile, int level, int x, int y, const vec2d &min,
+                       const vec2d &max, double &best);
+
 
     // ACCESS
     HeightmapGround::Tile &provide(const TileCoordinates &key);
@@ -122,6 +390,15 @@ private:
 
     Mesh &provideMesh(const TileCoordinates &key);
 
+    /** Compute the mip levels of the tile texture, if they are not already
+     * computed. */
+    void provideTextureMips(const TileCoordinates &key);
+
+    /** Clear the mip levels of the tile texture after it changed, and those
+     * of the generated children whose coarse levels were cropped from it.
+     * The children are emitted again at the next collect. */
+    void invalidateTextureMips(const TileCoordinates &key);
+
     bool isGenerated(const TileCoordinates &key);
 
 
@@ -137,6 +414,11 @@ private:
      * the terrains already exist they are not generated again. */
     void generateTerrains(const std::set<TileCoordinates> &keys);
 
+    /** Publish the terrains generated or edited since the last call, and
+     * remove the evicted tiles from the index of the altitude queries. Only
+     * the buckets of the index containing those tiles are replaced. */
+    void publishTerrains();
+
     void generateMesh(const TileCoordinates &key);
 
     friend class PGround;
@@ -3,6 +3,8 @@
 
 #include "world/core/WorldConfig.h"
 
+#include <set>
+
 #include "world/core/TileSystem.h"
 
 #include "Terrain.h"
@@ -61,6 +63,13 @@ public:
      * worker starts processing. This may be useful if this ITerrainWorker can
      * run several jobs concurrently. */
     virtual void flush(){};
+
+    /** Add to keys the tiles processed by this worker whose result is
+     * outdated, for example because some input was not available when they
+     * were processed. The HeightmapGround processes them again with this
+     * worker only, and collects their texture again. The default
+     * implementation adds nothing. */
+    virtual void popOutdatedTiles(std::set<TileCoordinates> &) {}
 };
 } // namespace world
 
@@ -1,5 +1,9 @@
-#include <world/assets/ImageUtils.h>
 #include "MultilayerGroundTexture.h"
+#include "TerrainOps.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace world {
 
@@ -17,8 +21,14 @@ void MultilayerGroundTexture::processTerrain(Terrain &terrain) {
 }
 
 void MultilayerGroundTexture::processTile(ITileContext &context) {
-    process(context.getTile().terrain(), context.getTile().texture(),
-            context.getCoords());
+    const TileCoordinates key = context.getCoords();
+
+    if (process(context.getTile().terrain(), context.getTile().texture(),
+                key)) {
+        _placeholderTiles.insert(key);
+    } else {
+        _placeholderTiles.erase(key);
+    }
 }
 
 void MultilayerGroundTexture::addLayer(DistributionParams params) {
@@ -27,6 +37,25 @@ void MultilayerGroundTexture::addLayer(DistributionParams params) {
 
 GridStorageBase *MultilayerGroundTexture::getStorage() { return &_storage; }
 
+void MultilayerGroundTexture::popOutdatedTiles(
+    std::set<TileCoordinates> &keys) {
+    for (auto it = _placeholderTiles.begin();
+         it != _placeholderTiles.end();) {
+        bool ready = true;
+
+        for (size_t layer = 0; layer < _layers.size() && ready; ++layer) {
+            ready = _texProvider->hasTexture(int(layer), it->_lod);
+        }
+
+        if (ready) {
+            keys.insert(*it);
+            it = _placeholderTiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void MultilayerGroundTexture::write(WorldFile &wf) const {
     wf.addArray("layers");
 
@@ -50,6 +79,9 @@ void MultilayerGroundTexture::read(const WorldFile &wf) {
     }
 }
 
+/** Only the blending of the texture rows is vectorized: the ramps are
+ * computed on the terrain grid, which is much smaller than the texture, and
+ * an SSE2 version of this function was not faster. */
 double ramp(double a, double b, double c, double d, double lowb, double highb,
             double x) {
     double ya = (x - a) / (b - a);
@@ -58,7 +90,32 @@ double ramp(double a, double b, double c, double d, double lowb, double highb,
     return clamp(yr, lowb, highb);
 }
 
-void MultilayerGroundTexture::process(Terrain &terrain, Image &image,
+/** Blends one row of u16 lanes in 8.8 fixed point:
+ * acc = acc * (1 - alpha) + tex * alpha, with alpha in 0.16 fixed point.
+ * The SSE2 kernel and the scalar tail compute exactly the same values. */
+static void blendRow(u16 *acc, const u16 *tex, const u16 *alpha, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i ones = _mm_set1_epi16(-1);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<__m128i *>(acc + i));
+        __m128i t =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(tex + i));
+        __m128i a =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha + i));
+        __m128i ia = _mm_sub_epi16(ones, a);
+        c = _mm_add_epi16(_mm_mulhi_epu16(c, ia), _mm_mulhi_epu16(t, a));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i), c);
+    }
+#endif
+    for (; i < count; ++i) {
+        acc[i] = u16(((u32(acc[i]) * (0xFFFFu - alpha[i])) >> 16) +
+                     ((u32(tex[i]) * alpha[i]) >> 16));
+    }
+}
+
+bool MultilayerGroundTexture::process(Terrain &terrain, Image &image,
                                       const TileCoordinates &tc) {
 
     if (_texProvider == nullptr) {
@@ -68,7 +125,6 @@ void MultilayerGroundTexture::process(Terrain &terrain, Image &image,
     const int imWidth = image.width();
     const int imHeight = image.height();
     const u32 tRes = u32(terrain.getResolution());
-    Image proxy(imWidth, imHeight, ImageType::RGBA);
 
     // Precomputing
     double terrainSize = terrain.getBoundingBox().getDimensions().x;
@@ -78,6 +134,10 @@ void MultilayerGroundTexture::process(Terrain &terrain, Image &image,
         _texProvider->setBasePixelSize(terrainSize / imWidth);
     }
 
+    for (size_t layer = 0; layer < _layers.size(); ++layer) {
+        _texProvider->prefetch(int(layer), tc._lod);
+    }
+
     // generate perlin matrix
     PerlinInfo pinfo{2 + tc._lod, 0.8, false, tc._lod, 4};
     int factor = 4;
@@ -92,6 +152,29 @@ void MultilayerGroundTexture::process(Terrain &terrain, Image &image,
     auto perlinMat = _perlin.generatePerlinNoise2D(tRes, pinfo);
 
     MultilayerElement &elem = _storage.getOrCreate(tc);
+    // The tile may be processed again, see popOutdatedTiles()
+    elem._distributions.clear();
+    bool placeholder = false;
+
+    // Height and slope do not depend on the layer
+    arma::mat heights(tRes, tRes);
+    arma::mat slopes(tRes, tRes);
+
+    for (u32 y = 0; y < tRes; ++y) {
+        for (u32 x = 0; x < tRes; ++x) {
+            vec2d uv = vec2d{vec2u{x, y}} / (tRes - 1);
+            heights(x, y) = terrain.getExactHeightAt(uv.x, uv.y);
+            slopes(x, y) =
+                std::atan(terrain.getSlopeAt(uv.x, uv.y)) * 2.0 / M_PI;
+        }
+    }
+
+    // Colors are accumulated in u16 lanes (8.8 fixed point), row after row
+    const int rowLanes = imWidth * 3;
+    std::vector<u16> accum(size_t(rowLanes) * imHeight, 0);
+    std::vector<u16> texRow(rowLanes);
+    std::vector<u16> alphaRow(rowLanes);
+    arma::mat alphaMap(imWidth, imHeight);
 
     for (size_t layer = 0; layer < _layers.size(); ++layer) {
         // Compute distribution
@@ -99,57 +182,72 @@ void MultilayerGroundTexture::process(Terrain &terrain, Image &image,
         Terrain &distrib = elem._distributions.back();
 
         DistributionParams &params = _layers.at(layer);
+        const double threshold = params.threshold * thresholdFactor;
 
         for (u32 y = 0; y < tRes; ++y) {
+            const double *h = heights.colptr(y);
+            const double *dh = slopes.colptr(y);
+            const double *t = perlinMat.colptr(y);
+
             for (u32 x = 0; x < tRes; ++x) {
                 // See shader distribution-height.frag in vkworld for more
                 // details
-                vec2d uv = vec2d{vec2u{x, y}} / (tRes - 1);
-                double h = terrain.getExactHeightAt(uv.x, uv.y);
-                double dh =
-                    std::atan(terrain.getSlopeAt(uv.x, uv.y)) * 2.0 / M_PI;
-
                 double r1 = ramp(params.ha, params.hb, params.hc, params.hd,
-                                 params.hmin, params.hmax, h);
+                                 params.hmin, params.hmax, h[x]);
                 double r2 = ramp(params.dha, params.dhb, params.dhc, params.dhd,
-                                 params.dhmin, params.dhmax, dh);
+                                 params.dhmin, params.dhmax, dh[x]);
                 double r = r1 * r2;
-                double t = perlinMat(x, y);
-
-                double threshold = params.threshold * thresholdFactor;
-                distrib(x, y) = smoothstep(r + threshold, r - threshold, t);
+                distrib(x, y) = smoothstep(r + threshold, r - threshold, t[x]);
             }
         }
 
         // Sum with final image
+        placeholder |= !_texProvider->hasTexture(int(layer), tc._lod);
         Image &layerTex = _texProvider->getTexture(layer, tc._lod);
         const int texWidth = layerTex.width();
         const int texHeight = layerTex.height();
         vec2i offset(world::mod<int>(tc._pos.x * imWidth, texWidth),
                      world::mod<int>(tc._pos.y * imHeight, texHeight));
 
+        TerrainOps::resampleCubic(distrib, {0, 0}, {1, 1}, alphaMap);
+
         for (int y = 0; y < imHeight; ++y) {
+            const double *p = alphaMap.colptr(y);
+            const int texY = (y + offset.y) % texHeight;
+
             for (int x = 0; x < imWidth; ++x) {
-                auto origin = proxy.rgba(x, y);
-                auto texPix = layerTex.rgba((x + offset.x) % texWidth,
-                                            (y + offset.y) % texHeight);
-
-                vec2d uv =
-                    vec2d{vec2i{x, y}} / vec2i{imWidth - 1, imHeight - 1};
-                double p = distrib.getCubicHeight(uv.x, uv.y);
-                double alpha = clamp(p * texPix.getAlphaf(), 0, 1);
-
-                auto &dest = proxy.rgba(x, y);
-                dest.setf(
-                    origin.getRedf() * (1 - alpha) + texPix.getRedf() * alpha,
-                    origin.getGreenf() * (1 - alpha) +
-                        texPix.getGreenf() * alpha,
-                    origin.getBluef() * (1 - alpha) + texPix.getBluef() * alpha,
-                    1);
+                auto &texPix = layerTex.rgba((x + offset.x) % texWidth, texY);
+
+                // alpha in 0.16 fixed point
+                const u16 alpha = static_cast<u16>(
+                    clamp(p[x] * texPix.getAlphaf(), 0, 1) * 65535 + 0.5);
+
+                u16 *t = &texRow[x * 3];
+                t[0] = u16(texPix.getRed() << 8);
+                t[1] = u16(texPix.getGreen() << 8);
+                t[2] = u16(texPix.getBlue() << 8);
+                alphaRow[x * 3] = alphaRow[x * 3 + 1] = alphaRow[x * 3 + 2] =
+                    alpha;
             }
+            blendRow(&accum[size_t(y) * rowLanes], texRow.data(),
+                     alphaRow.data(), rowLanes);
+        }
+    }
+
+    Image output(imWidth, imHeight, ImageType::RGB);
+
+    for (int y = 0; y < imHeight; ++y) {
+        const u16 *src = &accum[size_t(y) * rowLanes];
+
+        for (int x = 0; x < imWidth; ++x) {
+            const u16 *c = src + x * 3;
+            output.rgb(x, y).set(u8(std::min(c[0] + 128, 0xFFFF) >> 8),
+                                 u8(std::min(c[1] + 128, 0xFFFF) >> 8),
+                                 u8(std::min(c[2] + 128, 0xFFFF) >> 8));
         }
     }
 
-    image = ImageUtils::toType(proxy, ImageType::RGB);
+    image = std::move(output);
+    return placeholder;
 }
 } // namespace world
@@ -17,6 +17,15 @@ public:
 
     virtual Image &getTexture(int layer, int lod) = 0;
 
+    /** Returns false if getTexture() would return a placeholder, because
+     * the texture is not available yet. The default implementation returns
+     * true. */
+    virtual bool hasTexture(int, int) { return true; }
+
+    /** Tell the provider that the texture will be needed soon. The default
+     * implementation does nothing. */
+    virtual void prefetch(int, int) {}
+
     void configureCacheOverride(const std::string &path) {
         _cache.setRoot(path);
     }
@@ -78,6 +87,8 @@ public:
 
     GridStorageBase *getStorage() override;
 
+    void popOutdatedTiles(std::set<TileCoordinates> &keys) override;
+
     void write(WorldFile &wf) const override;
 
     void read(const WorldFile &wf) override;
@@ -89,9 +100,13 @@ private:
     std::vector<DistributionParams> _layers;
 
     Perlin _perlin;
+    /// Tiles textured with a placeholder of the texture provider
+    std::set<TileCoordinates> _placeholderTiles;
 
 
-    void process(Terrain &terrain, Image &image, const TileCoordinates &tc);
+    /** Compute the texture of the terrain. Returns true if a placeholder
+     * texture of the provider was used. */
+    bool process(Terrain &terrain, Image &image, const TileCoordinates &tc);
 };
 
 template <typename T, typename... Args>
@@ -44,8 +44,12 @@ void PerlinTerrainGenerator::setMaxOctaveCount(u32 maxOctaveCount) {
     _maxOctaves = maxOctaveCount;
 }
 
+void PerlinTerrainGenerator::setSeamless(bool seamless) {
+    _seamless = seamless;
+}
+
 void PerlinTerrainGenerator::processTerrain(Terrain &terrain) {
-    _perlin.generatePerlinNoise2D(terrain._array, _perlinInfo);
+    generate(terrain._array, _perlinInfo);
 
     // Normalize relatively to the first lod level
     TerrainOps::multiply(terrain, 1 / _perlin.getMaxPossibleValue(_perlinInfo));
@@ -57,55 +61,16 @@ void PerlinTerrainGenerator::processTile(ITileContext &context) {
 
 void PerlinTerrainGenerator::write(WorldFile &wf) const {
     wf.addUint("maxOctaves", _maxOctaves);
+    wf.addBool("seamless", _seamless);
     wf.addStruct("perlinInfo", _perlinInfo);
 }
 
 void PerlinTerrainGenerator::read(const WorldFile &wf) {
     wf.readUintOpt("maxOctaves", _maxOctaves);
+    wf.readBoolOpt("seamless", _seamless);
     wf.readStruct("perlinInfo", _perlinInfo);
 }
 
-void PerlinTerrainGenerator::processByNeighbours(world::Terrain &terrain,
-                                                 world::ITileContext &context) {
-    TileCoordinates tc = context.getCoords();
-    auto top = _storage.getopt(tc + vec2i{0, 1});
-    auto bottom = _storage.getopt(tc + vec2i{0, -1});
-    auto left = _storage.getopt(tc + vec2i{-1, 0});
-    auto right = _storage.getopt(tc + vec2i{1, 0});
-    auto topleft = _storage.getopt(tc + vec2i{-1, 1});
-    auto topright = _storage.getopt(tc + vec2i{1, 1});
-    auto bottomleft = _storage.getopt(tc + vec2i{-1, -1});
-    auto bottomright = _storage.getopt(tc + vec2i{1, -1});
-
-    const double eps = std::numeric_limits<double>::epsilon();
-
-    Perlin::modifier modifier = [&](double x, double y, double val) {
-        if (x < eps && y < eps && bottomleft) {
-            return bottomleft->_terrain.getExactHeightAt(1, 1);
-        } else if (x < eps && 1 - y < eps && topleft) {
-            return topleft->_terrain.getExactHeightAt(1, 0);
-        } else if (1 - x < eps && y < eps && bottomright) {
-            return bottomright->_terrain.getExactHeightAt(0, 1);
-        } else if (1 - x < eps && 1 - y < eps && topright) {
-            return topright->_terrain.getExactHeightAt(0, 0);
-        } else if (x < eps && left) {
-            return left->_terrain.getExactHeightAt(1, y);
-        } else if (1 - x < eps && right) {
-            return right->_terrain.getExactHeightAt(0, y);
-        } else if (y < eps && bottom) {
-            return bottom->_terrain.getExactHeightAt(x, 1);
-        } else if (1 - y < eps && top) {
-            return top->_terrain.getExactHeightAt(x, 0);
-        } else {
-            return val;
-        }
-    };
-
-    _perlin.generatePerlinNoise2D(terrain._array, _perlinInfo, modifier);
-
-    _storage.set(tc, terrain);
-}
-
 void PerlinTerrainGenerator::processByTileCoords(Terrain &terrain,
                                                  ITileContext &context) {
     PerlinInfo localInfo = _perlinInfo;
@@ -120,10 +85,19 @@ void PerlinTerrainGenerator::processByTileCoords(Terrain &terrain,
     if (_maxOctaves > 0 && localInfo.octaves > _maxOctaves)
         localInfo.octaves = _maxOctaves;
 
-    _perlin.generatePerlinNoise2D(terrain._array, localInfo);
+    generate(terrain._array, localInfo);
 
     // Normalize relatively to the first lod level
     TerrainOps::multiply(terrain, 1 / _perlin.getMaxPossibleValue(_perlinInfo));
 }
 
+void PerlinTerrainGenerator::generate(arma::mat &output,
+                                      const PerlinInfo &info) {
+    if (_seamless) {
+        _perlin.generateGradientNoise2D(output, info);
+    } else {
+        _perlin.generatePerlinNoise2D(output, info);
+    }
+}
+
 } // namespace world
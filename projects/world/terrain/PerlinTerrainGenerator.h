@@ -3,7 +3,6 @@
 #include "world/core/WorldConfig.h"
 
 #include <memory>
-#include <map>
 #include <utility>
 
 #include "world/core/WorldTypes.h"
@@ -30,6 +29,13 @@ public:
      * have at maximum. 0 for unlimited.*/
     void setMaxOctaveCount(u32 maxOctaveCount);
 
+    /** In seamless mode, the generator uses gradient noise evaluated at
+     * absolute world coordinates (see Perlin::generateGradientNoise2D).
+     * Each tile is then fully determined by its coordinates: tiles can be
+     * generated in any order, at any lod, and always match at their
+     * borders. */
+    void setSeamless(bool seamless);
+
     void processTerrain(Terrain &terrain) override;
 
     void processTile(ITileContext &context) override;
@@ -42,11 +48,10 @@ private:
     PerlinInfo _perlinInfo;
     Perlin _perlin;
     u32 _maxOctaves = 0;
-
-    TerrainGrid _storage;
-
-    void processByNeighbours(Terrain &terrain, ITileContext &context);
+    bool _seamless = false;
 
     void processByTileCoords(Terrain &terrain, ITileContext &context);
+
+    void generate(arma::mat &output, const PerlinInfo &info);
 };
 } // namespace world
@@ -48,23 +48,18 @@ void ReliefMapModifier::processTerrain(Terrain &terrain) {
     arma::mat bufferOffset(size, size);
     arma::mat bufferDiff(size, size);
 
-    for (int x = 0; x < size; x++) {
-        for (int y = 0; y < size; y++) {
-            double mapX = mapOx + ((double)x / (size - 1)) * ratio;
-            double mapY = mapOy + ((double)y / (size - 1)) * ratio;
-
-            double offset = heightMap.getCubicHeight(mapX, mapY) * offsetCoef;
-            double diff = diffMap.getCubicHeight(mapX, mapY) * diffCoef;
-
-            bufferOffset(x, y) = offset;
-            bufferDiff(x, y) = diff;
-
-            // to unapply
-            // bufferOffset(x, y) = -offset;
-            // bufferDiff(x, y) = diff > std::numeric_limits<double>::epsilon()
-            // ? 1 / diff : 0;
-        }
-    }
+    const vec2d mapOrigin{mapOx, mapOy};
+    const vec2d mapSpan{ratio, ratio};
+    TerrainOps::resampleCubic(heightMap, mapOrigin, mapSpan, bufferOffset);
+    TerrainOps::resampleCubic(diffMap, mapOrigin, mapSpan, bufferDiff);
+    bufferOffset *= offsetCoef;
+    bufferDiff *= diffCoef;
+
+    // to unapply
+    // bufferOffset = -bufferOffset;
+    // bufferDiff.transform([](double diff) {
+    //     return diff > std::numeric_limits<double>::epsilon() ? 1 / diff : 0;
+    // });
 
     TerrainOps::multiply(terrain, bufferDiff);
     TerrainOps::applyOffset(terrain, bufferOffset);
@@ -153,6 +148,10 @@ void CustomWorldRMModifier::setBiomeDensity(float biomeDensity) {
 
 void CustomWorldRMModifier::setLimitBrightness(int p) { _limitBrightness = p; }
 
+void CustomWorldRMModifier::setNeighbourCount(int count) {
+    _neighbourCount = count;
+}
+
 void CustomWorldRMModifier::setDifferentialLaw(const AltDiffParam &law) {
     _diffLaw = law;
 }
@@ -265,6 +264,7 @@ void CustomWorldRMModifier::generate(Terrain &height, Terrain &heightDiff) {
 
     // Cration des interpolateur
     IDWInterpolator<vec2d, vec2d> interpolator(_limitBrightness);
+    interpolator.setNeighbourCount(_neighbourCount);
 
     // On prpare les donnes  interpoler.
     for (auto &slice : pointsMap) {
@@ -296,6 +296,7 @@ void CustomWorldRMModifier::write(WorldFile &wf) const {
 
     wf.addDouble("biomeDensity", _biomeDensity);
     wf.addInt("limitBrightness", _limitBrightness);
+    wf.addInt("neighbourCount", _neighbourCount);
 }
 
 void CustomWorldRMModifier::read(const WorldFile &wf) {
@@ -303,5 +304,6 @@ void CustomWorldRMModifier::read(const WorldFile &wf) {
 
     wf.readDoubleOpt("biomeDensity", _biomeDensity);
     wf.readIntOpt("limitBrightness", _limitBrightness);
+    wf.readIntOpt("neighbourCount", _neighbourCount);
 }
 } // namespace world
@@ -68,6 +68,11 @@ public:
 
     void setLimitBrightness(int);
 
+    /** Set the number of nearest biomes used to interpolate each point of
+     * the relief map. 0 means all the biomes are used, which gets slow when
+     * there are many of them. */
+    void setNeighbourCount(int count);
+
     void setDifferentialLaw(const AltDiffParam &law);
 
     void write(WorldFile &wf) const;
@@ -85,6 +90,7 @@ private:
     /** La nettet des limites entre les biomes. En pratique c'est
      *le "p" dans l'algo de l'interpolation. */
     int _limitBrightness;
+    int _neighbourCount = 0;
 
     /** Probability law for altitude offset. */
     ElevationParam _offsetLaw;
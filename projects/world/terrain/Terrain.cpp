@@ -89,19 +89,7 @@ double Terrain::getRawHeight(double x, double y) const {
 
 double Terrain::getInterpolatedHeight(
     double x, double y, const Interpolation::interpFunc &func) const {
-    int width = (int)(_array.n_rows - 1);
-    int height = (int)(_array.n_cols - 1);
-
-    x *= width;
-    y *= height;
-    int xi = clamp((int)floor(x), 0, width - 1);
-    int yi = clamp((int)floor(y), 0, height - 1);
-
-    double v1 = Interpolation::interpolate(xi, _array(xi, yi), xi + 1,
-                                           _array(xi + 1, yi), x, func);
-    double v2 = Interpolation::interpolate(xi, _array(xi, yi + 1), xi + 1,
-                                           _array(xi + 1, yi + 1), x, func);
-    return Interpolation::interpolate(yi, v1, yi + 1, v2, y, func);
+    return getInterpolatedHeight<Interpolation::interpFunc>(x, y, func);
 }
 
 double Terrain::getCubicHeight(double x, double y) const {
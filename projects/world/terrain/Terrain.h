@@ -66,6 +66,12 @@ public:
     double getInterpolatedHeight(double x, double y,
                                  const Interpolation::interpFunc &func) const;
 
+    /** Same as above, but the interpolation function is a functor type
+     * (for example Interpolation::Linear) that can be inlined. */
+    template <typename Interp>
+    double getInterpolatedHeight(double x, double y,
+                                 const Interp &interp) const;
+
     /** Get the height of the terrain at the specified point.
      * The height given by this method corresponds to the exact
      * height of the terrain mesh at the point (x, y), given
@@ -122,4 +128,23 @@ private:
 
     vec2i getPixelPos(double x, double y) const;
 };
+
+template <typename Interp>
+double Terrain::getInterpolatedHeight(double x, double y,
+                                      const Interp &interp) const {
+    int width = (int)(_array.n_rows - 1);
+    int height = (int)(_array.n_cols - 1);
+
+    x *= width;
+    y *= height;
+    int xi = clamp((int)floor(x), 0, width - 1);
+    int yi = clamp((int)floor(y), 0, height - 1);
+
+    double v1 = Interpolation::interpolate(xi, _array.at(xi, yi), xi + 1,
+                                           _array.at(xi + 1, yi), x, interp);
+    double v2 =
+        Interpolation::interpolate(xi, _array.at(xi, yi + 1), xi + 1,
+                                   _array.at(xi + 1, yi + 1), x, interp);
+    return Interpolation::interpolate(yi, v1, yi + 1, v2, y, interp);
+}
 } // namespace world
@@ -85,6 +85,139 @@ void TerrainOps::copyNeighbours(Terrain &terrain, const TileCoordinates &coords,
     }
 }
 
+template <int N> struct ResampleTaps {
+    arma::uword _ids[N];
+    double _weights[N];
+};
+
+/** Compute taps of Terrain::getCubicHeight for each output sample along one
+ * axis. Weights are the coefficients of cuberp() for each value. */
+std::vector<ResampleTaps<4>> getCubicTaps(arma::uword count, double origin,
+                                          double size, int res) {
+    std::vector<ResampleTaps<4>> taps(count);
+    const double step = count > 1 ? size / (count - 1) : 0;
+
+    for (arma::uword i = 0; i < count; ++i) {
+        const double x = (origin + i * step) * res;
+        const int xi = static_cast<int>(floor(x));
+        const double t = x - xi;
+        const double t2 = t * t;
+        const double t3 = t * t2;
+
+        auto &tap = taps[i];
+        tap._weights[0] = -t3 / 2. + t2 - t / 2.;
+        tap._weights[1] = 3. * t3 / 2. - 5. * t2 / 2. + 1.;
+        tap._weights[2] = -3. * t3 / 2. + 2. * t2 + t / 2.;
+        tap._weights[3] = t3 / 2. - t2 / 2.;
+
+        for (int k = 0; k < 4; ++k) {
+            tap._ids[k] = static_cast<arma::uword>(clamp(xi + k, 0, res - 1));
+        }
+    }
+
+    return taps;
+}
+
+/** Compute taps of Terrain::getInterpolatedHeight with linear interpolation
+ * for each output sample along one axis. */
+std::vector<ResampleTaps<2>> getLinearTaps(arma::uword count, double origin,
+                                           double size, int res) {
+    std::vector<ResampleTaps<2>> taps(count);
+    const double step = count > 1 ? size / (count - 1) : 0;
+    const int width = res - 1;
+
+    for (arma::uword i = 0; i < count; ++i) {
+        const double x = (origin + i * step) * width;
+        const int xi = clamp(static_cast<int>(floor(x)), 0, width - 1);
+        const double t = clamp(x - xi, 0, 1);
+
+        auto &tap = taps[i];
+        tap._ids[0] = static_cast<arma::uword>(xi);
+        tap._ids[1] = static_cast<arma::uword>(xi + 1);
+        tap._weights[0] = 1 - t;
+        tap._weights[1] = t;
+    }
+
+    return taps;
+}
+
+/** Apply separable interpolation to src. First pass interpolates along y
+ * for all the source lines that are used, second pass interpolates along
+ * x. */
+template <int N>
+void resampleSeparable(const arma::mat &src,
+                       const std::vector<ResampleTaps<N>> &xTaps,
+                       const std::vector<ResampleTaps<N>> &yTaps,
+                       arma::mat &output) {
+    arma::uword xmin = src.n_rows, xmax = 0;
+
+    for (const auto &tap : xTaps) {
+        for (int k = 0; k < N; ++k) {
+            xmin = std::min(xmin, tap._ids[k]);
+            xmax = std::max(xmax, tap._ids[k]);
+        }
+    }
+
+    if (xmin > xmax) {
+        return;
+    }
+
+    // Pass 1: along y
+    arma::mat buffer(xmax - xmin + 1, output.n_cols);
+
+    for (arma::uword y = 0; y < output.n_cols; ++y) {
+        const auto &tap = yTaps[y];
+        const double *srcCols[N];
+
+        for (int k = 0; k < N; ++k) {
+            srcCols[k] = src.colptr(tap._ids[k]) + xmin;
+        }
+
+        double *dst = buffer.colptr(y);
+
+        for (arma::uword x = 0; x < buffer.n_rows; ++x) {
+            double sum = 0;
+
+            for (int k = 0; k < N; ++k) {
+                sum += tap._weights[k] * srcCols[k][x];
+            }
+            dst[x] = sum;
+        }
+    }
+
+    // Pass 2: along x
+    for (arma::uword y = 0; y < output.n_cols; ++y) {
+        const double *col = buffer.colptr(y) - xmin;
+        double *dst = output.colptr(y);
+
+        for (arma::uword x = 0; x < output.n_rows; ++x) {
+            const auto &tap = xTaps[x];
+            double sum = 0;
+
+            for (int k = 0; k < N; ++k) {
+                sum += tap._weights[k] * col[tap._ids[k]];
+            }
+            dst[x] = sum;
+        }
+    }
+}
+
+void TerrainOps::resampleCubic(const Terrain &terrain, const vec2d &origin,
+                               const vec2d &size, arma::mat &output) {
+    const int res = terrain.getResolution();
+    auto xTaps = getCubicTaps(output.n_rows, origin.x, size.x, res);
+    auto yTaps = getCubicTaps(output.n_cols, origin.y, size.y, res);
+    resampleSeparable(terrain._array, xTaps, yTaps, output);
+}
+
+void TerrainOps::resampleLinear(const Terrain &terrain, const vec2d &origin,
+                                const vec2d &size, arma::mat &output) {
+    const int res = terrain.getResolution();
+    auto xTaps = getLinearTaps(output.n_rows, origin.x, size.x, res);
+    auto yTaps = getLinearTaps(output.n_cols, origin.y, size.y, res);
+    resampleSeparable(terrain._array, xTaps, yTaps, output);
+}
+
 vec2d TerrainOps::computeZBounds(const Terrain &terrain) {
     vec2d bounds{std::numeric_limits<double>::max(),
                  std::numeric_limits<double>::min()};
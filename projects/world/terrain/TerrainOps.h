@@ -22,6 +22,27 @@ public:
     static void copyNeighbours(Terrain &terrain, const TileCoordinates &coords,
                                const TerrainGrid &storage);
 
+    /** Resample a region of the terrain onto the whole output matrix, using
+     * the same bicubic interpolation as Terrain::getCubicHeight. This is
+     * equivalent to:
+     *
+     * output(x, y) = terrain.getCubicHeight(
+     *     origin.x + x / (output.n_rows - 1) * size.x,
+     *     origin.y + y / (output.n_cols - 1) * size.y)
+     *
+     * but the interpolation weights are computed once per line and column,
+     * and the interpolation is done in two separable passes.
+     * @param origin lower corner of the region, in terrain coordinates
+     * (between 0 and 1)
+     * @param size size of the region, in terrain coordinates */
+    static void resampleCubic(const Terrain &terrain, const vec2d &origin,
+                              const vec2d &size, arma::mat &output);
+
+    /** Same as resampleCubic, but with the bilinear interpolation of
+     * Terrain::getInterpolatedHeight(x, y, Interpolation::LINEAR). */
+    static void resampleLinear(const Terrain &terrain, const vec2d &origin,
+                               const vec2d &size, arma::mat &output);
+
     /** Find the min value and the max value of this terrain.
      * \returns vec2d{min value, max value} */
     static vec2d computeZBounds(const Terrain &terrain);
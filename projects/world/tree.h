@@ -3,6 +3,7 @@
 
 #include "tree/LeavesGenerator.h"
 #include "tree/Tree.h"
+#include "tree/TreeVariantPool.h"
 #include "tree/TreeSkelettonGenerator.h"
 #include "tree/TreeSkeletton.h"
 #include "tree/TreeSkelettonParameters.h"
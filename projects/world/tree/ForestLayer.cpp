@@ -1,23 +1,23 @@
 #include "ForestLayer.h"
 
+#include <random>
+
 #include "world/core/Chunk.h"
+#include "world/assets/ImageUtils.h"
+#include "world/math/BlueNoise.h"
 
 namespace world {
 
 WORLD_REGISTER_CHILD_CLASS(IChunkDecorator, ForestLayer, "ForestLayer")
 
 ForestLayer::ForestLayer()
-        : _rng(static_cast<u32>(time(NULL))),
-          _templateTree(std::make_unique<Tree>()),
+        : _templateTree(std::make_unique<Tree>()),
+          _rng(static_cast<u32>(time(NULL))), _seed(_rng()),
           _treeSprite(3, 3, ImageType::RGB) {
 
     _templateTree->randomize();
 
-    for (int x = 0; x < 3; ++x) {
-        for (int y = 0; y < 3; ++y) {
-            _treeSprite.rgb(x, y).setf(0.05, 0.35, 0.0);
-        }
-    }
+    ImageUtils::fill(_treeSprite, Color4d(0.05, 0.35, 0.0, 1));
 }
 
 void ForestLayer::decorate(Chunk &chunk, const ExplorationContext &ctx) {
@@ -32,42 +32,43 @@ void ForestLayer::decorate(Chunk &chunk, const ExplorationContext &ctx) {
 
     const IEnvironment &env = ctx.getEnvironment();
 
-    // Compute area
+    if (_variantCount != 0 && !_variantPool) {
+        _variantPool =
+            std::make_shared<TreeVariantPool>(*_templateTree, _variantCount);
+        _variantPool->setImpostorResolution(_impostorRes);
+    }
+
     vec3d chunkSize = chunk.getSize();
     vec3d chunkOffset = chunk.getPosition3D();
-    const double area = chunkSize.x * chunkSize.y;
-
-    // Max tree count
-    std::uniform_real_distribution<double> stddistrib(0, 1);
-    double maxTreeCountf = _maxDensity * area / 1e6;
-    u32 maxTreeCount = static_cast<u32>(floor(maxTreeCountf));
 
-    if (stddistrib(_rng) < maxTreeCountf - maxTreeCount) {
-        maxTreeCount++;
-    }
+    // Evenly spaced points at the maximum density. The pattern is the same
+    // for all the chunks, so that trees are placed identically each time a
+    // chunk is generated, and it is shifted according to the seed of the
+    // layer.
+    auto samples = BlueNoiseTile::getDefault().getSamples(
+        {chunkOffset.x, chunkOffset.y},
+        {chunkOffset.x + chunkSize.x, chunkOffset.y + chunkSize.y},
+        _maxDensity / 1e6, getPatternOffset());
 
-    // Generate random points
-    std::vector<vec2d> randomPoints;
-    randomPoints.reserve(maxTreeCount);
+    // Populate trees
+    int remainingTrees = 0;
+    Tree *trees = nullptr;
 
-    // TODO use a method that includes a minimal distance between points
-    std::uniform_real_distribution<double> xdistrib(0, chunkSize.x);
-    std::uniform_real_distribution<double> ydistrib(0, chunkSize.y);
+    std::vector<vec3d> groundPoints;
+    groundPoints.reserve(samples.size());
 
-    for (u32 i = 0; i < maxTreeCount; ++i) {
-        randomPoints.emplace_back(xdistrib(_rng), ydistrib(_rng));
+    for (auto &sample : samples) {
+        groundPoints.emplace_back(sample._position.x, sample._position.y, 0);
     }
 
-    // Populate trees
-    int remainingTrees = 0;
-    Tree *trees = nullptr;
+    ctx.getEnvironment().findNearestFreePoints(
+        groundPoints.data(), groundPoints.data(), groundPoints.size(),
+        {0, 0, 1}, resolution, ctx);
 
-    for (auto &pt : randomPoints) {
-        vec3d origin{chunkOffset.x + pt.x, chunkOffset.y + pt.y, 0};
-        const double altitude =
-            ctx.getEnvironment()
-                .findNearestFreePoint(origin, {0, 0, 1}, resolution, ctx)
-                .z;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const vec2d pt = samples[i]._position - vec2d{chunkOffset.x,
+                                                      chunkOffset.y};
+        const double altitude = groundPoints[i].z;
 
         // skip if altitude is not in this chunk
         if (altitude < chunkOffset.z ||
@@ -75,16 +76,23 @@ void ForestLayer::decorate(Chunk &chunk, const ExplorationContext &ctx) {
             continue;
         }
 
-        if (stddistrib(_rng) < getDensityAtAltitude(altitude)) {
+        // Thinning by rank keeps the remaining trees evenly spaced
+        if (samples[i]._rank < getDensityAtAltitude(altitude)) {
             if (remainingTrees <= 0) {
                 trees = &chunk.addChild<Tree>();
                 trees->setup(*_templateTree);
+                trees->setVariantPool(_variantPool);
                 trees->setPosition3D(chunkSize / 2.0);
                 remainingTrees = 50; // treeGroup->maxTreeCount();
             }
 
             vec3d pos{pt.x, pt.y, altitude - chunkOffset.z};
-            trees->addTree(pos - chunkSize / 2.0);
+            TreeVariant variant;
+
+            if (_variantPool) {
+                variant = _variantPool->pick(groundPoints[i]);
+            }
+            trees->addTree(pos - chunkSize / 2.0, variant);
             --remainingTrees;
 
             /*ground.paintTexture(
@@ -94,10 +102,26 @@ void ForestLayer::decorate(Chunk &chunk, const ExplorationContext &ctx) {
     }
 }
 
+void ForestLayer::setVariantCount(u32 variantCount) {
+    _variantCount = variantCount;
+    _variantPool.reset();
+}
+
+void ForestLayer::setImpostorResolution(double resolution) {
+    _impostorRes = resolution;
+
+    if (_variantPool) {
+        _variantPool->setImpostorResolution(resolution);
+    }
+}
+
 void ForestLayer::write(WorldFile &wf) const {
     wf.addChild("templateTree",
                 dynamic_cast<WorldNode &>(*_templateTree).serialize());
     wf.addDouble("maxDensity", _maxDensity);
+    wf.addUint("variantCount", _variantCount);
+    wf.addDouble("impostorResolution", _impostorRes);
+    wf.addUint("seed", _seed);
 }
 
 void ForestLayer::read(const WorldFile &wf) {
@@ -106,6 +130,10 @@ void ForestLayer::read(const WorldFile &wf) {
         _templateTree->read(wf.readChild("templateTree"));
     }
     wf.readDoubleOpt("maxDensity", _maxDensity);
+    wf.readUintOpt("variantCount", _variantCount);
+    wf.readDoubleOpt("impostorResolution", _impostorRes);
+    wf.readUintOpt("seed", _seed);
+    _variantPool.reset();
 }
 
 double ForestLayer::getDensityAtAltitude(double altitude) {
@@ -129,4 +157,13 @@ double ForestLayer::getDensityAtAltitude(double altitude) {
         return 0;
 }
 
+vec2d ForestLayer::getPatternOffset() const {
+    // The offset only has to differ between the layers: the variants of the
+    // blue noise tile already avoid the repetitions within a layer
+    std::minstd_rand rng(_seed);
+    std::uniform_real_distribution<double> offsetDistrib(0, 1000);
+    const double x = offsetDistrib(rng);
+    return {x, offsetDistrib(rng)};
+}
+
 } // namespace world
@@ -9,6 +9,7 @@
 #include "world/flat/FlatWorld.h"
 #include "world/assets/Image.h"
 #include "Tree.h"
+#include "TreeVariantPool.h"
 
 namespace world {
 
@@ -19,14 +20,44 @@ public:
 
     void decorate(Chunk &chunk, const ExplorationContext &ctx) override;
 
+    /** Set the count of tree variants shared by all the trees of the layer.
+     * More variants give more variety, less variants make the forest faster
+     * to generate and lighter in memory. If 0, each tree is unique. */
+    void setVariantCount(u32 variantCount);
+
+    u32 getVariantCount() const { return _variantCount; }
+
+    /** Set the resolution below which trees are drawn as impostors. Only
+     * used when the trees are drawn from a pool of variants, see
+     * TreeVariantPool::setImpostorResolution(). */
+    void setImpostorResolution(double resolution);
+
+    double getImpostorResolution() const { return _impostorRes; }
+
+    /** Set the seed from which the layout of the trees is derived. Layers
+     * with different seeds place their trees differently. The seed is
+     * random by default. */
+    void setSeed(u32 seed) { _seed = seed; }
+
+    u32 getSeed() const { return _seed; }
+
+    /** Get the pool of tree variants, or nullptr if the trees are unique or
+     * if no tree was placed yet. */
+    const TreeVariantPool *getVariantPool() const {
+        return _variantPool.get();
+    }
+
     void write(WorldFile &wf) const override;
 
     void read(const WorldFile &wf) override;
 
 private:
-    std::mt19937 _rng;
-
     std::unique_ptr<Tree> _templateTree;
+    std::shared_ptr<TreeVariantPool> _variantPool;
+    u32 _variantCount = 16;
+    double _impostorRes = 4;
+    std::mt19937 _rng;
+    u32 _seed;
 
     Image _treeSprite;
 
@@ -37,6 +68,9 @@ private:
     // complexity
 
     double getDensityAtAltitude(double altitude);
+
+    /** Offset of the blue noise pattern, derived from the seed. */
+    vec2d getPatternOffset() const;
 };
 
 } // namespace world
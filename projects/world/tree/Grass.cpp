@@ -5,6 +5,7 @@
 #include "../math/Bezier.h"
 #include "../math/RandomHelper.h"
 #include "world/assets/MeshOps.h"
+#include "world/assets/ImageUtils.h"
 
 namespace world {
 
@@ -23,6 +24,7 @@ void Grass::addBush(const vec3d &root) {
 
     _meshes.emplace_back();
     auto &mesh = _meshes.back();
+    updateGeneration();
 
     for (u32 i = 0; i < _grassCount; ++i) {
         double bladeAngle = angle(_rng);
@@ -38,6 +40,7 @@ void Grass::addBush(const vec3d &root) {
 void Grass::removeAllBushes() {
     _points.clear();
     _meshes.clear();
+    updateGeneration();
 }
 
 std::vector<Template> Grass::collectTemplates(ICollector &collector,
@@ -149,13 +152,7 @@ void Grass::addBlade(const vec3d &root, const vec3d &bottom, Mesh &mesh) {
 }
 
 void Grass::generateTexture() {
-    // Pixel per pixel shading
-
-    for (int y = 0; y < _texture.height(); ++y) {
-        for (int x = 0; x < _texture.width(); ++x) {
-            _texture.rgb(x, y).setf(0.4, 0.8, 0.2);
-        }
-    }
+    ImageUtils::fill(_texture, Color4d(0.4, 0.8, 0.2, 1));
 }
 
 HabitatFeatures Grass::randomize() {
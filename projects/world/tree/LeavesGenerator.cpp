@@ -1,5 +1,8 @@
 #include "LeavesGenerator.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "Tree.h"
 #include "world/assets/MeshOps.h"
 
@@ -7,35 +10,124 @@ namespace world {
 
 WORLD_REGISTER_CHILD_CLASS(ITreeWorker, LeavesGenerator, "LeavesGenerator")
 
+static const double LEAF_HALF_WIDTH = 0.04;
+static const double LEAF_HEIGHT = 0.13;
+
+/** Euler angles of the rotation whose columns are the given axes. The
+ * angles are applied around x, then y, then z. */
+static vec3d toEulerAngles(const vec3d &ax, const vec3d &ay, const vec3d &az) {
+    const double beta = std::asin(std::max(-1.0, std::min(-ax.z, 1.0)));
+
+    // At the poles, the rotations around x and z are the same
+    if (std::abs(std::cos(beta)) < 1e-9) {
+        return {0, beta, std::atan2(-ay.x, ay.y)};
+    }
+    return {std::atan2(ay.z, az.z), beta, std::atan2(ax.y, ax.x)};
+}
+
+/** Axes of the rotation given by Euler angles, see toEulerAngles(). */
+static void fromEulerAngles(const vec3d &angles, vec3d &ax, vec3d &ay,
+                            vec3d &az) {
+    const double ca = std::cos(angles.x), sa = std::sin(angles.x);
+    const double cb = std::cos(angles.y), sb = std::sin(angles.y);
+    const double cg = std::cos(angles.z), sg = std::sin(angles.z);
+
+    ax = {cg * cb, sg * cb, -sb};
+    ay = {cg * sb * sa - sg * ca, sg * sb * sa + cg * ca, cb * sa};
+    az = {cg * sb * ca + sg * sa, sg * sb * ca - cg * sa, cb * ca};
+}
+
 LeavesGenerator::LeavesGenerator(double leafDensity, double weightThreshold)
-        : _rng(static_cast<u32>(time(NULL))), _distrib(0, 1),
-          _leafDensity(leafDensity), _weightThreshold(weightThreshold) {}
+        : _leafDensity(leafDensity), _weightThreshold(weightThreshold) {}
 
 void LeavesGenerator::setLeafDensity(double density) { _leafDensity = density; }
 
+void LeavesGenerator::setLeafCards(bool leafCards) { _leafCards = leafCards; }
+
 void LeavesGenerator::process(TreeInstance &tree) {
-    Mesh &leaves = tree._leavesMesh;
-    Mesh &trunk = tree._trunkMesh;
     TreeSkeletton &skeletton = tree._skeletton;
+    // The leaves only depend on the seed of the tree, so that the trees can
+    // be generated on any thread. The stream differs from the skeleton one.
+    std::mt19937 rng(tree._seed ^ 0x5bd1e995u);
 
-    processNode(*skeletton.getPrimaryNode(), leaves, trunk);
+    processNode(*skeletton.getPrimaryNode(), tree, rng);
 
-    MeshOps::singleToDoubleSided(leaves);
+    if (!_leafCards) {
+        MeshOps::singleToDoubleSided(tree._leavesMesh);
+    }
 }
 
 LeavesGenerator *LeavesGenerator::clone() const {
     return new LeavesGenerator(*this);
 }
 
+void LeavesGenerator::write(WorldFile &wf) const {
+    wf.addDouble("leafDensity", _leafDensity);
+    wf.addDouble("weightThreshold", _weightThreshold);
+    wf.addBool("leafCards", _leafCards);
+}
+
+void LeavesGenerator::read(const WorldFile &wf) {
+    wf.readDoubleOpt("leafDensity", _leafDensity);
+    wf.readDoubleOpt("weightThreshold", _weightThreshold);
+    wf.readBoolOpt("leafCards", _leafCards);
+}
+
+Mesh LeavesGenerator::createLeafCard() {
+    // The card grows along z from its origin, and faces y
+    Mesh card;
+    const vec3d normal{0, 1, 0};
+    card.newVertex({LEAF_HALF_WIDTH, 0, 0}, normal, {1, 0});
+    card.newVertex({-LEAF_HALF_WIDTH, 0, 0}, normal, {0, 0});
+    card.newVertex({-LEAF_HALF_WIDTH, 0, LEAF_HEIGHT}, normal, {0, 1});
+    card.newVertex({LEAF_HALF_WIDTH, 0, LEAF_HEIGHT}, normal, {1, 1});
+    card.newFace(0, 1, 2);
+    card.newFace(0, 2, 3);
+    return card;
+}
+
+void LeavesGenerator::expandLeafCards(
+    const std::vector<InstanceTransform> &cards, Mesh &mesh) {
+    const Mesh card = createLeafCard();
+    const u32 cardVertCount = card.getVerticesCount();
+    mesh.reserveVertices(cardVertCount * static_cast<u32>(cards.size()));
+    mesh.reserveFaces(card.getFaceCount() * static_cast<int>(cards.size()));
+
+    for (const InstanceTransform &transform : cards) {
+        const vec3d position = transform._position;
+        const vec3d scale = transform._scale;
+        vec3d ax, ay, az;
+        fromEulerAngles(transform._rotation, ax, ay, az);
+
+        const int idStart = mesh.getVerticesCount();
+
+        for (u32 i = 0; i < cardVertCount; ++i) {
+            const Vertex &vert = card.getVertex(i);
+            const vec3d p = vert.getPosition() * scale;
+            const vec3d n = vert.getNormal();
+            mesh.newVertex(position + ax * p.x + ay * p.y + az * p.z,
+                           ax * n.x + ay * n.y + az * n.z, vert.getTexture());
+        }
+
+        for (u32 i = 0; i < card.getFaceCount(); ++i) {
+            const Face &face = card.getFace(i);
+            mesh.newFace(face.getID(0) + idStart, face.getID(1) + idStart,
+                         face.getID(2) + idStart);
+        }
+    }
+}
+
 void LeavesGenerator::processNode(SkelettonNode<TreeInfo> &node,
-                                  Mesh &leavesMesh, Mesh &trunkMesh) {
+                                  TreeInstance &tree,
+                                  std::mt19937 &rng) const {
+    std::uniform_real_distribution<double> distrib(0, 1);
     auto &nodeInfo = node.getInfo();
 
     if (nodeInfo._weight < _weightThreshold) {
         for (int i = nodeInfo._firstVert; i < nodeInfo._lastVert; ++i) {
-            if (_leafDensity > _distrib(_rng)) {
-                auto &vert = trunkMesh.getVertex(i);
-                addLeaf(leavesMesh, vert.getPosition(), vert.getNormal());
+            if (_leafDensity > distrib(rng)) {
+                auto &vert = tree._trunkMesh.getVertex(i);
+                addLeaf(tree, vert.getPosition(), vert.getNormal(), rng);
             }
         }
     }
@@ -43,12 +135,12 @@ void LeavesGenerator::processNode(SkelettonNode<TreeInfo> &node,
     auto &children = node.getChildrenOrNeighboursAccess();
 
     for (auto child : children) {
-        processNode(*child, leavesMesh, trunkMesh);
+        processNode(*child, tree, rng);
     }
 }
 
-void LeavesGenerator::addLeaf(Mesh &mesh, const vec3d &position,
-                              const vec3d &normal) {
+void LeavesGenerator::addLeaf(TreeInstance &tree, const vec3d &position,
+                              const vec3d &normal, std::mt19937 &rng) const {
     // Compute missing base vectors
     vec3d ez{0, 0, 1};
     vec3d ax = ez.crossProduct(normal);
@@ -62,9 +154,8 @@ void LeavesGenerator::addLeaf(Mesh &mesh, const vec3d &position,
     vec3d ay = ax.crossProduct(normal);
 
     // Create a square
-    double hwidth = 0.04;
-    double height = 0.13;
-    double angle = _distrib(_rng) * M_PI;
+    std::uniform_real_distribution<double> distrib(0, 1);
+    double angle = distrib(rng) * M_PI;
 
     double cs = cos(angle);
     double sn = sin(angle);
@@ -77,14 +168,25 @@ void LeavesGenerator::addLeaf(Mesh &mesh, const vec3d &position,
         leafNormal = leafNormal * (-1);
     }
 
-    vec3d v1 = position + sideVec * hwidth;
-    vec3d v2 = position - sideVec * hwidth;
+    if (_leafCards) {
+        // The card faces y and grows along z, and its axes must be direct
+        const vec3d cardZ = normal.normalize();
+        const vec3d cardY = leafNormal.normalize();
+        const vec3d cardX = cardY.crossProduct(cardZ);
+        tree._leafCards.push_back(
+            {position, toEulerAngles(cardX, cardY, cardZ), {1}});
+        return;
+    }
+
+    vec3d v1 = position + sideVec * LEAF_HALF_WIDTH;
+    vec3d v2 = position - sideVec * LEAF_HALF_WIDTH;
 
+    Mesh &mesh = tree._leavesMesh;
     int idStart = mesh.getVerticesCount();
     mesh.newVertex(v1, leafNormal);
     mesh.newVertex(v2, leafNormal);
-    mesh.newVertex(v2 + normal * height, leafNormal);
-    mesh.newVertex(v1 + normal * height, leafNormal);
+    mesh.newVertex(v2 + normal * LEAF_HEIGHT, leafNormal);
+    mesh.newVertex(v1 + normal * LEAF_HEIGHT, leafNormal);
 
     int ids[][3] = {{idStart, idStart + 1, idStart + 2},
                     {idStart, idStart + 2, idStart + 3}};
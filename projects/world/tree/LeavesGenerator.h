@@ -4,10 +4,12 @@
 #include "world/core/WorldConfig.h"
 
 #include <random>
+#include <vector>
 
 #include "ITreeWorker.h"
 #include "TreeSkeletton.h"
 #include "world/assets/Mesh.h"
+#include "world/assets/InstanceBuffer.h"
 
 namespace world {
 
@@ -18,21 +20,43 @@ public:
 
     void setLeafDensity(double density);
 
+    /** Generate the leaves as leaf cards instead of geometry. Each leaf is
+     * then a transform of the card returned by createLeafCard(), stored in
+     * TreeInstance::_leafCards, and the leaves mesh stays empty. The card
+     * is single sided and must be drawn with a double sided material.
+     * Leaves are generated as geometry by default. */
+    void setLeafCards(bool leafCards);
+
+    bool hasLeafCards() const { return _leafCards; }
+
     void process(TreeInstance &tree) override;
 
     LeavesGenerator *clone() const override;
 
-private:
-    std::mt19937 _rng;
-    std::uniform_real_distribution<double> _distrib;
+    void write(WorldFile &wf) const override;
+
+    void read(const WorldFile &wf) override;
 
+    /** Create the mesh of a single leaf card, in the space of the card. */
+    static Mesh createLeafCard();
+
+    /** Add the geometry of each leaf card to the mesh, for the consumers
+     * that cannot draw instances. The rotation of a card is given by Euler
+     * angles in radians, applied around x, then y, then z. The geometry is
+     * single sided, like the card. */
+    static void expandLeafCards(const std::vector<InstanceTransform> &cards,
+                                Mesh &mesh);
+
+private:
     double _leafDensity;
     double _weightThreshold;
+    bool _leafCards = false;
 
-    void processNode(SkelettonNode<TreeInfo> &node, Mesh &leavesMesh,
-                     Mesh &trunkMesh);
+    void processNode(SkelettonNode<TreeInfo> &node, TreeInstance &tree,
+                     std::mt19937 &rng) const;
 
-    void addLeaf(Mesh &mesh, const vec3d &position, const vec3d &normal);
+    void addLeaf(TreeInstance &tree, const vec3d &position,
+                 const vec3d &normal, std::mt19937 &rng) const;
 };
 
 } // namespace world
@@ -1,19 +1,44 @@
 #include "Tree.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <thread>
 #include <vector>
 
 #include "world/core/IResolutionModel.h"
+#include "world/core/Parameters.h"
+#include "world/math/BoundingVolumeHierarchy.h"
 #include "world/assets/SceneNode.h"
 #include "world/assets/MeshOps.h"
 #include "TreeSkelettonGenerator.h"
 #include "TrunkGenerator.h"
 #include "LeavesGenerator.h"
+#include "TreeVariantPool.h"
 
 namespace world {
 
 WORLD_REGISTER_CHILD_CLASS(WorldNode, Tree, "Tree");
 WORLD_SECOND_REGISTER_CHILD_CLASS(IInstanceGenerator, Tree, "Tree")
 
+/** Seed of the generation of a tree, which only depends on its position and
+ * on its index in the Tree node. */
+static u32 getTreeSeed(const vec3d &pos, u32 index) {
+    u32 h = static_cast<u32>(static_cast<s64>(std::floor(pos.x * 16)));
+    h = h * 0x27d4eb2d ^
+        static_cast<u32>(static_cast<s64>(std::floor(pos.y * 16)));
+    h = h * 0x27d4eb2d ^ index;
+
+    // Finalizer of MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
 TreeInstance::TreeInstance(vec3d pos) : _pos(pos), _trunkMaterial("trunk") {
     _trunkMaterial.setKd(0.5, 0.2, 0);
 }
@@ -23,6 +48,7 @@ void TreeInstance::reset() {
 
     _trunkMesh = Mesh();
     _leavesMesh = Mesh();
+    _leafCards.clear();
     _simpleTrunk = Mesh();
     _simpleLeaves = Mesh();
 }
@@ -32,87 +58,203 @@ class PTree {
 public:
     std::vector<std::unique_ptr<TreeInstance>> _instances;
     std::vector<std::unique_ptr<ITreeWorker>> _workers;
-
-    BoundingBox _bbox;
+    std::shared_ptr<TreeVariantPool> _variantPool;
+
+    /// Positions of the instances on the ground at the lowest level of
+    /// detail, used to get their resolution
+    std::vector<vec3d> _groundPositions;
+    /// Positions of the instances on the ground at the resolution of their
+    /// last collected level of detail, or -1 if they were not collected
+    std::vector<vec3d> _lodPositions;
+    std::vector<double> _lodResolutions;
+    /// Hierarchy of the ground positions
+    BoundingVolumeHierarchy _bvh;
+    /// Edit epoch of the environment when the instances were grounded
+    u64 _groundEpoch = 0;
 };
 
 Tree::Tree() : _internal(new PTree()) {}
 
 Tree::~Tree() { delete _internal; }
 
-void Tree::addTree(vec3d pos) {
-    _internal->_instances.emplace_back(std::make_unique<TreeInstance>(pos));
-
-    if (_internal->_instances.size() == 1) {
-        _internal->_bbox.reset(pos);
-    } else {
-        _internal->_bbox.addPoint(pos);
-    }
+void Tree::addTree(vec3d pos, const TreeVariant &variant) {
+    auto &instances = _internal->_instances;
+    const u32 index = static_cast<u32>(instances.size());
+    instances.emplace_back(std::make_unique<TreeInstance>(pos));
+    instances.back()->_variant = variant;
+    instances.back()->_seed = getTreeSeed(pos, index);
+    updateGeneration();
 }
 
 TreeInstance &Tree::getTreeInstance(int i) {
     return *_internal->_instances.at(i);
 }
 
-void Tree::setup(const Tree &model) {
-    _internal->_workers.clear();
+u32 Tree::getTreeCount() const {
+    return static_cast<u32>(_internal->_instances.size());
+}
 
-    for (auto &worker : model._internal->_workers) {
-        addWorkerInternal(worker->clone());
-    }
+void Tree::setup(const Tree &model) {
+    setupWorkers(model);
+    _internal->_variantPool = model._internal->_variantPool;
 
     for (auto &ti : model._internal->_instances) {
-        addTree(ti->_pos);
+        addTree(ti->_pos, ti->_variant);
     }
 }
 
-const double SIMPLE_RES = 2;
-const double BASE_RES = 7;
+void Tree::setVariantPool(std::shared_ptr<TreeVariantPool> pool) {
+    _internal->_variantPool = std::move(pool);
+    updateGeneration();
+}
+
+const double Tree::SIMPLE_RES = 2;
+const double Tree::BASE_RES = 7;
+
+void Tree::generate(std::vector<u32> indices, int threadCount) {
+    auto &instances = _internal->_instances;
+
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    indices.erase(std::remove_if(indices.begin(), indices.end(),
+                                 [&](u32 i) {
+                                     return instances.at(i)->_generated;
+                                 }),
+                  indices.end());
+
+    if (indices.empty()) {
+        return;
+    }
+
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threadCount =
+        std::max(1, std::min(threadCount, static_cast<int>(indices.size())));
+
+    // Workers may keep a state, so each thread has its own copy. The first
+    // thread is the calling thread, which uses the workers of the tree.
+    std::vector<std::vector<std::unique_ptr<ITreeWorker>>> threadWorkers(
+        threadCount - 1);
+
+    for (auto &workers : threadWorkers) {
+        for (auto &worker : _internal->_workers) {
+            workers.emplace_back(worker->clone());
+        }
+    }
+
+    // Trees are not equally long to generate, so the threads take them one
+    // by one rather than in fixed slices
+    std::atomic<size_t> next{0};
+    std::vector<std::exception_ptr> errors(threadCount);
+
+    auto generateTrees =
+        [&](int t, const std::vector<std::unique_ptr<ITreeWorker>> &workers) {
+            Mesh trunkScratch, leavesScratch;
+
+            try {
+                for (size_t i = next++; i < indices.size(); i = next++) {
+                    generateBase(*instances[indices[i]], workers,
+                                 trunkScratch, leavesScratch);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+
+    std::vector<std::thread> threads;
+
+    for (int t = 1; t < threadCount; ++t) {
+        threads.emplace_back(generateTrees, t, std::cref(threadWorkers[t - 1]));
+    }
+    generateTrees(0, _internal->_workers);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
 
 void Tree::collect(ICollector &collector,
                    const IResolutionModel &resolutionModel,
                    const ExplorationContext &ctx) {
-
-    // All the trees are too far to be seen
-    auto allRes = resolutionModel.getMaxResolutionIn(_internal->_bbox, ctx);
-    if (allRes < SIMPLE_RES)
+    if (!collector.hasChannel<SceneNode>()) {
         return;
+    }
+    updateGround(ctx);
 
-    if (collector.hasChannel<SceneNode>()) {
-        auto &objChan = collector.getChannel<SceneNode>();
-        int tpCount = 0;
-
-        for (auto &ti : _internal->_instances) {
-            ++tpCount;
-            vec3d realPos = ctx.getEnvironment().findNearestFreePoint(
-                ti->_pos, {0, 0, 1}, SIMPLE_RES, ctx);
-            double resolution = resolutionModel.getResolutionAt(realPos, ctx);
+    auto &bvh = _internal->_bvh;
+    const auto &indices = bvh.getIndices();
+    // Visible instances with their resolution
+    std::vector<std::pair<u32, double>> visible;
 
-            // Tree is too far to be seen
-            if (resolution < SIMPLE_RES)
-                continue;
+    bvh.visit([&](const BoundingVolumeHierarchy::Node &node) {
+        const double maxRes =
+            resolutionModel.getMaxResolutionIn(node._bbox, ctx);
 
-            Template tp = collectTree(*ti, collector, ctx, resolution);
-            auto *item = tp.getAt(resolution);
+        // All the trees are too far to be seen
+        if (maxRes < SIMPLE_RES) {
+            return false;
+        }
 
-            if (item != nullptr) {
-                int i = 0;
+        // If all the trees of the node have the same level of detail, they
+        // are collected without querying their resolution
+        const double minRes =
+            resolutionModel.getMinResolutionIn(node._bbox, ctx);
+        const bool singleLod =
+            getLod(minRes, collector) == getLod(maxRes, collector);
 
-                for (SceneNode node : item->_nodes) {
-                    ItemKey key{std::to_string(tpCount) + "." +
-                                std::to_string(i) + "." +
-                                std::to_string(item->_minRes)};
+        if (!singleLod && !node.isLeaf()) {
+            return true;
+        }
 
-                    node.setPosition(
-                        node.getPosition() +
-                        ctx.getEnvironment().findNearestFreePoint(
-                            tp._position, {0, 0, 1}, item->_minRes, ctx));
+        for (u32 i = node._first; i < node._first + node._count; ++i) {
+            const u32 index = indices[i];
+            const double resolution =
+                singleLod ? maxRes
+                          : resolutionModel.getResolutionAt(
+                                _internal->_groundPositions[index], ctx);
 
-                    objChan.put(key, node, ctx);
-                    ++i;
-                }
+            // Tree is too far to be seen
+            if (resolution >= SIMPLE_RES) {
+                visible.emplace_back(index, resolution);
             }
         }
+        return false;
+    });
+
+    // The full resolution models are generated in a batch before being
+    // collected
+    auto &pool = _internal->_variantPool;
+    std::vector<u32> pending;
+
+    for (auto &instance : visible) {
+        const TreeInstance &ti = *_internal->_instances[instance.first];
+        const int lod = getLod(instance.second, collector);
+
+        if (pool) {
+            // Impostors are baked from the full resolution models
+            if (lod == 2 || lod == 0) {
+                pending.push_back(ti._variant._index);
+            }
+        } else if (lod == 2 && !ti._generated) {
+            pending.push_back(instance.first);
+        }
+    }
+
+    if (pool) {
+        pool->generate(pending);
+    } else {
+        generate(pending);
+    }
+
+    for (auto &instance : visible) {
+        collectInstance(instance.first, collector, ctx, instance.second);
     }
 }
 
@@ -164,10 +306,23 @@ void Tree::read(const WorldFile &wf) {
     for (auto it = wf.readArray("workers"); !it.end(); ++it) {
         _internal->_workers.emplace_back(readSubclass<ITreeWorker>(*it));
     }
+    updateGeneration();
 }
 
 Template Tree::collectTree(TreeInstance &ti, ICollector &collector,
-                           const ExplorationContext &ctx, double res) {
+                           const ExplorationContext &ctx, double res,
+                           InstanceBuffer *leafCards) {
+    auto &pool = _internal->_variantPool;
+
+    if (pool) {
+        Template tp =
+            pool->collectVariant(ti._variant, collector, res, leafCards);
+        tp._position = ti._pos;
+        tp._rotation = {0, 0, ti._variant._rotation};
+        tp._scale = {ti._variant._scale};
+        return tp;
+    }
+
     Template tp;
 
     if (collector.hasChannel<Mesh>()) {
@@ -186,14 +341,41 @@ Template Tree::collectTree(TreeInstance &ti, ICollector &collector,
         // Complex tree model
         SceneNode trunk(ctx({"1"}).str());
         SceneNode leaves(ctx({"2"}).str());
+        bool instancedCards = false;
 
-        if (res > BASE_RES) {
+        if (res >= BASE_RES) {
             if (!ti._generated) {
                 generateBase(ti);
             }
 
             meshChannel.put({"1"}, ti._trunkMesh, ctx);
-            meshChannel.put({"2"}, ti._leavesMesh, ctx);
+
+            if (ti._leafCards.empty()) {
+                meshChannel.put({"2"}, ti._leavesMesh, ctx);
+            } else if (leafCards != nullptr) {
+                instancedCards = true;
+
+                // The card is shared by all the trees of the node
+                if (!meshChannel.has({"card"}, ctx)) {
+                    meshChannel.put({"card"}, LeavesGenerator::createLeafCard(),
+                                    ctx);
+                }
+                const std::string materialID =
+                    collector.hasChannel<Material>() ? ctx({"c"}).str() : "";
+                *leafCards = InstanceBuffer(ctx({"card"}).str(), materialID);
+                leafCards->reserve(ti._leafCards.size());
+
+                for (auto &card : ti._leafCards) {
+                    leafCards->add(card._position, card._rotation,
+                                   card._scale);
+                }
+            } else {
+                if (ti._leavesMesh.empty()) {
+                    LeavesGenerator::expandLeafCards(ti._leafCards,
+                                                     ti._leavesMesh);
+                }
+                meshChannel.put({"2"}, ti._leavesMesh, ctx);
+            }
         }
 
 
@@ -211,12 +393,21 @@ Template Tree::collectTree(TreeInstance &ti, ICollector &collector,
 
             materialsChannel.put({"1"}, ti._trunkMaterial, ctx);
             materialsChannel.put({"2"}, leavesMat, ctx);
+
+            // Leaf cards are single sided
+            if (!ti._leafCards.empty()) {
+                leavesMat.setDoubleSided(true);
+                leaves.setMaterialID(ctx({"c"}).str());
+                materialsChannel.put({"c"}, leavesMat, ctx);
+            }
         }
 
         tp._position = ti._pos;
         tp.insert(SIMPLE_RES, {simpleTrunk, simpleLeaves});
 
-        if (res > BASE_RES) {
+        if (instancedCards) {
+            tp.insert(BASE_RES, trunk);
+        } else if (res >= BASE_RES) {
             tp.insert(BASE_RES, {trunk, leaves});
         }
     }
@@ -225,14 +416,37 @@ Template Tree::collectTree(TreeInstance &ti, ICollector &collector,
 }
 
 void Tree::generateBase(TreeInstance &instance) {
-    for (auto &worker : _internal->_workers) {
+    Mesh trunkScratch, leavesScratch;
+    generateBase(instance, _internal->_workers, trunkScratch, leavesScratch);
+}
+
+void Tree::generateBase(
+    TreeInstance &instance,
+    const std::vector<std::unique_ptr<ITreeWorker>> &workers,
+    Mesh &trunkScratch, Mesh &leavesScratch) {
+    // The workers fill the scratch meshes, whose buffers were grown by the
+    // previous trees of the thread, so they do not reallocate at each vertex
+    trunkScratch.clearVertices();
+    trunkScratch.clearFaces();
+    leavesScratch.clearVertices();
+    leavesScratch.clearFaces();
+    std::swap(instance._trunkMesh, trunkScratch);
+    std::swap(instance._leavesMesh, leavesScratch);
+
+    // The parameters of the workers are drawn from an engine seeded for
+    // this tree only
+    std::mt19937 rng(instance._seed);
+    ParamsRngScope rngScope(rng);
+
+    for (auto &worker : workers) {
         worker->process(instance);
     }
-    // u32 total = instance._trunkMesh.getVerticesCount() +
-    // instance._leavesMesh.getVerticesCount(); std::cout << total << " "  << u
-    // / total << std::endl; std::cout << (u += total * sizeof(Vertex)) <<
-    // std::endl;
 
+    // The meshes of the instance get buffers of the exact size
+    std::swap(instance._trunkMesh, trunkScratch);
+    std::swap(instance._leavesMesh, leavesScratch);
+    instance._trunkMesh = trunkScratch;
+    instance._leavesMesh = leavesScratch;
     instance._generated = true;
 }
 
@@ -301,9 +515,200 @@ void Tree::reset() {
     for (auto &ti : _internal->_instances) {
         ti->reset();
     }
+    updateGeneration();
+}
+
+void Tree::setupWorkers(const Tree &model) {
+    _internal->_workers.clear();
+
+    for (auto &worker : model._internal->_workers) {
+        addWorkerInternal(worker->clone());
+    }
+}
+
+/** Check if the projections of the boxes on the (x, y) plane overlap. The
+ * instances are grounded vertically, so the height of the box of an edit
+ * does not matter. */
+static bool overlapsXY(const BoundingBox &a, const BoundingBox &b) {
+    const vec3d aMin = a.getLowerBound(), aMax = a.getUpperBound();
+    const vec3d bMin = b.getLowerBound(), bMax = b.getUpperBound();
+    return aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y &&
+           bMin.y <= aMax.y;
+}
+
+void Tree::updateGround(const ExplorationContext &ctx) {
+    auto &instances = _internal->_instances;
+    auto &groundPositions = _internal->_groundPositions;
+    const IEnvironment &env = ctx.getEnvironment();
+    bool moved = false;
+
+    const u64 epoch = env.getEditEpoch();
+
+    if (epoch != _internal->_groundEpoch) {
+        std::vector<BoundingBox> edits;
+
+        if (env.getEditsSince(_internal->_groundEpoch, edits, ctx)) {
+            moved = groundEditedInstances(edits, ctx);
+        } else {
+            // The edits are unknown, all the instances are grounded again
+            groundPositions.clear();
+            _internal->_lodResolutions.assign(instances.size(), -1);
+        }
+        _internal->_groundEpoch = epoch;
+    }
+
+    const size_t groundedCount = groundPositions.size();
+
+    if (groundedCount == instances.size()) {
+        if (moved) {
+            _internal->_bvh.build(groundPositions);
+        }
+        return;
+    }
+
+    // Ground the new instances at once
+    groundPositions.resize(instances.size());
+
+    for (size_t i = groundedCount; i < instances.size(); ++i) {
+        groundPositions[i] = instances[i]->_pos;
+    }
+    ctx.getEnvironment().findNearestFreePoints(
+        groundPositions.data() + groundedCount,
+        groundPositions.data() + groundedCount,
+        instances.size() - groundedCount, {0, 0, 1}, SIMPLE_RES, ctx);
+
+    _internal->_lodPositions.resize(instances.size());
+    _internal->_lodResolutions.resize(instances.size(), -1);
+    _internal->_bvh.build(groundPositions);
+}
+
+bool Tree::groundEditedInstances(const std::vector<BoundingBox> &edits,
+                                 const ExplorationContext &ctx) {
+    auto &instances = _internal->_instances;
+    auto &groundPositions = _internal->_groundPositions;
+    const auto &indices = _internal->_bvh.getIndices();
+    std::vector<u32> edited;
+
+    auto isEdited = [&](const BoundingBox &bbox) {
+        return std::any_of(edits.begin(), edits.end(),
+                           [&](const BoundingBox &edit) {
+                               return overlapsXY(edit, bbox);
+                           });
+    };
+
+    // Instances added since the hierarchy was built are grounded later
+    _internal->_bvh.visit([&](const BoundingVolumeHierarchy::Node &node) {
+        if (!isEdited(node._bbox)) {
+            return false;
+        }
+
+        if (node.isLeaf()) {
+            for (u32 i = node._first; i < node._first + node._count; ++i) {
+                if (isEdited(BoundingBox(groundPositions[indices[i]]))) {
+                    edited.push_back(indices[i]);
+                }
+            }
+        }
+        return true;
+    });
+
+    if (edited.empty()) {
+        return false;
+    }
+
+    std::vector<vec3d> positions(edited.size());
+
+    for (size_t i = 0; i < edited.size(); ++i) {
+        positions[i] = instances[edited[i]]->_pos;
+    }
+    ctx.getEnvironment().findNearestFreePoints(
+        positions.data(), positions.data(), positions.size(), {0, 0, 1},
+        SIMPLE_RES, ctx);
+
+    for (size_t i = 0; i < edited.size(); ++i) {
+        groundPositions[edited[i]] = positions[i];
+        _internal->_lodResolutions[edited[i]] = -1;
+    }
+    return true;
+}
+
+int Tree::getLod(double resolution, const ICollector &collector) const {
+    if (resolution < SIMPLE_RES) {
+        return -1;
+    } else if (resolution >= BASE_RES) {
+        return 2;
+    }
+    auto &pool = _internal->_variantPool;
+    return pool && pool->isImpostor(resolution, collector) ? 0 : 1;
+}
+
+void Tree::collectInstance(u32 index, ICollector &collector,
+                           const ExplorationContext &ctx,
+                           double resolution) {
+    TreeInstance &ti = *_internal->_instances[index];
+    // Leaf cards are collected as instances when the collector allows it
+    InstanceBuffer leafCards;
+    const bool instancing = collector.hasChannel<InstanceBuffer>();
+    Template tp = collectTree(ti, collector, ctx, resolution,
+                              instancing ? &leafCards : nullptr);
+    auto *item = tp.getAt(resolution);
+
+    if (item == nullptr) {
+        return;
+    }
+
+    // The ground depends on the resolution, so the instance is grounded
+    // again only when its level of detail changes
+    vec3d &offset = _internal->_lodPositions[index];
+    double &offsetRes = _internal->_lodResolutions[index];
+
+    if (offsetRes != item->_minRes) {
+        offset = ctx.getEnvironment().findNearestFreePoint(
+            tp._position, {0, 0, 1}, item->_minRes, ctx);
+        offsetRes = item->_minRes;
+    }
+
+    auto &objChan = collector.getChannel<SceneNode>();
+    int i = 0;
+
+    for (SceneNode node : item->_nodes) {
+        ItemKey key{std::to_string(index + 1) + "." + std::to_string(i) +
+                    "." + std::to_string(item->_minRes)};
+
+        node.setPosition(node.getPosition() * tp._scale + offset);
+        node.setRotation(tp._rotation);
+        node.setScale(node.getScale() * tp._scale);
+
+        objChan.put(key, node, ctx);
+        ++i;
+    }
+
+    if (!leafCards.empty()) {
+        // The tree is only rotated around z, which adds up with the
+        // rotation of the cards around z
+        const double cosRot = cos(tp._rotation.z);
+        const double sinRot = sin(tp._rotation.z);
+        InstanceBuffer buffer(leafCards.getMeshID(),
+                              leafCards.getMaterialID());
+        buffer.reserve(leafCards.size());
+
+        for (size_t c = 0; c < leafCards.size(); ++c) {
+            const InstanceTransform &card = leafCards[c];
+            const vec3d p = vec3d(card._position) * tp._scale;
+            const vec3d position{cosRot * p.x - sinRot * p.y,
+                                 sinRot * p.x + cosRot * p.y, p.z};
+            buffer.add(position + offset,
+                       vec3d(card._rotation) + tp._rotation,
+                       vec3d(card._scale) * tp._scale);
+        }
+
+        ItemKey key{std::to_string(index + 1) + ".cards"};
+        collector.getChannel<InstanceBuffer>().put(key, buffer, ctx);
+    }
 }
 
 void Tree::addWorkerInternal(ITreeWorker *worker) {
     _internal->_workers.push_back(std::unique_ptr<ITreeWorker>(worker));
+    updateGeneration();
 }
 } // namespace world
\ No newline at end of file
@@ -3,20 +3,36 @@
 #include "world/core/WorldConfig.h"
 
 #include <memory>
+#include <vector>
 
 #include "world/core/IResolutionModel.h"
 #include "world/core/WorldNode.h"
 #include "world/core/IInstanceGenerator.h"
 #include "world/assets/Mesh.h"
 #include "world/assets/Material.h"
+#include "world/assets/InstanceBuffer.h"
 #include "ITreeWorker.h"
 #include "TreeSkeletton.h"
 
 namespace world {
 
+/** Look of a tree drawn from a TreeVariantPool. */
+struct TreeVariant {
+    /// Index of the variant in the pool
+    u32 _index = 0;
+    /// Rotation around the vertical axis, in radians
+    double _rotation = 0;
+    double _scale = 1;
+    /// Index of the tint of the leaves
+    u32 _tint = 0;
+};
+
 class TreeInstance {
 public:
     vec3d _pos;
+    TreeVariant _variant;
+    /// Seed of the random generation of the tree
+    u32 _seed = 0;
 
     TreeSkeletton _skeletton;
 
@@ -24,6 +40,9 @@ public:
     Mesh _simpleLeaves;
     Mesh _trunkMesh;
     Mesh _leavesMesh;
+    /// Transforms of the leaf cards relative to the tree, if the leaves are
+    /// generated as cards (see LeavesGenerator::setLeafCards())
+    std::vector<InstanceTransform> _leafCards;
 
     Material _trunkMaterial;
 
@@ -36,6 +55,7 @@ public:
 };
 
 class PTree;
+class TreeVariantPool;
 
 class WORLDAPI_EXPORT Tree : public WorldNode, public IInstanceGenerator {
     WORLD_WRITE_SUBCLASS_METHOD
@@ -44,14 +64,30 @@ public:
 
     ~Tree() override;
 
-    void addTree(vec3d pos = {});
+    void addTree(vec3d pos = {}, const TreeVariant &variant = {});
 
     TreeInstance &getTreeInstance(int i);
 
+    u32 getTreeCount() const;
+
     void setup(const Tree &model);
 
+    /** Draw the trees from the given pool instead of generating a unique
+     * model for each tree. The variant of each tree is given to addTree().
+     * If the pool is null, each tree gets its own model. */
+    void setVariantPool(std::shared_ptr<TreeVariantPool> pool);
+
     template <typename T, typename... Args> T &addWorker(Args &&... args);
 
+    /** Generate the full resolution models of the given instances at once,
+     * on a pool of threads. The instances already generated are skipped.
+     * Each model only depends on the position and index of its instance,
+     * so the result does not depend on the count of threads. The models
+     * are all published when this method returns.
+     * @param threadCount number of threads. If 0, the number of hardware
+     * threads is used. */
+    void generate(std::vector<u32> indices, int threadCount = 0);
+
     void collect(ICollector &collector, const IResolutionModel &explorer,
                  const ExplorationContext &ctx) override;
 
@@ -68,22 +104,60 @@ public:
     void read(const WorldFile &wf) override;
 
 private:
+    static const double SIMPLE_RES;
+    static const double BASE_RES;
+
     PTree *_internal;
 
 
     void addWorkerInternal(ITreeWorker *worker);
 
+    /** Replace the workers of this tree by copies of the model workers. */
+    void setupWorkers(const Tree &model);
+
+    /** Collect the assets of the tree and get its template. If leafCards is
+     * not null and the leaves of the tree are cards, the cards are not in
+     * the template: they are returned in leafCards, relative to the tree.
+     * Otherwise the cards are expanded to a mesh. */
     Template collectTree(TreeInstance &instance, ICollector &collector,
-                         const ExplorationContext &ctx, double res);
+                         const ExplorationContext &ctx, double res,
+                         InstanceBuffer *leafCards = nullptr);
+
+    /** Ground the instances added since the last call, and the instances
+     * in the areas of the environment edited since the last call, or all of
+     * them if those areas are not known. Rebuild the hierarchy of the
+     * instances if needed. */
+    void updateGround(const ExplorationContext &ctx);
+
+    /** Ground again the instances located in the given bounds, found with
+     * the hierarchy of the instances. Returns true if some instances were
+     * grounded again. The hierarchy must be rebuilt afterwards. */
+    bool groundEditedInstances(const std::vector<BoundingBox> &edits,
+                               const ExplorationContext &ctx);
+
+    /** Level of detail of a tree seen at the given resolution, or -1 if the
+     * tree is not visible. */
+    int getLod(double resolution, const ICollector &collector) const;
+
+    void collectInstance(u32 index, ICollector &collector,
+                         const ExplorationContext &ctx, double resolution);
 
     void generateBase(TreeInstance &instance);
 
+    /** Generate the instance with the given workers, building its meshes in
+     * the given scratch meshes to reuse their memory. */
+    static void
+    generateBase(TreeInstance &instance,
+                 const std::vector<std::unique_ptr<ITreeWorker>> &workers,
+                 Mesh &trunkScratch, Mesh &leavesScratch);
+
     void generateSimpleMeshes(TreeInstance &instance);
 
     /** Ungenerate the tree */
     void reset();
 
     friend class TrunkGenerator;
+    friend class TreeVariantPool;
 };
 
 template <typename T, typename... Args> T &Tree::addWorker(Args &&... args) {
@@ -0,0 +1,334 @@
+#include "TreeVariantPool.h"
+
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "world/assets/SceneNode.h"
+#include "LeavesGenerator.h"
+
+namespace world {
+
+/** Hash of a position, precise to a few centimeters. */
+static u32 hashPosition(const vec3d &position) {
+    u32 h = static_cast<u32>(static_cast<s64>(std::floor(position.x * 16)));
+    h = h * 0x27d4eb2d ^
+        static_cast<u32>(static_cast<s64>(std::floor(position.y * 16)));
+
+    // Finalizer of MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/** Number of views on each side of the impostor atlases. */
+static const int IMPOSTOR_GRID_SIZE = 8;
+/** Resolution of each view of the impostor atlases, in pixels. */
+static const int IMPOSTOR_CELL_RES = 32;
+
+static const Color4d LEAVES_COLOR{0.4, 0.9, 0.4};
+
+/** Size of a mesh in memory, in bytes. */
+static size_t meshByteSize(const Mesh &mesh) {
+    return mesh.getVerticesCount() * sizeof(Vertex) +
+           mesh.getFaceCount() * sizeof(Face);
+}
+
+TreeVariantPool::VariantImpostor::VariantImpostor()
+        : _impostor(IMPOSTOR_GRID_SIZE, IMPOSTOR_CELL_RES) {}
+
+TreeVariantPool::TreeVariantPool(const Tree &model, u32 variantCount,
+                                 u32 tintCount)
+        : _model(std::make_unique<Tree>()), _variantCount(variantCount),
+          _tintCount(tintCount), _impostors(variantCount) {
+
+    if (_variantCount == 0 || _tintCount == 0) {
+        throw std::invalid_argument(
+            "TreeVariantPool: variant and tint counts must not be 0");
+    }
+
+    _model->setupWorkers(model);
+
+    for (u32 i = 0; i < _variantCount; ++i) {
+        _model->addTree();
+    }
+
+    static std::atomic<u32> poolCount{0};
+    _ctx.appendPrefix("treeVariants" + std::to_string(poolCount++));
+}
+
+TreeVariantPool::~TreeVariantPool() = default;
+
+void TreeVariantPool::setImpostorResolution(double resolution) {
+    _impostorRes = resolution;
+}
+
+const Impostor &TreeVariantPool::getImpostor(u32 index) {
+    return bakeImpostor(index)._impostor;
+}
+
+void TreeVariantPool::generate(std::vector<u32> indices, int threadCount) {
+    _model->generate(std::move(indices), threadCount);
+}
+
+void TreeVariantPool::generateAll(int threadCount) {
+    std::vector<u32> indices(_variantCount);
+
+    for (u32 i = 0; i < _variantCount; ++i) {
+        indices[i] = i;
+    }
+    generate(std::move(indices), threadCount);
+}
+
+TreeVariant TreeVariantPool::pick(const vec3d &position) const {
+    u32 h = hashPosition(position);
+
+    TreeVariant variant;
+    variant._index = h % _variantCount;
+    h /= _variantCount;
+    variant._tint = h % _tintCount;
+    h /= _tintCount;
+    // The remaining bits give the rotation and the scale
+    variant._rotation = (h & 0xFF) / 256. * M_PI * 2;
+    variant._scale = 0.8 + ((h >> 8) & 0xFF) / 255. * 0.4;
+    return variant;
+}
+
+Template TreeVariantPool::collectVariant(const TreeVariant &variant,
+                                         ICollector &collector,
+                                         double resolution,
+                                         InstanceBuffer *leafCards) {
+    Template tp;
+
+    if (!collector.hasChannel<Mesh>()) {
+        return tp;
+    }
+    auto &meshChannel = collector.getChannel<Mesh>();
+    TreeInstance &ti = _model->getTreeInstance(variant._index);
+
+    ExplorationContext ctx = _ctx;
+    ctx.appendPrefix(std::to_string(variant._index));
+
+    // Simple model (from far away)
+    if (ti._simpleTrunk.getVerticesCount() == 0) {
+        _model->generateSimpleMeshes(ti);
+    }
+
+    if (!meshChannel.has({"s1"}, ctx)) {
+        meshChannel.put({"s1"}, ti._simpleTrunk, ctx);
+        meshChannel.put({"s2"}, ti._simpleLeaves, ctx);
+    }
+    SceneNode simpleTrunk(ctx({"s1"}).str());
+    SceneNode simpleLeaves(ctx({"s2"}).str());
+
+    // Impostor (from farther away), with one material per tint because the
+    // tint is the diffuse color
+    const bool impostor = hasImpostors(collector);
+    SceneNode impostorNode(ctx({"i"}).str());
+
+    if (impostor) {
+        auto &imageChannel = collector.getChannel<Image>();
+        auto &materialsChannel = collector.getChannel<Material>();
+        const ItemKey materialKey{"i" + std::to_string(variant._tint)};
+
+        if (!meshChannel.has({"i"}, ctx)) {
+            VariantImpostor &vi = bakeImpostor(variant._index);
+            meshChannel.put({"i"}, vi._quads, ctx);
+            imageChannel.put({"ic"}, vi._impostor.getColorAtlas(), ctx);
+            imageChannel.put({"in"}, vi._impostor.getNormalAtlas(), ctx);
+        }
+
+        if (!materialsChannel.has(materialKey, ctx)) {
+            const double tint = getTint(variant._tint);
+            Material impostorMat("impostor");
+            impostorMat.setKd(tint, tint, tint);
+            impostorMat.setMapKd(ctx({"ic"}).str());
+            impostorMat.setTransparent(true);
+            impostorMat.setShaderParam(
+                "normalMap",
+                {ShaderParam::Type::TEXTURE, ctx({"in"}).str()});
+            impostorMat.setShaderParam(
+                "gridSize", {ShaderParam::Type::INTEGER,
+                             std::to_string(IMPOSTOR_GRID_SIZE)});
+            materialsChannel.put(materialKey, impostorMat, ctx);
+        }
+        impostorNode.setMaterialID(ctx(materialKey).str());
+    }
+
+    // Complex tree model
+    const bool complex = resolution >= Tree::BASE_RES;
+    SceneNode trunk(ctx({"1"}).str());
+    SceneNode leaves(ctx({"2"}).str());
+    bool cards = false;
+    bool instancedCards = false;
+
+    if (complex) {
+        if (!ti._generated) {
+            _model->generateBase(ti);
+        }
+        cards = !ti._leafCards.empty();
+        instancedCards = cards && leafCards != nullptr;
+
+        if (!meshChannel.has({"1"}, ctx)) {
+            meshChannel.put({"1"}, ti._trunkMesh, ctx);
+        }
+
+        if (instancedCards) {
+            // The card is shared by all the variants
+            if (!meshChannel.has({"card"}, _ctx)) {
+                meshChannel.put({"card"}, LeavesGenerator::createLeafCard(),
+                                _ctx);
+            }
+        } else if (!meshChannel.has({"2"}, ctx)) {
+            if (cards && ti._leavesMesh.empty()) {
+                LeavesGenerator::expandLeafCards(ti._leafCards,
+                                                 ti._leavesMesh);
+            }
+            meshChannel.put({"2"}, ti._leavesMesh, ctx);
+        }
+    }
+    std::string cardMaterialID;
+
+    // Materials are shared by all the variants
+    if (collector.hasChannel<Material>()) {
+        auto &materialsChannel = collector.getChannel<Material>();
+        const ItemKey trunkKey{"trunk"};
+        const ItemKey leavesKey{"leaves" + std::to_string(variant._tint)};
+
+        if (!materialsChannel.has(trunkKey, _ctx)) {
+            materialsChannel.put(trunkKey, ti._trunkMaterial, _ctx);
+        }
+
+        const double tint = getTint(variant._tint);
+        Material leavesMat("leaves");
+        leavesMat.setKd(LEAVES_COLOR._r * tint, LEAVES_COLOR._g * tint,
+                        LEAVES_COLOR._b * tint);
+
+        if (!materialsChannel.has(leavesKey, _ctx)) {
+            materialsChannel.put(leavesKey, leavesMat, _ctx);
+        }
+
+        simpleTrunk.setMaterialID(_ctx(trunkKey).str());
+        simpleLeaves.setMaterialID(_ctx(leavesKey).str());
+        trunk.setMaterialID(_ctx(trunkKey).str());
+        leaves.setMaterialID(_ctx(leavesKey).str());
+
+        // Leaf cards are single sided
+        if (cards) {
+            const ItemKey cardKey{"cards" + std::to_string(variant._tint)};
+
+            if (!materialsChannel.has(cardKey, _ctx)) {
+                leavesMat.setDoubleSided(true);
+                materialsChannel.put(cardKey, leavesMat, _ctx);
+            }
+            cardMaterialID = _ctx(cardKey).str();
+            leaves.setMaterialID(cardMaterialID);
+        }
+    }
+
+    if (instancedCards) {
+        *leafCards = InstanceBuffer(_ctx({"card"}).str(), cardMaterialID);
+        leafCards->reserve(ti._leafCards.size());
+
+        for (auto &card : ti._leafCards) {
+            leafCards->add(card._position, card._rotation, card._scale);
+        }
+    }
+
+    if (impostor) {
+        tp.insert(Tree::SIMPLE_RES, impostorNode);
+
+        if (_impostorRes < Tree::BASE_RES) {
+            tp.insert(_impostorRes, {simpleTrunk, simpleLeaves});
+        }
+    } else {
+        tp.insert(Tree::SIMPLE_RES, {simpleTrunk, simpleLeaves});
+    }
+
+    if (instancedCards) {
+        tp.insert(Tree::BASE_RES, trunk);
+    } else if (complex) {
+        tp.insert(Tree::BASE_RES, {trunk, leaves});
+    }
+    return tp;
+}
+
+u32 TreeVariantPool::getImpostorCount() const {
+    u32 count = 0;
+
+    for (auto &impostor : _impostors) {
+        if (impostor) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+u32 TreeVariantPool::getGeneratedCount() const {
+    u32 count = 0;
+
+    for (u32 i = 0; i < _variantCount; ++i) {
+        if (_model->getTreeInstance(i)._generated) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t TreeVariantPool::getByteSize() const {
+    size_t size = 0;
+
+    for (u32 i = 0; i < _variantCount; ++i) {
+        const TreeInstance &ti = _model->getTreeInstance(i);
+        size += meshByteSize(ti._simpleTrunk) + meshByteSize(ti._simpleLeaves) +
+                meshByteSize(ti._trunkMesh) + meshByteSize(ti._leavesMesh) +
+                ti._leafCards.size() * sizeof(InstanceTransform);
+    }
+
+    for (auto &impostor : _impostors) {
+        if (impostor) {
+            size += impostor->_impostor.getColorAtlas().size() +
+                    impostor->_impostor.getNormalAtlas().size() +
+                    meshByteSize(impostor->_quads);
+        }
+    }
+    return size;
+}
+
+double TreeVariantPool::getTint(u32 tint) const {
+    return _tintCount == 1 ? 1 : 0.85 + 0.3 * tint / (_tintCount - 1);
+}
+
+bool TreeVariantPool::hasImpostors(const ICollector &collector) const {
+    return _impostorRes > Tree::SIMPLE_RES && collector.hasChannel<Image>() &&
+           collector.hasChannel<Material>();
+}
+
+TreeVariantPool::VariantImpostor &TreeVariantPool::bakeImpostor(u32 index) {
+    auto &impostor = _impostors.at(index);
+
+    if (!impostor) {
+        TreeInstance &ti = _model->getTreeInstance(index);
+
+        if (!ti._generated) {
+            _model->generateBase(ti);
+        }
+        if (!ti._leafCards.empty() && ti._leavesMesh.empty()) {
+            LeavesGenerator::expandLeafCards(ti._leafCards, ti._leavesMesh);
+        }
+
+        impostor = std::make_unique<VariantImpostor>();
+        impostor->_impostor.addMesh(ti._trunkMesh, ti._trunkMaterial.getKd());
+        impostor->_impostor.addMesh(ti._leavesMesh, LEAVES_COLOR);
+        impostor->_impostor.bake();
+        impostor->_quads = impostor->_impostor.createCrossedQuads();
+    }
+    return *impostor;
+}
+
+} // namespace world
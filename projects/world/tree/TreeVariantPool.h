@@ -0,0 +1,122 @@
+#ifndef WORLD_TREEVARIANTPOOL_H
+#define WORLD_TREEVARIANTPOOL_H
+
+#include "world/core/WorldConfig.h"
+
+#include <memory>
+#include <vector>
+
+#include "world/core/ExplorationContext.h"
+#include "world/assets/Impostor.h"
+#include "Tree.h"
+
+namespace world {
+
+/** Bounded set of tree variants shared by many Tree nodes. The meshes of a
+ * variant are generated once per level of detail, and put once in the
+ * collector for all the trees that use it. Trees drawn from the pool only
+ * differ by their variant, transform, scale and tint.
+ *
+ * The count of variants sets the trade-off between the variety of a forest
+ * and the time and memory spent generating it. */
+class WORLDAPI_EXPORT TreeVariantPool {
+public:
+    /** Create a pool of variants generated by the workers of the model.
+     * Variants are generated the first time they are collected. */
+    TreeVariantPool(const Tree &model, u32 variantCount = 16,
+                    u32 tintCount = 4);
+
+    ~TreeVariantPool();
+
+    TreeVariantPool(const TreeVariantPool &other) = delete;
+
+    TreeVariantPool &operator=(const TreeVariantPool &other) = delete;
+
+    u32 getVariantCount() const { return _variantCount; }
+
+    u32 getTintCount() const { return _tintCount; }
+
+    /** Draw the trees seen at a lower resolution than the given one with
+     * impostors instead of meshes. The impostor of a variant is baked from
+     * its full resolution meshes the first time it is collected. Impostors
+     * are disabled if the resolution is not above the lowest resolution at
+     * which trees are visible, which is the default. */
+    void setImpostorResolution(double resolution);
+
+    double getImpostorResolution() const { return _impostorRes; }
+
+    /** Returns true if trees seen at the given resolution are drawn as
+     * impostors in the given collector. */
+    bool isImpostor(double resolution, const ICollector &collector) const {
+        return resolution < _impostorRes && hasImpostors(collector);
+    }
+
+    /** Get the impostor of the variant, baking it if needed. */
+    const Impostor &getImpostor(u32 index);
+
+    /** Pick the variant, rotation, scale and tint of a tree. The choice only
+     * depends on the position of the tree. */
+    TreeVariant pick(const vec3d &position) const;
+
+    /** Generate the full resolution meshes of the given variants at once,
+     * on a pool of threads. The variants do not depend on the count of
+     * threads. See Tree::generate(). */
+    void generate(std::vector<u32> indices, int threadCount = 0);
+
+    /** Generate the full resolution meshes of all the variants, for example
+     * before entering a forest. */
+    void generateAll(int threadCount = 0);
+
+    /** Put the assets of the variant in the collector if they are not
+     * already there, and get the template of the variant at the given
+     * resolution. The template is centered on the origin, the transform of
+     * the variant is left to the caller. If leafCards is not null and the
+     * leaves of the variant are cards, the cards are returned in leafCards,
+     * relative to the variant, instead of being in the template. Otherwise
+     * the cards are expanded to a mesh. */
+    Template collectVariant(const TreeVariant &variant, ICollector &collector,
+                            double resolution,
+                            InstanceBuffer *leafCards = nullptr);
+
+    /** Count of variants whose impostor is baked. */
+    u32 getImpostorCount() const;
+
+    /** Count of variants whose full resolution meshes are generated. */
+    u32 getGeneratedCount() const;
+
+    /** Get the total size of the meshes and impostors generated by the
+     * pool, in bytes. */
+    size_t getByteSize() const;
+
+private:
+    struct VariantImpostor {
+        Impostor _impostor;
+        /// Mesh showing the impostor without a dedicated shader
+        Mesh _quads;
+
+        VariantImpostor();
+    };
+
+    std::unique_ptr<Tree> _model;
+    u32 _variantCount;
+    u32 _tintCount;
+
+    double _impostorRes = 0;
+    std::vector<std::unique_ptr<VariantImpostor>> _impostors;
+
+    /// Context of the assets of the pool, which do not depend on the
+    /// chunk of the trees
+    ExplorationContext _ctx;
+
+
+    /** Brightness factor of the given tint. */
+    double getTint(u32 tint) const;
+
+    bool hasImpostors(const ICollector &collector) const;
+
+    VariantImpostor &bakeImpostor(u32 index);
+};
+
+} // namespace world
+
+#endif // WORLD_TREEVARIANTPOOL_H
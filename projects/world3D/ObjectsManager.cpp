@@ -66,6 +66,7 @@ void ObjectNodeHandler::setMaterial(const Material &mat, Collector &collector) {
     if (mat.isTransparent()) {
         irrmat.MaterialType = EMT_TRANSPARENT_ALPHA_CHANNEL;
     }
+    irrmat.BackfaceCulling = !mat.isDoubleSided();
 
     // Textures
     int texstart = 0;
@@ -1,8 +1,12 @@
 #include <catch/catch.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <random>
+#include <thread>
 
 #include <world/core.h>
+#include <world/core/ConstantResolution.h>
 #include <world/terrain.h>
 
 using namespace world;
@@ -30,3 +34,1037 @@ TEST_CASE("HeightmapGround - observeAltitudeAt benchmark",
         }
     }
 }
+
+class CountingImageChannel : public CollectorChannel<Image> {
+public:
+    int _putCount = 0;
+
+    void put(const ItemKey &key, const Image &item,
+             const ExplorationContext &ctx) override {
+        ++_putCount;
+        CollectorChannel<Image>::put(key, item, ctx);
+    }
+};
+
+class CountingNodeChannel : public CollectorChannel<SceneNode> {
+public:
+    int _putCount = 0;
+
+    void put(const ItemKey &key, const SceneNode &item,
+             const ExplorationContext &ctx) override {
+        ++_putCount;
+        CollectorChannel<SceneNode>::put(key, item, ctx);
+    }
+};
+
+TEST_CASE("HeightmapGround - texture atlas", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(3);
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    collector.addStorageChannel<Mesh>();
+    collector.addStorageChannel<Material>();
+    auto &images = collector.addCustomChannel<Image, CountingImageChannel>();
+
+    FirstPersonView view;
+    view.setFarDistance(5000);
+
+    auto collectFrames = [&]() {
+        view.setPosition({0, 0, 0});
+        ground.collect(collector, view);
+        const int firstFramePuts = images._putCount;
+        images._putCount = 0;
+
+        view.setPosition({1500, 0, 0});
+        ground.collect(collector, view);
+        return firstFramePuts;
+    };
+
+    SECTION("one texture per tile") {
+        const int firstFramePuts = collectFrames();
+        INFO("tiles: " << collector.getStorageChannel<SceneNode>().size());
+        CHECK(firstFramePuts > 50);
+        CHECK(images.size() == collector.getStorageChannel<SceneNode>().size());
+    }
+
+    SECTION("atlas") {
+        ground.enableTextureAtlas(1024, 8);
+        const int firstFramePuts = collectFrames();
+        const int secondFramePuts = images._putCount;
+        INFO("tiles: " << collector.getStorageChannel<SceneNode>().size());
+
+        // Only the pages are emitted, and they are emitted again only if
+        // they change
+        CHECK(firstFramePuts <= 8);
+        CHECK(secondFramePuts <= 8);
+        CHECK(images.size() <= 8);
+
+        // Each tile points to its page, through its material
+        std::set<std::string> pageIds;
+
+        for (int i = 0; i < 8; ++i) {
+            pageIds.insert(ItemKey{"_atlas" + std::to_string(i)}.str());
+        }
+
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            CHECK(pageIds.count(entry._value.getMaterialID()) == 1);
+        }
+    }
+
+    SECTION("tiles of the frame keep their slots") {
+        // 3 x 3 slots, less than the tiles in view
+        ground.enableTextureAtlas(512, 1);
+        Collector small;
+        auto &nodes = small.addCustomChannel<SceneNode, CountingNodeChannel>();
+        small.addStorageChannel<Mesh>();
+        small.addStorageChannel<Material>();
+        small.addStorageChannel<Image>();
+
+        view.setPosition({0, 0, 0});
+        ground.collect(small, view);
+
+        // No tile of the frame was evicted to make room for another one
+        CHECK(nodes._putCount == 9);
+        CHECK(nodes.size() == 9);
+
+        // The tiles of the previous frames leave room for the new ones
+        nodes._putCount = 0;
+        view.setPosition({20000, 0, 0});
+        ground.collect(small, view);
+        CHECK(nodes._putCount > 0);
+        CHECK(nodes.size() == 9);
+    }
+
+    SECTION("page table limits") {
+        CHECK_THROWS_AS(ground.enableTextureAtlas(1024, 300),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(ground.enableTextureAtlas(132 * 300, 1),
+                        std::invalid_argument);
+    }
+
+    SECTION("compressed atlas") {
+        ground.enableTextureAtlas(1024, 8);
+        ground.enableTextureMips(2);
+        ground.setTextureCompression(true);
+        collectFrames();
+
+        // The pages compressed again in the changed rectangles are the same
+        // as the current pages compressed as a whole
+        ground.setTextureCompression(false);
+        Collector uncompressed;
+        uncompressed.addStorageChannel<SceneNode>();
+        uncompressed.addStorageChannel<Mesh>();
+        uncompressed.addStorageChannel<Material>();
+        uncompressed.addStorageChannel<Image>();
+        ground.collect(uncompressed, view);
+        REQUIRE(uncompressed.getStorageChannel<Image>().size() != 0);
+
+        for (auto entry : uncompressed.getStorageChannel<Image>()) {
+            const Image expected = BlockCompression::encode(entry._value);
+            const Image &page = images.get(entry._key);
+
+            for (int level = 0; level <= expected.mipCount(); ++level) {
+                const Image &mip = expected.mip(level);
+                CHECK(std::equal(mip.data(), mip.data() + mip.size(),
+                                 page.mip(level).data()));
+            }
+        }
+    }
+}
+
+TEST_CASE("HeightmapGround - texture mips", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(2);
+    ground.setTextureRes(64);
+    ground.enableTextureMips(2);
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    collector.addStorageChannel<Mesh>();
+    collector.addStorageChannel<Material>();
+    collector.addStorageChannel<Image>();
+
+    FirstPersonView view;
+    view.setFarDistance(5000);
+
+    SECTION("full mip chains") {
+        ground.collect(collector, view);
+        auto &images = collector.getStorageChannel<Image>();
+        REQUIRE(images.size() > 0);
+
+        for (auto entry : images) {
+            const Image &image = entry._value;
+            REQUIRE(image.mipCount() == 6);
+
+            for (int level = 1; level <= image.mipCount(); ++level) {
+                CHECK(image.mip(level).width() == 64 >> level);
+                CHECK(image.mip(level).height() == 64 >> level);
+            }
+        }
+    }
+
+    SECTION("compressed mip chains") {
+        ground.setTextureCompression(true);
+        ground.collect(collector, view);
+
+        for (auto entry : collector.getStorageChannel<Image>()) {
+            const Image &image = entry._value;
+            CHECK(image.type() == ImageType::BC1);
+            CHECK(image.mipCount() == 6);
+            CHECK(image.mip(6).size() == 8);
+        }
+    }
+}
+
+/** Image channel of a host which keeps the collected textures, decompressed,
+ * to apply the partial updates on them. */
+class HostImageChannel : public CollectorChannel<Image> {
+public:
+    std::map<ItemKey, Image> _textures;
+    int _putCount = 0;
+
+    void put(const ItemKey &key, const Image &item,
+             const ExplorationContext &ctx) override {
+        ++_putCount;
+        _textures.erase(key);
+        _textures.emplace(
+            key, item.isCompressed() ? BlockCompression::decode(item) : item);
+        CollectorChannel<Image>::put(key, item, ctx);
+    }
+};
+
+class HostUpdateChannel : public CollectorChannel<ImageUpdate> {
+public:
+    HostImageChannel &_images;
+    int _putCount = 0;
+    int _maxPixelCount = 0;
+
+    explicit HostUpdateChannel(HostImageChannel &images) : _images(images) {}
+
+    void put(const ItemKey &key, const ImageUpdate &item,
+             const ExplorationContext &) override {
+        ++_putCount;
+        auto it = _images._textures.find(key);
+        REQUIRE(it != _images._textures.end());
+
+        const Image &pixels = item._pixels;
+        _maxPixelCount =
+            std::max(_maxPixelCount, pixels.width() * pixels.height());
+        ImageUtils::blit(it->second,
+                         pixels.isCompressed()
+                             ? BlockCompression::decode(pixels)
+                             : pixels,
+                         item._x, item._y);
+    }
+};
+
+/** Check that the textures of the host are the same as the textures
+ * collected from scratch. */
+static void checkHostTextures(HeightmapGround &ground,
+                              const IResolutionModel &view,
+                              const HostImageChannel &host) {
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    collector.addStorageChannel<Mesh>();
+    collector.addStorageChannel<Material>();
+    auto &reference = collector.addCustomChannel<Image, HostImageChannel>();
+    ground.collect(collector, view);
+
+    REQUIRE(reference._textures.size() > 0);
+
+    for (auto &entry : reference._textures) {
+        auto it = host._textures.find(entry.first);
+        REQUIRE(it != host._textures.end());
+        const Image &expected = entry.second;
+        const Image &actual = it->second;
+        REQUIRE(actual.size() == expected.size());
+        CHECK(std::equal(actual.data(), actual.data() + actual.size(),
+                         expected.data()));
+    }
+}
+
+TEST_CASE("HeightmapGround - texture painting", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(2);
+    ground.setTextureRes(64);
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    collector.addStorageChannel<Mesh>();
+    collector.addStorageChannel<Material>();
+    auto &images = collector.addCustomChannel<Image, HostImageChannel>();
+
+    FirstPersonView view;
+    view.setFarDistance(5000);
+
+    Image brush(8, 8, ImageType::RGB);
+    ImageUtils::fill(brush, Color4d(1, 0, 0));
+    const vec2d allLods{0, 1e6};
+
+    SECTION("partial updates") {
+        auto &updates =
+            collector.addCustomChannel<ImageUpdate, HostUpdateChannel>(images);
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        // Painting is deferred to the next collect
+        ground.paintTexture({100, 100}, {100, 100}, allLods, brush);
+        CHECK(updates._putCount == 0);
+
+        ground.collect(collector, view);
+        CHECK(images._putCount == 0);
+        CHECK(updates._putCount >= 1);
+        CHECK(updates._putCount <= 3);
+        CHECK(updates._maxPixelCount <= 36);
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("updates kept until the host consumes them") {
+        auto &updates = collector.addStorageChannel<ImageUpdate>();
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        // The host does not consume the first update before the second one,
+        // which modifies another part of the same textures
+        ground.paintTexture({100, 100}, {100, 100}, allLods, brush);
+        ground.collect(collector, view);
+        ground.paintTexture({400, 400}, {100, 100}, allLods, brush);
+        ground.collect(collector, view);
+        CHECK(images._putCount == 0);
+        CHECK(updates.size() == 1);
+
+        for (auto entry : updates) {
+            const Image &pixels = entry._value._pixels;
+            ImageUtils::blit(images._textures.at(entry._key), pixels,
+                             entry._value._x, entry._value._y);
+        }
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("whole textures without update channel") {
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        ground.paintTexture({100, 100}, {100, 100}, allLods, brush);
+        ground.collect(collector, view);
+        CHECK(images._putCount >= 1);
+        CHECK(images._putCount <= 3);
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("compressed partial updates") {
+        ground.setTextureCompression(true);
+        auto &updates =
+            collector.addCustomChannel<ImageUpdate, HostUpdateChannel>(images);
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        ground.paintTexture({100, 100}, {100, 100}, allLods, brush);
+        ground.collect(collector, view);
+        CHECK(images._putCount == 0);
+        CHECK(updates._putCount >= 1);
+        CHECK(updates._maxPixelCount <= 64);
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("atlas partial updates") {
+        ground.enableTextureAtlas(1024, 8);
+        auto &updates =
+            collector.addCustomChannel<ImageUpdate, HostUpdateChannel>(images);
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        ground.paintTexture({100, 100}, {100, 100}, allLods, brush);
+        ground.collect(collector, view);
+        CHECK(images._putCount == 0);
+        CHECK(updates._putCount == 1);
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("atlas pages updated with the new tiles") {
+        ground.enableTextureAtlas(1024, 8);
+        auto &updates =
+            collector.addCustomChannel<ImageUpdate, HostUpdateChannel>(images);
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        // The tiles loaded in the pages already emitted are sent as updates
+        view.setPosition({1500, 0, 0});
+        ground.collect(collector, view);
+        CHECK(images._putCount == 0);
+        CHECK(updates._putCount >= 1);
+        CHECK(updates._maxPixelCount < 1024 * 1024);
+        checkHostTextures(ground, view, images);
+    }
+
+    SECTION("children of a repainted tile") {
+        ground.enableTextureMips(2);
+        // The tiles of lod 1, which crop their coarse levels from lod 0
+        ConstantResolution children(0.06);
+        ground.collect(collector, children);
+        images._putCount = 0;
+
+        // Only the tiles of lod 0 are painted, but the levels that their
+        // children cropped from them change as well
+        ground.paintTexture({-2000, -2000}, {4000, 4000}, {0, 0}, brush);
+        ground.collect(collector, children);
+        // The children of the 4 painted tiles are emitted again
+        CHECK(images._putCount == 16);
+        int painted = 0;
+
+        for (auto &entry : images._textures) {
+            const RGBPixel &color = entry.second.mip(2).rgb(8, 8);
+            painted += color.getRed() == 255 && color.getGreen() == 0;
+        }
+        CHECK(painted == 4);
+    }
+
+    SECTION("footprints at 60 Hz") {
+        ground.setTextureRes(256);
+        auto &updates =
+            collector.addCustomChannel<ImageUpdate, HostUpdateChannel>(images);
+        ground.collect(collector, view);
+        images._putCount = 0;
+
+        // A vehicle driving at 90 km/h for 5 seconds, leaving two tyre
+        // tracks, painted once per frame. Tracks are large compared to a
+        // vehicle, so that each print covers at least one pixel.
+        for (int frame = 0; frame < 300; ++frame) {
+            const double x = -200 + frame * 1.5;
+            ground.paintTexture({x, 40}, {12, 12}, allLods, brush);
+            ground.paintTexture({x, 60}, {12, 12}, allLods, brush);
+            ground.collect(collector, view);
+        }
+
+        CHECK(images._putCount == 0);
+        CHECK(updates._putCount > 0);
+        CHECK(updates._maxPixelCount <= 32);
+        checkHostTextures(ground, view, images);
+    }
+}
+
+/** Texture provider whose textures are not available until _ready is set,
+ * like a DefaultTextureProvider decoding its images in the background. */
+class DelayedTextureProvider : public ITextureProvider {
+public:
+    bool _ready = false;
+    Image _texture{4, 4, ImageType::RGBA};
+    Image _placeholder{1, 1, ImageType::RGBA};
+
+    DelayedTextureProvider() {
+        ImageUtils::fill(_texture, Color4d(1, 0, 0));
+        ImageUtils::fill(_placeholder, Color4d(0, 0, 1));
+    }
+
+    Image &getTexture(int, int) override {
+        return _ready ? _texture : _placeholder;
+    }
+
+    bool hasTexture(int, int) override { return _ready; }
+};
+
+TEST_CASE("HeightmapGround - delayed layer textures", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(2);
+    ground.setTextureRes(16);
+    ground.addWorker<PerlinTerrainGenerator>(3, 4., 0.35);
+
+    auto &texturer = ground.addWorker<MultilayerGroundTexture>();
+    auto &provider = texturer.setTextureProvider<DelayedTextureProvider>();
+    // One layer covering the whole ground
+    texturer.addLayer({0, 1, 1, 2, 0, 1, 1, 2, 2, 2, 2, 2, 0.1f, 0});
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    collector.addStorageChannel<Mesh>();
+    collector.addStorageChannel<Material>();
+    auto &images = collector.addCustomChannel<Image, HostImageChannel>();
+
+    FirstPersonView view;
+    view.setFarDistance(5000);
+
+    ground.collect(collector, view);
+    REQUIRE(images._textures.size() > 0);
+
+    for (auto &entry : images._textures) {
+        CHECK(entry.second.rgb(8, 8).getBlue() > 200);
+    }
+
+    // The tiles textured with the placeholder are textured again
+    provider._ready = true;
+    images._putCount = 0;
+    ground.collect(collector, view);
+    CHECK(images._putCount == int(images._textures.size()));
+
+    for (auto &entry : images._textures) {
+        CHECK(entry.second.rgb(8, 8).getRed() > 200);
+        CHECK(entry.second.rgb(8, 8).getBlue() < 50);
+    }
+
+    images._putCount = 0;
+    ground.collect(collector, view);
+    CHECK(images._putCount == 0);
+}
+
+class CountingMeshChannel : public CollectorChannel<Mesh> {
+public:
+    int _putCount = 0;
+
+    void put(const ItemKey &key, const Mesh &item,
+             const ExplorationContext &ctx) override {
+        ++_putCount;
+        CollectorChannel<Mesh>::put(key, item, ctx);
+    }
+};
+
+/** Worker generating flat terrains, which are the same each time. */
+class FlatWorker : public ITerrainWorker {
+public:
+    WORLD_WRITE_SUBCLASS_METHOD
+
+    void processTerrain(Terrain &terrain) override {
+        const int res = terrain.getResolution();
+
+        for (int y = 0; y < res; ++y) {
+            for (int x = 0; x < res; ++x) {
+                terrain(x, y) = 0.5;
+            }
+        }
+    }
+
+    void processTile(ITileContext &context) override {
+        processTerrain(context.getTile()._terrain);
+    }
+};
+
+WORLD_REGISTER_CHILD_CLASS(ITerrainWorker, FlatWorker, "FlatWorker")
+
+TEST_CASE("HeightmapGround - height edits", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(2);
+    ground.setDefaultWorkerSet();
+
+    // (x, y) is a point of the terrains at lod 2
+    const double x = 1500. / 32 * 3, y = 1500. / 32 * 5;
+    const double fine = 1e6, coarse = 0;
+
+    SECTION("add height") {
+        const double before = ground.observeAltitudeAt(x, y, fine);
+        const double beforeCoarse = ground.observeAltitudeAt(x, y, coarse);
+        const double far = ground.observeAltitudeAt(x + 2000, y, fine);
+
+        ground.addHeight({x, y}, 300, 20);
+        CHECK(ground.observeAltitudeAt(x, y, fine) == Approx(before + 20));
+        CHECK(ground.observeAltitudeAt(x, y, coarse) > beforeCoarse + 5);
+        CHECK(ground.observeAltitudeAt(x + 2000, y, fine) == Approx(far));
+
+        ground.addHeight({x, y}, 300, -50);
+        CHECK(ground.observeAltitudeAt(x, y, fine) == Approx(before - 30));
+        // Each edit changes the edit epoch
+        CHECK(ground.getEditEpoch() == 2);
+
+        // The bounds of the edits are remembered
+        std::vector<BoundingBox> edits;
+        CHECK(ground.getEditsSince(2, edits));
+        CHECK(edits.empty());
+        CHECK(ground.getEditsSince(1, edits));
+        REQUIRE(edits.size() == 1);
+        CHECK(ground.getEditsSince(0, edits));
+        REQUIRE(edits.size() == 3);
+
+        for (const BoundingBox &bbox : edits) {
+            CHECK(bbox.contains({x - 300, y + 300, 0}));
+            CHECK_FALSE(bbox.contains({x + 2000, y, 0}));
+        }
+        CHECK_FALSE(ground.getEditsSince(3, edits));
+    }
+
+    SECTION("set height") {
+        ground.setHeight({x, y}, 300, 500);
+        CHECK(ground.observeAltitudeAt(x, y, fine) == Approx(500));
+
+        ground.setHeight({x, y}, 300, 100, 0.5);
+        CHECK(ground.observeAltitudeAt(x, y, fine) == Approx(300));
+    }
+
+    SECTION("smooth height") {
+        const double before = ground.observeAltitudeAt(x, y, fine);
+        ground.addHeight({x, y}, 60, 200);
+        const double spike = ground.observeAltitudeAt(x, y, fine) - before;
+        ground.smoothHeight({x, y}, 300, 1);
+        const double smoothed = ground.observeAltitudeAt(x, y, fine) - before;
+        CHECK(smoothed < spike * 0.8);
+    }
+
+    SECTION("queries see the edits") {
+        // A narrow peak, higher than the margins observed before the edit
+        ground.addHeight({x, y}, 40, 2500);
+        const double peak = ground.observeAltitudeAt(x, y, fine);
+        const double highest =
+            ground.observeMaxAltitude({x - 100, y - 100}, {x + 100, y + 100},
+                                      fine);
+        CHECK(highest >= peak - 1e-6);
+
+        auto hit = ground.raycast({x, y, peak + 1000}, {0, 0, -1}, 2000, fine);
+        REQUIRE(hit);
+        CHECK(hit->z == Approx(peak));
+    }
+
+    SECTION("edits are kept when tiles are generated again") {
+        const double before = ground.observeAltitudeAt(x, y, fine);
+        ground.addHeight({x, y}, 300, 20);
+        const double editedCoarse = ground.observeAltitudeAt(x, y, coarse);
+
+        // Exploring far away removes the edited tiles from the storage
+        Collector collector;
+        collector.addStorageChannel<SceneNode>();
+        collector.addStorageChannel<Mesh>();
+        FirstPersonView view;
+        view.setFarDistance(5000);
+
+        for (int i = 1; i <= 4; ++i) {
+            view.setPosition({i * 20000., 0, 0});
+            ground.collect(collector, view);
+        }
+
+        CHECK(ground.observeAltitudeAt(x, y, fine) == Approx(before + 20));
+        // The coarser lods are computed again from the edits
+        CHECK(ground.observeAltitudeAt(x, y, coarse) == Approx(editedCoarse));
+    }
+
+    SECTION("edits are saved") {
+        HeightmapGround flat;
+        flat.setMaxLOD(2);
+        flat.addWorker<FlatWorker>();
+        flat.addHeight({x, y}, 300, 20);
+        const double edited = flat.observeAltitudeAt(x, y, fine);
+        const double editedCoarse = flat.observeAltitudeAt(x, y, coarse);
+
+        WorldFile wf;
+        flat.write(wf);
+        WorldFile json;
+        json.fromJson(wf.toJson());
+
+        HeightmapGround loaded;
+        loaded.read(json);
+        CHECK(loaded.observeAltitudeAt(x, y, fine) == Approx(edited));
+        CHECK(loaded.observeAltitudeAt(x, y, coarse) == Approx(editedCoarse));
+        CHECK(editedCoarse > loaded.observeAltitudeAt(x + 2000, y, coarse));
+    }
+
+    SECTION("collected meshes") {
+        Collector collector;
+        collector.addStorageChannel<SceneNode>();
+        auto &meshes = collector.addCustomChannel<Mesh, CountingMeshChannel>();
+
+        FirstPersonView view;
+        view.setFarDistance(5000);
+        ground.collect(collector, view);
+        meshes._putCount = 0;
+
+        ground.addHeight({x, y}, 100, 20);
+        ground.collect(collector, view);
+
+        // Only the edited tiles and their neighbours are collected again
+        CHECK(meshes._putCount > 0);
+        CHECK(meshes._putCount <= 27);
+
+        double maxZ = -1e9;
+
+        for (auto entry : meshes) {
+            const Mesh &mesh = entry._value;
+
+            for (u32 i = 0; i < mesh.getVerticesCount(); ++i) {
+                maxZ = std::max(maxZ, mesh.getVertex(i).getPosition().z);
+            }
+        }
+        CHECK(maxZ > 0);
+
+        meshes._putCount = 0;
+        ground.collect(collector, view);
+        CHECK(meshes._putCount == 0);
+    }
+}
+
+/** Find the first intersection of the ray with the ground by marching along
+ * the ray with a small step. Returns a negative distance if there is no
+ * intersection. */
+static double marchRay(HeightmapGround &ground, const vec3d &origin,
+                       const vec3d &direction, double maxDistance,
+                       double resolution, double step) {
+    for (double t = 0; t <= maxDistance; t += step) {
+        vec3d pos = origin + direction * t;
+
+        if (pos.z <= ground.observeAltitudeAt(pos.x, pos.y, resolution)) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+/** Worker raising a single tile to the maximum altitude. */
+class RaisedTileWorker : public ITerrainWorker {
+public:
+    TileCoordinates _raised{1, 1, 0, 3};
+
+    void processTerrain(Terrain &) override {}
+
+    void processTile(ITileContext &context) override {
+        if (context.getCoords() == _raised) {
+            Terrain &terrain = context.getTile()._terrain;
+            const int res = terrain.getResolution();
+
+            for (int y = 0; y < res; ++y) {
+                for (int x = 0; x < res; ++x) {
+                    terrain(x, y) = 1;
+                }
+            }
+        }
+    }
+
+    void write(WorldFile &) const override {}
+
+    void read(const WorldFile &) override {}
+};
+
+TEST_CASE("HeightmapGround - ground queries", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(3);
+    ground.addWorker<PerlinTerrainGenerator>(3, 4., 0.35);
+    ground.addWorker<RaisedTileWorker>();
+    const double resolution = 1e6;
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<double> coord(-5000, 5000);
+
+    SECTION("vertical rays") {
+        for (int i = 0; i < 20; ++i) {
+            const double x = coord(rng), y = coord(rng);
+            auto hit = ground.raycast({x, y, 5000}, {0, 0, -1}, 10000,
+                                      resolution);
+            REQUIRE(hit);
+            CHECK(hit->x == Approx(x));
+            CHECK(hit->y == Approx(y));
+            CHECK(hit->z ==
+                  Approx(ground.observeAltitudeAt(x, y, resolution)));
+        }
+    }
+
+    SECTION("tiles raised below the generated lods") {
+        // The coarse tiles over the raised tile are generated first
+        ground.raycast({1000, 1000, 5000}, {0, 0, -1}, 10000, 0.001);
+        // The ray stays above the other tiles, and reaches the maximum
+        // altitude above the center of the raised tile
+        auto hit = ground.raycast({-4875, 1125, 4300}, {1, 0, -0.05}, 10000,
+                                  resolution);
+        REQUIRE(hit);
+        CHECK(hit->x == Approx(1125));
+        CHECK(hit->z == Approx(4000));
+    }
+
+    SECTION("rays above the ground") {
+        auto hit = ground.raycast({-5000, 0, 4500}, {1, 0.3, 0}, 10000,
+                                  resolution);
+        CHECK(!hit);
+        hit = ground.raycast({0, 0, 5000}, {0, 0, 1}, 10000, resolution);
+        CHECK(!hit);
+    }
+
+    SECTION("slanted rays") {
+        std::uniform_real_distribution<double> slope(-0.3, -0.05);
+        std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+        const double step = 1;
+
+        for (int i = 0; i < 20; ++i) {
+            const double a = angle(rng);
+            const double x = coord(rng), y = coord(rng);
+            const vec3d origin{
+                x, y, ground.observeAltitudeAt(x, y, resolution) + 200};
+            const vec3d direction =
+                vec3d{cos(a), sin(a), slope(rng)}.normalize();
+
+            auto hit = ground.raycast(origin, direction, 5000, resolution);
+            const double expected =
+                marchRay(ground, origin, direction, 5000, resolution, step);
+
+            if (expected < 0) {
+                CHECK(!hit);
+            } else {
+                REQUIRE(hit);
+                const double distance = (*hit - origin).norm();
+                CHECK(distance <= expected + 1e-6);
+                CHECK(distance >= expected - step);
+            }
+        }
+    }
+
+    SECTION("max altitude in a region") {
+        std::uniform_real_distribution<double> extent(10, 1000);
+
+        for (int i = 0; i < 10; ++i) {
+            const vec2d min{coord(rng), coord(rng)};
+            const vec2d max{min.x + extent(rng), min.y + extent(rng)};
+            const double result =
+                ground.observeMaxAltitude(min, max, resolution);
+
+            double sampled = -1e9;
+            const int samples = 100;
+
+            for (int sx = 0; sx <= samples; ++sx) {
+                for (int sy = 0; sy <= samples; ++sy) {
+                    const double x = min.x + (max.x - min.x) * sx / samples;
+                    const double y = min.y + (max.y - min.y) * sy / samples;
+                    sampled = std::max(
+                        sampled, ground.observeAltitudeAt(x, y, resolution));
+                }
+            }
+
+            CHECK(result >= sampled - 1e-6);
+            CHECK(result <= sampled + 5);
+        }
+    }
+
+    SECTION("batched altitudes") {
+        const size_t count = 200;
+        std::vector<vec2d> points;
+        std::vector<double> altitudes(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            points.emplace_back(coord(rng), coord(rng));
+        }
+        ground.observeAltitudesAt(points.data(), altitudes.data(), count,
+                                  resolution);
+
+        for (size_t i = 0; i < count; ++i) {
+            CHECK(altitudes[i] == Approx(ground.observeAltitudeAt(
+                                      points[i].x, points[i].y, resolution)));
+        }
+    }
+}
+
+/** Mesh channel that pauses the first put until it is released, or until a
+ * timeout, so that the collecting thread is stuck in collect(). */
+class PausingMeshChannel : public CollectorChannel<Mesh> {
+public:
+    std::atomic_bool _paused{false};
+    std::atomic_bool _released{false};
+    std::atomic_bool _timedOut{false};
+
+    void put(const ItemKey &key, const Mesh &item,
+             const ExplorationContext &ctx) override {
+        if (!_paused.exchange(true)) {
+            auto start = std::chrono::steady_clock::now();
+
+            while (!_released) {
+                if (std::chrono::steady_clock::now() - start >
+                    std::chrono::seconds(5)) {
+                    _timedOut = true;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        CollectorChannel<Mesh>::put(key, item, ctx);
+    }
+};
+
+/** Worker counting how many times each tile is generated. */
+class TileCountingWorker : public ITerrainWorker {
+public:
+    std::map<TileCoordinates, int> _counts;
+
+    void processTerrain(Terrain &) override {}
+
+    void processTile(ITileContext &context) override {
+        ++_counts[context.getCoords()];
+    }
+
+    void write(WorldFile &) const override {}
+
+    void read(const WorldFile &) override {}
+};
+
+TEST_CASE("HeightmapGround - concurrent altitude queries", "[terrain]") {
+    HeightmapGround ground;
+    ground.setMaxLOD(3);
+    ground.addWorker<PerlinTerrainGenerator>(3, 4., 0.35);
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    auto &meshes = collector.addCustomChannel<Mesh, PausingMeshChannel>();
+    collector.addStorageChannel<Material>();
+    collector.addStorageChannel<Image>();
+    FirstPersonView view;
+    view.setFarDistance(5000);
+
+    const double range = ground.getAltitudeRange();
+    const double minAltitude = ground.getMinAltitude() - range;
+    const double maxAltitude = ground.getMaxAltitude() + range;
+
+    SECTION("queries while collecting and editing") {
+        meshes._paused = true;
+        std::atomic_bool stop{false};
+        std::atomic_int queries{0}, invalid{0};
+        std::vector<std::thread> readers;
+
+        for (int t = 0; t < 3; ++t) {
+            readers.emplace_back([&, t]() {
+                std::mt19937 rng(t);
+                std::uniform_real_distribution<double> coord(-20000, 20000);
+                std::uniform_real_distribution<double> exponent(-3, 3);
+                std::vector<vec2d> points(16);
+                std::vector<double> altitudes(16);
+
+                while (!stop) {
+                    const double resolution = pow(10, exponent(rng));
+
+                    for (auto &point : points) {
+                        point = {coord(rng), coord(rng)};
+                    }
+
+                    // Single and batched queries
+                    altitudes[0] = ground.observeAltitudeAt(
+                        points[0].x, points[0].y, resolution);
+                    ground.observeAltitudesAt(points.data() + 1,
+                                              altitudes.data() + 1, 15,
+                                              resolution);
+
+                    for (double altitude : altitudes) {
+                        if (!(altitude >= minAltitude &&
+                              altitude <= maxAltitude)) {
+                            ++invalid;
+                        }
+                    }
+                    ++queries;
+                }
+            });
+        }
+
+        // Each frame generates tiles, and evicts old ones
+        for (int frame = 0; frame < 20; ++frame) {
+            const double x = (frame % 5) * 8000. - 16000;
+            view.setPosition({x, 0, 0});
+            ground.collect(collector, view);
+            ground.addHeight({x, 0}, 200, frame % 2 == 0 ? 10 : -10);
+        }
+        stop = true;
+
+        for (auto &reader : readers) {
+            reader.join();
+        }
+        CHECK(invalid == 0);
+        CHECK(queries > 0);
+    }
+
+    SECTION("queries do not wait for collect") {
+        // Generate the tiles read by the queries
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> coord(-1000, 1000);
+        std::vector<vec2d> points(100);
+
+        for (auto &point : points) {
+            point = {coord(rng), coord(rng)};
+            ground.observeAltitudeAt(point.x, point.y, 1e6);
+        }
+
+        // The writer generates new tiles, and is paused in collect()
+        std::thread writer([&]() {
+            view.setPosition({30000, 0, 0});
+            ground.collect(collector, view);
+        });
+
+        while (!meshes._paused) {
+            std::this_thread::yield();
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            const vec2d &point = points[i % points.size()];
+            ground.observeAltitudeAt(point.x, point.y, 1e6);
+        }
+        meshes._released = true;
+        writer.join();
+
+        // If the queries waited for collect, the writer would have timed out
+        CHECK_FALSE(meshes._timedOut);
+    }
+
+    SECTION("missing tiles are generated once") {
+        auto &counter = ground.addWorker<TileCountingWorker>();
+        std::vector<double> altitudes(8);
+        std::vector<std::thread> readers;
+
+        for (int t = 0; t < 8; ++t) {
+            readers.emplace_back([&, t]() {
+                altitudes[t] = ground.observeAltitudeAt(1234, -567, 1e6);
+            });
+        }
+
+        for (auto &reader : readers) {
+            reader.join();
+        }
+
+        for (double altitude : altitudes) {
+            CHECK(altitude == altitudes[0]);
+        }
+        CHECK(altitudes[0] >= minAltitude);
+        CHECK(altitudes[0] <= maxAltitude);
+        REQUIRE_FALSE(counter._counts.empty());
+
+        for (auto &entry : counter._counts) {
+            CHECK(entry.second == 1);
+        }
+    }
+}
+
+TEST_CASE("HeightmapGround - raycast benchmark", "[terrain][!benchmark]") {
+    HeightmapGround ground;
+    ground.setDefaultWorkerSet();
+    const double resolution = 1;
+
+    // Random rays across a 10 km area
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(-5000, 5000);
+    std::uniform_real_distribution<double> slope(-0.3, -0.02);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::vector<std::pair<vec3d, vec3d>> rays;
+
+    for (int i = 0; i < 1000; ++i) {
+        const double a = angle(rng);
+        rays.emplace_back(vec3d{coord(rng), coord(rng), 2000},
+                          vec3d{cos(a), sin(a), slope(rng)}.normalize());
+    }
+
+    int hits = 0;
+
+    // The first raycasts include the generation of the tiles
+    BENCHMARK("1000 raycasts (cold)") {
+        for (auto &ray : rays) {
+            hits += bool(ground.raycast(ray.first, ray.second, 10000,
+                                        resolution));
+        }
+    }
+
+    BENCHMARK("1000 raycasts (warm)") {
+        for (auto &ray : rays) {
+            hits += bool(ground.raycast(ray.first, ray.second, 10000,
+                                        resolution));
+        }
+    }
+
+    BENCHMARK("1000 ray marchings (10 m step)") {
+        for (auto &ray : rays) {
+            hits += marchRay(ground, ray.first, ray.second, 10000,
+                             resolution, 10) >= 0;
+        }
+    }
+
+    BENCHMARK("1000 max altitude queries") {
+        for (auto &ray : rays) {
+            const vec2d min{ray.first.x, ray.first.y};
+            ground.observeMaxAltitude(min, {min.x + 500, min.y + 500},
+                                      resolution);
+        }
+    }
+
+    CHECK(hits > 0);
+}
@@ -1,5 +1,9 @@
 #include <catch/catch.hpp>
 
+#include <random>
+#include <thread>
+#include <vector>
+
 #include <world/core.h>
 
 using namespace world;
@@ -115,6 +119,56 @@ TEST_CASE("Image - IO", "[image]") {
     CHECK(pix1.getAlpha() == pix2.getAlpha());
 }
 
+TEST_CASE("Image - ImageCache", "[image]") {
+    world::createDirectories("unittests");
+
+    Image img1(4, 4, ImageType::RGBA);
+    img1.rgba(1, 2).set(10, 20, 30, 40);
+    img1.write("unittests/cache1.png");
+    Image img2(8, 8, ImageType::RGB);
+    img2.write("unittests/cache2.png");
+
+    ImageCache cache(2);
+
+    SECTION("get") {
+        auto image = cache.get("unittests/cache1.png");
+        REQUIRE(image);
+        CHECK(image->width() == 4);
+        CHECK(image->rgba(1, 2).getGreen() == 20);
+        CHECK(cache.getByteSize() == 4 * 4 * 4);
+
+        // Once decoded, tryGet returns the same image
+        CHECK(cache.tryGet("unittests/cache1.png") == image);
+    }
+
+    SECTION("tryGet does not block") {
+        cache.prefetch("unittests/cache2.png");
+        auto image = cache.tryGet("unittests/cache2.png");
+
+        while (!image) {
+            std::this_thread::yield();
+            image = cache.tryGet("unittests/cache2.png");
+        }
+        CHECK(image->width() == 8);
+    }
+
+    SECTION("missing image") {
+        CHECK_THROWS_AS(cache.get("unittests/img_not_found.png"),
+                        std::runtime_error);
+        CHECK(cache.tryGet("unittests/img_not_found.png") == nullptr);
+    }
+
+    SECTION("byte budget") {
+        cache.setByteBudget(300);
+        auto image1 = cache.get("unittests/cache1.png");
+        auto image2 = cache.get("unittests/cache2.png");
+        CHECK(cache.getByteSize() == size_t(image2->size()));
+
+        // Evicted images are still valid
+        CHECK(image1->rgba(1, 2).getBlue() == 30);
+    }
+}
+
 TEST_CASE("Image - ImageStream", "[image]") {
     Image imgRGBA(3, 3, ImageType::RGBA);
 
@@ -152,6 +206,536 @@ TEST_CASE("Image - ImageStream", "[image]") {
     delete[] buffer;
 }
 
+/** Peak signal to noise ratio between the RGBA image and the RGB or RGBA
+ * reference, on the given channels. */
+double blockCompressionPSNR(const Image &reference, const Image &decoded,
+                            int channels) {
+    double error = 0;
+    const int elemSize = reference.elemSize();
+
+    for (int i = 0; i < reference.width() * reference.height(); ++i) {
+        for (int c = 0; c < channels; ++c) {
+            double d = reference.data()[i * elemSize + c] -
+                       decoded.data()[i * 4 + c];
+            error += d * d;
+        }
+    }
+    error /= reference.width() * reference.height() * channels;
+    return 10 * log10(255. * 255. / std::max(error, 1e-9));
+}
+
+TEST_CASE("Image - BlockCompression", "[image]") {
+    // Smooth gradient, with a size that is not a multiple of 4
+    Image rgb(66, 35, ImageType::RGB);
+    Image rgba(66, 35, ImageType::RGBA);
+
+    for (int y = 0; y < rgb.height(); ++y) {
+        for (int x = 0; x < rgb.width(); ++x) {
+            rgb.rgb(x, y).set(u8(x * 3), u8(y * 7), u8(128 + x - y));
+            rgba.rgba(x, y).set(u8(x * 3), u8(y * 7), u8(128 + x - y),
+                                u8(255 - x * 2));
+        }
+    }
+
+    SECTION("compressed size") {
+        Image bc1 = BlockCompression::encode(rgb);
+        CHECK(bc1.type() == ImageType::BC1);
+        CHECK(bc1.isCompressed());
+        CHECK(bc1.width() == 66);
+        CHECK(bc1.height() == 35);
+        CHECK(bc1.size() == 17 * 9 * 8);
+
+        Image bc3 = BlockCompression::encode(rgba);
+        CHECK(bc3.type() == ImageType::BC3);
+        CHECK(bc3.size() == 17 * 9 * 16);
+
+        Image big(256, 256, ImageType::RGB);
+        CHECK(BlockCompression::encode(big).size() * 6 == big.size());
+
+        // Copies keep the compressed data
+        Image copy(bc1);
+        CHECK(copy.size() == bc1.size());
+        CHECK(std::equal(bc1.data(), bc1.data() + bc1.size(), copy.data()));
+    }
+
+    SECTION("BC1 quality") {
+        Image decoded =
+            BlockCompression::decode(BlockCompression::encode(rgb));
+        CHECK(decoded.type() == ImageType::RGBA);
+        CHECK(blockCompressionPSNR(rgb, decoded, 3) > 35);
+    }
+
+    SECTION("BC3 quality") {
+        Image decoded =
+            BlockCompression::decode(BlockCompression::encode(rgba));
+        CHECK(blockCompressionPSNR(rgba, decoded, 3) > 35);
+        CHECK(blockCompressionPSNR(rgba, decoded, 4) > 35);
+    }
+
+    SECTION("uniform blocks are exact") {
+        Image grey(8, 8, ImageType::GREYSCALE);
+        ImageUtils::fill(grey, Color4d(1, 1, 1, 1));
+        Image decoded =
+            BlockCompression::decode(BlockCompression::encode(grey));
+        CHECK(std::all_of(decoded.data(), decoded.data() + decoded.size(),
+                          [](u8 v) { return v == 255; }));
+    }
+
+    SECTION("multithreaded encoding gives the same result") {
+        Image big(256, 256, ImageType::RGBA);
+
+        for (int y = 0; y < big.height(); ++y) {
+            for (int x = 0; x < big.width(); ++x) {
+                big.rgba(x, y).set(u8(x), u8(y), u8(x ^ y), u8(x + y));
+            }
+        }
+        Image single = BlockCompression::encode(big, ImageType::BC3, 1);
+        Image multi = BlockCompression::encode(big, ImageType::BC3, 4);
+        CHECK(std::equal(single.data(), single.data() + single.size(),
+                         multi.data()));
+    }
+
+    SECTION("rectangles compressed again") {
+        Image bc3 = BlockCompression::encode(rgba);
+        ImageUtils::fillRect(rgba, 10, 5, 30, 20, Color4d(1, 0, 0, 0.5));
+        BlockCompression::encodeRect(rgba, bc3, {10, 5, 30, 20});
+        Image expected = BlockCompression::encode(rgba);
+        CHECK(std::equal(expected.data(), expected.data() + expected.size(),
+                         bc3.data()));
+    }
+
+    SECTION("compressed channel") {
+        Collector collector;
+        auto &images =
+            collector.addCustomChannel<Image, BlockCompressedChannel>();
+        images.put({"rgb"}, rgb);
+        images.put({"bc3"}, BlockCompression::encode(rgba));
+        CHECK(images.get({"rgb"}).type() == ImageType::BC1);
+        CHECK(images.get({"bc3"}).type() == ImageType::BC3);
+    }
+
+    SECTION("errors") {
+        Image bc1 = BlockCompression::encode(rgb);
+        CHECK_THROWS_AS(BlockCompression::encode(bc1), std::invalid_argument);
+        CHECK_THROWS_AS(BlockCompression::encodeRect(rgb, rgb, {0, 0, 4, 4}),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(BlockCompression::encode(rgb, ImageType::RGB),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(BlockCompression::decode(rgb), std::invalid_argument);
+        CHECK_THROWS(bc1.write("assets/image/bc1.png"));
+    }
+}
+
+TEST_CASE("Image - mip chain", "[image]") {
+    Image img(16, 8, ImageType::RGBA);
+
+    for (int y = 0; y < img.height(); ++y) {
+        for (int x = 0; x < img.width(); ++x) {
+            img.rgba(x, y).set(u8(x * 16), u8(y * 32), 100, 255);
+        }
+    }
+
+    SECTION("levels") {
+        ImageUtils::generateMips(img);
+        REQUIRE(img.mipCount() == 4);
+        CHECK(&img.mip(0) == &img);
+        CHECK(img.mip(1).width() == 8);
+        CHECK(img.mip(1).height() == 4);
+        CHECK(img.mip(3).width() == 2);
+        CHECK(img.mip(3).height() == 1);
+        CHECK(img.mip(4).width() == 1);
+        CHECK(img.mip(4).height() == 1);
+        CHECK_THROWS_AS(img.mip(5), std::out_of_range);
+
+        // Box filter average
+        auto &pix = img.mip(1).rgba(1, 1);
+        CHECK(pix.getRed() == (32 + 48 + 1) / 2);
+        CHECK(pix.getGreen() == (64 + 96) / 2);
+        CHECK(pix.getBlue() == 100);
+
+        Image copy(img);
+        CHECK(copy.mipCount() == 4);
+        copy.clearMips(1);
+        CHECK(copy.mipCount() == 1);
+        CHECK(img.mipCount() == 4);
+    }
+
+    SECTION("seeded levels are kept") {
+        img.addMip(Image(8, 4, ImageType::RGBA));
+        ImageUtils::fill(img.mip(1), Color4d(1, 0, 0, 1));
+        ImageUtils::generateMips(img, {}, 2);
+        REQUIRE(img.mipCount() == 4);
+        CHECK(img.mip(1).rgba(0, 0).getRed() == 255);
+        CHECK(img.mip(4).rgba(0, 0).getRed() == 255);
+        CHECK(img.mip(4).rgba(0, 0).getGreen() == 0);
+    }
+
+    SECTION("box filter on every pixel size") {
+        // Odd sizes, so that the vectorized part and the scalar remainder
+        // of each line are both used
+        for (ImageType type :
+             {ImageType::GREYSCALE, ImageType::RGB, ImageType::RGBA}) {
+            Image src(37, 9, type);
+
+            for (int i = 0; i < src.size(); ++i) {
+                src.data()[i] = u8(i * 37 + (i >> 3) * 11);
+            }
+            Image mip = ImageUtils::downsample(src);
+            REQUIRE(mip.width() == 18);
+            REQUIRE(mip.height() == 4);
+            const int elem = src.elemSize();
+            int errors = 0;
+
+            for (int y = 0; y < mip.height(); ++y) {
+                for (int x = 0; x < mip.width(); ++x) {
+                    for (int c = 0; c < elem; ++c) {
+                        auto at = [&](int sx, int sy) {
+                            return int(
+                                src.data()[(sy * src.width() + sx) * elem + c]);
+                        };
+                        const int expected =
+                            (at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) +
+                             at(2 * x, 2 * y + 1) + at(2 * x + 1, 2 * y + 1) +
+                             2) >>
+                            2;
+                        const int actual =
+                            mip.data()[(y * mip.width() + x) * elem + c];
+                        errors += expected != actual;
+                    }
+                }
+            }
+            CHECK(errors == 0);
+        }
+    }
+
+    SECTION("kaiser filter keeps uniform colors") {
+        Image grey(32, 32, ImageType::GREYSCALE);
+        ImageUtils::fill(grey, Color4d(0.5, 0.5, 0.5, 1));
+        MipChainParams params;
+        params._filter = MipFilter::KAISER;
+        ImageUtils::generateMips(grey, params);
+        REQUIRE(grey.mipCount() == 5);
+
+        for (int level = 1; level <= 5; ++level) {
+            CHECK(std::abs(grey.mip(level).grey(0, 0).getLevel() -
+                           grey.grey(0, 0).getLevel()) <= 1);
+        }
+    }
+
+    SECTION("srgb") {
+        Image checker(2, 2, ImageType::RGB);
+        checker.rgb(0, 0).set(0, 0, 0);
+        checker.rgb(1, 0).set(255, 255, 255);
+        checker.rgb(0, 1).set(255, 255, 255);
+        checker.rgb(1, 1).set(0, 0, 0);
+
+        CHECK(ImageUtils::downsample(checker).rgb(0, 0).getRed() == 128);
+
+        MipChainParams params;
+        params._srgb = true;
+        // 0.5 in linear space is 188 in sRGB
+        CHECK(ImageUtils::downsample(checker, params).rgb(0, 0).getRed() ==
+              188);
+    }
+
+    SECTION("alpha weighted") {
+        Image quad(2, 2, ImageType::RGBA);
+        quad.rgba(0, 0).set(255, 0, 0, 255);
+        quad.rgba(1, 0).set(0, 255, 0, 0);
+        quad.rgba(0, 1).set(0, 255, 0, 0);
+        quad.rgba(1, 1).set(0, 255, 0, 0);
+
+        MipChainParams params;
+        params._alphaWeighted = true;
+        Image mip = ImageUtils::downsample(quad, params);
+        auto &pix = mip.rgba(0, 0);
+        CHECK(pix.getRed() == 255);
+        CHECK(pix.getGreen() == 0);
+        CHECK(pix.getAlpha() == 64);
+    }
+
+    SECTION("crop") {
+        Image part = ImageUtils::crop(img, 4, 2, 3, 5);
+        CHECK(part.width() == 3);
+        CHECK(part.height() == 5);
+        CHECK(part.rgba(1, 1).getRed() == 5 * 16);
+        CHECK(part.rgba(1, 1).getGreen() == 3 * 32);
+        CHECK_THROWS_AS(ImageUtils::crop(img, 14, 0, 3, 1),
+                        std::invalid_argument);
+    }
+}
+
+// Per pixel implementations of the ImageUtils functions, as they were before
+// the row kernels. The kernels must give the same results.
+
+Image referenceToType(const Image &src, ImageType type) {
+    Image dst(src.width(), src.height(), type);
+    float array[] = {0, 0, 0, 1};
+
+    for (int y = 0; y < dst.height(); ++y) {
+        for (int x = 0; x < dst.width(); ++x) {
+            src.getf(x, y, array);
+            dst.setf(x, y, array);
+        }
+    }
+    return dst;
+}
+
+void referencePaintTexturef(Image &dst, const Image &src, const vec2d &dstPos,
+                            const vec2d &dstSize) {
+    vec2i dstDims{dst.width(), dst.height()};
+    vec2i srcDims{src.width(), src.height()};
+    vec2d startPoint = dstPos * dstDims;
+    vec2d dims = dstSize * dstDims;
+    vec2d endPoint = startPoint + dims;
+
+    vec2i dstMin{static_cast<int>(ceil(max(startPoint.x, 0))),
+                 static_cast<int>(ceil(max(startPoint.y, 0)))};
+    vec2i dstMax{static_cast<int>(floor(min(endPoint.x, dstDims.x))),
+                 static_cast<int>(floor(min(endPoint.y, dstDims.y)))};
+
+    for (int x = dstMin.x; x < dstMax.x; ++x) {
+        for (int y = dstMin.y; y < dstMax.y; ++y) {
+            vec2d srcPos = (vec2d(x, y) - startPoint) / dims *
+                           (srcDims - vec2d(0.01, 0.01));
+            dst.rgb(x, y) = src.rgb(static_cast<int>(floor(srcPos.x)),
+                                    static_cast<int>(floor(srcPos.y)));
+        }
+    }
+}
+
+void referenceFill(Image &img, const Color4d &color) {
+    for (int y = 0; y < img.height(); ++y) {
+        for (int x = 0; x < img.width(); ++x) {
+            img.rgb(x, y).setf(color._r, color._g, color._b);
+        }
+    }
+}
+
+/** Scalar blending of one RGBA pixel over another, as done by the fallback
+ * loop of ImageUtils::blend(). */
+void referenceBlendPixel(u8 *dst, const u8 *src) {
+    const int alpha = src[3];
+    const int inv = 255 - alpha;
+
+    for (int c = 0; c < 3; ++c) {
+        dst[c] = static_cast<u8>((src[c] * alpha + dst[c] * inv + 127) / 255);
+    }
+    dst[3] = static_cast<u8>(alpha + (dst[3] * inv + 127) / 255);
+}
+
+Image randomImage(int width, int height, ImageType type, u32 seed) {
+    Image img(width, height, type);
+    std::mt19937 rng(seed);
+
+    for (int i = 0; i < img.size(); ++i) {
+        img.data()[i] = static_cast<u8>(rng());
+    }
+    return img;
+}
+
+bool sameData(const Image &a, const Image &b, int tolerance = 0) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (std::abs(a.data()[i] - b.data()[i]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("ImageUtils - row kernels conformance", "[image]") {
+    SECTION("toType") {
+        const ImageType types[] = {ImageType::RGB, ImageType::RGBA};
+
+        for (ImageType srcType : types) {
+            Image src = randomImage(23, 17, srcType, 1);
+
+            for (ImageType dstType :
+                 {ImageType::RGB, ImageType::RGBA, ImageType::GREYSCALE}) {
+                CHECK(sameData(ImageUtils::toType(src, dstType),
+                               referenceToType(src, dstType), 1));
+            }
+        }
+
+        // Greyscale levels are expanded to all the color channels
+        Image grey = randomImage(5, 3, ImageType::GREYSCALE, 2);
+        Image rgba = ImageUtils::toType(grey, ImageType::RGBA);
+        CHECK(rgba.rgba(4, 2).getRed() == grey.grey(4, 2).getLevel());
+        CHECK(rgba.rgba(4, 2).getBlue() == grey.grey(4, 2).getLevel());
+        CHECK(rgba.rgba(4, 2).getAlpha() == 255);
+    }
+
+    SECTION("paintTexturef") {
+        Image src = randomImage(17, 13, ImageType::RGB, 3);
+        const vec2d placements[][2] = {{{0.1, 0.2}, {0.5, 0.7}},
+                                       {{-0.2, 0.6}, {0.8, 0.8}},
+                                       {{0, 0}, {1, 1}}};
+
+        for (ImageType dstType : {ImageType::RGB, ImageType::RGBA}) {
+            for (auto &placement : placements) {
+                Image expected = randomImage(50, 40, dstType, 4);
+                Image actual(expected);
+                referencePaintTexturef(expected, src, placement[0],
+                                       placement[1]);
+                ImageUtils::paintTexturef(actual, src, placement[0],
+                                          placement[1]);
+                CHECK(sameData(actual, expected));
+            }
+        }
+    }
+
+    SECTION("fill") {
+        Image expected = randomImage(31, 9, ImageType::RGB, 5);
+        Image actual(expected);
+        referenceFill(expected, Color4d(0.4, 0.8, 0.2, 1));
+        ImageUtils::fill(actual, Color4d(0.4, 0.8, 0.2, 1));
+        CHECK(sameData(actual, expected));
+    }
+
+    SECTION("getRowf and setRowf") {
+        Image img = randomImage(11, 4, ImageType::RGBA, 6);
+        std::vector<float> row(11 * 4);
+        ImageUtils::getRowf(img, 2, row.data());
+        float pixel[4];
+        img.getf(7, 2, pixel);
+
+        for (int c = 0; c < 4; ++c) {
+            CHECK(row[7 * 4 + c] == pixel[c]);
+            row[7 * 4 + c] = 0.3f * c;
+        }
+
+        Image expected(img);
+        expected.setf(7, 2, row.data() + 7 * 4);
+        ImageUtils::setRowf(img, 2, row.data());
+        CHECK(sameData(img, expected));
+    }
+
+    // The widths cover the SSE2 and AVX2 parts of the rows as well as the
+    // scalar remainders
+    const int widths[] = {1, 3, 4, 7, 8, 13, 37};
+
+    SECTION("vectorized blend") {
+        for (int width : widths) {
+            Image src = randomImage(width, 3, ImageType::RGBA, 7);
+            // Fully transparent and fully opaque pixels
+            src.rgba(0, 1).setAlpha(0);
+            src.rgba(width - 1, 2).setAlpha(255);
+            Image expected = randomImage(width, 3, ImageType::RGBA, 8);
+            Image actual(expected);
+
+            for (int i = 0; i < src.size(); i += 4) {
+                referenceBlendPixel(expected.data() + i, src.data() + i);
+            }
+            ImageUtils::blend(actual, src, 0, 0);
+            CHECK(sameData(actual, expected));
+        }
+    }
+
+    SECTION("vectorized getRowf and setRowf") {
+        std::mt19937 rng(9);
+        std::uniform_real_distribution<float> distrib(-0.2f, 1.2f);
+
+        for (int width : widths) {
+            Image img = randomImage(width, 1, ImageType::RGBA, 10);
+            std::vector<float> row(width * 4);
+            ImageUtils::getRowf(img, 0, row.data());
+            int errors = 0;
+
+            for (int x = 0; x < width; ++x) {
+                float pixel[4];
+                img.getf(x, 0, pixel);
+                errors += !std::equal(pixel, pixel + 4, &row[x * 4]);
+            }
+            CHECK(errors == 0);
+
+            for (float &value : row) {
+                value = distrib(rng);
+            }
+            // Values on the rounding boundaries
+            row[0] = 1.f / 255;
+            row[width * 4 - 1] = 1;
+            // Values out of [0, 1] are clamped
+            Image expected(img);
+
+            for (int i = 0; i < width * 4; ++i) {
+                expected.data()[i] =
+                    static_cast<u8>(clamp(double(row[i]), 0., 1.) * 255);
+            }
+            ImageUtils::setRowf(img, 0, row.data());
+            CHECK(sameData(img, expected));
+        }
+    }
+}
+
+TEST_CASE("ImageUtils - row kernels", "[image]") {
+    Image img(8, 8, ImageType::RGBA);
+    ImageUtils::fill(img, Color4d(0, 0, 0, 1));
+
+    SECTION("fillRect clipping") {
+        ImageUtils::fillRect(img, -2, 6, 4, 10, Color4d(1, 0, 0, 1));
+        CHECK(img.rgba(0, 6).getRed() == 255);
+        CHECK(img.rgba(1, 7).getRed() == 255);
+        CHECK(img.rgba(2, 7).getRed() == 0);
+        CHECK(img.rgba(1, 5).getRed() == 0);
+    }
+
+    SECTION("blit with clipping and conversion") {
+        Image src(4, 4, ImageType::RGB);
+        ImageUtils::fill(src, Color4d(0, 1, 0, 1));
+        src.rgb(2, 0).set(10, 20, 30);
+        ImageUtils::blit(img, src, 5, -2);
+
+        CHECK(img.rgba(5, 0).getGreen() == 255);
+        CHECK(img.rgba(5, 0).getAlpha() == 255);
+        CHECK(img.rgba(4, 0).getGreen() == 0);
+        CHECK(img.rgba(7, 1).getGreen() == 255);
+        CHECK(img.rgba(7, 2).getGreen() == 0);
+
+        ImageUtils::blit(img, src, 5, 4);
+        CHECK(img.rgba(7, 4).getRed() == 10);
+        CHECK(img.rgba(7, 4).getBlue() == 30);
+    }
+
+    SECTION("blend") {
+        Image src(3, 1, ImageType::RGBA);
+        src.rgba(0, 0).set(255, 255, 255, 0);
+        src.rgba(1, 0).set(255, 255, 255, 255);
+        src.rgba(2, 0).set(255, 255, 255, 128);
+        ImageUtils::fillRect(img, 0, 0, 3, 1, Color4d(0, 0, 0, 0));
+        ImageUtils::blend(img, src, 0, 0);
+
+        CHECK(img.rgba(0, 0).getRed() == 0);
+        CHECK(img.rgba(0, 0).getAlpha() == 0);
+        CHECK(img.rgba(1, 0).getRed() == 255);
+        CHECK(img.rgba(1, 0).getAlpha() == 255);
+        CHECK(img.rgba(2, 0).getRed() == 128);
+        CHECK(img.rgba(2, 0).getAlpha() == 128);
+        // Untouched
+        CHECK(img.rgba(3, 0).getAlpha() == 255);
+    }
+
+    SECTION("scaleBias") {
+        ImageUtils::fill(img, Color4d(1, 0.2, 0, 1));
+        ImageUtils::scaleBias(img, Color4d(0.5, 1, 1, 1),
+                              Color4d(0.25, 0, -0.5, 0));
+        CHECK(img.rgba(3, 3).getRed() == 191);
+        CHECK(img.rgba(3, 3).getGreen() == 51);
+        CHECK(img.rgba(3, 3).getBlue() == 0);
+        CHECK(img.rgba(3, 3).getAlpha() == 255);
+    }
+
+    SECTION("compressed images are rejected") {
+        Image bc1 = BlockCompression::encode(img);
+        CHECK_THROWS_AS(ImageUtils::fill(bc1, Color4d(0, 0, 0, 0)),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(ImageUtils::blit(img, bc1, 0, 0),
+                        std::invalid_argument);
+    }
+}
+
 TEST_CASE("Image - Benchmarks", "[image][!benchmark]") {
 
     Image imgRGBA(1024, 1024, ImageType::RGBA);
@@ -174,4 +758,164 @@ TEST_CASE("Image - Benchmarks", "[image][!benchmark]") {
             }
         }
     }
-}
\ No newline at end of file
+
+    SECTION("Row kernels") {
+        Image src = randomImage(256, 256, ImageType::RGB, 7);
+
+        BENCHMARK("per pixel fill RGBA (1024 * 1024)") {
+            referenceFill(imgRGBA, Color4d(0.4, 0.8, 0.2, 1));
+        }
+
+        BENCHMARK("fill RGBA (1024 * 1024)") {
+            ImageUtils::fill(imgRGBA, Color4d(0.4, 0.8, 0.2, 1));
+        }
+
+        BENCHMARK("per pixel paintTexturef (1024 * 1024)") {
+            referencePaintTexturef(imgRGBA, src, {0, 0}, {1, 1});
+        }
+
+        BENCHMARK("paintTexturef (1024 * 1024)") {
+            ImageUtils::paintTexturef(imgRGBA, src, {0, 0}, {1, 1});
+        }
+
+        BENCHMARK("per pixel toType RGBA to RGB (1024 * 1024)") {
+            referenceToType(imgRGBA, ImageType::RGB);
+        }
+
+        BENCHMARK("toType RGBA to RGB (1024 * 1024)") {
+            ImageUtils::toType(imgRGBA, ImageType::RGB);
+        }
+    }
+
+    SECTION("Mip chain") {
+        for (int res : {128, 512, 2048}) {
+            for (ImageType type : {ImageType::RGB, ImageType::RGBA}) {
+                Image img(res, res, type);
+                ImageUtils::fill(img, Color4d(0.2, 0.5, 0.8, 1));
+                std::string name = std::to_string(res) + "x" +
+                                   std::to_string(res) +
+                                   (type == ImageType::RGB ? " RGB" : " RGBA");
+                MipChainParams srgb;
+                srgb._srgb = true;
+                MipChainParams kaiser;
+                kaiser._filter = MipFilter::KAISER;
+
+                BENCHMARK("box mips " + name) {
+                    ImageUtils::generateMips(img);
+                }
+
+                BENCHMARK("sRGB box mips " + name) {
+                    ImageUtils::generateMips(img, srgb);
+                }
+
+                BENCHMARK("kaiser mips " + name) {
+                    ImageUtils::generateMips(img, kaiser);
+                }
+            }
+        }
+    }
+
+    SECTION("Block compression") {
+        Image imgRGB(1024, 1024, ImageType::RGB);
+        ImageUtils::fill(imgRGB, Color4d(0.2, 0.5, 0.8, 1));
+        ImageUtils::fill(imgRGBA, Color4d(0.2, 0.5, 0.8, 0.5));
+
+        BENCHMARK("BC1 encoding, 1 thread (1024 * 1024)") {
+            BlockCompression::encode(imgRGB, ImageType::BC1, 1);
+        }
+
+        BENCHMARK("BC1 encoding, all threads (1024 * 1024)") {
+            BlockCompression::encode(imgRGB, ImageType::BC1);
+        }
+
+        BENCHMARK("BC3 encoding, all threads (1024 * 1024)") {
+            BlockCompression::encode(imgRGBA, ImageType::BC3);
+        }
+    }
+}
+TEST_CASE("Image - TextureAtlas", "[image]") {
+    // 2 x 2 slots of 16 + 2 * 2 pixels
+    TextureAtlas atlas(40, 16, 1);
+    REQUIRE(atlas.getSlotsPerRow() == 2);
+
+    Image texture(16, 16, ImageType::RGB);
+
+    for (int y = 0; y < 16; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            texture.rgb(x, y).set(u8(x), u8(y), 7);
+        }
+    }
+
+    AtlasSlot slot = atlas.put("a", texture);
+    REQUIRE(slot.isValid());
+    CHECK(atlas.getPageCount() == 1);
+
+    SECTION("content and padding") {
+        const Image &page = atlas.getPage(slot._page);
+        CHECK(page.rgb(slot._x + 3, slot._y + 5).getRed() == 3);
+        CHECK(page.rgb(slot._x + 3, slot._y + 5).getGreen() == 5);
+        CHECK(page.rgb(slot._x - 2, slot._y + 15).getRed() == 0);
+        CHECK(page.rgb(slot._x + 17, slot._y + 15).getRed() == 15);
+        CHECK(page.rgb(slot._x + 17, slot._y + 17).getGreen() == 15);
+    }
+
+    SECTION("uv transform") {
+        // v = 1 is the first row of the texture
+        vec2d topLeft = atlas.transformUV(slot, {0, 1});
+        CHECK(topLeft.x == Approx(slot._x / 40.));
+        CHECK(topLeft.y == Approx(1 - slot._y / 40.));
+        vec2d bottomRight = atlas.transformUV(slot, {1, 0});
+        CHECK(bottomRight.x == Approx((slot._x + 16) / 40.));
+        CHECK(bottomRight.y == Approx(1 - (slot._y + 16) / 40.));
+    }
+
+    SECTION("LRU eviction") {
+        atlas.put("b", texture);
+        atlas.put("c", texture);
+        atlas.put("d", texture);
+        atlas.get("a");
+
+        std::string evicted;
+        AtlasSlot slotE = atlas.put("e", texture, &evicted);
+        CHECK(evicted == "b");
+        CHECK_FALSE(atlas.has("b"));
+        CHECK(atlas.has("a"));
+        CHECK(atlas.getPageCount() == 1);
+        CHECK(slotE._page == 0);
+    }
+
+    SECTION("textures of the current frame") {
+        atlas.startFrame();
+        atlas.get("a");
+        atlas.put("b", texture);
+        atlas.put("c", texture);
+        atlas.put("d", texture);
+
+        // All the textures are used in this frame
+        std::string evicted;
+        CHECK_FALSE(atlas.put("e", texture, &evicted).isValid());
+        CHECK(evicted.empty());
+        CHECK(atlas.has("a"));
+        CHECK_FALSE(atlas.has("e"));
+
+        atlas.startFrame();
+        CHECK(atlas.put("e", texture, &evicted).isValid());
+        CHECK(evicted == "a");
+    }
+
+    SECTION("partial updates") {
+        atlas.takeChangedRect(slot._page);
+        texture.rgb(4, 5).set(255, 255, 255);
+        CHECK(atlas.update("a", texture, {4, 5, 1, 1})._page == slot._page);
+        CHECK_FALSE(atlas.update("b", texture, {4, 5, 1, 1}).isValid());
+
+        // The changed pixel, with the padding around it
+        ImageRect changed = atlas.takeChangedRect(slot._page);
+        CHECK(changed._x == slot._x + 2);
+        CHECK(changed._y == slot._y + 3);
+        CHECK(changed._width == 5);
+        CHECK(changed._height == 5);
+        const Image &page = atlas.getPage(slot._page);
+        CHECK(page.rgb(slot._x + 4, slot._y + 5).getRed() == 255);
+    }
+}
@@ -1,6 +1,12 @@
 #include <catch/catch.hpp>
 
+#include <algorithm>
+#include <tuple>
+
 #include <world/core.h>
+#include <world/core/ConstantResolution.h>
+#include <world/math/Interpolation.h>
+#include <world/math/RandomHelper.h>
 #include <world/terrain.h>
 
 using namespace world;
@@ -52,6 +58,519 @@ TEST_CASE("Templates", "[instance pool]") {
     }
 }
 
+TEST_CASE("Instance - instance buffers", "[instance pool]") {
+    Template tree;
+    tree._id = 1;
+    tree.insert(0, {SceneNode("trunk", "bark"), SceneNode("leaves", "leaf")});
+    Template rock(SceneNode("rock"));
+    rock._id = 2;
+
+    Instance instance;
+
+    for (int i = 0; i < 100; ++i) {
+        Template tp = i % 4 == 0 ? rock : tree;
+        tp._position = {i * 1., i * 2., 0};
+        tp._rotation = {0, 0, i * 0.01};
+        tp._scale = {2};
+        instance.addNode(tp);
+    }
+
+    ConstantResolution resolution(10);
+    Collector collector(CollectorPresets::SCENE);
+
+    // (mesh, material, x, y, z, rotation z, scale) for each collected node
+    typedef std::tuple<std::string, std::string, double, double, double,
+                       double, double>
+        NodeTuple;
+    auto toTuple = [](const SceneNode &node) {
+        return NodeTuple{node.getMeshID(),       node.getMaterialID(),
+                         node.getPosition().x,   node.getPosition().y,
+                         node.getPosition().z,   node.getRotation().z,
+                         node.getScale().x};
+    };
+
+    SECTION("one buffer per template node") {
+        auto &buffers = collector.addStorageChannel<InstanceBuffer>();
+        instance.collect(collector, resolution);
+
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 0);
+        REQUIRE(buffers.size() == 3);
+        size_t total = 0;
+
+        for (auto entry : buffers) {
+            total += entry._value.size();
+        }
+        CHECK(total == 75 * 2 + 25);
+    }
+
+    SECTION("buffers have the same transforms as scene nodes") {
+        instance.collect(collector, resolution);
+        std::vector<NodeTuple> expected;
+
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            expected.push_back(toTuple(entry._value));
+        }
+
+        Collector bufferCollector(CollectorPresets::SCENE);
+        auto &buffers = bufferCollector.addStorageChannel<InstanceBuffer>();
+        instance.collect(bufferCollector, resolution);
+        std::vector<NodeTuple> actual;
+
+        for (auto entry : buffers) {
+            for (size_t i = 0; i < entry._value.size(); ++i) {
+                // Transforms are stored in single precision
+                NodeTuple node = toTuple(entry._value.getNode(i));
+                std::get<5>(node) = float(std::get<5>(node));
+                actual.push_back(node);
+            }
+        }
+        for (auto &node : expected) {
+            std::get<5>(node) = float(std::get<5>(node));
+        }
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        CHECK(actual == expected);
+    }
+
+    SECTION("node offsets follow the template rotation") {
+        SceneNode leaves("leaves", "leaf");
+        leaves.setPosition({1, 0, 3});
+        Template offset(leaves);
+        offset._position = {10, 20, 0};
+        offset._rotation = {0, 0, M_PI / 2};
+        offset._scale = {2};
+        Instance rotated(offset);
+
+        // Scaled, then rotated by a quarter turn around z
+        const vec3d expected{10, 22, 6};
+        rotated.collect(collector, resolution);
+        REQUIRE(collector.getStorageChannel<SceneNode>().size() == 1);
+
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            const vec3d position = entry._value.getPosition();
+            CHECK(position.x == Approx(expected.x).margin(1e-9));
+            CHECK(position.y == Approx(expected.y));
+            CHECK(position.z == Approx(expected.z));
+        }
+
+        auto &buffers = collector.addStorageChannel<InstanceBuffer>();
+        rotated.collect(collector, resolution);
+        REQUIRE(buffers.size() == 1);
+
+        for (auto entry : buffers) {
+            const vec3d position = entry._value.getNode(0).getPosition();
+            CHECK(position.x == Approx(expected.x).margin(1e-5));
+            CHECK(position.y == Approx(expected.y));
+            CHECK(position.z == Approx(expected.z));
+        }
+    }
+}
+
+/** Constant resolution counting the point queries. */
+class InstanceResolutionCounter : public ConstantResolution {
+public:
+    mutable int _count = 0;
+
+    InstanceResolutionCounter(double resolution)
+            : ConstantResolution(resolution) {}
+
+    double getResolutionAt(const vec3d &coord) const override {
+        ++_count;
+        return ConstantResolution::getResolutionAt(coord);
+    }
+};
+
+TEST_CASE("Instance - hierarchical collect", "[instance pool]") {
+    Template tp;
+    tp.insert(5, SceneNode("far"));
+    tp.insert(10, SceneNode("near"));
+    Instance instance;
+
+    for (int i = 0; i < 100; ++i) {
+        tp._position = {i * 1., i * 2., 0};
+        instance.addNode(tp);
+    }
+
+    Collector collector(CollectorPresets::SCENE);
+    auto &nodes = collector.getStorageChannel<SceneNode>();
+
+    SECTION("nodes with a single level of detail are resolved at once") {
+        InstanceResolutionCounter resolution(7);
+        instance.collect(collector, resolution);
+        CHECK(resolution._count == 0);
+        REQUIRE(nodes.size() == 100);
+
+        for (auto entry : nodes) {
+            CHECK(entry._value.getMeshID() == "far");
+        }
+    }
+
+    SECTION("templates are culled at once") {
+        InstanceResolutionCounter resolution(2);
+        instance.collect(collector, resolution);
+        CHECK(resolution._count == 0);
+        CHECK(nodes.size() == 0);
+    }
+}
+
+TEST_CASE("Instance - collect benchmark", "[instance pool][!benchmark]") {
+    Template grass(SceneNode("grass", "grass_material"));
+    Instance instance;
+
+    for (int i = 0; i < 100000; ++i) {
+        grass._position = {i % 300 * 1., i / 300 * 1., 0};
+        instance.addNode(grass);
+    }
+
+    ConstantResolution resolution(10);
+
+    BENCHMARK("100000 instances as scene nodes") {
+        Collector collector(CollectorPresets::SCENE);
+        instance.collect(collector, resolution);
+    }
+
+    BENCHMARK("100000 instances in an instance buffer") {
+        Collector collector(CollectorPresets::SCENE);
+        collector.addStorageChannel<InstanceBuffer>();
+        instance.collect(collector, resolution);
+    }
+}
+
+class MeshPutCounter : public CollectorChannel<Mesh> {
+public:
+    std::map<std::string, int> _puts;
+
+    void put(const ItemKey &key, const Mesh &item,
+             const ExplorationContext &ctx) override {
+        ++_puts[ItemKeys::getLastNode(key)];
+        CollectorChannel<Mesh>::put(key, item, ctx);
+    }
+
+    int total() const {
+        int total = 0;
+
+        for (auto &entry : _puts) {
+            total += entry.second;
+        }
+        return total;
+    }
+};
+
+/** Generator with a low LOD visible from everywhere, and a high LOD that is
+ * never visible in the tests. It also puts a mesh that no template uses. */
+class LodGenerator : public IInstanceGenerator {
+public:
+    std::vector<Template> collectTemplates(ICollector &collector,
+                                           const ExplorationContext &ctx,
+                                           double maxRes) override {
+        auto &meshChan = collector.getChannel<Mesh>();
+        Template tp;
+        meshChan.put({"unused"}, Mesh(), ctx);
+        meshChan.put({"low"}, Mesh(), ctx);
+        tp.insert(0, ctx.createNode({"low"}, {}));
+
+        if (maxRes >= 1000) {
+            meshChan.put({"high"}, Mesh(), ctx);
+            tp.insert(1000, ctx.createNode({"high"}, {}));
+        }
+        return {tp};
+    }
+
+    HabitatFeatures randomize() override { return {}; }
+
+    LodGenerator *newInstance() override { return new LodGenerator(); }
+
+    void change() { updateGeneration(); }
+};
+
+TEST_CASE("InstancePool - template collection", "[instance pool]") {
+    GridChunkSystem chunkSystem(1000, 6, 0.5);
+    auto &pool = chunkSystem.addDecorator<InstancePool<>>();
+    pool.setTemplateGenerator<LodGenerator>();
+    pool.distribution().setDensity(0.02);
+
+    std::vector<LodGenerator *> generators;
+
+    for (int i = 0; i < 10; ++i) {
+        generators.push_back(&pool.addGenerator<LodGenerator>());
+    }
+
+    Collector collector;
+    collector.addStorageChannel<SceneNode>();
+    auto &meshes = collector.addCustomChannel<Mesh, MeshPutCounter>();
+    FirstPersonView view;
+
+    chunkSystem.collect(collector, view);
+    const int firstFrame = meshes.total();
+    REQUIRE(collector.getStorageChannel<SceneNode>().size() != 0);
+    // Each template is put once, at the resolution of the instances
+    CHECK(firstFrame != 0);
+    CHECK(firstFrame <= 10);
+    CHECK(meshes._puts["high"] == 0);
+    CHECK(meshes._puts["unused"] == 0);
+
+    SECTION("templates are put once per collector epoch") {
+        meshes._puts.clear();
+        chunkSystem.collect(collector, view);
+        CHECK(meshes.total() == 0);
+
+        collector.reset();
+        chunkSystem.collect(collector, view);
+        CHECK(meshes.total() == firstFrame);
+    }
+
+    SECTION("hosts resetting at each frame get the templates each time") {
+        for (int frame = 0; frame < 3; ++frame) {
+            meshes._puts.clear();
+            collector.reset();
+            chunkSystem.collect(collector, view);
+            CHECK(meshes.total() == firstFrame);
+            CHECK(meshes._puts["unused"] == 0);
+        }
+    }
+
+    SECTION("changed generators are put again") {
+        meshes._puts.clear();
+
+        for (auto *generator : generators) {
+            generator->change();
+        }
+        chunkSystem.collect(collector, view);
+        CHECK(meshes.total() == firstFrame);
+    }
+}
+
+/** Environment whose ground is a smooth wave, partly under the sea. */
+class WaveEnvironment : public IEnvironment {
+public:
+    vec3d findNearestFreePoint(const vec3d &origin, const vec3d &direction,
+                               double resolution,
+                               const ExplorationContext &ctx) const override {
+        return {origin.x, origin.y,
+                800 + 1000 * sin(origin.x / 700) * cos(origin.y / 500)};
+    }
+};
+
+/** SeedDistribution with a fixed random seed, and the scoring of the
+ * positions as it was before the seeds were stored in arrays. The
+ * distribution must still place the same instances. */
+class TestSeedDistribution : public SeedDistribution {
+public:
+    explicit TestSeedDistribution(u32 seed) {
+        _rng.seed(seed);
+        setSeed(seed);
+    }
+
+    std::vector<Position> getReferencePositions(
+        Chunk &chunk, const ExplorationContext &ctx) {
+        addSeeds(chunk);
+
+        std::vector<Position> positions;
+        std::vector<Seed> seedsAround = getSeedsAround(chunk);
+        double maxDensity = 0;
+
+        for (Seed &seed : seedsAround) {
+            maxDensity =
+                std::max(maxDensity, _habitats.at(seed._generatorId)._density);
+        }
+
+        vec3d chunkPos = chunk.getPosition3D();
+        vec3d chunkDims = chunk.getSize();
+        int count = randRound(_rng, maxDensity * chunkDims.x * chunkDims.y);
+
+        std::uniform_real_distribution<double> posDistrib(0, 1);
+        std::uniform_real_distribution<double> keepDistrib(0, 1);
+        std::vector<vec3d> absPositions(count);
+
+        for (vec3d &absPos : absPositions) {
+            absPos = chunkPos + vec3d{posDistrib(_rng) * chunkDims.x,
+                                      posDistrib(_rng) * chunkDims.y, -10000};
+        }
+        ctx.getEnvironment().findNearestFreePoints(
+            absPositions.data(), absPositions.data(), absPositions.size(),
+            vec3d{0, 0, 1}, _resolution, ExplorationContext::getDefault());
+
+        const auto getProb = [](vec2d range, double x) {
+            double l = (range.y - range.x) * 0.1;
+            return min(smoothstep(range.x - l, range.x + l, x),
+                       smoothstep(range.y + l, range.y - l, x));
+        };
+
+        for (const vec3d &absPos : absPositions) {
+            vec3d position = absPos - chunkPos;
+
+            if (position.z < 0 || position.z >= chunkDims.z) {
+                continue;
+            }
+            std::vector<double> habitatCoefs;
+            double total = 0;
+
+            for (auto &seed : seedsAround) {
+                HabitatFeatures &habitat = _habitats.at(seed._generatorId);
+                double habitatCoef = absPos.z < 0 && !habitat._sea ? 0 : 1;
+                habitatCoef *= getProb(habitat._altitude, absPos.z);
+                habitatCoefs.push_back(habitatCoef);
+
+                double distance = seed._position.length(vec2d(absPos));
+                total += habitatCoef * pow(2, -distance / seed._distance) / 2;
+            }
+
+            double selector = keepDistrib(_rng) * total;
+            int selected = -1;
+            double sum = 0;
+
+            while (sum <= selector && selected < int(seedsAround.size()) - 1) {
+                selected++;
+                sum += habitatCoefs[selected];
+            }
+
+            Seed &seed = seedsAround[selected];
+            double keepRate = habitatCoefs[selected] *
+                              _habitats[seed._generatorId]._density /
+                              maxDensity;
+
+            if (keepDistrib(_rng) <= keepRate) {
+                positions.push_back({position, int(seed._generatorId)});
+            }
+        }
+        return positions;
+    }
+};
+
+/** Habitats of random species of grass, with altitude ranges overlapping
+ * the sea level. */
+static std::vector<HabitatFeatures> grassHabitats(int speciesCount) {
+    std::mt19937 rng(speciesCount);
+    std::uniform_real_distribution<double> altitude(-400, 1000);
+    std::vector<HabitatFeatures> habitats(speciesCount);
+
+    for (int i = 0; i < speciesCount; ++i) {
+        habitats[i]._altitude.x = altitude(rng);
+        habitats[i]._altitude.y = habitats[i]._altitude.x + 1000;
+        habitats[i]._sea = i % 3 == 0;
+        habitats[i]._density = 0.001 * (1 + i % 4);
+    }
+    return habitats;
+}
+
+TEST_CASE("SeedDistribution - positions", "[instance pool]") {
+    WaveEnvironment env;
+    ExplorationContext ctx;
+    ctx.setEnvironment(&env);
+
+    for (int speciesCount : {1, 10, 50}) {
+        TestSeedDistribution distribution(12), reference(12);
+
+        for (auto &habitat : grassHabitats(speciesCount)) {
+            distribution.addGenerator(habitat);
+            reference.addGenerator(habitat);
+        }
+
+        int total = 0;
+
+        for (int c = 0; c < 8; ++c) {
+            Chunk chunk(vec3d{400, 400, 3000});
+            chunk.setPosition3D({c * 1700. - 6000, c * 900. - 3000, -500});
+
+            auto positions = distribution.getPositions(chunk, ctx);
+            auto expected = reference.getReferencePositions(chunk, ctx);
+            REQUIRE(positions.size() == expected.size());
+            total += positions.size();
+
+            for (size_t i = 0; i < positions.size(); ++i) {
+                CHECK(positions[i]._pos == expected[i]._pos);
+                CHECK(positions[i]._genID == expected[i]._genID);
+                CHECK(positions[i]._genID < speciesCount);
+            }
+        }
+        INFO("species: " << speciesCount);
+        CHECK(total != 0);
+    }
+}
+
+TEST_CASE("SeedDistribution - seed storage", "[instance pool]") {
+    SeedDistribution distribution;
+    distribution.setSeed(7);
+    distribution.setMaxCells(64);
+
+    for (auto &habitat : grassHabitats(10)) {
+        distribution.addGenerator(habitat);
+    }
+
+    Chunk start(vec3d{400, 400, 3000});
+    distribution.addSeeds(start);
+    auto startSeeds = distribution.getSeedsAround(start);
+    REQUIRE(!startSeeds.empty());
+
+    // 1000 km flight
+    size_t maxCells = 0;
+
+    for (int i = 1; i <= 2500; ++i) {
+        Chunk chunk(vec3d{400, 400, 3000});
+        chunk.setPosition3D({i * 400., i * 40., 0});
+        distribution.addSeeds(chunk);
+        maxCells = std::max(maxCells, distribution.getCellCount());
+    }
+    // The cells of the last chunk are added after the oldest cells are
+    // removed
+    CHECK(maxCells <= 64 + 9);
+
+    SECTION("removed cells are generated again") {
+        distribution.addSeeds(start);
+        auto seeds = distribution.getSeedsAround(start);
+        REQUIRE(seeds.size() == startSeeds.size());
+
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            CHECK(seeds[i]._position.x == startSeeds[i]._position.x);
+            CHECK(seeds[i]._position.y == startSeeds[i]._position.y);
+            CHECK(seeds[i]._generatorId == startSeeds[i]._generatorId);
+            CHECK(seeds[i]._distance == startSeeds[i]._distance);
+        }
+    }
+
+    SECTION("same seed, same seeds") {
+        SeedDistribution other;
+        other.setSeed(7);
+
+        for (auto &habitat : grassHabitats(10)) {
+            other.addGenerator(habitat);
+        }
+        other.addSeeds(start);
+        auto seeds = other.getSeedsAround(start);
+        REQUIRE(seeds.size() == startSeeds.size());
+
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            CHECK(seeds[i]._position.x == startSeeds[i]._position.x);
+            CHECK(seeds[i]._position.y == startSeeds[i]._position.y);
+        }
+    }
+}
+
+TEST_CASE("SeedDistribution - benchmark", "[instance pool][!benchmark]") {
+    WaveEnvironment env;
+    ExplorationContext ctx;
+    ctx.setEnvironment(&env);
+
+    for (int speciesCount : {1, 10, 50}) {
+        SeedDistribution distribution;
+        distribution.setSeed(3);
+
+        for (auto &habitat : grassHabitats(speciesCount)) {
+            distribution.addGenerator(habitat);
+        }
+
+        BENCHMARK("Grass positions, " + std::to_string(speciesCount) +
+                  " species") {
+            for (int c = 0; c < 16; ++c) {
+                Chunk chunk(vec3d{400, 400, 3000});
+                chunk.setPosition3D({c * 1700. - 6000, c * 900. - 3000, -500});
+                distribution.getPositions(chunk, ctx);
+            }
+        }
+    }
+}
+
 TEST_CASE("MapFilteredDistribution", "[instance pool]") {
     CHECK_THROWS(MapFilteredDistribution<SeedDistribution>(nullptr));
 }
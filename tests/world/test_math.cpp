@@ -1,5 +1,11 @@
 #include <catch/catch.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+
 #include <world/core.h>
 
 using namespace world;
@@ -155,4 +161,306 @@ TEST_CASE("Bounding box", "[math]") {
                vec3d{0.7919055360, 0.9085651401, 0.8228310264})
                   .norm() == Approx(0));
     }
-}
\ No newline at end of file
+}
+TEST_CASE("IDW interpolation", "[math]") {
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<double> coord(0, 100);
+
+    IDWInterpolator<vec2d, vec2d> reference(3);
+    IDWInterpolator<vec2d, vec2d> indexed(3);
+
+    for (int i = 0; i < 300; ++i) {
+        vec2d pt{coord(rng), coord(rng)};
+        vec2d value{coord(rng), coord(rng)};
+        reference.addData(pt, value);
+        indexed.addData(pt, value);
+    }
+
+    std::vector<vec2d> queries;
+
+    for (int i = 0; i < 200; ++i) {
+        queries.emplace_back(coord(rng) * 1.2 - 10, coord(rng) * 1.2 - 10);
+    }
+
+    SECTION("all neighbours") {
+        indexed.setNeighbourCount(300);
+
+        for (auto &q : queries) {
+            CHECK((indexed.getData(q) - reference.getData(q)).norm() ==
+                  Approx(0).margin(1e-9));
+        }
+    }
+
+    SECTION("cutoff radius") {
+        reference.setRadius(15);
+        indexed.setRadius(15);
+
+        for (auto &q : queries) {
+            CHECK((indexed.getData(q) - reference.getData(q)).norm() ==
+                  Approx(0).margin(1e-9));
+        }
+    }
+
+    SECTION("nearly colinear values") {
+        IDWInterpolator<vec2d, vec2d> line(3), lineIndexed(3);
+        lineIndexed.setNeighbourCount(1000);
+
+        for (int i = 0; i < 1000; ++i) {
+            vec2d pt{coord(rng), i * 1e-18};
+            vec2d value{coord(rng), coord(rng)};
+            line.addData(pt, value);
+            lineIndexed.addData(pt, value);
+        }
+
+        for (auto &q : queries) {
+            CHECK((lineIndexed.getData(q) - line.getData(q)).norm() ==
+                  Approx(0).margin(1e-9));
+        }
+    }
+
+    SECTION("k nearest") {
+        IDWInterpolator<vec2d, vec2d> single(3);
+        single.setNeighbourCount(1);
+        single.addData({0, 0}, {1, 0});
+        single.addData({10, 0}, {0, 1});
+        CHECK(single.getData({4, 3}).x == Approx(1));
+        CHECK(single.getData({6, -3}).y == Approx(1));
+    }
+}
+
+TEST_CASE("IDW interpolation benchmark", "[math][!benchmark]") {
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<double> coord(0, 512);
+
+    IDWInterpolator<vec2d, vec2d> interp(4);
+
+    for (int i = 0; i < 2600; ++i) {
+        interp.addData({coord(rng), coord(rng)}, {coord(rng), coord(rng)});
+    }
+
+    BENCHMARK("128x128 queries on 2600 points, all neighbours") {
+        for (int x = 0; x < 128; ++x) {
+            for (int y = 0; y < 128; ++y) {
+                interp.getData({x * 4 + 0.5, y * 4 + 0.5});
+            }
+        }
+    }
+
+    interp.setNeighbourCount(32);
+
+    BENCHMARK("128x128 queries on 2600 points, 32 neighbours") {
+        for (int x = 0; x < 128; ++x) {
+            for (int y = 0; y < 128; ++y) {
+                interp.getData({x * 4 + 0.5, y * 4 + 0.5});
+            }
+        }
+    }
+}
+
+static double minDistance(const std::vector<BlueNoiseTile::Sample> &samples) {
+    double minDist2 = std::numeric_limits<double>::max();
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        for (size_t j = i + 1; j < samples.size(); ++j) {
+            vec2d d = samples[i]._position - samples[j]._position;
+            minDist2 = std::min(minDist2, d.x * d.x + d.y * d.y);
+        }
+    }
+    return sqrt(minDist2);
+}
+
+TEST_CASE("BlueNoiseTile", "[math]") {
+    const BlueNoiseTile &tile = BlueNoiseTile::getDefault();
+    const double density = 0.01;
+    // Distance between points on a square grid of the same density
+    const double gridDistance = 1 / sqrt(density);
+
+    SECTION("density") {
+        auto samples = tile.getSamples({-1234, 567}, {2766, 4567}, density);
+        const double expected = 4000 * 4000 * density;
+        REQUIRE(samples.size() > expected * 0.98);
+        REQUIRE(samples.size() < expected * 1.02);
+
+        for (auto &sample : samples) {
+            REQUIRE(sample._position.x >= -1234);
+            REQUIRE(sample._position.x < 2766);
+            REQUIRE(sample._position.y >= 567);
+            REQUIRE(sample._position.y < 4567);
+            REQUIRE(sample._rank >= 0);
+            REQUIRE(sample._rank < 1);
+        }
+    }
+
+    SECTION("spacing across tile borders") {
+        // The rectangle covers 4 tiles and their borders
+        const double tileSize = sqrt(tile.getPointCount() / density);
+        auto samples = tile.getSamples({tileSize * 0.5, tileSize * 0.5},
+                                       {tileSize * 2.5, tileSize * 2.5},
+                                       density);
+        REQUIRE(minDistance(samples) > gridDistance * 0.4);
+
+        // Thinning by rank keeps the spacing
+        std::vector<BlueNoiseTile::Sample> thinned;
+
+        for (auto &sample : samples) {
+            if (sample._rank < 0.25) {
+                thinned.push_back(sample);
+            }
+        }
+        REQUIRE(minDistance(thinned) > gridDistance * 2 * 0.4);
+    }
+
+    SECTION("adjacent rectangles") {
+        auto whole = tile.getSamples({0, 0}, {1000, 500}, density, {7, 3});
+        auto left = tile.getSamples({0, 0}, {500, 500}, density, {7, 3});
+        auto right = tile.getSamples({500, 0}, {1000, 500}, density, {7, 3});
+        REQUIRE(left.size() + right.size() == whole.size());
+
+        left.insert(left.end(), right.begin(), right.end());
+        auto less = [](const BlueNoiseTile::Sample &a,
+                       const BlueNoiseTile::Sample &b) {
+            return a._position.x < b._position.x ||
+                   (a._position.x == b._position.x &&
+                    a._position.y < b._position.y);
+        };
+        std::sort(left.begin(), left.end(), less);
+        std::sort(whole.begin(), whole.end(), less);
+
+        for (size_t i = 0; i < whole.size(); ++i) {
+            REQUIRE(left[i]._position.x == whole[i]._position.x);
+            REQUIRE(left[i]._position.y == whole[i]._position.y);
+        }
+    }
+
+    SECTION("determinism") {
+        BlueNoiseTile other;
+        auto samples = tile.getSamples({-300, -300}, {300, 300}, density);
+        auto otherSamples =
+            other.getSamples({-300, -300}, {300, 300}, density);
+        REQUIRE(samples.size() == otherSamples.size());
+
+        for (size_t i = 0; i < samples.size(); ++i) {
+            REQUIRE(samples[i]._position.x == otherSamples[i]._position.x);
+            REQUIRE(samples[i]._position.y == otherSamples[i]._position.y);
+            REQUIRE(samples[i]._rank == otherSamples[i]._rank);
+        }
+    }
+
+    SECTION("variants") {
+        BlueNoiseTile small(64, 3);
+        REQUIRE(small.getVariantCount() == 8);
+        const double tileSize = sqrt(small.getPointCount() / density);
+
+        // 6 x 6 repetitions of the tile
+        auto samples =
+            small.getSamples({0, 0}, {tileSize * 6, tileSize * 6}, density);
+        REQUIRE(samples.size() == 36 * 64);
+        REQUIRE(minDistance(samples) > gridDistance * 0.4);
+
+        std::vector<BlueNoiseTile::Sample> thinned;
+
+        for (auto &sample : samples) {
+            if (sample._rank < 0.25) {
+                thinned.push_back(sample);
+            }
+        }
+        REQUIRE(minDistance(thinned) > gridDistance * 2 * 0.4);
+
+        // The repetitions of the tile do not all have the same points
+        std::map<u32, double> sums;
+
+        for (auto &sample : samples) {
+            sums[sample._tileHash] +=
+                sample._position.x - floor(sample._position.x / tileSize) *
+                                         tileSize;
+        }
+        std::set<long> layouts;
+
+        for (auto &entry : sums) {
+            layouts.insert(lround(entry.second));
+        }
+        CHECK(sums.size() == 36);
+        CHECK(layouts.size() >= 4);
+    }
+}
+
+TEST_CASE("BoundingVolumeHierarchy", "[math]") {
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<double> distrib(-100, 100);
+    std::vector<vec3d> points(1000);
+
+    for (auto &point : points) {
+        point = {distrib(rng), distrib(rng) * 0.1, distrib(rng)};
+    }
+
+    BoundingVolumeHierarchy bvh;
+    bvh.build(points, 8);
+    REQUIRE_FALSE(bvh.empty());
+
+    SECTION("nodes contain their points") {
+        const auto &indices = bvh.getIndices();
+        std::vector<int> visited(points.size(), 0);
+
+        bvh.visit([&](const BoundingVolumeHierarchy::Node &node) {
+            for (u32 i = node._first; i < node._first + node._count; ++i) {
+                REQUIRE(node._bbox.contains(points[indices[i]]));
+            }
+
+            if (node.isLeaf()) {
+                REQUIRE(node._count <= 8);
+
+                for (u32 i = node._first; i < node._first + node._count; ++i) {
+                    ++visited[indices[i]];
+                }
+            }
+            return true;
+        });
+
+        // Each point is in exactly one leaf
+        for (int count : visited) {
+            REQUIRE(count == 1);
+        }
+    }
+
+    SECTION("rejected nodes are not visited") {
+        int visitedNodes = 0;
+
+        bvh.visit([&](const BoundingVolumeHierarchy::Node &node) {
+            ++visitedNodes;
+            return node._bbox.getLowerBound().x < 0;
+        });
+        CHECK(visitedNodes < int(bvh.getNodeCount()));
+    }
+
+    SECTION("empty hierarchy") {
+        bvh.build({});
+        CHECK(bvh.empty());
+        bvh.visit([](const BoundingVolumeHierarchy::Node &node) {
+            FAIL("no node should be visited");
+            return true;
+        });
+    }
+}
+
+TEST_CASE("FirstPersonView - resolution bounds", "[math]") {
+    FirstPersonView view(1000, 60, 0.2);
+    view.setPosition({10, 20, 5});
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> distrib(-200, 200);
+
+    for (int i = 0; i < 100; ++i) {
+        BoundingBox bbox({distrib(rng), distrib(rng), distrib(rng)});
+        bbox.addPoint({distrib(rng), distrib(rng), distrib(rng)});
+        const double minRes = view.getMinResolutionIn(bbox);
+        const double maxRes = view.getMaxResolutionIn(bbox);
+        REQUIRE(minRes <= maxRes);
+
+        for (int j = 0; j < 20; ++j) {
+            vec3d t{(distrib(rng) + 200) / 400, (distrib(rng) + 200) / 400,
+                    (distrib(rng) + 200) / 400};
+            vec3d p = bbox.getLowerBound() + bbox.getDimensions() * t;
+            REQUIRE(view.getResolutionAt(p) >= minRes - 1e-9);
+            REQUIRE(view.getResolutionAt(p) <= maxRes + 1e-9);
+        }
+    }
+}
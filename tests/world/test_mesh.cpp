@@ -88,4 +88,168 @@ TEST_CASE("Mesh benchmarks", "[mesh][!benchmark]") {
             }
         }
     }
-}
\ No newline at end of file
+}
+/** Box of [-1, 1]^2 x [0, 2] with a pyramid roof up to z = 3. */
+static Mesh createHouse() {
+    Mesh mesh;
+    const vec3d normals[] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                             {0, -1, 0}, {0, 0, -1}};
+
+    for (const vec3d &n : normals) {
+        // Two axes of the face, so that a x b = n
+        vec3d a = n.z != 0 ? vec3d{0, 1, 0} : vec3d{0, 0, 1};
+        vec3d b = n.crossProduct(a);
+        a = b.crossProduct(n);
+        vec3d center = vec3d{0, 0, 1} + n;
+        const int first = static_cast<int>(mesh.getVerticesCount());
+
+        mesh.newVertex(center - a - b, n);
+        mesh.newVertex(center + a - b, n);
+        mesh.newVertex(center + a + b, n);
+        mesh.newVertex(center - a + b, n);
+        mesh.newFace(first, first + 1, first + 2);
+        mesh.newFace(first, first + 2, first + 3);
+    }
+
+    const vec3d apex{0, 0, 3};
+    const vec3d corners[] = {{1, 1, 2}, {-1, 1, 2}, {-1, -1, 2}, {1, -1, 2}};
+
+    for (int i = 0; i < 4; ++i) {
+        const vec3d &c1 = corners[i], &c2 = corners[(i + 1) % 4];
+        const vec3d n = (c2 - c1).crossProduct(apex - c1).normalize();
+        const int first = static_cast<int>(mesh.getVerticesCount());
+        mesh.newVertex(c1, n);
+        mesh.newVertex(c2, n);
+        mesh.newVertex(apex, n);
+        mesh.newFace(first, first + 1, first + 2);
+    }
+    return mesh;
+}
+
+TEST_CASE("Mesh - Impostor", "[mesh]") {
+    const Mesh house = createHouse();
+    const int gridSize = 5, cellRes = 32;
+    Impostor impostor(gridSize, cellRes);
+    impostor.addMesh(house, Color4d(1, 0.5, 0));
+    impostor.bake();
+
+    const Image &colors = impostor.getColorAtlas();
+    const Image &normals = impostor.getNormalAtlas();
+    REQUIRE(colors.width() == gridSize * cellRes);
+    REQUIRE(normals.height() == gridSize * cellRes);
+    CHECK(impostor.getRadius() == Approx(sqrt(2 + 1.5 * 1.5)));
+
+    // Pixel of the cell (i, j) at (x, y), y going up
+    auto pixel = [&](int i, int j, int x, int y) {
+        return ((gridSize - 1 - j) * cellRes + cellRes - 1 - y) *
+                   colors.width() +
+               i * cellRes + x;
+    };
+
+    SECTION("view directions") {
+        for (int j = 0; j < gridSize; ++j) {
+            for (int i = 0; i < gridSize; ++i) {
+                vec3d direction = impostor.getViewDirection(i, j);
+                REQUIRE(direction.norm() == Approx(1));
+                REQUIRE(direction.z >= 0);
+
+                vec2i cell = impostor.getCell(direction);
+                REQUIRE(cell.x == i);
+                REQUIRE(cell.y == j);
+            }
+        }
+    }
+
+    SECTION("silhouettes match the mesh") {
+        // Reference silhouette: pixel centers inside any projected triangle
+        for (int j = 0; j < gridSize; ++j) {
+            for (int i = 0; i < gridSize; ++i) {
+                const vec3d d = impostor.getViewDirection(i, j);
+                vec3d right = vec3d{0, 0, 1}.crossProduct(d);
+                right = right.norm() < 1e-9 ? vec3d{1, 0, 0}
+                                            : right.normalize();
+                const vec3d up = d.crossProduct(right);
+                const double radius = impostor.getRadius();
+                const vec3d center = impostor.getCenter();
+
+                auto project = [&](const vec3d &p) {
+                    return vec2d{(p - center).dotProduct(right) / radius,
+                                 (p - center).dotProduct(up) / radius};
+                };
+                int mismatches = 0, covered = 0;
+
+                for (int y = 0; y < cellRes; ++y) {
+                    for (int x = 0; x < cellRes; ++x) {
+                        vec2d c{(x + 0.5) / cellRes * 2 - 1,
+                                (y + 0.5) / cellRes * 2 - 1};
+                        bool inside = false;
+
+                        for (u32 f = 0; f < house.getFaceCount(); ++f) {
+                            const Face &face = house.getFace(f);
+                            vec2d p[3];
+
+                            for (int v = 0; v < 3; ++v) {
+                                p[v] = project(
+                                    house.getVertex(face.getID(v))
+                                        .getPosition());
+                            }
+                            double s[3];
+
+                            for (int v = 0; v < 3; ++v) {
+                                const vec2d &a = p[v], &b = p[(v + 1) % 3];
+                                s[v] = (b.x - a.x) * (c.y - a.y) -
+                                       (b.y - a.y) * (c.x - a.x);
+                            }
+                            inside |= (s[0] >= 0 && s[1] >= 0 && s[2] >= 0) ||
+                                      (s[0] <= 0 && s[1] <= 0 && s[2] <= 0);
+                        }
+
+                        const u8 alpha =
+                            colors.data()[pixel(i, j, x, y) * 4 + 3];
+                        covered += inside;
+                        mismatches += inside != (alpha == 255);
+                    }
+                }
+                CHECK(covered > cellRes * cellRes / 5);
+                // Only pixels exactly on the edges may differ
+                CHECK(mismatches <= cellRes / 4);
+            }
+        }
+    }
+
+    SECTION("colors and normals") {
+        // The center cell looks straight down on the roof
+        const int c = gridSize / 2;
+        REQUIRE(impostor.getViewDirection(c, c).z == Approx(1));
+
+        // Pixel above the +x side of the roof
+        const int p = pixel(c, c, cellRes * 5 / 8, cellRes / 2);
+        CHECK(int(colors.data()[p * 4]) == 255);
+        CHECK(int(colors.data()[p * 4 + 1]) == 128);
+        CHECK(int(colors.data()[p * 4 + 3]) == 255);
+
+        const double n = 0.5 / sqrt(2) + 0.5;
+        const u8 *normal = normals.data() + p * 3;
+        CHECK(normal[0] / 255. == Approx(n).margin(0.01));
+        CHECK(normal[1] / 255. == Approx(0.5).margin(0.01));
+        CHECK(normal[2] / 255. == Approx(n).margin(0.01));
+
+        // Corners of the cell are outside of the house
+        CHECK(int(colors.data()[pixel(c, c, 0, 0) * 4 + 3]) == 0);
+    }
+
+    SECTION("crossed quads") {
+        Mesh quads = impostor.createCrossedQuads(3);
+        REQUIRE(quads.getFaceCount() == 6);
+
+        for (u32 v = 0; v < quads.getVerticesCount(); ++v) {
+            const Vertex &vertex = quads.getVertex(v);
+            CHECK((vertex.getPosition() - impostor.getCenter()).norm() ==
+                  Approx(impostor.getRadius() * sqrt(2)));
+            CHECK(vertex.getTexture().x >= 0);
+            CHECK(vertex.getTexture().x <= 1);
+            CHECK(vertex.getTexture().y >= 0);
+            CHECK(vertex.getTexture().y <= 1);
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include <catch/catch.hpp>
 
+#include <set>
+
 #include <world/core.h>
 
 using namespace world;
@@ -61,6 +63,110 @@ TEST_CASE("Perlin - Random values modifier") {
     }
 }
 
+TEST_CASE("Perlin - Modifier and interpolation policies", "[perlin]") {
+    Perlin perlin(5);
+    PerlinInfo info{4, 0.5, false, 0, 4., 3, 7};
+    arma::mat reference(65, 65), subject(65, 65);
+
+    SECTION("identity functor gives the same result as std::function") {
+        perlin.generatePerlinNoise2D(reference, info, Perlin::DEFAULT_MODIFIER);
+        perlin.generatePerlinNoise2D(subject, info, Perlin::Identity());
+        CHECK(arma::approx_equal(subject, reference, "absdiff", 1e-12));
+    }
+
+    SECTION("ridged functor gives the same result as std::function") {
+        Perlin::modifier ridged = [](double x, double y, double val) {
+            return 1 - std::abs(2 * val - 1);
+        };
+        perlin.generatePerlinNoise2D(reference, info, ridged);
+        perlin.generatePerlinNoise2D(subject, info, Perlin::Ridged());
+        CHECK(arma::approx_equal(subject, reference, "absdiff", 1e-12));
+    }
+
+    SECTION("interpolation functors give the same result as std::function") {
+        perlin.generatePerlinNoise2D(reference, info, Perlin::DEFAULT_MODIFIER,
+                                     Interpolation::LINEAR);
+        perlin.generatePerlinNoise2D(subject, info, Perlin::Identity(),
+                                     Interpolation::Linear());
+        CHECK(arma::approx_equal(subject, reference, "absdiff", 1e-12));
+
+        Interpolation::interpFunc smooth = [](double x) {
+            return smoothstep(0, 1, x);
+        };
+        perlin.generatePerlinNoise2D(reference, info, Perlin::DEFAULT_MODIFIER,
+                                     smooth);
+        perlin.generatePerlinNoise2D(subject, info, Perlin::Identity(),
+                                     Interpolation::Smoothstep());
+        CHECK(arma::approx_equal(subject, reference, "absdiff", 1e-12));
+    }
+}
+
+TEST_CASE("Perlin - Gradient noise", "[perlin]") {
+    Perlin perlin(12);
+    perlin.setNormalize(false);
+
+    SECTION("adjacent tiles match at their borders") {
+        arma::mat left(33, 33), right(33, 33);
+        perlin.generateGradientNoise2D(left, {4, 0.5, false, 0, 4., 0, 0});
+        perlin.generateGradientNoise2D(right, {4, 0.5, false, 0, 4., 4, 0});
+
+        for (int y = 0; y < 33; ++y) {
+            CHECK(left(32, y) == Approx(right(0, y)));
+        }
+    }
+
+    SECTION("a child tile matches its parent where they overlap") {
+        arma::mat parent(33, 33), child(33, 33);
+        perlin.generateGradientNoise2D(parent, {3, 0.5, false, 0, 4., 0, 0});
+        // Child at lod 1, tile (1, 1)
+        perlin.generateGradientNoise2D(child, {3, 0.5, false, 1, 4., 4, 4});
+
+        for (int y = 0; y < 33; y += 2) {
+            for (int x = 0; x < 33; x += 2) {
+                CHECK(child(x, y) == Approx(parent(16 + x / 2, 16 + y / 2)));
+            }
+        }
+    }
+
+    SECTION("lattice points of the octaves do not line up") {
+        // The points of the first octave lattice are 8 pixels apart
+        arma::mat noise(33, 33);
+        perlin.generateGradientNoise2D(noise, {4, 0.5, false, 0, 4., 0, 0});
+        std::set<double> values;
+
+        for (int y = 0; y < 33; y += 8) {
+            for (int x = 0; x < 33; x += 8) {
+                values.insert(noise(x, y));
+            }
+        }
+        CHECK(values.size() == 25);
+    }
+
+    SECTION("output is statistically comparable to value noise") {
+        arma::mat value(129, 129), gradient(129, 129);
+        double vmean = 0, vsq = 0, gmean = 0, gsq = 0;
+        const int count = 16;
+
+        for (int i = 0; i < count; ++i) {
+            PerlinInfo info{3, 0.35, false, 0, 4., 4 * i, 0};
+            perlin.generatePerlinNoise2D(value, info);
+            perlin.generateGradientNoise2D(gradient, info);
+            vmean += arma::mean(arma::vectorise(value));
+            vsq += arma::mean(arma::vectorise(value % value));
+            gmean += arma::mean(arma::vectorise(gradient));
+            gsq += arma::mean(arma::vectorise(gradient % gradient));
+        }
+
+        vmean /= count;
+        gmean /= count;
+        double vstd = sqrt(vsq / count - vmean * vmean);
+        double gstd = sqrt(gsq / count - gmean * gmean);
+
+        CHECK(gmean == Approx(vmean).epsilon(0.05));
+        CHECK(gstd == Approx(vstd).epsilon(0.15));
+    }
+}
+
 TEST_CASE("Perlin - Benchmarks", "[!benchmark]") {
     arma::mat noise(1024, 1024);
 
@@ -78,4 +184,59 @@ TEST_CASE("Perlin - Benchmarks", "[!benchmark]") {
     BENCHMARK("4096*4096 perlin with 16 frequency at octave 0, and 4 octaves") {
         perlin.generatePerlinNoise2D(noise2, info);
     }
+}
+
+TEST_CASE("Perlin - Modifier and interpolation policies benchmarks",
+          "[!benchmark]") {
+    arma::mat noise(1024, 1024);
+
+    Perlin perlin;
+    PerlinInfo info{6, 0.4, false, 0, 8, 0, 0};
+
+    Perlin::modifier ridged = [](double x, double y, double val) {
+        return 1 - std::abs(2 * val - 1);
+    };
+    Interpolation::interpFunc smooth = [](double x) {
+        return smoothstep(0, 1, x);
+    };
+
+    BENCHMARK("identity + cosine, std::function") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::DEFAULT_MODIFIER,
+                                     Interpolation::COSINE);
+    }
+
+    BENCHMARK("identity + cosine, functors") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::Identity(),
+                                     Interpolation::Cosine());
+    }
+
+    BENCHMARK("ridged + cosine, std::function") {
+        perlin.generatePerlinNoise2D(noise, info, ridged,
+                                     Interpolation::COSINE);
+    }
+
+    BENCHMARK("ridged + cosine, functors") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::Ridged(),
+                                     Interpolation::Cosine());
+    }
+
+    BENCHMARK("identity + linear, std::function") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::DEFAULT_MODIFIER,
+                                     Interpolation::LINEAR);
+    }
+
+    BENCHMARK("identity + linear, functors") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::Identity(),
+                                     Interpolation::Linear());
+    }
+
+    BENCHMARK("identity + smoothstep, std::function") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::DEFAULT_MODIFIER,
+                                     smooth);
+    }
+
+    BENCHMARK("identity + smoothstep, functors") {
+        perlin.generatePerlinNoise2D(noise, info, Perlin::Identity(),
+                                     Interpolation::Smoothstep());
+    }
 }
\ No newline at end of file
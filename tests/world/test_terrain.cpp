@@ -82,6 +82,186 @@ TEST_CASE("Terrain - getExactHeightAt", "[terrain]") {
     }
 }
 
+TEST_CASE("TerrainOps - resample", "[terrain]") {
+    Terrain terrain(17);
+
+    for (int x = 0; x < 17; ++x) {
+        for (int y = 0; y < 17; ++y) {
+            terrain(x, y) = sin(x * 0.7) * cos(y * 0.3) + (x * y) % 5 * 0.1;
+        }
+    }
+
+    const vec2d origin{0.2, -0.1};
+    const vec2d size{0.45, 1.3};
+    arma::mat output(21, 9);
+
+    SECTION("cubic") {
+        TerrainOps::resampleCubic(terrain, origin, size, output);
+
+        for (arma::uword x = 0; x < output.n_rows; ++x) {
+            for (arma::uword y = 0; y < output.n_cols; ++y) {
+                double h = terrain.getCubicHeight(
+                    origin.x + (double)x / (output.n_rows - 1) * size.x,
+                    origin.y + (double)y / (output.n_cols - 1) * size.y);
+                CHECK(output(x, y) == Approx(h));
+            }
+        }
+    }
+
+    SECTION("linear") {
+        TerrainOps::resampleLinear(terrain, origin, size, output);
+
+        for (arma::uword x = 0; x < output.n_rows; ++x) {
+            for (arma::uword y = 0; y < output.n_cols; ++y) {
+                double h = terrain.getInterpolatedHeight(
+                    origin.x + (double)x / (output.n_rows - 1) * size.x,
+                    origin.y + (double)y / (output.n_cols - 1) * size.y,
+                    Interpolation::LINEAR);
+                CHECK(output(x, y) == Approx(h));
+            }
+        }
+    }
+}
+
+TEST_CASE("TerrainOps - resample benchmark", "[terrain][!benchmark]") {
+    Terrain terrain(400);
+    arma::mat output(129, 129);
+
+    BENCHMARK("Resample 129x129 from a 400x400 map, per sample") {
+        for (arma::uword x = 0; x < output.n_rows; ++x) {
+            for (arma::uword y = 0; y < output.n_cols; ++y) {
+                output(x, y) = terrain.getCubicHeight(0.25 + x / 128. * 0.5,
+                                                      0.25 + y / 128. * 0.5);
+            }
+        }
+    }
+
+    BENCHMARK("Resample 129x129 from a 400x400 map, separable") {
+        TerrainOps::resampleCubic(terrain, {0.25, 0.25}, {0.5, 0.5}, output);
+    }
+}
+
+class TestTextureProvider : public ITextureProvider {
+public:
+    Image &getTexture(int layer, int lod) override {
+        while (_textures.size() <= size_t(layer)) {
+            int l = int(_textures.size());
+            _textures.emplace_back(48, 48, ImageType::RGBA);
+            Image &tex = _textures.back();
+
+            for (int y = 0; y < tex.height(); ++y) {
+                for (int x = 0; x < tex.width(); ++x) {
+                    tex.rgba(x, y).set(u8(x * 5 + l * 40), u8(y * 5 + l * 20),
+                                       u8((x * y + l * 70) % 256),
+                                       u8(255 - (x + y) % 3 * 60));
+                }
+            }
+        }
+        return _textures[layer];
+    }
+
+private:
+    std::vector<Image> _textures;
+};
+
+void setupTestMultilayer(MultilayerGroundTexture &multilayer) {
+    multilayer.setTextureProvider<TestTextureProvider>();
+    multilayer.addLayer(DistributionParams{-1, 0, 1, 2, -1, 0, 1, 2, 0, 1, 0,
+                                           1, 0.05f});
+    multilayer.addLayer(DistributionParams{-1, 0, 0.4f, 0.45f, -1, 0, 0.4f,
+                                           0.6f, 0, 1, 0, 1, 0.05f});
+    multilayer.addLayer(DistributionParams{0.33f, 0.4f, 0.6f, 0.75f, -1, 0,
+                                           0.45f, 0.65f, 0, 0.85f, 0.25f,
+                                           0.85f, 0.05f});
+    multilayer.addLayer(DistributionParams{0.33f, 0.4f, 0.6f, 0.7f, -1, 0,
+                                           0.4f, 0.6f, 0, 1, 0.25f, 0.6f,
+                                           0.05f});
+    multilayer.addLayer(DistributionParams{0.65f, 0.8f, 1, 2, -1, 0, 0.5f,
+                                           0.7f, 0, 1, 0, 1, 0.05f});
+}
+
+Terrain createTexturedTerrain() {
+    Terrain terrain(33);
+
+    for (int x = 0; x < 33; ++x) {
+        for (int y = 0; y < 33; ++y) {
+            terrain(x, y) = 0.5 + 0.45 * sin(x * 0.2) * cos(y * 0.15);
+        }
+    }
+    terrain.setTexture(Image(128, 128, ImageType::RGB));
+    return terrain;
+}
+
+TEST_CASE("MultilayerGroundTexture - compositing", "[terrain]") {
+    MultilayerGroundTexture multilayer;
+    setupTestMultilayer(multilayer);
+    TestTextureProvider textures;
+    Terrain terrain = createTexturedTerrain();
+    multilayer.processTerrain(terrain);
+    const Image &image = terrain.getTexture();
+
+    // Per pixel floating point compositing, as it was done before
+    using Storage = GridStorage<MultilayerGroundTexture::Element>;
+    auto &storage = static_cast<Storage &>(*multilayer.getStorage());
+    MultilayerGroundTexture::Element *elem;
+    REQUIRE(storage.tryGet({}, &elem));
+    REQUIRE(elem->_distributions.size() == 5);
+
+    Image reference(image.width(), image.height(), ImageType::RGBA);
+    ImageUtils::fill(reference, Color4d(0, 0, 0, 0));
+
+    for (int layer = 0; layer < 5; ++layer) {
+        Terrain &distrib = elem->_distributions[layer];
+        Image &layerTex = textures.getTexture(layer, 0);
+
+        for (int y = 0; y < image.height(); ++y) {
+            for (int x = 0; x < image.width(); ++x) {
+                auto origin = reference.rgba(x, y);
+                auto texPix = layerTex.rgba(x % layerTex.width(),
+                                            y % layerTex.height());
+                double p = distrib.getCubicHeight(
+                    double(x) / (image.width() - 1),
+                    double(y) / (image.height() - 1));
+                double alpha = clamp(p * texPix.getAlphaf(), 0, 1);
+                reference.rgba(x, y).setf(
+                    origin.getRedf() * (1 - alpha) + texPix.getRedf() * alpha,
+                    origin.getGreenf() * (1 - alpha) +
+                        texPix.getGreenf() * alpha,
+                    origin.getBluef() * (1 - alpha) + texPix.getBluef() * alpha,
+                    1);
+            }
+        }
+    }
+
+    REQUIRE(image.type() == ImageType::RGB);
+    double mse = 0;
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            auto &a = image.rgb(x, y);
+            auto &b = reference.rgba(x, y);
+            double dr = a.getRed() - b.getRed();
+            double dg = a.getGreen() - b.getGreen();
+            double db = a.getBlue() - b.getBlue();
+            mse += (dr * dr + dg * dg + db * db) / 3;
+        }
+    }
+    mse /= image.width() * image.height();
+    double psnr = 10 * log10(255. * 255. / std::max(mse, 1e-10));
+    INFO("PSNR: " << psnr);
+    CHECK(psnr > 40);
+}
+
+TEST_CASE("MultilayerGroundTexture - benchmark", "[terrain][!benchmark]") {
+    MultilayerGroundTexture multilayer;
+    setupTestMultilayer(multilayer);
+    Terrain terrain = createTexturedTerrain();
+
+    BENCHMARK("Composite 5 layers on a 128x128 texture") {
+        multilayer.processTerrain(terrain);
+    }
+}
+
 TEST_CASE("Terrain - Mesh generation benchmark", "[terrain][!benchmark]") {
     Terrain terrain(129);
 
@@ -1,8 +1,500 @@
 #include <catch/catch.hpp>
 
+#include <set>
+#include <string>
+
 #include <world/core.h>
+#include <world/core/ConstantResolution.h>
 #include <world/tree.h>
 
 using namespace world;
 
-TEST_CASE("collect Tree group", "[tree]") {}
\ No newline at end of file
+TEST_CASE("collect Tree group", "[tree]") {}
+
+/** Environment counting the points it grounds. */
+class GroundCounter : public IEnvironment {
+public:
+    mutable int _count = 0;
+    u64 _epoch = 0;
+    /// Bounds of the edits since the epoch 0, if they are known
+    std::vector<BoundingBox> _edits;
+    bool _knownEdits = false;
+
+    vec3d findNearestFreePoint(const vec3d &origin, const vec3d &direction,
+                               double resolution,
+                               const ExplorationContext &ctx) const override {
+        ++_count;
+        return {origin.x, origin.y, 0};
+    }
+
+    u64 getEditEpoch() const override { return _epoch; }
+
+    bool getEditsSince(u64 epoch, std::vector<BoundingBox> &bounds,
+                       const ExplorationContext &ctx) const override {
+        if (!_knownEdits) {
+            return IEnvironment::getEditsSince(epoch, bounds, ctx);
+        }
+        bounds.insert(bounds.end(), _edits.begin(), _edits.end());
+        return true;
+    }
+};
+
+/** Constant resolution counting the point queries. */
+class ResolutionQueryCounter : public ConstantResolution {
+public:
+    mutable int _count = 0;
+
+    ResolutionQueryCounter(double resolution)
+            : ConstantResolution(resolution) {}
+
+    double getResolutionAt(const vec3d &coord) const override {
+        ++_count;
+        return ConstantResolution::getResolutionAt(coord);
+    }
+};
+
+TEST_CASE("Tree - hierarchical collect", "[tree]") {
+    Tree model;
+    model.randomize();
+    auto pool = std::make_shared<TreeVariantPool>(model, 2);
+
+    Tree trees;
+    trees.setup(model);
+    trees.setVariantPool(pool);
+
+    for (int i = 0; i < 100; ++i) {
+        vec3d pos{(i % 10) * 10., (i / 10) * 10., 0};
+        trees.addTree(pos, pool->pick(pos));
+    }
+
+    GroundCounter env;
+    ExplorationContext ctx;
+    ctx.setEnvironment(&env);
+    Collector collector(CollectorPresets::SCENE);
+
+    SECTION("trees are grounded once") {
+        ResolutionQueryCounter resolution(3);
+        trees.collect(collector, resolution, ctx);
+        const int firstCount = env._count;
+        // Once for the hierarchy and once for the level of detail
+        CHECK(firstCount == 200);
+
+        collector.reset();
+        trees.collect(collector, resolution, ctx);
+        CHECK(env._count == firstCount);
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 200);
+
+        // Changing the level of detail grounds the trees again
+        resolution.setResolution(10);
+        collector.reset();
+        trees.collect(collector, resolution, ctx);
+        CHECK(env._count == firstCount + 100);
+
+        // Editing the ground grounds the trees again
+        env._epoch = 1;
+        collector.reset();
+        trees.collect(collector, resolution, ctx);
+        CHECK(env._count == 2 * firstCount + 100);
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 200);
+    }
+
+    SECTION("edited areas are grounded again") {
+        ConstantResolution resolution(3);
+        trees.collect(collector, resolution, ctx);
+        const int firstCount = env._count;
+
+        // The edit covers the 3 first columns of trees
+        env._epoch = 1;
+        env._knownEdits = true;
+        env._edits.emplace_back(vec3d{-5, -5, -100}, vec3d{25, 95, 100});
+        collector.reset();
+        trees.collect(collector, resolution, ctx);
+        // Once for the hierarchy and once for the level of detail
+        CHECK(env._count == firstCount + 60);
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 200);
+    }
+
+    SECTION("whole groups are resolved at once") {
+        ResolutionQueryCounter resolution(3);
+        trees.collect(collector, resolution, ctx);
+        CHECK(resolution._count == 0);
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 200);
+
+        // No tree is visible
+        ResolutionQueryCounter lowResolution(1);
+        collector.reset();
+        trees.collect(collector, lowResolution, ctx);
+        CHECK(lowResolution._count == 0);
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 0);
+    }
+}
+
+TEST_CASE("Tree - variant pool", "[tree]") {
+    Tree model;
+    model.randomize();
+    auto pool = std::make_shared<TreeVariantPool>(model, 2);
+
+    SECTION("pick only depends on the position") {
+        for (int i = 0; i < 100; ++i) {
+            vec3d pos{i * 7.3, i * -3.1, 0};
+            TreeVariant variant = pool->pick(pos);
+            TreeVariant other = pool->pick(pos);
+
+            REQUIRE(variant._index < 2);
+            REQUIRE(variant._tint < pool->getTintCount());
+            REQUIRE(variant._scale >= 0.8);
+            REQUIRE(variant._scale <= 1.2);
+            REQUIRE(variant._index == other._index);
+            REQUIRE(variant._rotation == other._rotation);
+        }
+    }
+
+    SECTION("trees share the meshes of the variants") {
+        ConstantResolution resolution(10);
+        Collector collector(CollectorPresets::SCENE);
+        ExplorationContext ctx1, ctx2;
+        ctx1.appendPrefix("1");
+        ctx2.appendPrefix("2");
+
+        Tree trees1, trees2;
+        trees1.setup(model);
+        trees2.setup(model);
+        trees1.setVariantPool(pool);
+        trees2.setVariantPool(pool);
+
+        for (int i = 0; i < 10; ++i) {
+            vec3d pos1{i * 10., 0, 0}, pos2{i * 10., 100, 0};
+            trees1.addTree(pos1, pool->pick(pos1));
+            trees2.addTree(pos2, pool->pick(pos2));
+        }
+        CHECK(pool->getGeneratedCount() == 0);
+
+        trees1.collect(collector, resolution, ctx1);
+        trees2.collect(collector, resolution, ctx2);
+
+        // Trunk and leaves of each tree
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 40);
+        // Two levels of detail of the trunk and leaves for each variant
+        CHECK(collector.getStorageChannel<Mesh>().size() <= 2 * 4);
+        CHECK(pool->getGeneratedCount() > 0);
+        CHECK(pool->getGeneratedCount() <= 2);
+        CHECK(pool->getByteSize() > 0);
+
+        std::set<std::string> meshIDs;
+
+        for (auto entry : collector.getStorageChannel<Mesh>()) {
+            meshIDs.insert(entry._key.str());
+        }
+
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            const SceneNode &node = entry._value;
+            REQUIRE(meshIDs.count(node.getMeshID()) == 1);
+            REQUIRE(node.getScale().x >= 0.8);
+            REQUIRE(node.getScale().x <= 1.2);
+        }
+    }
+
+    SECTION("distant trees are drawn as impostors") {
+        pool->setImpostorResolution(4);
+        ConstantResolution resolution(3);
+        Collector collector(CollectorPresets::SCENE);
+        collector.addStorageChannel<Image>();
+
+        Tree trees;
+        trees.setup(model);
+        trees.setVariantPool(pool);
+
+        for (int i = 0; i < 10; ++i) {
+            vec3d pos{i * 10., 0, 0};
+            trees.addTree(pos, pool->pick(pos));
+        }
+        trees.collect(collector, resolution, ExplorationContext::getDefault());
+
+        // One impostor node per tree, using the textures of the variant
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 10);
+        CHECK(pool->getImpostorCount() > 0);
+        CHECK(collector.getStorageChannel<Image>().size() ==
+              2 * pool->getImpostorCount());
+
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            const std::string &matID = entry._value.getMaterialID();
+            const Material *material = nullptr;
+
+            for (auto mat : collector.getStorageChannel<Material>()) {
+                if (mat._key.str() == matID) {
+                    material = &mat._value;
+                    REQUIRE(material->isTransparent());
+                    REQUIRE(material->getMapKd() != "");
+                }
+            }
+            REQUIRE(material != nullptr);
+        }
+    }
+}
+
+/** Check that two meshes have the same vertices and faces. */
+static void requireSameMesh(const Mesh &mesh, const Mesh &other) {
+    REQUIRE(mesh.getVerticesCount() == other.getVerticesCount());
+    REQUIRE(mesh.getFaceCount() == other.getFaceCount());
+
+    for (u32 i = 0; i < mesh.getVerticesCount(); ++i) {
+        REQUIRE(mesh.getVertex(i).getPosition() ==
+                other.getVertex(i).getPosition());
+    }
+
+    for (u32 i = 0; i < mesh.getFaceCount(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            REQUIRE(mesh.getFace(i).getID(j) == other.getFace(i).getID(j));
+        }
+    }
+}
+
+TEST_CASE("Tree - parallel generation", "[tree]") {
+    Tree model;
+    model.randomize();
+
+    Tree trees1, trees4;
+    trees1.setup(model);
+    trees4.setup(model);
+    std::vector<u32> indices;
+
+    for (u32 i = 0; i < 12; ++i) {
+        vec3d pos{i * 10., i * -5., 0};
+        trees1.addTree(pos);
+        trees4.addTree(pos);
+        indices.push_back(i);
+    }
+
+    SECTION("models do not depend on the count of threads") {
+        trees1.generate(indices, 1);
+        trees4.generate(indices, 4);
+
+        for (u32 i = 0; i < trees1.getTreeCount(); ++i) {
+            TreeInstance &ti1 = trees1.getTreeInstance(i);
+            TreeInstance &ti4 = trees4.getTreeInstance(i);
+            REQUIRE(ti1._generated);
+            REQUIRE(ti4._generated);
+            REQUIRE(ti1._trunkMesh.getVerticesCount() > 0);
+            requireSameMesh(ti1._trunkMesh, ti4._trunkMesh);
+            requireSameMesh(ti1._leavesMesh, ti4._leavesMesh);
+        }
+    }
+
+    SECTION("models depend on the position of the trees") {
+        CHECK(trees1.getTreeInstance(0)._seed ==
+              trees4.getTreeInstance(0)._seed);
+        CHECK(trees1.getTreeInstance(0)._seed !=
+              trees1.getTreeInstance(1)._seed);
+    }
+
+    SECTION("generation keeps the random engine of the thread") {
+        const std::mt19937 before = paramsRng();
+        trees1.generate(indices, 1);
+        CHECK(paramsRng() == before);
+    }
+
+    SECTION("generated trees are skipped") {
+        trees1.generate({0}, 1);
+        const u32 vertCount =
+            trees1.getTreeInstance(0)._trunkMesh.getVerticesCount();
+        trees1.generate(indices, 4);
+        CHECK(trees1.getTreeInstance(0)._trunkMesh.getVerticesCount() ==
+              vertCount);
+        CHECK(trees1.getTreeInstance(11)._generated);
+    }
+
+    SECTION("pool variants are generated at once") {
+        TreeVariantPool pool(model, 4);
+        pool.generateAll(2);
+        CHECK(pool.getGeneratedCount() == 4);
+    }
+}
+
+/** Mesh channel counting the puts of each mesh. */
+class MeshPutCounter : public CollectorChannel<Mesh> {
+public:
+    std::map<std::string, int> _puts;
+
+    void put(const ItemKey &key, const Mesh &item,
+             const ExplorationContext &ctx) override {
+        ++_puts[ctx(key).str()];
+        CollectorChannel<Mesh>::put(key, item, ctx);
+    }
+};
+
+static void addLeafCardWorkers(Tree &tree, bool leafCards) {
+    tree.addWorker<TreeSkelettonGenerator>();
+    tree.addWorker<TrunkGenerator>(12);
+    tree.addWorker<LeavesGenerator>(0.2, 0.15).setLeafCards(leafCards);
+}
+
+TEST_CASE("Tree - leaf cards", "[tree]") {
+    Tree geometryTree, cardTree;
+    addLeafCardWorkers(geometryTree, false);
+    addLeafCardWorkers(cardTree, true);
+    geometryTree.addTree({10, 20, 0});
+    cardTree.addTree({10, 20, 0});
+    geometryTree.generate({0});
+    cardTree.generate({0});
+
+    TreeInstance &geometry = geometryTree.getTreeInstance(0);
+    TreeInstance &cards = cardTree.getTreeInstance(0);
+
+    SECTION("cards have the place and orientation of the leaves") {
+        // Leaf geometry is duplicated on both sides
+        const u32 leafCount = geometry._leavesMesh.getVerticesCount() / 8;
+        REQUIRE(leafCount > 0);
+        REQUIRE(cards._leafCards.size() == leafCount);
+        CHECK(cards._leavesMesh.getVerticesCount() == 0);
+
+        Mesh expanded;
+        LeavesGenerator::expandLeafCards(cards._leafCards, expanded);
+        REQUIRE(expanded.getVerticesCount() == leafCount * 4);
+        REQUIRE(expanded.getFaceCount() == leafCount * 2);
+
+        for (u32 leaf = 0; leaf < leafCount; ++leaf) {
+            for (u32 i = 0; i < 4; ++i) {
+                const Vertex &vert = expanded.getVertex(leaf * 4 + i);
+                bool found = false;
+
+                for (u32 j = 0; j < 4; ++j) {
+                    const Vertex &other =
+                        geometry._leavesMesh.getVertex(leaf * 4 + j);
+                    found = found ||
+                            (vert.getPosition().length(other.getPosition()) <
+                                 1e-6 &&
+                             vert.getNormal().length(other.getNormal()) <
+                                 1e-6);
+                }
+                REQUIRE(found);
+            }
+        }
+    }
+
+    SECTION("cards are collected as instances") {
+        Collector collector(CollectorPresets::SCENE);
+        auto &buffers = collector.addStorageChannel<InstanceBuffer>();
+        cardTree.collect(collector, ConstantResolution(10),
+                         ExplorationContext::getDefault());
+
+        // Only the trunk is a scene node
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 1);
+        REQUIRE(buffers.size() == 1);
+
+        for (auto entry : buffers) {
+            const InstanceBuffer &buffer = entry._value;
+            CHECK(buffer.size() == cards._leafCards.size());
+            bool hasMesh = false, doubleSided = false;
+
+            for (auto mesh : collector.getStorageChannel<Mesh>()) {
+                hasMesh = hasMesh || mesh._key.str() == buffer.getMeshID();
+            }
+            CHECK(hasMesh);
+
+            for (auto material : collector.getStorageChannel<Material>()) {
+                if (material._key.str() == buffer.getMaterialID()) {
+                    doubleSided = material._value.isDoubleSided();
+                }
+            }
+            CHECK(doubleSided);
+        }
+    }
+
+    SECTION("trees of a node share the card mesh") {
+        cardTree.addTree({40, 20, 0});
+        Collector collector;
+        collector.addStorageChannel<SceneNode>();
+        auto &meshes = collector.addCustomChannel<Mesh, MeshPutCounter>();
+        auto &buffers = collector.addStorageChannel<InstanceBuffer>();
+        cardTree.collect(collector, ConstantResolution(10),
+                         ExplorationContext::getDefault());
+        REQUIRE(buffers.size() == 2);
+        std::set<std::string> meshIDs;
+
+        for (auto entry : buffers) {
+            meshIDs.insert(entry._value.getMeshID());
+        }
+        CHECK(meshIDs.size() == 1);
+        CHECK(meshes._puts["card"] == 1);
+    }
+
+    SECTION("cards are expanded without instancing") {
+        Collector collector(CollectorPresets::SCENE);
+        cardTree.collect(collector, ConstantResolution(10),
+                         ExplorationContext::getDefault());
+
+        CHECK(collector.getStorageChannel<SceneNode>().size() == 2);
+        CHECK(cards._leavesMesh.getVerticesCount() ==
+              cards._leafCards.size() * 4);
+    }
+
+    SECTION("cards follow the transform of the trees") {
+        Tree model;
+        addLeafCardWorkers(model, true);
+        auto pool = std::make_shared<TreeVariantPool>(model, 1);
+        Tree trees;
+        trees.setup(model);
+        trees.setVariantPool(pool);
+
+        for (int i = 0; i < 4; ++i) {
+            vec3d pos{i * 13., i * 7., 0};
+            trees.addTree(pos, pool->pick(pos));
+        }
+
+        Collector collector(CollectorPresets::SCENE);
+        auto &buffers = collector.addStorageChannel<InstanceBuffer>();
+        trees.collect(collector, ConstantResolution(10),
+                      ExplorationContext::getDefault());
+        REQUIRE(buffers.size() == 4);
+        REQUIRE(collector.getStorageChannel<SceneNode>().size() == 4);
+
+        // Local cards of the variant
+        pool->generateAll();
+        Collector localCollector(CollectorPresets::SCENE);
+        auto &localBuffers =
+            localCollector.addStorageChannel<InstanceBuffer>();
+        InstanceBuffer local;
+        pool->collectVariant({}, localCollector, 10, &local);
+        Mesh localMesh;
+        std::vector<InstanceTransform> localCards(local.data(),
+                                                  local.data() + local.size());
+        LeavesGenerator::expandLeafCards(localCards, localMesh);
+        CHECK(localBuffers.size() == 0);
+
+        // Each tree has one trunk, whose node gives the transform of the tree
+        for (auto entry : collector.getStorageChannel<SceneNode>()) {
+            const SceneNode &trunk = entry._value;
+            const NodeKey key = entry._key.last();
+            const std::string prefix = key.substr(0, key.find('.'));
+            const InstanceBuffer *buffer = nullptr;
+
+            for (auto bufferEntry : buffers) {
+                if (bufferEntry._key.last() == prefix + ".cards") {
+                    buffer = &bufferEntry._value;
+                }
+            }
+            REQUIRE(buffer != nullptr);
+
+            std::vector<InstanceTransform> worldCards(
+                buffer->data(), buffer->data() + buffer->size());
+            Mesh worldMesh;
+            LeavesGenerator::expandLeafCards(worldCards, worldMesh);
+            REQUIRE(worldMesh.getVerticesCount() ==
+                    localMesh.getVerticesCount());
+
+            const double angle = trunk.getRotation().z;
+            const double scale = trunk.getScale().x;
+
+            for (u32 i = 0; i < worldMesh.getVerticesCount(); ++i) {
+                const vec3d p = localMesh.getVertex(i).getPosition() * scale;
+                const vec3d expected =
+                    trunk.getPosition() +
+                    vec3d{cos(angle) * p.x - sin(angle) * p.y,
+                          sin(angle) * p.x + cos(angle) * p.y, p.z};
+                // Transforms are stored in single precision
+                REQUIRE(worldMesh.getVertex(i).getPosition().length(
+                            expected) < 1e-3);
+            }
+        }
+    }
+}
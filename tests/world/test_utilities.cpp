@@ -1,5 +1,9 @@
 #include <catch/catch.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <world/core.h>
 
 using namespace world;
@@ -206,6 +210,61 @@ TEST_CASE("GridStorage", "[utilities]") {
     }
 }
 
+TEST_CASE("EpochManager", "[utilities]") {
+    EpochManager epochs;
+    int deleted = 0;
+
+    SECTION("retired objects are deleted after the readers are gone") {
+        {
+            auto guard = epochs.read();
+            epochs.retire([&]() { ++deleted; });
+            epochs.reclaim();
+            CHECK(deleted == 0);
+            CHECK(epochs.retiredCount() == 1);
+        }
+        epochs.reclaim();
+        CHECK(deleted == 1);
+        CHECK(epochs.retiredCount() == 0);
+    }
+
+    SECTION("each object waits for its own readers") {
+        epochs.retire([&]() { ++deleted; });
+        epochs.reclaim();
+        CHECK(deleted == 1);
+
+        // The reader may see the second object
+        auto guard = epochs.read();
+        epochs.retire([&]() { ++deleted; });
+        epochs.reclaim();
+        CHECK(deleted == 1);
+    }
+
+    SECTION("destruction deletes the retired objects") {
+        {
+            EpochManager other;
+            other.retire([&]() { ++deleted; });
+        }
+        CHECK(deleted == 1);
+    }
+
+    SECTION("synchronize") {
+        std::atomic_bool entered{false};
+        std::thread reader([&]() {
+            auto guard = epochs.read();
+            entered = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        });
+
+        while (!entered) {
+            std::this_thread::yield();
+        }
+        epochs.retire([&]() { ++deleted; });
+        epochs.synchronize();
+        CHECK(deleted == 1);
+        reader.join();
+    }
+}
+
 TEST_CASE("Test StringOps.h", "[utilities]") {
 
     SECTION("split") {
@@ -239,3 +298,46 @@ TEST_CASE("Test StringOps.h", "[utilities]") {
         REQUIRE(endsWith(".png", ".png"));
     }
 }
+
+TEST_CASE("ColorMap", "[utilities]") {
+    ColorMap colorMap({5, 5});
+    colorMap.addPoint({0, 0}, Color4d(1, 0, 0));
+    colorMap.addPoint({1, 0.5}, Color4d(0, 1, 0));
+    colorMap.addPoint({0.2, 1}, Color4d(0, 0, 1));
+
+    Color4d c1 = colorMap.getColorAt({0, 0.5});
+    Color4d c2 = colorMap.getColorAt({0.25, 0.5});
+
+    SECTION("bilinear sampling") {
+        colorMap.setBilinearSampling(true);
+
+        Color4d b1 = colorMap.getColorAt({0, 0.5});
+        CHECK(b1._r == Approx(c1._r));
+        CHECK(b1._b == Approx(c1._b));
+
+        Color4d mid = colorMap.getColorAt({0.125, 0.5});
+        CHECK(mid._r == Approx((c1._r + c2._r) / 2));
+        CHECK(mid._g == Approx((c1._g + c2._g) / 2));
+        CHECK(mid._b == Approx((c1._b + c2._b) / 2));
+    }
+
+    SECTION("neighbour count") {
+        // The two nearest points of the center are the last ones
+        colorMap.addPoint({0.9, 0.9}, Color4d(1, 1, 0));
+        colorMap.addPoint({0.6, 0.4}, Color4d(0, 1, 1));
+        colorMap.addPoint({0.3, 0.6}, Color4d(1, 0, 1));
+
+        ColorMap nearestMap({5, 5});
+        nearestMap.addPoint({0.6, 0.4}, Color4d(0, 1, 1));
+        nearestMap.addPoint({0.3, 0.6}, Color4d(1, 0, 1));
+
+        Color4d all = colorMap.getColorAt({0.5, 0.5});
+        colorMap.setNeighbourCount(2);
+        Color4d n1 = colorMap.getColorAt({0.5, 0.5});
+        Color4d expected = nearestMap.getColorAt({0.5, 0.5});
+        CHECK(n1._r == Approx(expected._r));
+        CHECK(n1._g == Approx(expected._g));
+        CHECK(n1._b == Approx(expected._b));
+        CHECK(n1._r != Approx(all._r));
+    }
+}